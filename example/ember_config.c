@@ -57,6 +57,10 @@
  private constants
  ===============================================*/
 
+/* The filesystem directory that holds the web files; paths below it are the
+ * same as those in the ROM filesystem image, if there is one */
+#define WEB_ROOT "/spidisk/web"
+
 /*===============================================
  private data prototypes
  ===============================================*/
@@ -69,16 +73,41 @@ static BaseType_t httpErrorHandler(void *pxc, eHttpStatus code);
 static BaseType_t httpRootHandler(void *pxc);
 static BaseType_t httpStaticHandler(void *pxc);
 static BaseType_t httpCountWebsocketHandler(void *pxc);
+static BaseType_t httpCountEventsHandler(void *pxc);
+static BaseType_t httpStatusHandler(void *pxc);
+static BaseType_t httpUploadHandler(void *pxc);
+static BaseType_t httpUploadPart(
+	void *pvArg,
+	const eMultipartEvent eEvent,
+	const MultipartPart_t *pxPart,
+	const uint8_t *pucData,
+	const size_t uxLen);
+static BaseType_t httpStatusTemplate(
+	void *pvArg,
+	const eTemplateQuery eQuery,
+	const char *pcName,
+	const UBaseType_t uxIteration,
+	char *pcValue,
+	const size_t uxMaxLen);
 
 /*===============================================
  private objects
  ===============================================*/
 
+static const RateLimit_t xHttpConnectLimit = {10, 20};
+static const RateLimit_t xStatusLimit = {2, 4};
+static RouteStats_t xStaticStats;
+static RouteStats_t xStatusStats;
+static RouteCache_t xStatusCache = {1000};
+static RouteQos_t xCountQos = {ePriority_Interactive};
+
 static const RouteItem_t pxRouteItems[] = {
 	{
-		eRouteOption_IgnoreTrailingSlash + eRouteOption_AllowWildcards,
+		eRouteOption_IgnoreTrailingSlash + eRouteOption_AllowWildcards + eRouteOption_StreamBody,
 		httpStaticHandler,
 		(const char const *[]){"static", "%", HTTPD_ROUTE_TERMINATOR},
+		NULL,
+		&xStaticStats,
 	},
 	{
 		eRouteOption_None,
@@ -89,6 +118,33 @@ static const RouteItem_t pxRouteItems[] = {
 		eRouteOption_IgnoreTrailingSlash,
 		httpCountWebsocketHandler,
 		(const char const *[]){"count", HTTPD_ROUTE_TERMINATOR},
+		NULL,
+		NULL,
+		NULL,
+		&xCountQos,
+	},
+	{
+		eRouteOption_IgnoreTrailingSlash,
+		httpCountEventsHandler,
+		(const char const *[]){"count", "events", HTTPD_ROUTE_TERMINATOR},
+	},
+	{
+		eRouteOption_IgnoreTrailingSlash,
+		httpStatusHandler,
+		(const char const *[]){"status", HTTPD_ROUTE_TERMINATOR},
+		&xStatusLimit,
+		&xStatusStats,
+		&xStatusCache,
+	},
+	{
+		eRouteOption_IgnoreTrailingSlash + eRouteOption_StreamBody,
+		httpUploadHandler,
+		(const char const *[]){"upload", HTTPD_ROUTE_TERMINATOR},
+	},
+	{
+		eRouteOption_IgnoreTrailingSlash,
+		xRouteStatsHandler,
+		(const char const *[]){"stats", HTTPD_ROUTE_TERMINATOR},
 	},
 };
 
@@ -104,8 +160,8 @@ const RouteConfig_t xRouteConfig = {
 };
 
 const WebProtoConfig_t pxWebProtocols[] = {
-	{80, 12, "/", HTTPD_CLIENT_SZ, HTTPD_CREATOR_METHOD, HTTPD_WORKER_METHOD, HTTPD_DELETE_METHOD},
-	{21, 4, "/", FTPD_CLIENT_SZ, FTPD_CREATOR_METHOD, FTPD_WORKER_METHOD, FTPD_WORKER_METHOD},
+	{80, 12, "/", HTTPD_CLIENT_SZ, HTTPD_CREATOR_METHOD, HTTPD_WORKER_METHOD, HTTPD_DELETE_METHOD, &xHttpConnectLimit},
+	{21, 4, "/", FTPD_CLIENT_SZ, FTPD_CREATOR_METHOD, FTPD_WORKER_METHOD, FTPD_WORKER_METHOD, NULL, ePriority_Bulk},
 };
 
 const TCPServerConfig_t xWebProtoConfig = {
@@ -130,7 +186,7 @@ static BaseType_t httpErrorHandler(void *pxc, eHttpStatus code)
 	BaseType_t xRc;
 	pxClient->bits.ulFlags = 0;
 	snprintf((char *)pxClient->pcCurrentFilename,
-			 sizeof(pxClient->pcCurrentFilename), "/spidisk/web/error/%d.htm", code);
+			 sizeof(pxClient->pcCurrentFilename), WEB_ROOT "/error/%d.htm", code);
 	pxClient->pxFileHandle = ff_fopen(pxClient->pcCurrentFilename, "r");
 	if (pxClient->pxFileHandle == 0)
 	{
@@ -156,12 +212,17 @@ static BaseType_t httpRootHandler(void *pxc)
 	size_t uxSent;
 	BaseType_t xRc;
 	BaseType_t xLen = 0;
+	const RomfsEntry_t *pxRomFile;
 	if (pxClient->xHttpVerb == eHTTP_GET)
 	{
 		pxClient->bits.ulFlags = 0;
+		// serve the file from the ROM filesystem image in preference
+		pxRomFile = pxRomfsFind("/static/index.htm");
+		if (pxRomFile != NULL)
+			return xSendHttpResponseRom(pxc, pxRomFile);
 		strncpy(pxClient->pxParent->pcContentsType, "text/html",
 				sizeof(pxClient->pxParent->pcContentsType));
-		pxClient->pxFileHandle = ff_fopen("/spidisk/web/static/index.htm", "r");
+		pxClient->pxFileHandle = ff_fopen(WEB_ROOT "/static/index.htm", "r");
 		if (pxClient->pxFileHandle == 0)
 			return httpErrorHandler(pxc, eHTTP_NOT_FOUND);
 		xRc = xSendHttpResponseHeaders(pxClient, eHTTP_REPLY_OK,
@@ -185,17 +246,33 @@ static BaseType_t httpRootHandler(void *pxc)
 static BaseType_t httpStaticHandler(void *pxc)
 {
 	HTTPClient_t *pxClient = (HTTPClient_t *)pxc;
+	const RomfsEntry_t *pxRomFile;
 	BaseType_t xp;
 	BaseType_t xRc;
 	BaseType_t xLen = 0;
+	xp = snprintf((char *)pxClient->pcCurrentFilename,
+				  sizeof(pxClient->pcCurrentFilename), WEB_ROOT "/static");
+	xp += xPrintRoute((char *)&pxClient->pcCurrentFilename[xp],
+					  &pxClient->pcRouteParts[1],
+					  sizeof(pxClient->pcCurrentFilename) - xp);
+	if (pxClient->xHttpVerb == eHTTP_PUT || pxClient->xHttpVerb == eHTTP_DELETE)
+	{
+		// files are stored and deleted below the static directory only
+		for (xp = 1; pxClient->pcRouteParts[xp] != HTTPD_ROUTE_TERMINATOR; xp++)
+			if (pxClient->pcRouteParts[xp][0] == '.')
+				return httpErrorHandler(pxc, eHTTP_BAD_REQUEST);
+		pxClient->bits.ulFlags = 0;
+		if (pxClient->xHttpVerb == eHTTP_PUT)
+			return xReceiveHttpFile(pxc, pxClient->pcCurrentFilename);
+		return xDeleteHttpFile(pxc, pxClient->pcCurrentFilename);
+	}
 	if (pxClient->xHttpVerb == eHTTP_GET)
 	{
-		xp = snprintf((char *)pxClient->pcCurrentFilename,
-					  sizeof(pxClient->pcCurrentFilename), "/spidisk/web/static");
-		xp += xPrintRoute((char *)&pxClient->pcCurrentFilename[xp],
-						  &pxClient->pcRouteParts[1],
-						  sizeof(pxClient->pcCurrentFilename) - xp);
 		pxClient->bits.ulFlags = 0;
+		// serve the file from the ROM filesystem image in preference
+		pxRomFile = pxRomfsFind(&pxClient->pcCurrentFilename[sizeof(WEB_ROOT) - 1]);
+		if (pxRomFile != NULL)
+			return xSendHttpResponseRom(pxc, pxRomFile);
 		pxClient->pxFileHandle = ff_fopen(pxClient->pcCurrentFilename, "r");
 		if (pxClient->pxFileHandle == 0)
 			return httpErrorHandler(pxc, eHTTP_NOT_FOUND);
@@ -222,3 +299,122 @@ static BaseType_t httpCountWebsocketHandler(void *pxc)
 {
 	return xUpgradeToWebsocket(pxc, xSocketCounterMessageHandler, NULL, "/count");
 }
+
+static BaseType_t httpCountEventsHandler(void *pxc)
+{
+	return xUpgradeToEventStream(pxc, SOCKET_COUNTER_STREAM);
+}
+
+static BaseType_t httpStatusHandler(void *pxc)
+{
+	HTTPClient_t *pxClient = (HTTPClient_t *)pxc;
+	BaseType_t xRc;
+	BaseType_t xLen = 0;
+	if (pxClient->xHttpVerb != eHTTP_GET)
+		return httpErrorHandler(pxc, eHTTP_NOT_ALLOWED);
+	pxClient->bits.ulFlags = 0;
+	pxClient->pxFileHandle = ff_fopen(WEB_ROOT "/templates/status.htm.tplc", "r");
+	if (pxClient->pxFileHandle == 0)
+		return httpErrorHandler(pxc, eHTTP_NOT_FOUND);
+	xRc = xSendHttpResponseHeaders(pxc, eHTTP_REPLY_OK,
+								   eResponseOption_ChunkedBody, 0, "text/html", 0);
+	if (xRc < 0)
+		return xRc;
+	xLen += xRc;
+	xRc = xSendHttpResponseTemplate(pxc, httpStatusTemplate, NULL);
+	if (xRc < 0)
+		return xRc;
+	xLen += xRc;
+	return xLen;
+}
+
+static BaseType_t httpStatusTemplate(
+	void *pvArg,
+	const eTemplateQuery eQuery,
+	const char *pcName,
+	const UBaseType_t uxIteration,
+	char *pcValue,
+	const size_t uxMaxLen)
+{
+	(void)pvArg;
+	if (eQuery == eTemplateQuery_Loop)
+		return (strcmp(pcName, "protocols") == 0)
+			   && (uxIteration < xWebProtoConfig.uxNumProtocols);
+	if (strcmp(pcName, "uptime") == 0)
+		return snprintf(pcValue, uxMaxLen, "%lu",
+						(unsigned long)(xTaskGetTickCount() * portTICK_PERIOD_MS));
+	if (strcmp(pcName, "heap") == 0)
+		return snprintf(pcValue, uxMaxLen, "%lu",
+						(unsigned long)xPortGetFreeHeapSize());
+	if (strcmp(pcName, "port") == 0)
+		return snprintf(pcValue, uxMaxLen, "%ld",
+						(long)pxWebProtocols[uxIteration].xPortNum);
+	if (strcmp(pcName, "backlog") == 0)
+		return snprintf(pcValue, uxMaxLen, "%ld",
+						(long)pxWebProtocols[uxIteration].xBacklog);
+	return 0;
+}
+
+static BaseType_t httpUploadHandler(void *pxc)
+{
+	HTTPClient_t *pxClient = (HTTPClient_t *)pxc;
+	if (pxClient->xHttpVerb != eHTTP_POST)
+		return httpErrorHandler(pxc, eHTTP_NOT_ALLOWED);
+	pxClient->bits.ulFlags = 0;
+	return xReceiveHttpMultipart(pxc, httpUploadPart, pxc);
+}
+
+static BaseType_t httpUploadPart(
+	void *pvArg,
+	const eMultipartEvent eEvent,
+	const MultipartPart_t *pxPart,
+	const uint8_t *pucData,
+	const size_t uxLen)
+{
+	HTTPClient_t *pxClient = (HTTPClient_t *)pvArg;
+	static const char pcUploaded[] = "Uploaded";
+	BaseType_t xRc;
+	switch (eEvent)
+	{
+	case eMultipartEvent_PartStart:
+		// only file parts are stored, in the static files directory; the
+		// filename has no path, but may still be "." or ".."
+		if (pxPart->pcFilename[0] == 0)
+			return 0;
+		if (pxPart->pcFilename[0] == '.')
+			return -eHTTP_BAD_REQUEST;
+		snprintf((char *)pxClient->pcCurrentFilename,
+				 sizeof(pxClient->pcCurrentFilename), WEB_ROOT "/static/%s",
+				 pxPart->pcFilename);
+		pxClient->pxFileHandle = ff_fopen(pxClient->pcCurrentFilename, "w");
+		return (pxClient->pxFileHandle != 0) ? 0 : -eHTTP_INTERNAL_SERVER_ERROR;
+	case eMultipartEvent_PartData:
+		if (pxClient->pxFileHandle == 0)
+			return 0;
+		return (ff_fwrite(pucData, 1, uxLen, pxClient->pxFileHandle) == uxLen)
+				   ? 0
+				   : -eHTTP_INTERNAL_SERVER_ERROR;
+	case eMultipartEvent_PartEnd:
+		if (pxClient->pxFileHandle != 0)
+			ff_fclose(pxClient->pxFileHandle);
+		pxClient->pxFileHandle = 0;
+		return 0;
+	case eMultipartEvent_End:
+		xRc = xSendHttpResponseHeaders(pxClient, eHTTP_REPLY_OK,
+									   eResponseOption_ContentLength,
+									   sizeof(pcUploaded) - 1, "text/plain", 0);
+		if (xRc < 0)
+			return xRc;
+		return xRc + xSendHttpResponseContent(pxClient, (char *)pcUploaded,
+											   sizeof(pcUploaded) - 1);
+	default:
+		// discard a partly written file
+		if (pxClient->pxFileHandle != 0)
+		{
+			ff_fclose(pxClient->pxFileHandle);
+			ff_remove(pxClient->pcCurrentFilename);
+		}
+		pxClient->pxFileHandle = 0;
+		return 0;
+	}
+}
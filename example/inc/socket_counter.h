@@ -53,6 +53,8 @@
  public constants
  ===============================================*/
 
+#define SOCKET_COUNTER_STREAM "count"
+
 /*===============================================
  public data prototypes
  ===============================================*/
@@ -49,7 +49,7 @@
 #include <FreeRTOS.h>
 #include <ember.h>
 #include <websocketd.h>
-#include <core_json.h>
+#include <ssed.h>
 #include <socket_counter.h>
 
 /*===============================================
@@ -120,23 +120,20 @@ void vSocketCounter_DeInit(void)
 BaseType_t xSocketCounterMessageHandler(void *pxc)
 {
 	WebsocketClient_t *pxClient = (WebsocketClient_t *)pxc;
-	char *pcFieldVal;
-	size_t xFieldSz;
-	JSONTypes_t xFieldType;
-	JSONStatus_t xStatus;
-	xStatus = JSON_Validate(pxClient->pcPayload, pxClient->xPayloadSz);
-	if (xStatus != JSONSuccess)
+	const JsonToken_t *pxField;
+	int32_t lValue;
+	// the message was validated and indexed as it was received
+	if (pxClient->pxJson == NULL)
 		return -1;
-	xStatus = JSON_SearchT(pxClient->pcPayload, pxClient->xPayloadSz, "get", 3, &pcFieldVal, &xFieldSz, &xFieldType);
-	if (xStatus == JSONSuccess)
+	if (pxJsonGet(pxClient->pxJson, "get") != NULL)
 	{
 		char msg[32];
 		return xSendWebsocketTextMessage(pxc, msg, snprintf(msg, sizeof(msg), "{\"count\":%d}", prvCount));
 	}
-	xStatus = JSON_SearchT(pxClient->pcPayload, pxClient->xPayloadSz, "set", 3, &pcFieldVal, &xFieldSz, &xFieldType);
-	if (xStatus == JSONSuccess && xFieldType == JSONNumber)
+	pxField = pxJsonGet(pxClient->pxJson, "set");
+	if (pxField != NULL && xJsonInteger(pxClient->pxJson, pxField, &lValue))
 	{
-		prvCount = atoi(pcFieldVal);
+		prvCount = lValue;
 		return 0;
 	}
 	return 0;
@@ -150,10 +147,14 @@ static void prvSocketCounter_Service(void *pvArgs)
 {
 	char pcMsg[32];
 	SocketCounterActionArgs_t xSelectArg = {"/count", pcMsg, 0};
+	// the count is also published to server-sent events clients, at "/count/events"
+	EventStream_t *pxStream = pxEventStreamCreate(SOCKET_COUNTER_STREAM, 256);
 	while (1)
 	{
 		xSelectArg.xMsgLen = snprintf(pcMsg, sizeof(pcMsg), "{\"count\":%d}", prvCount);
 		Ember_SelectClients(prvUpdateWebSockets, &xSelectArg);
+		if (pxStream)
+			xEventStreamPublish(pxStream, "count", pcMsg, xSelectArg.xMsgLen);
 		vTaskDelay(1000);
 		prvCount++;
 	}
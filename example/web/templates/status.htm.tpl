@@ -0,0 +1,19 @@
+<!DOCTYPE html>
+<html>
+<head>
+<meta charset="utf-8">
+<title>EMBER status</title>
+</head>
+<body>
+{{! rendered by httpStatusHandler in example/ember_config.c }}
+<h1>EMBER status</h1>
+<p>Uptime: {{uptime}} ms</p>
+<p>Free heap: {{heap}} bytes</p>
+<table>
+<tr><th>Port</th><th>Backlog</th></tr>
+{{#protocols}}
+<tr><td>{{port}}</td><td>{{backlog}}</td></tr>
+{{/protocols}}
+</table>
+</body>
+</html>
@@ -0,0 +1,513 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <FreeRTOS_IP.h>
+#include <string.h>
+#include "inc/deflate.h"
+
+#if (emberDEFLATE_WINDOW_BITS < 8) || (emberDEFLATE_WINDOW_BITS > 14)
+#error "emberDEFLATE_WINDOW_BITS must be from 8 to 14"
+#endif
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+/* An empty entry of a hash chain */
+#define deflateNIL                 (0xFFFFu)
+#define deflateMIN_MATCH           (3)
+#define deflateMAX_MATCH           (258)
+/* The end-of-block symbol */
+#define deflateEOB                 (256)
+/* The three bits that start a block: BFINAL, then BTYPE = 01 (fixed codes) */
+#define deflateBLOCK_FIXED         (2)
+#define deflateBLOCK_FIXED_FINAL   (3)
+
+/* The base lengths, and numbers of extra bits, of the length symbols 257-285 */
+static const uint16_t pusLengthBase[] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t pucLengthExtra[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+/* The base distances, and numbers of extra bits, of the distance codes 0-29 */
+static const uint16_t pusDistanceBase[] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+	16385, 24577,
+};
+static const uint8_t pucDistanceExtra[] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+/* The bits of each nibble, reversed */
+static const uint8_t pucReverse[16] = {
+	0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+	0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF,
+};
+/* The CRC-32 of each nibble, for a table-driven CRC that fits in 64 bytes */
+static const uint32_t pulCrcTable[16] = {
+	0x00000000u, 0x1DB71064u, 0x3B6E20C8u, 0x26D930ACu,
+	0x76DC4190u, 0x6B6B51F4u, 0x4DB26158u, 0x5005713Cu,
+	0xEDB88320u, 0xF00F9344u, 0xD6D6A3E8u, 0xCB61B38Cu,
+	0x9B64C2B0u, 0x86D3D2D4u, 0xA00AE278u, 0xBDBDF21Cu,
+};
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static void prvCompress(DeflateStream_t *pxStream, size_t uxPos, const size_t uxEnd);
+static size_t prvLongestMatch(
+	DeflateStream_t *pxStream,
+	const size_t uxPos,
+	const size_t uxEnd,
+	size_t *puxDistance);
+static void prvInsert(DeflateStream_t *pxStream, const size_t uxPos);
+static UBaseType_t prvHash(const uint8_t *pucKey);
+static void prvPutSymbol(DeflateStream_t *pxStream, const UBaseType_t uxSymbol);
+static void prvPutMatch(
+	DeflateStream_t *pxStream,
+	const size_t uxLen,
+	const size_t uxDistance);
+static void prvPutBits(
+	DeflateStream_t *pxStream,
+	const uint32_t ulValue,
+	const UBaseType_t uxCount);
+static void prvAlign(DeflateStream_t *pxStream);
+static void prvPutByte(DeflateStream_t *pxStream, const uint8_t ucByte);
+static void prvEmit(DeflateStream_t *pxStream);
+static void prvUpdateCheck(
+	DeflateStream_t *pxStream,
+	const uint8_t *pucData,
+	const size_t uxLen);
+static uint32_t prvReverse(const uint32_t ulCode, const UBaseType_t uxLen);
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+DeflateStream_t *pxDeflateStart(
+	const eDeflateFormat eFormat,
+	xDeflateSink *pxSink,
+	void *pvArg)
+{
+	DeflateStream_t *pxStream;
+	uint32_t ulHeader;
+	pxStream = (DeflateStream_t *)pvPortMalloc(sizeof(DeflateStream_t));
+	if (pxStream == NULL)
+		return NULL;
+	pxStream->pxSink = pxSink;
+	pxStream->pvArg = pvArg;
+	pxStream->xFormat = eFormat;
+	pxStream->ulTotal = 0;
+	pxStream->xError = 0;
+	pxStream->uxSent = 0;
+	pxStream->ulBits = 0;
+	pxStream->uxBitCount = 0;
+	pxStream->xBlockOpen = pdFALSE;
+	pxStream->uxPos = 0;
+	pxStream->uxOutLen = 0;
+	memset(pxStream->pusHead, 0xFF, sizeof(pxStream->pusHead));
+	if (eFormat == eDeflateFormat_Gzip)
+	{
+		// no file name or modification time, and an unknown OS
+		static const uint8_t pucGzipHeader[] = {
+			0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF,
+		};
+		memcpy(pxStream->pucOut, pucGzipHeader, sizeof(pucGzipHeader));
+		pxStream->uxOutLen = sizeof(pucGzipHeader);
+		pxStream->ulCheck = 0;
+	}
+	else
+	{
+		// the window size, then the check bits that make the header a
+		// multiple of 31
+		ulHeader = (uint32_t)(0x08 | ((emberDEFLATE_WINDOW_BITS - 8) << 4)) << 8;
+		ulHeader += (31 - (ulHeader % 31)) % 31;
+		pxStream->pucOut[0] = (uint8_t)(ulHeader >> 8);
+		pxStream->pucOut[1] = (uint8_t)ulHeader;
+		pxStream->uxOutLen = 2;
+		pxStream->ulCheck = 1;
+	}
+	return pxStream;
+}
+
+uint8_t *pucDeflateInput(DeflateStream_t *pxStream, size_t *puxSpace)
+{
+	uint16_t *pusEntry;
+	if ((2 * DEFLATE_WINDOW_SZ) - pxStream->uxPos < DEFLATE_WINDOW_SZ / 4)
+	{
+		// slide the window by its size, so that the chains, which are indexed
+		// by position modulo the window size, stay where they are
+		memmove(pxStream->pucWindow, &pxStream->pucWindow[DEFLATE_WINDOW_SZ],
+				pxStream->uxPos - DEFLATE_WINDOW_SZ);
+		pxStream->uxPos -= DEFLATE_WINDOW_SZ;
+		for (pusEntry = pxStream->pusHead;
+			 pusEntry < &pxStream->pusHead[1u << emberDEFLATE_HASH_BITS]; pusEntry++)
+			*pusEntry = (*pusEntry != deflateNIL && *pusEntry >= DEFLATE_WINDOW_SZ)
+							? (uint16_t)(*pusEntry - DEFLATE_WINDOW_SZ)
+							: deflateNIL;
+		for (pusEntry = pxStream->pusPrev;
+			 pusEntry < &pxStream->pusPrev[DEFLATE_WINDOW_SZ]; pusEntry++)
+			*pusEntry = (*pusEntry != deflateNIL && *pusEntry >= DEFLATE_WINDOW_SZ)
+							? (uint16_t)(*pusEntry - DEFLATE_WINDOW_SZ)
+							: deflateNIL;
+	}
+	*puxSpace = (2 * DEFLATE_WINDOW_SZ) - pxStream->uxPos;
+	return &pxStream->pucWindow[pxStream->uxPos];
+}
+
+BaseType_t xDeflateCommit(
+	DeflateStream_t *pxStream,
+	const size_t uxLen,
+	const BaseType_t xFlush)
+{
+	const size_t uxStart = pxStream->uxPos;
+	pxStream->uxSent = 0;
+	if (pxStream->xError < 0)
+		return pxStream->xError;
+	if (uxLen > 0)
+	{
+		prvUpdateCheck(pxStream, &pxStream->pucWindow[uxStart], uxLen);
+		pxStream->ulTotal += (uint32_t)uxLen;
+		pxStream->uxPos += uxLen;
+		if (!pxStream->xBlockOpen)
+		{
+			prvPutBits(pxStream, deflateBLOCK_FIXED, 3);
+			pxStream->xBlockOpen = pdTRUE;
+		}
+		prvCompress(pxStream, uxStart, pxStream->uxPos);
+	}
+	if (xFlush)
+	{
+		// end the block, and align the stream with an empty stored block
+		if (pxStream->xBlockOpen)
+		{
+			prvPutSymbol(pxStream, deflateEOB);
+			pxStream->xBlockOpen = pdFALSE;
+			prvPutBits(pxStream, 0, 3);
+			prvAlign(pxStream);
+			prvPutByte(pxStream, 0x00);
+			prvPutByte(pxStream, 0x00);
+			prvPutByte(pxStream, 0xFF);
+			prvPutByte(pxStream, 0xFF);
+		}
+		prvEmit(pxStream);
+	}
+	if (pxStream->xError < 0)
+		return pxStream->xError;
+	return (BaseType_t)pxStream->uxSent;
+}
+
+BaseType_t xDeflateWrite(
+	DeflateStream_t *pxStream,
+	const uint8_t *pucData,
+	size_t uxLen,
+	const BaseType_t xFlush)
+{
+	uint8_t *pucDst;
+	size_t uxSpace, uxSent = 0;
+	BaseType_t xRc;
+	do
+	{
+		pucDst = pucDeflateInput(pxStream, &uxSpace);
+		if (uxSpace > uxLen)
+			uxSpace = uxLen;
+		memcpy(pucDst, pucData, uxSpace);
+		pucData += uxSpace;
+		uxLen -= uxSpace;
+		xRc = xDeflateCommit(pxStream, uxSpace, xFlush && uxLen == 0);
+		if (xRc < 0)
+			return xRc;
+		uxSent += (size_t)xRc;
+	} while (uxLen > 0);
+	return (BaseType_t)uxSent;
+}
+
+BaseType_t xDeflateFinish(DeflateStream_t *pxStream)
+{
+	uint32_t ulCheck = pxStream->ulCheck;
+	pxStream->uxSent = 0;
+	if (pxStream->xError < 0)
+		return pxStream->xError;
+	if (pxStream->xBlockOpen)
+		prvPutSymbol(pxStream, deflateEOB);
+	// an empty final block
+	prvPutBits(pxStream, deflateBLOCK_FIXED_FINAL, 3);
+	prvPutSymbol(pxStream, deflateEOB);
+	pxStream->xBlockOpen = pdFALSE;
+	prvAlign(pxStream);
+	if (pxStream->xFormat == eDeflateFormat_Gzip)
+	{
+		// the CRC-32 and length, little-endian
+		for (UBaseType_t uxi = 0; uxi < 4; uxi++, ulCheck >>= 8)
+			prvPutByte(pxStream, (uint8_t)ulCheck);
+		for (UBaseType_t uxi = 0; uxi < 4; uxi++)
+			prvPutByte(pxStream, (uint8_t)(pxStream->ulTotal >> (uxi * 8)));
+	}
+	else
+	{
+		// the Adler-32, big-endian
+		for (UBaseType_t uxi = 0; uxi < 4; uxi++)
+			prvPutByte(pxStream, (uint8_t)(ulCheck >> (24 - uxi * 8)));
+	}
+	prvEmit(pxStream);
+	if (pxStream->xError < 0)
+		return pxStream->xError;
+	return (BaseType_t)pxStream->uxSent;
+}
+
+void vDeflateStop(DeflateStream_t *pxStream)
+{
+	vPortFree(pxStream);
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+static void prvCompress(DeflateStream_t *pxStream, size_t uxPos, const size_t uxEnd)
+{
+	size_t uxLen, uxDistance;
+	// greedy matching: the longest match at each position is taken
+	while (uxPos < uxEnd)
+	{
+		uxLen = 0;
+		if (uxEnd - uxPos >= deflateMIN_MATCH)
+		{
+			uxLen = prvLongestMatch(pxStream, uxPos, uxEnd, &uxDistance);
+			prvInsert(pxStream, uxPos);
+		}
+		if (uxLen < deflateMIN_MATCH)
+		{
+			prvPutSymbol(pxStream, pxStream->pucWindow[uxPos]);
+			uxPos++;
+			continue;
+		}
+		prvPutMatch(pxStream, uxLen, uxDistance);
+		// the rest of the match can be found by later matches
+		for (size_t uxi = 1; uxi < uxLen; uxi++)
+		{
+			if (uxPos + uxi + deflateMIN_MATCH <= uxEnd)
+				prvInsert(pxStream, uxPos + uxi);
+		}
+		uxPos += uxLen;
+	}
+}
+
+static size_t prvLongestMatch(
+	DeflateStream_t *pxStream,
+	const size_t uxPos,
+	const size_t uxEnd,
+	size_t *puxDistance)
+{
+	const uint8_t *pucWindow = pxStream->pucWindow;
+	const size_t uxMax = (uxEnd - uxPos < deflateMAX_MATCH) ? uxEnd - uxPos
+															 : deflateMAX_MATCH;
+	const uint8_t *pucHere = &pucWindow[uxPos];
+	const uint8_t *pucThere;
+	size_t uxBest = 0, uxLen, uxCandidate;
+	UBaseType_t uxChain = emberDEFLATE_CHAIN_LENGTH;
+	uxCandidate = pxStream->pusHead[prvHash(pucHere)];
+	// a chain entry is only valid while it is within the window
+	while (uxCandidate != deflateNIL && uxCandidate < uxPos
+		   && uxPos - uxCandidate < DEFLATE_WINDOW_SZ && uxChain-- > 0)
+	{
+		pucThere = &pucWindow[uxCandidate];
+		// a candidate that cannot be longer than the best is skipped quickly
+		if (pucThere[uxBest] == pucHere[uxBest] && pucThere[0] == pucHere[0])
+		{
+			for (uxLen = 1; uxLen < uxMax && pucThere[uxLen] == pucHere[uxLen]; uxLen++)
+				;
+			if (uxLen > uxBest)
+			{
+				uxBest = uxLen;
+				*puxDistance = uxPos - uxCandidate;
+				if (uxLen == uxMax)
+					break;
+			}
+		}
+		uxCandidate = pxStream->pusPrev[uxCandidate & (DEFLATE_WINDOW_SZ - 1)];
+	}
+	return uxBest;
+}
+
+static void prvInsert(DeflateStream_t *pxStream, const size_t uxPos)
+{
+	uint16_t *pusHead = &pxStream->pusHead[prvHash(&pxStream->pucWindow[uxPos])];
+	pxStream->pusPrev[uxPos & (DEFLATE_WINDOW_SZ - 1)] = *pusHead;
+	*pusHead = (uint16_t)uxPos;
+}
+
+static UBaseType_t prvHash(const uint8_t *pucKey)
+{
+	// a multiplicative hash of the three bytes that start a match
+	return (UBaseType_t)(((((uint32_t)pucKey[0] << 16) | ((uint32_t)pucKey[1] << 8)
+						   | pucKey[2]) * 2654435761u)
+						 >> (32 - emberDEFLATE_HASH_BITS));
+}
+
+static void prvPutSymbol(DeflateStream_t *pxStream, const UBaseType_t uxSymbol)
+{
+	// the fixed literal/length code of RFC 1951, 3.2.6
+	if (uxSymbol < 144)
+		prvPutBits(pxStream, prvReverse(0x30 + uxSymbol, 8), 8);
+	else if (uxSymbol < 256)
+		prvPutBits(pxStream, prvReverse(0x190 + uxSymbol - 144, 9), 9);
+	else if (uxSymbol < 280)
+		prvPutBits(pxStream, prvReverse(uxSymbol - 256, 7), 7);
+	else
+		prvPutBits(pxStream, prvReverse(0xC0 + uxSymbol - 280, 8), 8);
+}
+
+static void prvPutMatch(
+	DeflateStream_t *pxStream,
+	const size_t uxLen,
+	const size_t uxDistance)
+{
+	UBaseType_t uxCode = sizeof(pusLengthBase) / sizeof(pusLengthBase[0]) - 1;
+	while (pusLengthBase[uxCode] > uxLen)
+		uxCode--;
+	prvPutSymbol(pxStream, 257 + uxCode);
+	prvPutBits(pxStream, (uint32_t)(uxLen - pusLengthBase[uxCode]), pucLengthExtra[uxCode]);
+	uxCode = sizeof(pusDistanceBase) / sizeof(pusDistanceBase[0]) - 1;
+	while (pusDistanceBase[uxCode] > uxDistance)
+		uxCode--;
+	// distance codes are all 5 bits long
+	prvPutBits(pxStream, prvReverse(uxCode, 5), 5);
+	prvPutBits(pxStream, (uint32_t)(uxDistance - pusDistanceBase[uxCode]),
+			   pucDistanceExtra[uxCode]);
+}
+
+static void prvPutBits(
+	DeflateStream_t *pxStream,
+	const uint32_t ulValue,
+	const UBaseType_t uxCount)
+{
+	// bits are packed from the least significant bit of each byte
+	pxStream->ulBits |= ulValue << pxStream->uxBitCount;
+	pxStream->uxBitCount += uxCount;
+	while (pxStream->uxBitCount >= 8)
+	{
+		prvPutByte(pxStream, (uint8_t)pxStream->ulBits);
+		pxStream->ulBits >>= 8;
+		pxStream->uxBitCount -= 8;
+	}
+}
+
+static void prvAlign(DeflateStream_t *pxStream)
+{
+	if (pxStream->uxBitCount > 0)
+		prvPutBits(pxStream, 0, 8 - pxStream->uxBitCount);
+}
+
+static void prvPutByte(DeflateStream_t *pxStream, const uint8_t ucByte)
+{
+	if (pxStream->uxOutLen == sizeof(pxStream->pucOut))
+		prvEmit(pxStream);
+	pxStream->pucOut[pxStream->uxOutLen++] = ucByte;
+}
+
+static void prvEmit(DeflateStream_t *pxStream)
+{
+	BaseType_t xRc;
+	if (pxStream->uxOutLen > 0 && pxStream->xError >= 0)
+	{
+		xRc = pxStream->pxSink(pxStream->pvArg, pxStream->pucOut, pxStream->uxOutLen);
+		if (xRc < 0)
+			pxStream->xError = xRc;
+		else
+			pxStream->uxSent += pxStream->uxOutLen;
+	}
+	pxStream->uxOutLen = 0;
+}
+
+static void prvUpdateCheck(
+	DeflateStream_t *pxStream,
+	const uint8_t *pucData,
+	const size_t uxLen)
+{
+	uint32_t ulCrc, ulA, ulB;
+	size_t uxi;
+	if (pxStream->xFormat == eDeflateFormat_Gzip)
+	{
+		ulCrc = ~pxStream->ulCheck;
+		for (uxi = 0; uxi < uxLen; uxi++)
+		{
+			ulCrc ^= pucData[uxi];
+			ulCrc = (ulCrc >> 4) ^ pulCrcTable[ulCrc & 0xF];
+			ulCrc = (ulCrc >> 4) ^ pulCrcTable[ulCrc & 0xF];
+		}
+		pxStream->ulCheck = ~ulCrc;
+		return;
+	}
+	ulA = pxStream->ulCheck & 0xFFFF;
+	ulB = pxStream->ulCheck >> 16;
+	for (uxi = 0; uxi < uxLen; uxi++)
+	{
+		ulA += pucData[uxi];
+		if (ulA >= 65521u)
+			ulA -= 65521u;
+		ulB += ulA;
+		if (ulB >= 65521u)
+			ulB -= 65521u;
+	}
+	pxStream->ulCheck = (ulB << 16) | ulA;
+}
+
+static uint32_t prvReverse(const uint32_t ulCode, const UBaseType_t uxLen)
+{
+	uint32_t ulReversed = ((uint32_t)pucReverse[ulCode & 0xF] << 8)
+						  | ((uint32_t)pucReverse[(ulCode >> 4) & 0xF] << 4)
+						  | pucReverse[(ulCode >> 8) & 0xF];
+	return ulReversed >> (12 - uxLen);
+}
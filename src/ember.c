@@ -83,7 +83,12 @@ static BaseType_t prvCreateProtocolServer(
 	WebProtoServer_t *pxProto,
 	const WebProtoConfig_t *pxProtoCfg);
 static void prvTCPServerWork(void);
-static void prvAcceptNewClient(WebProtoServer_t *pxProto, Socket_t xNewSock);
+static void prvServiceClients(const BaseType_t xPriority);
+static void prvShareBulkBudget(void);
+static void prvAcceptNewClient(
+	WebProtoServer_t *pxProto,
+	Socket_t xNewSock,
+	const struct freertos_sockaddr *pxAddr);
 static TCPClient_t *prvRemoveClient(TCPClient_t *pxClient);
 static TCPClient_t *prvDropClient(TCPClient_t *pxClient);
 
@@ -100,6 +105,10 @@ static const TCPServerConfig_t _xWebProtoConfig = {0, 0};
  private global variables
  ===============================================*/
 
+/* The order in which the priority classes are served in each pass */
+static const BaseType_t pxServiceOrder[] =
+	{ ePriority_Interactive, ePriority_Normal, ePriority_Bulk };
+
 static EmberConfig_t xEmber =
 	{ pdFALSE, emberSTACK_SIZE, emberSTARTUP_DELAY_MS, emberPERIOD_MS, 0, &xWebProtoConfig, 0 };;
 
@@ -158,6 +167,10 @@ static void prvEmber_Service(void *args)
 		xEmber.xReady = pdFALSE;
 		return;
 	}
+#if (emberFILE_IO_TASK != 0)
+	// if the I/O task cannot be started, files are read inline instead
+	xEmberIOInit();
+#endif
 	while (1)
 	{
 		prvTCPServerWork();
@@ -231,12 +244,13 @@ static BaseType_t prvCreateProtocolServer(
 	pxProto->xCreator = pxProtoCfg->xCreator;
 	pxProto->xWorker = pxProtoCfg->xWorker;
 	pxProto->xDelete = pxProtoCfg->xDelete;
+	pxProto->pxRateLimit = pxProtoCfg->pxRateLimit;
+	pxProto->xPriority = pxProtoCfg->xPriority;
 	return pdTRUE;
 }
 
 static void prvTCPServerWork(void)
 {
-	TCPClient_t *currClient;
 	BaseType_t xRc;
 	if (!xEmber.xReady || !xEmber.pxServer)
 		return;
@@ -254,17 +268,45 @@ static void prvTCPServerWork(void)
 				continue;
 			newSock = FreeRTOS_accept(currProto->xSock, &sockAddr, &newSockLen);
 			if (newSock != FREERTOS_INVALID_SOCKET && newSock != FREERTOS_NO_SOCKET)
-				prvAcceptNewClient(currProto, newSock);
+				prvAcceptNewClient(currProto, newSock, &sockAddr);
 		}
 	}
-	// service existing connections/clients
+	// service existing connections/clients, a priority class at a time; a client
+	// whose class changes while it is served may be served twice, or not at all,
+	// in this pass
+	for (size_t i = 0; i < sizeof(pxServiceOrder) / sizeof(pxServiceOrder[0]); i++)
+	{
+		if (pxServiceOrder[i] == ePriority_Bulk)
+			prvShareBulkBudget();
+		prvServiceClients(pxServiceOrder[i]);
+	}
+}
+
+static void prvServiceClients(const BaseType_t xPriority)
+{
+	TCPClient_t *currClient;
+	BaseType_t xRc, xClass;
 	currClient = xEmber.pxServer->pxClients;
 	while (currClient)
 	{
+		// clients of an unknown class are served as normal clients
+		xClass = currClient->xPriority;
+		if (xClass != ePriority_Interactive && xClass != ePriority_Bulk)
+			xClass = ePriority_Normal;
+		if (xClass != xPriority)
+		{
+			currClient = currClient->pxNextClient;
+			continue;
+		}
 		BaseType_t sockLive = FreeRTOS_issocketconnected(currClient->xSock);
 		if (sockLive == pdTRUE)
 		{
-			xRc = currClient->xWork(currClient);
+			// queued output must be transmitted before the client does any more work
+			xRc = 0;
+			if (currClient->pxOutputHead != NULL)
+				xRc = xEmberDrain(currClient);
+			if (xRc >= 0 && currClient->pxOutputHead == NULL)
+				xRc = currClient->xWork(currClient);
 			if (xRc < 0)
 				currClient = prvRemoveClient(currClient);
 			else
@@ -277,8 +319,36 @@ static void prvTCPServerWork(void)
 	}
 }
 
-static void prvAcceptNewClient(WebProtoServer_t *pxProto, Socket_t xNewSock)
+static void prvShareBulkBudget(void)
 {
+	TCPClient_t *pxClient;
+	size_t uxCount = 0;
+	for (pxClient = xEmber.pxServer->pxClients; pxClient; pxClient = pxClient->pxNextClient)
+	{
+		if (pxClient->xPriority == ePriority_Bulk)
+			uxCount++;
+	}
+	// an equal share for each, so that no bulk client is starved by the others
+	xEmber.pxServer->uxBulkShare = emberBULK_PASS_BUDGET;
+	if (uxCount > 1)
+		xEmber.pxServer->uxBulkShare /= uxCount;
+	if (xEmber.pxServer->uxBulkShare == 0)
+		xEmber.pxServer->uxBulkShare = 1;
+}
+
+static void prvAcceptNewClient(
+	WebProtoServer_t *pxProto,
+	Socket_t xNewSock,
+	const struct freertos_sockaddr *pxAddr)
+{
+	// refuse connections from an address that is opening them too quickly,
+	// before any resources are committed to it
+	if (xEmberRateLimit(xEmber.pxServer, pxAddr->sin_address.ulIP_IPv4,
+						pxProto->pxRateLimit) != pdTRUE)
+	{
+		FreeRTOS_closesocket(xNewSock);
+		return;
+	}
 	xSemaphoreTake(xEmber.pxServer->xClientMutex, portMAX_DELAY);
 	TCPClient_t *newClient = 0;
 	// (try to) malloc enough space for a suitable new TCP client struct
@@ -292,9 +362,11 @@ static void prvAcceptNewClient(WebProtoServer_t *pxProto, Socket_t xNewSock)
 	memset(newClient, 0, pxProto->uxClientSz);
 	newClient->pxParent = pxProto->pxParent;
 	newClient->xSock = xNewSock;
+	newClient->ulRemoteAddress = pxAddr->sin_address.ulIP_IPv4;
 	newClient->xCreator = pxProto->xCreator;
 	newClient->xWork = pxProto->xWorker;
 	newClient->xDelete = pxProto->xDelete;
+	newClient->xPriority = pxProto->xPriority;
 	// try to create the new client; if this fails, delete it and ditch
 	if (newClient->xCreator && newClient->xCreator(newClient) != 0)
 	{
@@ -334,6 +406,7 @@ static TCPClient_t *prvDropClient(TCPClient_t *pxClient)
 	// close any system resources used by the client (file handles, typically)
 	if (pxClient->xDelete)
 		pxClient->xDelete(pxClient);
+	vEmberDiscardOutput(pxClient);
 	// close the client's socket
 	if (pxClient->xSock != FREERTOS_NO_SOCKET)
 	{
@@ -0,0 +1,657 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <FreeRTOS_IP.h>
+#include <ff_stdio.h>
+#include <task.h>
+#include <queue.h>
+#include <string.h>
+#include "inc/ember_private.h"
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+static const char pcHexDigits[] = "0123456789abcdef";
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+typedef struct
+{
+	FileReadAhead_t *pxReadAhead;
+	BaseType_t xIndex;
+} ReadRequest_t;
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static BaseType_t prvSendComplete(
+	TCPServer_t *pxServer,
+	Socket_t xSock,
+	const BaseType_t xRc,
+	const BaseType_t xWantWrite,
+	const size_t uxSent);
+static void prvSetCloseAfterSend(Socket_t xSock);
+static BaseType_t prvCorkDrain(TCPServer_t *pxServer);
+static BaseType_t prvSendOrQueue(
+	TCPClient_t *pxClient,
+	const char *pcData,
+	const size_t uxLen);
+static BaseType_t prvQueueOutput(
+	TCPClient_t *pxClient,
+	const char *pcData,
+	const size_t uxLen);
+static void prvEmberIO_Service(void *pvArgs);
+static void prvReadAheadFill(FileReadAhead_t *pxReadAhead);
+static void prvReadAheadRelease(FileReadAhead_t *pxReadAhead);
+
+/*===============================================
+ private global variables
+ ===============================================*/
+
+static TaskHandle_t xIOTask = NULL;
+static QueueHandle_t xIOQueue = NULL;
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+BaseType_t xEmberSendFile(
+	TCPServer_t *pxServer,
+	Socket_t xSock,
+	FF_FILE *pxFile,
+	size_t *puxBytesLeft,
+	const size_t uxBudget,
+	const UBaseType_t uxOpts)
+{
+	char *pcBuffer;
+	BaseType_t xSpace, xRc = 0;
+	size_t uxCount, uxSent = 0;
+	if (pxFile == NULL)
+		return 0;
+	while (*puxBytesLeft > 0u && uxSent < uxBudget)
+	{
+		xSpace = FreeRTOS_tx_space(xSock);
+		if (xSpace <= 0)
+			break;
+		uxCount = *puxBytesLeft < (size_t)xSpace ? *puxBytesLeft : (size_t)xSpace;
+		if (uxCount > uxBudget - uxSent)
+			uxCount = uxBudget - uxSent;
+#if (emberFILE_TX_ZERO_COPY != 0)
+		// FreeRTOS_get_tx_head() returns a direct pointer to the head of the TX
+		// stream, and the number of contiguous bytes available there
+		pcBuffer = (char *)FreeRTOS_get_tx_head(xSock, &xSpace);
+		if (pcBuffer != NULL && xSpace >= emberFILE_SECTOR_SIZE)
+		{
+			if (uxCount > (size_t)xSpace)
+				uxCount = (size_t)xSpace;
+		}
+		else
+#endif
+		{
+			// the TX stream is about to wrap; use the shared buffer for this block
+			pcBuffer = pxServer->pcSndBuff;
+			if (uxCount > sizeof(pxServer->pcSndBuff))
+				uxCount = sizeof(pxServer->pcSndBuff);
+		}
+		// keep reads sector-aligned, except for the last block of the file
+		if (uxCount < *puxBytesLeft)
+			uxCount &= ~((size_t)emberFILE_SECTOR_SIZE - 1u);
+		if (uxCount == 0u)
+			break;
+		if (ff_fread(pcBuffer, 1, uxCount, pxFile) != uxCount)
+		{
+			xRc = -pdFREERTOS_ERRNO_EIO;
+			break;
+		}
+		*puxBytesLeft -= uxCount;
+		if (*puxBytesLeft == 0u && (uxOpts & eFileTx_CloseAfterSend))
+			prvSetCloseAfterSend(xSock);
+		// a NULL buffer commits data already written to the head of the TX stream
+		xRc = FreeRTOS_send(xSock, pcBuffer == pxServer->pcSndBuff ? pcBuffer : NULL,
+							uxCount, 0);
+		if (xRc < 0)
+			break;
+		uxSent += (size_t)xRc;
+	}
+	return prvSendComplete(pxServer, xSock, xRc, *puxBytesLeft > 0u, uxSent);
+}
+
+BaseType_t xEmberSendMemory(
+	TCPServer_t *pxServer,
+	Socket_t xSock,
+	const uint8_t **ppucData,
+	size_t *puxBytesLeft,
+	const size_t uxBudget)
+{
+	BaseType_t xSpace, xRc = 0;
+	size_t uxCount, uxSent = 0;
+	while (*puxBytesLeft > 0u && uxSent < uxBudget)
+	{
+		xSpace = FreeRTOS_tx_space(xSock);
+		if (xSpace <= 0)
+			break;
+		uxCount = *puxBytesLeft < (size_t)xSpace ? *puxBytesLeft : (size_t)xSpace;
+		if (uxCount > uxBudget - uxSent)
+			uxCount = uxBudget - uxSent;
+		// the stack copies straight from the source into the TX stream
+		xRc = FreeRTOS_send(xSock, *ppucData, uxCount, 0);
+		if (xRc <= 0)
+			break;
+		*ppucData += xRc;
+		*puxBytesLeft -= (size_t)xRc;
+		uxSent += (size_t)xRc;
+	}
+	return prvSendComplete(pxServer, xSock, xRc, *puxBytesLeft > 0u, uxSent);
+}
+
+size_t uxEmberTxBudget(const TCPClient_t *pxClient, const size_t uxBudget)
+{
+	if (pxClient->xPriority != ePriority_Bulk)
+		return uxBudget;
+	if (uxBudget > pxClient->pxParent->uxBulkShare)
+		return pxClient->pxParent->uxBulkShare;
+	return uxBudget;
+}
+
+BaseType_t xEmberIOInit(void)
+{
+	if (xIOTask != NULL)
+		return pdTRUE;
+	xIOQueue = xQueueCreate(emberFILE_IO_QUEUE_LENGTH, sizeof(ReadRequest_t));
+	if (xIOQueue == NULL)
+		return pdFALSE;
+	if (xTaskCreate(prvEmberIO_Service, (const char *)"EmberIO",
+					emberFILE_IO_STACK_SIZE, 0, emberFILE_IO_PRIORITY,
+					&xIOTask) != pdPASS)
+	{
+		vQueueDelete(xIOQueue);
+		xIOQueue = NULL;
+		xIOTask = NULL;
+		return pdFALSE;
+	}
+	return pdTRUE;
+}
+
+FileReadAhead_t *pxEmberReadAheadStart(FF_FILE *pxFile, const size_t uxBytes)
+{
+	FileReadAhead_t *pxReadAhead;
+	if (xIOTask == NULL || pxFile == NULL)
+		return NULL;
+	pxReadAhead = (FileReadAhead_t *)pvPortMalloc(sizeof(FileReadAhead_t));
+	if (pxReadAhead == NULL)
+		return NULL;
+	memset(pxReadAhead, 0, sizeof(FileReadAhead_t));
+	pxReadAhead->pxFile = pxFile;
+	pxReadAhead->uxUnrequested = uxBytes;
+	pxReadAhead->uxRefs = 1;
+	// queue both buffers straight away; a failure here is retried when sending
+	prvReadAheadFill(pxReadAhead);
+	return pxReadAhead;
+}
+
+void vEmberReadAheadStop(FileReadAhead_t *pxReadAhead)
+{
+	if (pxReadAhead == NULL)
+		return;
+	pxReadAhead->xCancelled = pdTRUE;
+	prvReadAheadRelease(pxReadAhead);
+}
+
+BaseType_t xEmberSendReadAhead(
+	TCPServer_t *pxServer,
+	Socket_t xSock,
+	FileReadAhead_t *pxReadAhead,
+	size_t *puxBytesLeft,
+	const size_t uxBudget,
+	const UBaseType_t uxOpts)
+{
+	struct xREADAHEAD_BUFFER *pxBuffer;
+	BaseType_t xSpace, xRc = 0, xWaiting = pdFALSE;
+	size_t uxCount, uxSent = 0;
+	if (pxReadAhead == NULL)
+		return 0;
+	while (*puxBytesLeft > 0u && uxSent < uxBudget)
+	{
+		prvReadAheadFill(pxReadAhead);
+		pxBuffer = &pxReadAhead->pxBuffers[pxReadAhead->xCurrent];
+		if (pxBuffer->xState == eReadAhead_Error)
+		{
+			xRc = -pdFREERTOS_ERRNO_EIO;
+			break;
+		}
+		if (pxBuffer->xState != eReadAhead_Ready)
+		{
+			// storage is slow: come back on the next pass rather than waiting
+			xWaiting = pdTRUE;
+			break;
+		}
+		xSpace = FreeRTOS_tx_space(xSock);
+		if (xSpace <= 0)
+			break;
+		uxCount = pxBuffer->uxLen - pxBuffer->uxOffset;
+		if (uxCount > (size_t)xSpace)
+			uxCount = (size_t)xSpace;
+		if (uxCount > *puxBytesLeft)
+			uxCount = *puxBytesLeft;
+		if (uxCount == *puxBytesLeft && (uxOpts & eFileTx_CloseAfterSend))
+			prvSetCloseAfterSend(xSock);
+		xRc = FreeRTOS_send(xSock, &pxBuffer->pcData[pxBuffer->uxOffset], uxCount, 0);
+		if (xRc < 0)
+			break;
+		pxBuffer->uxOffset += (size_t)xRc;
+		*puxBytesLeft -= (size_t)xRc;
+		uxSent += (size_t)xRc;
+		if (pxBuffer->uxOffset == pxBuffer->uxLen)
+		{
+			// buffer drained: refill it, and move on to the other one
+			pxBuffer->xState = eReadAhead_Empty;
+			pxReadAhead->xCurrent ^= 1;
+			prvReadAheadFill(pxReadAhead);
+		}
+	}
+	return prvSendComplete(pxServer, xSock, xRc,
+						   *puxBytesLeft > 0u && !xWaiting, uxSent);
+}
+
+void vEmberCork(TCPClient_t *pxClient)
+{
+	TCPServer_t *pxServer = pxClient->pxParent;
+	if (pxServer->pxCorkClient == pxClient)
+		return;
+	if (pxServer->pxCorkClient != NULL)
+		xEmberFlush(pxServer->pxCorkClient);
+	pxServer->pxCorkClient = pxClient;
+	pxServer->uxCorkLen = 0;
+}
+
+BaseType_t xEmberWrite(
+	TCPClient_t *pxClient,
+	const void *pvData,
+	const size_t uxLen)
+{
+	TCPServer_t *pxServer = pxClient->pxParent;
+	const char *pcData = (const char *)pvData;
+	size_t uxSpace, uxWritten = 0;
+	BaseType_t xRc;
+	if (pxServer->pxCorkClient != pxClient)
+		return prvSendOrQueue(pxClient, pcData, uxLen);
+	uxSpace = sizeof(pxServer->pcSndBuff) - pxServer->uxCorkLen;
+	if (uxLen > uxSpace)
+	{
+		// top up the cork so that a full buffer is transmitted, then flush it
+		memcpy(&pxServer->pcSndBuff[pxServer->uxCorkLen], pcData, uxSpace);
+		pxServer->uxCorkLen += uxSpace;
+		uxWritten = uxSpace;
+		xRc = prvCorkDrain(pxServer);
+		if (xRc < 0)
+			return xRc;
+		// data that would fill the cork again is sent directly
+		if ((uxLen - uxWritten) >= sizeof(pxServer->pcSndBuff))
+		{
+			xRc = prvSendOrQueue(pxClient, &pcData[uxWritten], uxLen - uxWritten);
+			if (xRc < 0)
+				return xRc;
+			return (BaseType_t)uxLen;
+		}
+	}
+	memcpy(&pxServer->pcSndBuff[pxServer->uxCorkLen], &pcData[uxWritten],
+		   uxLen - uxWritten);
+	pxServer->uxCorkLen += uxLen - uxWritten;
+	return (BaseType_t)uxLen;
+}
+
+BaseType_t xEmberFlush(TCPClient_t *pxClient)
+{
+	TCPServer_t *pxServer = pxClient->pxParent;
+	BaseType_t xRc;
+	if (pxServer->pxCorkClient != pxClient)
+		return 0;
+	xRc = prvCorkDrain(pxServer);
+	pxServer->pxCorkClient = NULL;
+	return xRc;
+}
+
+BaseType_t xEmberDrain(TCPClient_t *pxClient)
+{
+	OutputBlock_t *pxBlock;
+	BaseType_t xRc;
+	size_t uxSent = 0;
+	while ((pxBlock = pxClient->pxOutputHead) != NULL)
+	{
+		xRc = FreeRTOS_send(pxClient->xSock, &pxBlock->pcData[pxBlock->uxOffset],
+							pxBlock->uxLen - pxBlock->uxOffset, 0);
+		if (xRc < 0)
+			return xRc;
+		uxSent += (size_t)xRc;
+		pxClient->uxOutputQueued -= (size_t)xRc;
+		pxBlock->uxOffset += (size_t)xRc;
+		if (pxBlock->uxOffset < pxBlock->uxLen)
+			break;
+		pxClient->pxOutputHead = pxBlock->pxNext;
+		vPortFree(pxBlock);
+	}
+	if (pxClient->pxOutputHead == NULL)
+	{
+		pxClient->pxOutputTail = NULL;
+		FreeRTOS_FD_CLR(pxClient->xSock, pxClient->pxParent->xSockSet,
+						eSELECT_WRITE);
+	}
+	else
+	{
+		FreeRTOS_FD_SET(pxClient->xSock, pxClient->pxParent->xSockSet,
+						eSELECT_WRITE);
+	}
+	return (BaseType_t)uxSent;
+}
+
+void vEmberDiscardOutput(TCPClient_t *pxClient)
+{
+	OutputBlock_t *pxBlock;
+	if (pxClient->pxParent->pxCorkClient == pxClient)
+	{
+		pxClient->pxParent->pxCorkClient = NULL;
+		pxClient->pxParent->uxCorkLen = 0;
+	}
+	while ((pxBlock = pxClient->pxOutputHead) != NULL)
+	{
+		pxClient->pxOutputHead = pxBlock->pxNext;
+		vPortFree(pxBlock);
+	}
+	pxClient->pxOutputTail = NULL;
+	pxClient->uxOutputQueued = 0;
+	vEmberTapStop(pxClient);
+}
+
+char *pcEmberCorkTail(TCPClient_t *pxClient, size_t *puxSpace)
+{
+	TCPServer_t *pxServer = pxClient->pxParent;
+	if (pxServer->pxCorkClient != pxClient)
+	{
+		*puxSpace = 0;
+		return NULL;
+	}
+	*puxSpace = sizeof(pxServer->pcSndBuff) - pxServer->uxCorkLen;
+	return &pxServer->pcSndBuff[pxServer->uxCorkLen];
+}
+
+void vEmberCorkAdvance(TCPClient_t *pxClient, const size_t uxLen)
+{
+	pxClient->pxParent->uxCorkLen += uxLen;
+}
+
+OutputTap_t *pxEmberTapStart(TCPClient_t *pxClient, const size_t uxMax)
+{
+	OutputTap_t *pxTap;
+	vEmberTapStop(pxClient);
+	pxTap = (OutputTap_t *)pvPortMalloc(sizeof(OutputTap_t) + uxMax);
+	if (pxTap == NULL)
+		return NULL;
+	pxTap->uxLen = 0;
+	pxTap->uxMax = uxMax;
+	pxTap->xOverflow = pdFALSE;
+	pxClient->pxOutputTap = pxTap;
+	return pxTap;
+}
+
+void vEmberTapStop(TCPClient_t *pxClient)
+{
+	if (pxClient->pxOutputTap == NULL)
+		return;
+	vPortFree(pxClient->pxOutputTap);
+	pxClient->pxOutputTap = NULL;
+}
+
+size_t uxEmberUtoa(char *pcDst, size_t uxValue)
+{
+	char pcDigits[emberUTOA_MAX_LEN];
+	size_t uxn = 0, uxLen;
+	// digits are generated least-significant first, then copied out in order
+	do
+	{
+		pcDigits[uxn++] = (char) ('0' + (uxValue % 10u));
+		uxValue /= 10u;
+	} while (uxValue != 0u);
+	uxLen = uxn;
+	while (uxn > 0)
+		*pcDst++ = pcDigits[--uxn];
+	return uxLen;
+}
+
+size_t uxEmberUtoHex(char *pcDst, size_t uxValue)
+{
+	size_t uxLen = 1;
+	BaseType_t xShift;
+	while ((uxLen < (sizeof(size_t) * 2)) && ((uxValue >> (uxLen * 4)) != 0u))
+		uxLen++;
+	for (xShift = (BaseType_t) ((uxLen - 1) * 4); xShift >= 0; xShift -= 4)
+		*pcDst++ = pcHexDigits[(uxValue >> xShift) & 0xfu];
+	return uxLen;
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+static BaseType_t prvSendComplete(
+	TCPServer_t *pxServer,
+	Socket_t xSock,
+	const BaseType_t xRc,
+	const BaseType_t xWantWrite,
+	const size_t uxSent)
+{
+	if (xRc < 0 || !xWantWrite)
+	{
+		/* Writing is done (or is waiting on storage), no need for further
+		 * 'eSELECT_WRITE' events. */
+		FreeRTOS_FD_CLR(xSock, pxServer->xSockSet, eSELECT_WRITE);
+		if (xRc < 0)
+			return xRc;
+	}
+	else
+	{
+		/* Wake up the TCP task as soon as this socket may be written to. */
+		FreeRTOS_FD_SET(xSock, pxServer->xSockSet, eSELECT_WRITE);
+	}
+	return (BaseType_t)uxSent;
+}
+
+static void prvSetCloseAfterSend(Socket_t xSock)
+{
+	BaseType_t xTrueValue = 1;
+	FreeRTOS_setsockopt(xSock, 0, FREERTOS_SO_CLOSE_AFTER_SEND,
+						(void *)&xTrueValue, sizeof(xTrueValue));
+}
+
+static BaseType_t prvCorkDrain(TCPServer_t *pxServer)
+{
+	BaseType_t xRc = 0;
+	if (pxServer->uxCorkLen > 0)
+		xRc = prvSendOrQueue(pxServer->pxCorkClient, pxServer->pcSndBuff,
+							 pxServer->uxCorkLen);
+	pxServer->uxCorkLen = 0;
+	return xRc;
+}
+
+static BaseType_t prvSendOrQueue(
+	TCPClient_t *pxClient,
+	const char *pcData,
+	const size_t uxLen)
+{
+	OutputTap_t *pxTap = pxClient->pxOutputTap;
+	BaseType_t xRc = 0;
+	if (pxTap != NULL && !pxTap->xOverflow)
+	{
+		if (uxLen <= pxTap->uxMax - pxTap->uxLen)
+		{
+			memcpy(&pxTap->pcData[pxTap->uxLen], pcData, uxLen);
+			pxTap->uxLen += uxLen;
+		}
+		else
+		{
+			pxTap->xOverflow = pdTRUE;
+		}
+	}
+	if (pxClient->xOutput != NULL)
+		return pxClient->xOutput(pxClient, pcData, uxLen);
+	// data already queued must be transmitted first
+	if (pxClient->pxOutputHead == NULL)
+	{
+		xRc = FreeRTOS_send(pxClient->xSock, pcData, uxLen, 0);
+		if (xRc < 0)
+			return xRc;
+	}
+	if ((size_t)xRc < uxLen)
+	{
+		BaseType_t xQueueRc = prvQueueOutput(pxClient, &pcData[xRc],
+											 uxLen - (size_t)xRc);
+		if (xQueueRc < 0)
+			return xQueueRc;
+	}
+	return (BaseType_t)uxLen;
+}
+
+static BaseType_t prvQueueOutput(
+	TCPClient_t *pxClient,
+	const char *pcData,
+	const size_t uxLen)
+{
+	OutputBlock_t *pxBlock;
+	if ((pxClient->uxOutputQueued + uxLen) > emberOUTPUT_QUEUE_SIZE)
+		return -pdFREERTOS_ERRNO_ENOBUFS;
+	pxBlock = (OutputBlock_t *)pvPortMalloc(sizeof(OutputBlock_t) + uxLen);
+	if (pxBlock == NULL)
+		return -pdFREERTOS_ERRNO_ENOMEM;
+	memcpy(pxBlock->pcData, pcData, uxLen);
+	pxBlock->pxNext = NULL;
+	pxBlock->uxLen = uxLen;
+	pxBlock->uxOffset = 0;
+	if (pxClient->pxOutputTail != NULL)
+		pxClient->pxOutputTail->pxNext = pxBlock;
+	else
+		pxClient->pxOutputHead = pxBlock;
+	pxClient->pxOutputTail = pxBlock;
+	pxClient->uxOutputQueued += uxLen;
+	// wake up the EMBER task as soon as the socket may be written to
+	FreeRTOS_FD_SET(pxClient->xSock, pxClient->pxParent->xSockSet,
+					eSELECT_WRITE);
+	return (BaseType_t)uxLen;
+}
+
+static void prvEmberIO_Service(void *pvArgs)
+{
+	ReadRequest_t xRequest;
+	struct xREADAHEAD_BUFFER *pxBuffer;
+	while (1)
+	{
+		if (xQueueReceive(xIOQueue, &xRequest, portMAX_DELAY) != pdTRUE)
+			continue;
+		pxBuffer = &xRequest.pxReadAhead->pxBuffers[xRequest.xIndex];
+		if (!xRequest.pxReadAhead->xCancelled)
+		{
+			// requests for a transfer are queued, and so serviced, in file order
+			if (ff_fread(pxBuffer->pcData, 1, pxBuffer->uxLen,
+						 xRequest.pxReadAhead->pxFile) == pxBuffer->uxLen)
+				pxBuffer->xState = eReadAhead_Ready;
+			else
+				pxBuffer->xState = eReadAhead_Error;
+		}
+		prvReadAheadRelease(xRequest.pxReadAhead);
+	}
+}
+
+static void prvReadAheadFill(FileReadAhead_t *pxReadAhead)
+{
+	struct xREADAHEAD_BUFFER *pxBuffer;
+	ReadRequest_t xRequest = {pxReadAhead, 0};
+	// buffers are always requested alternately, so that they are filled (and
+	// drained) in file order
+	while (pxReadAhead->uxUnrequested > 0u)
+	{
+		xRequest.xIndex = pxReadAhead->xNextRequest;
+		pxBuffer = &pxReadAhead->pxBuffers[xRequest.xIndex];
+		if (pxBuffer->xState != eReadAhead_Empty)
+			break;
+		pxBuffer->uxLen = pxReadAhead->uxUnrequested < sizeof(pxBuffer->pcData)
+							  ? pxReadAhead->uxUnrequested
+							  : sizeof(pxBuffer->pcData);
+		pxBuffer->uxOffset = 0;
+		pxBuffer->xState = eReadAhead_Pending;
+		taskENTER_CRITICAL();
+		pxReadAhead->uxRefs++;
+		taskEXIT_CRITICAL();
+		if (xQueueSendToBack(xIOQueue, &xRequest, 0) != pdTRUE)
+		{
+			// the queue is full; leave the buffer empty so the request is retried
+			taskENTER_CRITICAL();
+			pxReadAhead->uxRefs--;
+			taskEXIT_CRITICAL();
+			pxBuffer->xState = eReadAhead_Empty;
+			break;
+		}
+		pxReadAhead->uxUnrequested -= pxBuffer->uxLen;
+		pxReadAhead->xNextRequest ^= 1;
+	}
+}
+
+static void prvReadAheadRelease(FileReadAhead_t *pxReadAhead)
+{
+	UBaseType_t uxRefs;
+	taskENTER_CRITICAL();
+	uxRefs = --pxReadAhead->uxRefs;
+	taskEXIT_CRITICAL();
+	if (uxRefs == 0u)
+	{
+		ff_fclose(pxReadAhead->pxFile);
+		vPortFree(pxReadAhead);
+	}
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include "inc/ember_private.h"
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+#if (emberRATE_LIMIT_BUCKETS > 0)
+static RateBucket_t *prvFindBucket(
+	TCPServer_t *pxServer,
+	const uint32_t ulAddress,
+	const RateLimit_t *pxLimit,
+	const TickType_t xNow);
+#endif
+
+/*===============================================
+ private global variables
+ ===============================================*/
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+BaseType_t xEmberRateLimit(
+	TCPServer_t *pxServer,
+	const uint32_t ulAddress,
+	const RateLimit_t *pxLimit)
+{
+#if (emberRATE_LIMIT_BUCKETS > 0)
+	RateBucket_t *pxBucket;
+	TickType_t xNow, xInterval, xCapacity;
+	if (pxLimit == NULL || pxLimit->usPerSecond == 0)
+		return pdTRUE;
+	xNow = xTaskGetTickCount();
+	// the cost of one token, and the credit of a full bucket, in ticks
+	xInterval = pdMS_TO_TICKS(1000) / pxLimit->usPerSecond;
+	if (xInterval == 0)
+		xInterval = 1;
+	xCapacity = xInterval * (pxLimit->usBurst ? pxLimit->usBurst : 1);
+	pxBucket = prvFindBucket(pxServer, ulAddress, pxLimit, xNow);
+	if (pxBucket->pxLimit != pxLimit || pxBucket->ulAddress != ulAddress)
+	{
+		// a new (or reused) bucket starts full
+		pxBucket->pxLimit = pxLimit;
+		pxBucket->ulAddress = ulAddress;
+		pxBucket->xCredit = xCapacity;
+	}
+	else if ((xNow - pxBucket->xLastTick) >= (xCapacity - pxBucket->xCredit))
+	{
+		pxBucket->xCredit = xCapacity;
+	}
+	else
+	{
+		pxBucket->xCredit += xNow - pxBucket->xLastTick;
+	}
+	pxBucket->xLastTick = xNow;
+	if (pxBucket->xCredit < xInterval)
+		return pdFALSE;
+	pxBucket->xCredit -= xInterval;
+	return pdTRUE;
+#else
+	(void)pxServer;
+	(void)ulAddress;
+	(void)pxLimit;
+	return pdTRUE;
+#endif
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+#if (emberRATE_LIMIT_BUCKETS > 0)
+static RateBucket_t *prvFindBucket(
+	TCPServer_t *pxServer,
+	const uint32_t ulAddress,
+	const RateLimit_t *pxLimit,
+	const TickType_t xNow)
+{
+	RateBucket_t *pxBucket, *pxVictim = NULL;
+	uint32_t ulHash;
+	BaseType_t xi;
+	// multiplicative hash of the address and limit; the upper bits are the best
+	// mixed
+	ulHash = (ulAddress ^ (uint32_t)(uintptr_t)pxLimit) * 2654435761u;
+	ulHash = (ulHash >> 16) % emberRATE_LIMIT_BUCKETS;
+	for (xi = 0; xi < emberRATE_LIMIT_PROBES; xi++)
+	{
+		pxBucket = &pxServer->pxBuckets[(ulHash + xi) % emberRATE_LIMIT_BUCKETS];
+		if (pxBucket->pxLimit == pxLimit && pxBucket->ulAddress == ulAddress)
+			return pxBucket;
+		if (pxBucket->pxLimit == NULL)
+			return pxBucket;
+		if (pxVictim == NULL
+			|| (xNow - pxBucket->xLastTick) > (xNow - pxVictim->xLastTick))
+			pxVictim = pxBucket;
+	}
+	return pxVictim;
+}
+#endif
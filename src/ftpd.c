@@ -522,7 +522,8 @@ BaseType_t xFtpWork(void *pxTCPClient) {
 				/* Still listing a directory. */
 				xClientRc = prvListSendWork(pxClient);
 			}
-			else if (pxClient->pxReadHandle != NULL) {
+			else if ((pxClient->pxReadHandle != NULL)
+			    || (pxClient->pxReadAhead != NULL)) {
 				/* Sending a file. */
 				xClientRc = prvRetrieveFileWork(pxClient);
 			}
@@ -1325,7 +1326,8 @@ static void prvTransferCloseSocket(FTPClient_t *pxClient)
 		}
 	}
 
-	if ((pxClient->pxWriteHandle != NULL) || (pxClient->pxReadHandle != NULL))
+	if ((pxClient->pxWriteHandle != NULL) || (pxClient->pxReadHandle != NULL)
+	    || (pxClient->pxReadAhead != NULL))
 	    {
 		BaseType_t xLength;
 
@@ -1354,7 +1356,7 @@ static void prvTransferCloseSocket(FTPClient_t *pxClient)
             ulAverage = ulGetAverage( pxClient->ulRecvBytes, xDelta );
 
             FreeRTOS_printf( ( "FTP: %s: '%s' %lu Bytes (%s/sec)\n",
-                               pxClient->pxReadHandle ? "sent" : "recv",
+                               pxClient->pxWriteHandle ? "recv" : "sent",
                                pxClient->pcFileName,
                                pxClient->ulRecvBytes,
                                pcMkSize( ulAverage, pcStrBuf, sizeof( pcStrBuf ) ) ) );
@@ -1406,6 +1408,12 @@ static void prvTransferCloseFile(FTPClient_t *pxClient)
 		pxClient->pxReadHandle = NULL;
 	}
 
+	if (pxClient->pxReadAhead != NULL)
+	{
+		vEmberReadAheadStop(pxClient->pxReadAhead);
+		pxClient->pxReadAhead = NULL;
+	}
+
 	/* These two field are only used for logging / file-statistics */
 	pxClient->ulRecvBytes = 0ul;
 	pxClient->xStartTime = 0ul;
@@ -1932,6 +1940,18 @@ static BaseType_t prvRetrieveFilePrep(FTPClient_t *pxClient,
 
 	if (xResult != pdFALSE)
 	{
+#if (emberFILE_IO_TASK != 0)
+		if (pxClient->uxBytesLeft != 0u)
+		{
+			/* Hand the file over to the I/O task, which then owns it. */
+			pxClient->pxReadAhead = pxEmberReadAheadStart(pxClient->pxReadHandle,
+			    pxClient->uxBytesLeft);
+			if (pxClient->pxReadAhead != NULL)
+			{
+				pxClient->pxReadHandle = NULL;
+			}
+		}
+#endif
 		if (pxClient->bits1.bIsListen != pdFALSE_UNSIGNED)
 		{
 			/* True if PASV is used. */
@@ -1976,154 +1996,45 @@ static BaseType_t prvRetrieveFilePrep(FTPClient_t *pxClient,
 
 static BaseType_t prvRetrieveFileWork(FTPClient_t *pxClient)
 {
-	size_t uxSpace;
-	size_t uxCount, uxItemsRead;
-	BaseType_t xRc = 0;
-	BaseType_t xSetEvent = pdFALSE;
+	BaseType_t xRc;
 
-	do
+	/* The file is read directly into the TX stream of the data socket, in
+	 * sector-aligned blocks, and 'eSELECT_WRITE' is set or cleared as needed.
+	 * When the file I/O task is reading the file, only data that it has already
+	 * read is sent. */
+	if (pxClient->pxReadAhead != NULL)
 	{
-#if ( ipconfigFTP_TX_ZERO_COPY != 0 )
-            char * pcBuffer;
-            BaseType_t xBufferLength;
-        #endif /* ipconfigFTP_TX_ZERO_COPY */
-
-		/* Take the lesser of the two: tx_space (number of bytes that can be
-		 * queued for transmission) and uxBytesLeft (the number of bytes left to
-		 * read from the file) */
-		uxSpace = FreeRTOS_tx_space(pxClient->xTransferSocket);
-
-		if (uxSpace == 0)
-		    {
-			FreeRTOS_FD_SET(pxClient->xTransferSocket, pxClient->pxParent->xSockSet,
-			    eSELECT_WRITE | eSELECT_EXCEPT);
-			xRc = FreeRTOS_select(pxClient->pxParent->xSockSet, 200);
-			uxSpace = FreeRTOS_tx_space(pxClient->xTransferSocket);
-		}
-
-		uxCount = FreeRTOS_min_uint32(pxClient->uxBytesLeft, uxSpace);
-
-		if (uxCount == 0)
-		    {
-			break;
-		}
-
-#if ( ipconfigFTP_TX_ZERO_COPY == 0 )
-		{
-			if (uxCount > sizeof( pcSND_BUFFER))
-			    {
-				uxCount = sizeof( pcSND_BUFFER);
-			}
-
-			uxItemsRead = ff_fread( pcSND_BUFFER, 1, uxCount, pxClient->pxReadHandle);
-
-			if (uxItemsRead != uxCount)
-			    {
-				FreeRTOS_printf(
-				    ( "prvRetrieveFileWork: Got %u Expected %u\n", ( unsigned ) uxItemsRead, ( unsigned ) uxCount ));
-				xRc = FreeRTOS_shutdown(pxClient->xTransferSocket, FREERTOS_SHUT_RDWR);
-				pxClient->uxBytesLeft = 0u;
-				break;
-			}
-
-			pxClient->uxBytesLeft -= uxCount;
-
-			if (pxClient->uxBytesLeft == 0u)
-			    {
-				BaseType_t xTrueValue = 1;
-
-				FreeRTOS_setsockopt(pxClient->xTransferSocket, 0,
-				    FREERTOS_SO_CLOSE_AFTER_SEND, (void*) &xTrueValue,
-				    sizeof(xTrueValue));
-			}
-
-			xRc = FreeRTOS_send(pxClient->xTransferSocket, pcSND_BUFFER, uxCount, 0);
-		}
-#else /* ipconfigFTP_TX_ZERO_COPY != 0 */
-        {
-            /* Use zero-copy transmission:
-             * FreeRTOS_get_tx_head() returns a direct pointer to the TX stream and
-             * set xBufferLength to know how much space there is left. */
-            pcBuffer = ( char * ) FreeRTOS_get_tx_head( pxClient->xTransferSocket, &xBufferLength );
-
-            if( ( pcBuffer != NULL ) && ( xBufferLength >= 512 ) )
-            {
-                /* Will read disk data directly to the TX stream of the socket. */
-                uxCount = FreeRTOS_min_uint32( uxCount, ( uint32_t ) xBufferLength );
-
-                if( uxCount > ( size_t ) 0x40000u )
-                {
-                    uxCount = ( size_t ) 0x40000u;
-                }
-            }
-            else
-            {
-                /* Use the normal file i/o buffer. */
-                pcBuffer = pcSND_BUFFER;
-
-                if( uxCount > sizeof( pcSND_BUFFER ) )
-                {
-                    uxCount = sizeof( pcSND_BUFFER );
-                }
-            }
-
-            if( pxClient->uxBytesLeft >= 1024u )
-            {
-                uxCount &= ~( ( size_t ) 512u - 1u );
-            }
-
-            if( uxCount <= 0u )
-            {
-                /* Nothing to send after rounding down to a multiple of a sector size. */
-                break;
-            }
-
-            uxItemsRead = ff_fread( pcBuffer, 1, uxCount, pxClient->pxReadHandle );
-
-            if( uxCount != uxItemsRead )
-            {
-                FreeRTOS_printf( ( "prvRetrieveFileWork: Got %u Expected %u\n", ( unsigned ) uxItemsRead, ( unsigned ) uxCount ) );
-                xRc = FreeRTOS_shutdown( pxClient->xTransferSocket, FREERTOS_SHUT_RDWR );
-                pxClient->uxBytesLeft = 0u;
-                break;
-            }
-
-            pxClient->uxBytesLeft -= uxCount;
-
-            if( pxClient->uxBytesLeft == 0u )
-            {
-                BaseType_t xTrueValue = 1;
-
-                FreeRTOS_setsockopt( pxClient->xTransferSocket, 0, FREERTOS_SO_CLOSE_AFTER_SEND, ( void * ) &xTrueValue, sizeof( xTrueValue ) );
-            }
-
-            if( pcBuffer != pcSND_BUFFER )
-            {
-                pcBuffer = NULL;
-            }
-
-            xRc = FreeRTOS_send( pxClient->xTransferSocket, pcBuffer, uxCount, 0 );
-        }
-        #endif /* ipconfigFTP_TX_ZERO_COPY */
-
-		if (xRc < 0)
-		    {
-			break;
-		}
-
-		pxClient->ulRecvBytes += xRc;
-
-		if (pxClient->uxBytesLeft == 0u)
-		    {
-			break;
-		}
-	} while (uxCount > 0u);
+		xRc = xEmberSendReadAhead(pxClient->pxParent, pxClient->xTransferSocket,
+		    pxClient->pxReadAhead, &pxClient->uxBytesLeft,
+		    uxEmberTxBudget((TCPClient_t *) pxClient, emberFTP_FILE_CHUNK_SIZE),
+		    eFileTx_CloseAfterSend);
+	}
+	else
+	{
+		xRc = xEmberSendFile(pxClient->pxParent, pxClient->xTransferSocket,
+		    pxClient->pxReadHandle, &pxClient->uxBytesLeft,
+		    uxEmberTxBudget((TCPClient_t *) pxClient, emberFTP_FILE_CHUNK_SIZE),
+		    eFileTx_CloseAfterSend);
+	}
 
-	if (xRc < 0)
+	if (xRc == -pdFREERTOS_ERRNO_EIO)
+	    {
+		FreeRTOS_printf(( "prvRetrieveFileWork: read error, %u bytes left\n",
+		    ( unsigned ) pxClient->uxBytesLeft ));
+		xRc = FreeRTOS_shutdown(pxClient->xTransferSocket, FREERTOS_SHUT_RDWR);
+		pxClient->uxBytesLeft = 0u;
+	}
+	else if (xRc < 0)
 	    {
 		FreeRTOS_printf(( "prvRetrieveFileWork: already disconnected\n" ));
+		return xRc;
 	}
-	else if (pxClient->uxBytesLeft <= 0u)
+	else
+	{
+		pxClient->ulRecvBytes += xRc;
+	}
+
+	if (pxClient->uxBytesLeft == 0u)
 	    {
 		BaseType_t x;
 
@@ -2140,18 +2051,6 @@ static BaseType_t prvRetrieveFileWork(FTPClient_t *pxClient)
 
 		/*		FreeRTOS_printf( ( "prvRetrieveFileWork: %s all sent: xRc %ld\n", pxClient->pcFileName, xRc ) ); */
 	}
-	else
-	{
-		FreeRTOS_FD_SET(pxClient->xTransferSocket, pxClient->pxParent->xSockSet,
-		    eSELECT_WRITE);
-		xSetEvent = pdTRUE;
-	}
-
-	if (xSetEvent == pdFALSE)
-	{
-		FreeRTOS_FD_CLR(pxClient->xTransferSocket, pxClient->pxParent->xSockSet,
-		    eSELECT_WRITE);
-	}
 
 	return xRc;
 }
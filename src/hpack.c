@@ -0,0 +1,611 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <FreeRTOS_IP.h>
+#include <string.h>
+#include "inc/hpack.h"
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+/* The number of codes of each length (in bits) of the canonical Huffman code
+ * of RFC 7541, Appendix B; the EOS code is the first of length 30 not used */
+static const uint8_t pucHuffCounts[HPACK_HUFFMAN_MAX_BITS + 1] = {
+	0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+	0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 3,
+};
+
+/* The symbols of the Huffman code, in order of code length, then value */
+static const uint8_t pucHuffSymbols[256] = {
+	0x30, 0x31, 0x32, 0x61, 0x63, 0x65, 0x69, 0x6f, 0x73, 0x74, 0x20, 0x25,
+	0x2d, 0x2e, 0x2f, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3d, 0x41,
+	0x5f, 0x62, 0x64, 0x66, 0x67, 0x68, 0x6c, 0x6d, 0x6e, 0x70, 0x72, 0x75,
+	0x3a, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x4b, 0x4c,
+	0x4d, 0x4e, 0x4f, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x59,
+	0x6a, 0x6b, 0x71, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x26, 0x2a, 0x2c, 0x3b,
+	0x58, 0x5a, 0x21, 0x22, 0x28, 0x29, 0x3f, 0x27, 0x2b, 0x7c, 0x23, 0x3e,
+	0x00, 0x24, 0x40, 0x5b, 0x5d, 0x7e, 0x5e, 0x7d, 0x3c, 0x60, 0x7b, 0x5c,
+	0xc3, 0xd0, 0x80, 0x82, 0x83, 0xa2, 0xb8, 0xc2, 0xe0, 0xe2, 0x99, 0xa1,
+	0xa7, 0xac, 0xb0, 0xb1, 0xb3, 0xd1, 0xd8, 0xd9, 0xe3, 0xe5, 0xe6, 0x81,
+	0x84, 0x85, 0x86, 0x88, 0x92, 0x9a, 0x9c, 0xa0, 0xa3, 0xa4, 0xa9, 0xaa,
+	0xad, 0xb2, 0xb5, 0xb9, 0xba, 0xbb, 0xbd, 0xbe, 0xc4, 0xc6, 0xe4, 0xe8,
+	0xe9, 0x01, 0x87, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8f, 0x93, 0x95, 0x96,
+	0x97, 0x98, 0x9b, 0x9d, 0x9e, 0xa5, 0xa6, 0xa8, 0xae, 0xaf, 0xb4, 0xb6,
+	0xb7, 0xbc, 0xbf, 0xc5, 0xe7, 0xef, 0x09, 0x8e, 0x90, 0x91, 0x94, 0x9f,
+	0xab, 0xce, 0xd7, 0xe1, 0xec, 0xed, 0xc7, 0xcf, 0xea, 0xeb, 0xc0, 0xc1,
+	0xc8, 0xc9, 0xca, 0xcd, 0xd2, 0xd5, 0xda, 0xdb, 0xee, 0xf0, 0xf2, 0xf3,
+	0xff, 0xcb, 0xcc, 0xd3, 0xd4, 0xd6, 0xdd, 0xde, 0xdf, 0xf1, 0xf4, 0xf5,
+	0xf6, 0xf7, 0xf8, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0x02, 0x03, 0x04, 0x05,
+	0x06, 0x07, 0x08, 0x0b, 0x0c, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+	0x15, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x7f, 0xdc,
+	0xf9, 0x0a, 0x0d, 0x16,
+};
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+typedef struct
+{
+	const char *pcName;
+	const char *pcValue;
+} HpackStaticEntry_t;
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static BaseType_t prvTableField(
+	const HpackTable_t *pxTable,
+	const uint32_t ulIndex,
+	const char **ppcName,
+	size_t *puxNameLen,
+	const char **ppcValue,
+	size_t *puxValueLen);
+static void prvTableEvict(HpackTable_t *pxTable, const size_t uxRoom);
+static void prvTableInsert(
+	HpackTable_t *pxTable,
+	const char *pcName,
+	const size_t uxNameLen,
+	const char *pcValue,
+	const size_t uxValueLen);
+static BaseType_t prvDecodeInt(
+	const uint8_t **ppucSrc,
+	const uint8_t *pucEnd,
+	const uint8_t ucPrefixBits,
+	uint32_t *pulValue);
+static BaseType_t prvDecodeString(
+	const uint8_t **ppucSrc,
+	const uint8_t *pucEnd,
+	char *pcScratch,
+	const size_t uxScratchSz,
+	const char **ppcStr,
+	size_t *puxLen);
+static BaseType_t prvHuffmanDecode(
+	const uint8_t *pucSrc,
+	const size_t uxLen,
+	char *pcDst,
+	const size_t uxDstSz);
+static size_t prvEncodeInt(
+	uint8_t *pucDst,
+	const size_t uxSpace,
+	const uint8_t ucFlags,
+	const uint8_t ucPrefixBits,
+	uint32_t ulValue);
+static size_t prvEncodeString(
+	uint8_t *pucDst,
+	const size_t uxSpace,
+	const char *pcStr,
+	const size_t uxLen);
+
+/*===============================================
+ private global variables
+ ===============================================*/
+
+/* RFC 7541, Appendix A; entry `i` has index `i + 1` */
+static const HpackStaticEntry_t pxStaticTable[HPACK_STATIC_ENTRIES] = {
+	{":authority", ""},
+	{":method", "GET"},
+	{":method", "POST"},
+	{":path", "/"},
+	{":path", "/index.html"},
+	{":scheme", "http"},
+	{":scheme", "https"},
+	{":status", "200"},
+	{":status", "204"},
+	{":status", "206"},
+	{":status", "304"},
+	{":status", "400"},
+	{":status", "404"},
+	{":status", "500"},
+	{"accept-charset", ""},
+	{"accept-encoding", "gzip, deflate"},
+	{"accept-language", ""},
+	{"accept-ranges", ""},
+	{"accept", ""},
+	{"access-control-allow-origin", ""},
+	{"age", ""},
+	{"allow", ""},
+	{"authorization", ""},
+	{"cache-control", ""},
+	{"content-disposition", ""},
+	{"content-encoding", ""},
+	{"content-language", ""},
+	{"content-length", ""},
+	{"content-location", ""},
+	{"content-range", ""},
+	{"content-type", ""},
+	{"cookie", ""},
+	{"date", ""},
+	{"etag", ""},
+	{"expect", ""},
+	{"expires", ""},
+	{"from", ""},
+	{"host", ""},
+	{"if-match", ""},
+	{"if-modified-since", ""},
+	{"if-none-match", ""},
+	{"if-range", ""},
+	{"if-unmodified-since", ""},
+	{"last-modified", ""},
+	{"link", ""},
+	{"location", ""},
+	{"max-forwards", ""},
+	{"proxy-authenticate", ""},
+	{"proxy-authorization", ""},
+	{"range", ""},
+	{"referer", ""},
+	{"refresh", ""},
+	{"retry-after", ""},
+	{"server", ""},
+	{"set-cookie", ""},
+	{"strict-transport-security", ""},
+	{"transfer-encoding", ""},
+	{"user-agent", ""},
+	{"vary", ""},
+	{"via", ""},
+	{"www-authenticate", ""},
+};
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+void vHpackTableInit(HpackTable_t *pxTable, uint8_t *pucData, size_t uxCapacity)
+{
+	pxTable->pucData = pucData;
+	pxTable->uxCapacity = uxCapacity;
+	// the encoder starts with the default size, and may only change it to the
+	// size allowed by the decoder's settings once it has received them
+	pxTable->uxMaxSize = (uxCapacity < HPACK_DEFAULT_TABLE_SIZE)
+							 ? uxCapacity
+							 : HPACK_DEFAULT_TABLE_SIZE;
+	vHpackTableClear(pxTable);
+}
+
+void vHpackTableCopy(HpackTable_t *pxDst, const HpackTable_t *pxSrc)
+{
+	memcpy(pxDst->pucData, pxSrc->pucData, pxSrc->uxUsed);
+	pxDst->uxMaxSize = pxSrc->uxMaxSize;
+	pxDst->uxSize = pxSrc->uxSize;
+	pxDst->uxEntries = pxSrc->uxEntries;
+	pxDst->uxUsed = pxSrc->uxUsed;
+}
+
+void vHpackTableClear(HpackTable_t *pxTable)
+{
+	pxTable->uxSize = 0;
+	pxTable->uxEntries = 0;
+	pxTable->uxUsed = 0;
+}
+
+BaseType_t xHpackDecode(
+	HpackTable_t *pxTable,
+	const uint8_t *pucBlock,
+	size_t uxLen,
+	char *pcScratch,
+	size_t uxScratchSz,
+	xHpackField *pxField,
+	void *pvArg)
+{
+	const uint8_t *pucSrc = pucBlock, *pucEnd = &pucBlock[uxLen];
+	const char *pcName, *pcValue;
+	size_t uxNameLen, uxValueLen, uxUsed;
+	uint32_t ulIndex;
+	BaseType_t xRc, xIndexing, xFields = 0;
+	while (pucSrc < pucEnd)
+	{
+		xIndexing = pdFALSE;
+		if (*pucSrc & 0x80)
+		{
+			// indexed field
+			if (prvDecodeInt(&pucSrc, pucEnd, 7, &ulIndex) < 0
+				|| ulIndex == 0)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			xRc = prvTableField(pxTable, ulIndex, &pcName, &uxNameLen,
+								&pcValue, &uxValueLen);
+			if (xRc < 0)
+				return xRc;
+		}
+		else if ((*pucSrc & 0xE0) == 0x20)
+		{
+			// dynamic table size update, which evicts entries if it shrinks
+			// the table; without a table, there is never anything in it
+			if (prvDecodeInt(&pucSrc, pucEnd, 5, &ulIndex) < 0)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			if (pxTable == NULL)
+				continue;
+			if (ulIndex > pxTable->uxCapacity)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			pxTable->uxMaxSize = ulIndex;
+			prvTableEvict(pxTable, 0);
+			continue;
+		}
+		else
+		{
+			// literal field, with incremental indexing (6-bit index), without
+			// indexing or never indexed (4-bit index)
+			xIndexing = (*pucSrc & 0x40) != 0;
+			if (prvDecodeInt(&pucSrc, pucEnd, xIndexing ? 6 : 4, &ulIndex) < 0)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			uxUsed = 0;
+			if (ulIndex != 0)
+			{
+				xRc = prvTableField(pxTable, ulIndex, &pcName, &uxNameLen,
+									&pcValue, &uxValueLen);
+				if (xRc < 0)
+					return xRc;
+			}
+			else
+			{
+				xRc = prvDecodeString(&pucSrc, pucEnd, pcScratch, uxScratchSz,
+									  &pcName, &uxNameLen);
+				if (xRc < 0)
+					return xRc;
+				if (pcName == pcScratch)
+					uxUsed = uxNameLen;
+			}
+			xRc = prvDecodeString(&pucSrc, pucEnd, &pcScratch[uxUsed],
+								  uxScratchSz - uxUsed, &pcValue, &uxValueLen);
+			if (xRc < 0)
+				return xRc;
+			if (pcValue == &pcScratch[uxUsed])
+				uxUsed += uxValueLen;
+			// a name from the dynamic table may be evicted by the entry that
+			// it is added to, so is copied first (RFC 7541, section 4.4)
+			if (xIndexing && pxTable != NULL && ulIndex > HPACK_STATIC_ENTRIES)
+			{
+				if (uxNameLen > uxScratchSz - uxUsed)
+					return -pdFREERTOS_ERRNO_ENOBUFS;
+				memcpy(&pcScratch[uxUsed], pcName, uxNameLen);
+				pcName = &pcScratch[uxUsed];
+			}
+		}
+		xRc = pxField(pvArg, pcName, uxNameLen, pcValue, uxValueLen);
+		if (xRc < 0)
+			return xRc;
+		if (xIndexing && pxTable != NULL)
+			prvTableInsert(pxTable, pcName, uxNameLen, pcValue, uxValueLen);
+		xFields++;
+	}
+	return xFields;
+}
+
+size_t uxHpackEncode(
+	uint8_t *pucDst,
+	size_t uxSpace,
+	const char *pcName,
+	size_t uxNameLen,
+	const char *pcValue,
+	size_t uxValueLen)
+{
+	uint32_t ulName = 0;
+	size_t uxLen, uxi;
+	for (uxi = 0; uxi < HPACK_STATIC_ENTRIES; uxi++)
+	{
+		if (strncmp(pxStaticTable[uxi].pcName, pcName, uxNameLen) != 0
+			|| pxStaticTable[uxi].pcName[uxNameLen] != 0)
+			continue;
+		if (ulName == 0)
+			ulName = (uint32_t)uxi + 1;
+		if (strncmp(pxStaticTable[uxi].pcValue, pcValue, uxValueLen) == 0
+			&& pxStaticTable[uxi].pcValue[uxValueLen] == 0)
+			return prvEncodeInt(pucDst, uxSpace, 0x80, 7, (uint32_t)uxi + 1);
+	}
+	// a literal field without indexing, with an indexed or a literal name
+	uxLen = prvEncodeInt(pucDst, uxSpace, 0x00, 4, ulName);
+	if (uxLen == 0)
+		return 0;
+	if (ulName == 0)
+	{
+		uxi = prvEncodeString(&pucDst[uxLen], uxSpace - uxLen, pcName, uxNameLen);
+		if (uxi == 0)
+			return 0;
+		uxLen += uxi;
+	}
+	uxi = prvEncodeString(&pucDst[uxLen], uxSpace - uxLen, pcValue, uxValueLen);
+	if (uxi == 0)
+		return 0;
+	return uxLen + uxi;
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+static BaseType_t prvTableField(
+	const HpackTable_t *pxTable,
+	const uint32_t ulIndex,
+	const char **ppcName,
+	size_t *puxNameLen,
+	const char **ppcValue,
+	size_t *puxValueLen)
+{
+	size_t pxLens[2], uxOffset = 0, uxSkip;
+	if (ulIndex <= HPACK_STATIC_ENTRIES)
+	{
+		*ppcName = pxStaticTable[ulIndex - 1].pcName;
+		*puxNameLen = strlen(*ppcName);
+		*ppcValue = pxStaticTable[ulIndex - 1].pcValue;
+		*puxValueLen = strlen(*ppcValue);
+		return 0;
+	}
+	// the dynamic table's indices count from its newest entry, which is the
+	// last in `pucData`
+	if (pxTable == NULL || ulIndex - HPACK_STATIC_ENTRIES > pxTable->uxEntries)
+		return -pdFREERTOS_ERRNO_EINVAL;
+	uxSkip = pxTable->uxEntries - (ulIndex - HPACK_STATIC_ENTRIES);
+	for (;;)
+	{
+		memcpy(pxLens, &pxTable->pucData[uxOffset], sizeof(pxLens));
+		if (uxSkip-- == 0)
+			break;
+		uxOffset += sizeof(pxLens) + pxLens[0] + pxLens[1];
+	}
+	*ppcName = (const char *)&pxTable->pucData[uxOffset + sizeof(pxLens)];
+	*puxNameLen = pxLens[0];
+	*ppcValue = &(*ppcName)[pxLens[0]];
+	*puxValueLen = pxLens[1];
+	return 0;
+}
+
+static void prvTableEvict(HpackTable_t *pxTable, const size_t uxRoom)
+{
+	// removes the oldest entries until there is room for `uxRoom` more
+	size_t pxLens[2], uxOffset = 0;
+	while (pxTable->uxEntries > 0 && pxTable->uxSize + uxRoom > pxTable->uxMaxSize)
+	{
+		memcpy(pxLens, &pxTable->pucData[uxOffset], sizeof(pxLens));
+		uxOffset += sizeof(pxLens) + pxLens[0] + pxLens[1];
+		pxTable->uxSize -= pxLens[0] + pxLens[1] + HPACK_ENTRY_OVERHEAD;
+		pxTable->uxEntries--;
+	}
+	if (uxOffset == 0)
+		return;
+	pxTable->uxUsed -= uxOffset;
+	memmove(pxTable->pucData, &pxTable->pucData[uxOffset], pxTable->uxUsed);
+}
+
+static void prvTableInsert(
+	HpackTable_t *pxTable,
+	const char *pcName,
+	const size_t uxNameLen,
+	const char *pcValue,
+	const size_t uxValueLen)
+{
+	const size_t uxEntrySz = uxNameLen + uxValueLen + HPACK_ENTRY_OVERHEAD;
+	size_t pxLens[2] = {uxNameLen, uxValueLen};
+	uint8_t *pucDst;
+	prvTableEvict(pxTable, uxEntrySz);
+	// an entry larger than the table empties it, and is not added
+	if (pxTable->uxSize + uxEntrySz > pxTable->uxMaxSize)
+		return;
+	// each entry takes less space than its size, so it fits
+	pucDst = &pxTable->pucData[pxTable->uxUsed];
+	memcpy(pucDst, pxLens, sizeof(pxLens));
+	memcpy(&pucDst[sizeof(pxLens)], pcName, uxNameLen);
+	memcpy(&pucDst[sizeof(pxLens) + uxNameLen], pcValue, uxValueLen);
+	pxTable->uxUsed += sizeof(pxLens) + uxNameLen + uxValueLen;
+	pxTable->uxSize += uxEntrySz;
+	pxTable->uxEntries++;
+}
+
+static BaseType_t prvDecodeInt(
+	const uint8_t **ppucSrc,
+	const uint8_t *pucEnd,
+	const uint8_t ucPrefixBits,
+	uint32_t *pulValue)
+{
+	const uint8_t *pucSrc = *ppucSrc;
+	const uint32_t ulMax = (1u << ucPrefixBits) - 1u;
+	uint32_t ulValue;
+	uint8_t ucShift = 0;
+	if (pucSrc >= pucEnd)
+		return -pdFREERTOS_ERRNO_EINVAL;
+	ulValue = *pucSrc++ & ulMax;
+	if (ulValue == ulMax)
+	{
+		// the rest of the value follows, 7 bits at a time; nothing in a header
+		// block needs more than 28 bits
+		do
+		{
+			if (pucSrc >= pucEnd || ucShift > 21)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			ulValue += (uint32_t)(*pucSrc & 0x7F) << ucShift;
+			ucShift += 7;
+		} while (*pucSrc++ & 0x80);
+	}
+	*ppucSrc = pucSrc;
+	*pulValue = ulValue;
+	return 0;
+}
+
+static BaseType_t prvDecodeString(
+	const uint8_t **ppucSrc,
+	const uint8_t *pucEnd,
+	char *pcScratch,
+	const size_t uxScratchSz,
+	const char **ppcStr,
+	size_t *puxLen)
+{
+	const uint8_t *pucSrc = *ppucSrc;
+	BaseType_t xHuffman, xRc;
+	uint32_t ulLen;
+	if (pucSrc >= pucEnd)
+		return -pdFREERTOS_ERRNO_EINVAL;
+	xHuffman = (*pucSrc & 0x80) != 0;
+	if (prvDecodeInt(&pucSrc, pucEnd, 7, &ulLen) < 0
+		|| ulLen > (size_t)(pucEnd - pucSrc))
+		return -pdFREERTOS_ERRNO_EINVAL;
+	if (xHuffman)
+	{
+		xRc = prvHuffmanDecode(pucSrc, ulLen, pcScratch, uxScratchSz);
+		if (xRc < 0)
+			return xRc;
+		*ppcStr = pcScratch;
+		*puxLen = (size_t)xRc;
+	}
+	else
+	{
+		// a plain string is used where it is
+		*ppcStr = (const char *)pucSrc;
+		*puxLen = ulLen;
+	}
+	*ppucSrc = &pucSrc[ulLen];
+	return 0;
+}
+
+static BaseType_t prvHuffmanDecode(
+	const uint8_t *pucSrc,
+	const size_t uxLen,
+	char *pcDst,
+	const size_t uxDstSz)
+{
+	size_t uxOut = 0, uxi;
+	int32_t lCode = 0, lFirst = 0, lIndex = 0, lCount;
+	BaseType_t xBits = 0, xOnes = pdTRUE, xBit, xShift;
+	// the code is canonical, so each code is decoded one bit at a time by
+	// comparing it with the first code of its length (as in zlib's "puff")
+	for (uxi = 0; uxi < uxLen; uxi++)
+	{
+		for (xShift = 7; xShift >= 0; xShift--)
+		{
+			xBit = (pucSrc[uxi] >> xShift) & 1;
+			lCode |= xBit;
+			xOnes &= xBit;
+			xBits++;
+			lCount = pucHuffCounts[xBits];
+			if (lCode - lCount < lFirst)
+			{
+				if (uxOut >= uxDstSz)
+					return -pdFREERTOS_ERRNO_ENOBUFS;
+				pcDst[uxOut++] = (char)pucHuffSymbols[lIndex + (lCode - lFirst)];
+				lCode = lFirst = lIndex = 0;
+				xBits = 0;
+				xOnes = pdTRUE;
+				continue;
+			}
+			// a 30-bit code that is not a symbol is EOS, which must not be sent
+			if (xBits == HPACK_HUFFMAN_MAX_BITS)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			lIndex += lCount;
+			lFirst = (lFirst + lCount) << 1;
+			lCode <<= 1;
+		}
+	}
+	// the string is padded to a whole byte with the start of EOS, i.e. ones
+	if (xBits > 7 || !xOnes)
+		return -pdFREERTOS_ERRNO_EINVAL;
+	return (BaseType_t)uxOut;
+}
+
+static size_t prvEncodeInt(
+	uint8_t *pucDst,
+	const size_t uxSpace,
+	const uint8_t ucFlags,
+	const uint8_t ucPrefixBits,
+	uint32_t ulValue)
+{
+	const uint32_t ulMax = (1u << ucPrefixBits) - 1u;
+	size_t uxLen = 1;
+	if (uxSpace == 0)
+		return 0;
+	if (ulValue < ulMax)
+	{
+		pucDst[0] = ucFlags | (uint8_t)ulValue;
+		return 1;
+	}
+	pucDst[0] = ucFlags | (uint8_t)ulMax;
+	ulValue -= ulMax;
+	while (ulValue >= 0x80)
+	{
+		if (uxLen >= uxSpace)
+			return 0;
+		pucDst[uxLen++] = (uint8_t)(ulValue | 0x80);
+		ulValue >>= 7;
+	}
+	if (uxLen >= uxSpace)
+		return 0;
+	pucDst[uxLen++] = (uint8_t)ulValue;
+	return uxLen;
+}
+
+static size_t prvEncodeString(
+	uint8_t *pucDst,
+	const size_t uxSpace,
+	const char *pcStr,
+	const size_t uxLen)
+{
+	size_t uxHead = prvEncodeInt(pucDst, uxSpace, 0x00, 7, (uint32_t)uxLen);
+	if (uxHead == 0 || uxLen > uxSpace - uxHead)
+		return 0;
+	memcpy(&pucDst[uxHead], pcStr, uxLen);
+	return uxHead + uxLen;
+}
@@ -0,0 +1,1631 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <FreeRTOS_IP.h>
+#include <string.h>
+#include <base64.h>
+
+#include "inc/ember_private.h"
+#include "inc/httpd.h"
+#include "inc/hpack.h"
+#include "inc/http2.h"
+
+#if (emberHTTP2_MAX_STREAMS > 0)
+
+#if (emberHTTP2_HPACK_TABLE_SIZE > 0) && (emberHTTP2_HPACK_TABLE_SIZE < HPACK_DEFAULT_TABLE_SIZE)
+#error "emberHTTP2_HPACK_TABLE_SIZE must be 0, or at least 4096"
+#endif
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+typedef enum
+{
+	eSetting_HeaderTableSize = 1,
+	eSetting_MaxConcurrentStreams = 3,
+	eSetting_InitialWindowSize = 4,
+	eSetting_MaxFrameSize = 5,
+} eHttp2Setting;
+
+static const char pcPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+static const char pcSwitchingProtocols[] =
+	"HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+static const char pcContentLength[] = "Content-Length: ";
+/* the room kept in a request between its headers and its body, for the
+ * Content-Length header and the end of the headers */
+static const size_t uxLengthGap =
+	sizeof(pcContentLength) - 1 + emberUTOA_MAX_LEN + 4;
+
+/* response headers that only apply to an HTTP/1.1 connection */
+static const char *const pcConnectionHeaders[] = {
+	"connection",
+	"keep-alive",
+	"proxy-connection",
+	"transfer-encoding",
+	"upgrade",
+};
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+/* The state of the translation of a request's header block to HTTP/1.1. The
+ * block is decoded once for each part of the request, in the order that they
+ * are written: the method, the path, then the headers. */
+struct xREQUEST_BUILDER
+{
+	Http2Stream_t *pxStream;
+	BaseType_t xPass;
+	BaseType_t xMethods;
+	BaseType_t xPaths;
+	BaseType_t xAuthority;
+};
+typedef struct xREQUEST_BUILDER RequestBuilder_t;
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static Http2Connection_t *prvConnectionCreate(void);
+static BaseType_t prvConnectionError(
+	Http2Connection_t *pxConn,
+	const BaseType_t xError);
+static BaseType_t prvReceiveFrames(Http2Client_t *pxClient);
+static BaseType_t prvFrameStart(Http2Client_t *pxClient, const uint8_t *pucHead);
+static BaseType_t prvFramePayload(
+	Http2Client_t *pxClient,
+	const uint8_t *pucData,
+	size_t uxLen);
+static BaseType_t prvFrameData(
+	Http2Client_t *pxClient,
+	const uint8_t *pucData,
+	const size_t uxLen);
+static BaseType_t prvFrameEnd(Http2Client_t *pxClient);
+static BaseType_t prvFrameControl(Http2Client_t *pxClient, const uint8_t *pucData);
+static BaseType_t prvApplySettings(
+	Http2Connection_t *pxConn,
+	const uint8_t *pucData,
+	const size_t uxLen);
+static BaseType_t prvApplyEncodedSettings(
+	Http2Connection_t *pxConn,
+	const char *pcValue,
+	const size_t uxLen);
+static BaseType_t prvBlockStart(Http2Client_t *pxClient);
+static BaseType_t prvBlockEnd(Http2Client_t *pxClient);
+static BaseType_t prvRequestHeaders(Http2Connection_t *pxConn, Http2Stream_t *pxStream);
+static BaseType_t prvDecodeBlock(
+	Http2Connection_t *pxConn,
+	xHpackField *pxField,
+	void *pvArg);
+static BaseType_t prvSkipBlock(Http2Connection_t *pxConn);
+static BaseType_t prvIgnoreField(
+	void *pvArg,
+	const char *pcName,
+	size_t uxNameLen,
+	const char *pcValue,
+	size_t uxValueLen);
+static void prvSaveTable(Http2Connection_t *pxConn);
+static void prvRestoreTable(Http2Connection_t *pxConn);
+static BaseType_t prvRequestField(
+	void *pvArg,
+	const char *pcName,
+	size_t uxNameLen,
+	const char *pcValue,
+	size_t uxValueLen);
+static BaseType_t prvRequestAppend(
+	Http2Stream_t *pxStream,
+	const char *pcData,
+	const size_t uxLen);
+static BaseType_t prvRequestBody(
+	Http2Client_t *pxClient,
+	const uint8_t *pucData,
+	const size_t uxLen);
+static void prvRequestEnd(Http2Stream_t *pxStream);
+static Http2Stream_t *prvStreamCreate(Http2Client_t *pxClient, const uint32_t ulId);
+static Http2Stream_t *prvStreamFind(Http2Connection_t *pxConn, const uint32_t ulId);
+static void prvStreamClose(Http2Connection_t *pxConn, Http2Stream_t *pxStream);
+static BaseType_t prvStreamRefuse(
+	Http2Client_t *pxClient,
+	Http2Stream_t *pxStream,
+	const char *pcStatus);
+static BaseType_t prvServeStreams(Http2Client_t *pxClient);
+static BaseType_t prvStreamStart(Http2Stream_t *pxStream);
+static BaseType_t prvStreamWantsWrite(Http2Stream_t *pxStream);
+static BaseType_t prvStreamOutput(void *pxc, const char *pcData, size_t uxLen);
+static BaseType_t prvResponseHead(
+	Http2Stream_t *pxStream,
+	const char *pcData,
+	const size_t uxLen,
+	size_t *puxUsed);
+static BaseType_t prvSendHead(Http2Stream_t *pxStream);
+static BaseType_t prvResponseChunked(Http2Stream_t *pxStream, const char cChar);
+static BaseType_t prvStreamData(
+	Http2Stream_t *pxStream,
+	const char *pcData,
+	const size_t uxLen);
+static BaseType_t prvSendData(
+	Http2Stream_t *pxStream,
+	const char *pcData,
+	const size_t uxLen);
+static BaseType_t prvQueueData(
+	Http2Stream_t *pxStream,
+	const char *pcData,
+	const size_t uxLen);
+static BaseType_t prvDrainStream(Http2Stream_t *pxStream);
+static BaseType_t prvSendFrame(
+	TCPClient_t *pxOwner,
+	const uint8_t ucType,
+	const uint8_t ucFlags,
+	const uint32_t ulId,
+	const void *pvPayload,
+	const size_t uxLen);
+static BaseType_t prvSendSettings(Http2Client_t *pxClient);
+static BaseType_t prvSendRstStream(
+	Http2Client_t *pxClient,
+	const uint32_t ulId,
+	const uint32_t ulError);
+static BaseType_t prvSendWindowUpdate(
+	Http2Client_t *pxClient,
+	const uint32_t ulId,
+	const uint32_t ulIncrement);
+static BaseType_t prvSendStatus(
+	Http2Client_t *pxClient,
+	const uint32_t ulId,
+	const char *pcStatus,
+	const BaseType_t xReset);
+static BaseType_t prvSendGoaway(Http2Client_t *pxClient);
+static BaseType_t prvFindHeader(
+	const char *pcHead,
+	const char *pcEnd,
+	const char *pcName,
+	const char **ppcValue);
+static const char *prvFindHeadEnd(const char *pcData, const size_t uxLen);
+static void prvPut32(uint8_t *pucDst, const uint32_t ulValue);
+static uint32_t prvGet32(const uint8_t *pucSrc);
+
+/*===============================================
+ private global variables
+ ===============================================*/
+
+#if (emberHTTP2_HPACK_TABLE_SIZE > 0)
+/* The dynamic table of the connection whose request is being decoded, as it
+ * was before the request's header block, which is decoded once per pass */
+static HpackTable_t xSavedTable;
+static uint8_t pucSavedTable[emberHTTP2_HPACK_TABLE_SIZE];
+#endif
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+BaseType_t xHttp2Upgrade(void *pxc, const char *pcData, size_t uxLen)
+{
+	Http2Client_t *pxClient = (Http2Client_t *)pxc;
+	Http2Connection_t *pxConn;
+	Http2Stream_t *pxStream;
+	const char *pcEnd, *pcValue;
+	BaseType_t xLen, xRc, xSent = 0;
+	if (uxLen >= HTTP2_PREFACE_SZ && memcmp(pcData, pcPreface, HTTP2_PREFACE_SZ) == 0)
+	{
+		// "prior knowledge": the client started with the HTTP/2 preface
+		pxConn = prvConnectionCreate();
+		if (pxConn == NULL)
+			return -pdFREERTOS_ERRNO_ENOMEM;
+		// any frames that followed the preface are processed by the worker
+		pxConn->uxInLen = uxLen - HTTP2_PREFACE_SZ;
+		memcpy(pxConn->pucIn, &pcData[HTTP2_PREFACE_SZ], pxConn->uxInLen);
+		pxConn->pxClient = pxClient;
+		pxClient->pxConn = pxConn;
+	}
+	else
+	{
+		// only a complete request, without a body, is upgraded; anything else
+		// is served as HTTP/1.1, as the upgrade is optional
+		pcEnd = prvFindHeadEnd(pcData, uxLen);
+		if (pcEnd == NULL || uxLen >= sizeof(pxStream->pcBuff))
+			return 0;
+		xLen = prvFindHeader(pcData, pcEnd, "Upgrade", &pcValue);
+		if (xLen < 3 || strncasecmp(pcValue, "h2c", 3) != 0
+			|| (xLen > 3 && pcValue[3] != ',' && pcValue[3] != ' '))
+			return 0;
+		if (prvFindHeader(pcData, pcEnd, "Transfer-Encoding", &pcValue) >= 0)
+			return 0;
+		xLen = prvFindHeader(pcData, pcEnd, "Content-Length", &pcValue);
+		if (xLen > 0 && (xLen != 1 || pcValue[0] != '0'))
+			return 0;
+		xLen = prvFindHeader(pcData, pcEnd, "HTTP2-Settings", &pcValue);
+		if (xLen < 0)
+			return 0;
+		pxConn = prvConnectionCreate();
+		if (pxConn == NULL)
+			return 0;
+		if (prvApplyEncodedSettings(pxConn, pcValue, (size_t)xLen) < 0)
+		{
+			vPortFree(pxConn);
+			return 0;
+		}
+		// the request is served as it is, on stream 1
+		pxConn->pxClient = pxClient;
+		pxClient->pxConn = pxConn;
+		pxStream = prvStreamCreate(pxClient, 1);
+		if (pxStream == NULL)
+		{
+			vPortFree(pxConn);
+			pxClient->pxConn = NULL;
+			return 0;
+		}
+		memcpy(pxStream->pcBuff, pcData, uxLen);
+		pxStream->uxLen = uxLen;
+		pxStream->xState = eStream_Ready;
+		pxConn->ulLastStream = 1;
+		// the client sends its preface once it has received the 101 response
+		pxConn->uxPrefaceLeft = HTTP2_PREFACE_SZ;
+	}
+	pxClient->xCreator = HTTP2_CREATOR_METHOD;
+	pxClient->xWork = HTTP2_WORKER_METHOD;
+	pxClient->xDelete = HTTP2_DELETE_METHOD;
+	if (pxConn->uxPrefaceLeft > 0)
+	{
+		xRc = xEmberWrite((TCPClient_t *)pxClient, pcSwitchingProtocols,
+						  sizeof(pcSwitchingProtocols) - 1);
+		if (xRc < 0)
+			return xRc;
+		xSent = xRc;
+	}
+	xRc = prvSendSettings(pxClient);
+	if (xRc < 0)
+		return xRc;
+	xSent += xRc;
+	// streams use the send buffer, so the cork must be emptied before any are
+	// served
+	xRc = xEmberFlush((TCPClient_t *)pxClient);
+	if (xRc < 0)
+		return xRc;
+	return xSent;
+}
+
+BaseType_t xHttp2Work(void *pxc)
+{
+	Http2Client_t *pxClient = (Http2Client_t *)pxc;
+	BaseType_t xRc;
+	xRc = prvReceiveFrames(pxClient);
+	if (xRc >= 0)
+		xRc = prvServeStreams(pxClient);
+	// a connection error is reported before the connection is closed
+	if (xRc < 0 && pxClient->pxConn->xError != eHttp2Error_None)
+		prvSendGoaway(pxClient);
+	return xRc;
+}
+
+BaseType_t xHttp2Delete(void *pxc)
+{
+	Http2Client_t *pxClient = (Http2Client_t *)pxc;
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	if (pxConn == NULL)
+		return 0;
+	for (BaseType_t xi = 0; xi < emberHTTP2_MAX_STREAMS; xi++)
+	{
+		if (pxConn->pxStreams[xi] != NULL)
+			prvStreamClose(pxConn, pxConn->pxStreams[xi]);
+	}
+	vPortFree(pxConn);
+	pxClient->pxConn = NULL;
+	return 0;
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+static Http2Connection_t *prvConnectionCreate(void)
+{
+	Http2Connection_t *pxConn = pvPortMalloc(sizeof(Http2Connection_t));
+	if (pxConn == NULL)
+		return NULL;
+	memset(pxConn, 0, sizeof(Http2Connection_t));
+	pxConn->lSendWindow = HTTP2_DEFAULT_WINDOW;
+	pxConn->lInitialWindow = HTTP2_DEFAULT_WINDOW;
+	pxConn->ulMaxFrame = HTTP2_MAX_FRAME_SZ;
+#if (emberHTTP2_HPACK_TABLE_SIZE > 0)
+	vHpackTableInit(&pxConn->xTable, pxConn->pucTable, sizeof(pxConn->pucTable));
+#endif
+	return pxConn;
+}
+
+static BaseType_t prvConnectionError(
+	Http2Connection_t *pxConn,
+	const BaseType_t xError)
+{
+	pxConn->xError = xError;
+	return -pdFREERTOS_ERRNO_EINVAL;
+}
+
+static BaseType_t prvReceiveFrames(Http2Client_t *pxClient)
+{
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	const uint8_t *pucData;
+	size_t uxAvail, uxUsed;
+	BaseType_t xRc = 0;
+	if (pxConn->uxInLen < sizeof(pxConn->pucIn))
+	{
+		xRc = FreeRTOS_recv(pxClient->xSock, &pxConn->pucIn[pxConn->uxInLen],
+							sizeof(pxConn->pucIn) - pxConn->uxInLen, 0);
+		if (xRc < 0)
+			return xRc;
+		pxConn->uxInLen += (size_t)xRc;
+		xRc = 0;
+	}
+	// the client preface of an upgraded connection
+	while (pxConn->uxPrefaceLeft > 0 && pxConn->uxInPos < pxConn->uxInLen)
+	{
+		if (pxConn->pucIn[pxConn->uxInPos++]
+			!= (uint8_t)pcPreface[HTTP2_PREFACE_SZ - pxConn->uxPrefaceLeft])
+			return prvConnectionError(pxConn, eHttp2Error_Protocol);
+		pxConn->uxPrefaceLeft--;
+	}
+	while (xRc >= 0 && pxConn->uxPrefaceLeft == 0)
+	{
+		uxAvail = pxConn->uxInLen - pxConn->uxInPos;
+		pucData = &pxConn->pucIn[pxConn->uxInPos];
+		if (!pxConn->xInFrame)
+		{
+			if (uxAvail < HTTP2_FRAME_HEADER_SZ)
+				break;
+			pxConn->uxInPos += HTTP2_FRAME_HEADER_SZ;
+			xRc = prvFrameStart(pxClient, pucData);
+		}
+		else if (pxConn->ucType == eHttp2_Settings || pxConn->ucType == eHttp2_Ping
+				 || pxConn->ucType == eHttp2_WindowUpdate
+				 || pxConn->ucType == eHttp2_RstStream)
+		{
+			// control frames are small, and are processed whole
+			if (uxAvail < pxConn->uxLeft)
+				break;
+			pxConn->uxInPos += pxConn->uxLeft;
+			pxConn->xInFrame = pdFALSE;
+			xRc = prvFrameControl(pxClient, pucData);
+		}
+		else
+		{
+			// other frames are processed as their payload arrives
+			if (uxAvail == 0 && pxConn->uxLeft > 0)
+				break;
+			uxUsed = (uxAvail < pxConn->uxLeft) ? uxAvail : pxConn->uxLeft;
+			pxConn->uxInPos += uxUsed;
+			xRc = prvFramePayload(pxClient, pucData, uxUsed);
+			if (xRc >= 0 && pxConn->uxLeft == 0)
+			{
+				pxConn->xInFrame = pdFALSE;
+				xRc = prvFrameEnd(pxClient);
+			}
+		}
+	}
+	// keep the unprocessed data, e.g. the start of a frame, at the start of the
+	// buffer
+	memmove(pxConn->pucIn, &pxConn->pucIn[pxConn->uxInPos],
+			pxConn->uxInLen - pxConn->uxInPos);
+	pxConn->uxInLen -= pxConn->uxInPos;
+	pxConn->uxInPos = 0;
+	return xRc;
+}
+
+static BaseType_t prvFrameStart(Http2Client_t *pxClient, const uint8_t *pucHead)
+{
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	pxConn->uxFrameLen = ((size_t)pucHead[0] << 16) | ((size_t)pucHead[1] << 8)
+						 | pucHead[2];
+	pxConn->uxLeft = pxConn->uxFrameLen;
+	pxConn->ucType = pucHead[3];
+	pxConn->ucFlags = pucHead[4];
+	pxConn->ulStream = prvGet32(&pucHead[5]) & 0x7FFFFFFFu;
+	pxConn->uxSkip = 0;
+	pxConn->uxPad = 0;
+	pxConn->xPadPending = pdFALSE;
+	pxConn->xInFrame = pdTRUE;
+	// SETTINGS_MAX_FRAME_SIZE is not advertised, so is the default
+	if (pxConn->uxFrameLen > HTTP2_MAX_FRAME_SZ)
+		return prvConnectionError(pxConn, eHttp2Error_FrameSize);
+	// nothing may come between the frames of a header block
+	if (pxConn->ulBlockStream != 0
+		&& (pxConn->ucType != eHttp2_Continuation
+			|| pxConn->ulStream != pxConn->ulBlockStream))
+		return prvConnectionError(pxConn, eHttp2Error_Protocol);
+	switch (pxConn->ucType)
+	{
+	case eHttp2_Data:
+		if (pxConn->ulStream == 0)
+			return prvConnectionError(pxConn, eHttp2Error_Protocol);
+		pxConn->xPadPending = (pxConn->ucFlags & eHttp2Flag_Padded) != 0;
+		break;
+	case eHttp2_Headers:
+		if (pxConn->ulStream == 0)
+			return prvConnectionError(pxConn, eHttp2Error_Protocol);
+		pxConn->xPadPending = (pxConn->ucFlags & eHttp2Flag_Padded) != 0;
+		// the stream dependency and weight are not used
+		if (pxConn->ucFlags & eHttp2Flag_Priority)
+			pxConn->uxSkip = 5;
+		return prvBlockStart(pxClient);
+	case eHttp2_Continuation:
+		if (pxConn->ulBlockStream == 0)
+			return prvConnectionError(pxConn, eHttp2Error_Protocol);
+		break;
+	case eHttp2_Settings:
+		if (pxConn->ulStream != 0)
+			return prvConnectionError(pxConn, eHttp2Error_Protocol);
+		if ((pxConn->ucFlags & eHttp2Flag_EndStream)
+				? pxConn->uxFrameLen != 0
+				: (pxConn->uxFrameLen % 6) != 0
+					  || pxConn->uxFrameLen > sizeof(pxConn->pucIn))
+			return prvConnectionError(pxConn, eHttp2Error_FrameSize);
+		break;
+	case eHttp2_Ping:
+		if (pxConn->ulStream != 0)
+			return prvConnectionError(pxConn, eHttp2Error_Protocol);
+		if (pxConn->uxFrameLen != 8)
+			return prvConnectionError(pxConn, eHttp2Error_FrameSize);
+		break;
+	case eHttp2_WindowUpdate:
+		if (pxConn->uxFrameLen != 4)
+			return prvConnectionError(pxConn, eHttp2Error_FrameSize);
+		break;
+	case eHttp2_RstStream:
+		if (pxConn->ulStream == 0)
+			return prvConnectionError(pxConn, eHttp2Error_Protocol);
+		if (pxConn->uxFrameLen != 4)
+			return prvConnectionError(pxConn, eHttp2Error_FrameSize);
+		break;
+	case eHttp2_Priority:
+		if (pxConn->uxFrameLen != 5)
+			return prvConnectionError(pxConn, eHttp2Error_FrameSize);
+		break;
+	case eHttp2_PushPromise:
+		// clients cannot push
+		return prvConnectionError(pxConn, eHttp2Error_Protocol);
+	default:
+		// GOAWAY, which needs no action as no stream is ever retried, and
+		// unknown frame types are discarded
+		break;
+	}
+	return 0;
+}
+
+static BaseType_t prvFramePayload(
+	Http2Client_t *pxClient,
+	const uint8_t *pucData,
+	size_t uxLen)
+{
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	size_t uxUsed;
+	BaseType_t xRc;
+	while (uxLen > 0)
+	{
+		if (pxConn->xPadPending)
+		{
+			pxConn->uxPad = *pucData++;
+			uxLen--;
+			pxConn->uxLeft--;
+			pxConn->xPadPending = pdFALSE;
+			if (pxConn->uxPad + pxConn->uxSkip > pxConn->uxLeft)
+				return prvConnectionError(pxConn, eHttp2Error_Protocol);
+			continue;
+		}
+		uxUsed = uxLen;
+		if (pxConn->uxSkip > 0)
+		{
+			if (uxUsed > pxConn->uxSkip)
+				uxUsed = pxConn->uxSkip;
+			pxConn->uxSkip -= uxUsed;
+		}
+		else if (pxConn->uxLeft > pxConn->uxPad)
+		{
+			if (uxUsed > pxConn->uxLeft - pxConn->uxPad)
+				uxUsed = pxConn->uxLeft - pxConn->uxPad;
+			xRc = prvFrameData(pxClient, pucData, uxUsed);
+			if (xRc < 0)
+				return xRc;
+		}
+		// anything else is padding, and is discarded
+		pucData += uxUsed;
+		uxLen -= uxUsed;
+		pxConn->uxLeft -= uxUsed;
+	}
+	return 0;
+}
+
+static BaseType_t prvFrameData(
+	Http2Client_t *pxClient,
+	const uint8_t *pucData,
+	const size_t uxLen)
+{
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	switch (pxConn->ucType)
+	{
+	case eHttp2_Data:
+		return prvRequestBody(pxClient, pucData, uxLen);
+	case eHttp2_Headers:
+	case eHttp2_Continuation:
+		// a block that does not fit is discarded, and its request refused
+		if (pxConn->uxBlockLen + uxLen > sizeof(pxConn->pucBlock))
+			pxConn->xBlockOverflow = pdTRUE;
+		if (!pxConn->xBlockOverflow)
+		{
+			memcpy(&pxConn->pucBlock[pxConn->uxBlockLen], pucData, uxLen);
+			pxConn->uxBlockLen += uxLen;
+		}
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+static BaseType_t prvFrameEnd(Http2Client_t *pxClient)
+{
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	BaseType_t xRc = 0;
+	// a padded frame must at least contain its pad length
+	if (pxConn->xPadPending)
+		return prvConnectionError(pxConn, eHttp2Error_FrameSize);
+	switch (pxConn->ucType)
+	{
+	case eHttp2_Data:
+		// the data has been consumed (or discarded), so the client may send as
+		// much again; a stream's window never runs out, as its request is
+		// refused long before
+		if (pxConn->uxFrameLen > 0)
+			xRc = prvSendWindowUpdate(pxClient, 0, (uint32_t)pxConn->uxFrameLen);
+		if (xRc >= 0 && (pxConn->ucFlags & eHttp2Flag_EndStream))
+			prvRequestEnd(prvStreamFind(pxConn, pxConn->ulStream));
+		return xRc;
+	case eHttp2_Headers:
+	case eHttp2_Continuation:
+		if (pxConn->ucFlags & eHttp2Flag_EndHeaders)
+			return prvBlockEnd(pxClient);
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+static BaseType_t prvFrameControl(Http2Client_t *pxClient, const uint8_t *pucData)
+{
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	Http2Stream_t *pxStream;
+	uint32_t ulValue;
+	BaseType_t xRc;
+	switch (pxConn->ucType)
+	{
+	case eHttp2_Settings:
+		if (pxConn->ucFlags & eHttp2Flag_EndStream)
+			return 0;
+		xRc = prvApplySettings(pxConn, pucData, pxConn->uxFrameLen);
+		if (xRc < 0)
+			return xRc;
+		return prvSendFrame((TCPClient_t *)pxClient, eHttp2_Settings,
+							eHttp2Flag_EndStream, 0, NULL, 0);
+	case eHttp2_Ping:
+		if (pxConn->ucFlags & eHttp2Flag_EndStream)
+			return 0;
+		return prvSendFrame((TCPClient_t *)pxClient, eHttp2_Ping,
+							eHttp2Flag_EndStream, 0, pucData, 8);
+	case eHttp2_WindowUpdate:
+		ulValue = prvGet32(pucData) & 0x7FFFFFFFu;
+		if (ulValue == 0)
+			return prvConnectionError(pxConn, eHttp2Error_Protocol);
+		if (pxConn->ulStream == 0)
+		{
+			if (ulValue > (uint32_t)(0x7FFFFFFF - pxConn->lSendWindow))
+				return prvConnectionError(pxConn, eHttp2Error_FlowControl);
+			pxConn->lSendWindow += (int32_t)ulValue;
+			return 0;
+		}
+		pxStream = prvStreamFind(pxConn, pxConn->ulStream);
+		if (pxStream == NULL)
+			return 0;
+		if (ulValue > (uint32_t)(0x7FFFFFFF - pxStream->lSendWindow))
+			return prvConnectionError(pxConn, eHttp2Error_FlowControl);
+		pxStream->lSendWindow += (int32_t)ulValue;
+		return 0;
+	case eHttp2_RstStream:
+		pxStream = prvStreamFind(pxConn, pxConn->ulStream);
+		if (pxStream != NULL)
+			prvStreamClose(pxConn, pxStream);
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+static BaseType_t prvApplySettings(
+	Http2Connection_t *pxConn,
+	const uint8_t *pucData,
+	const size_t uxLen)
+{
+	uint32_t ulValue;
+	int32_t lDelta;
+	for (size_t uxi = 0; uxi + 6 <= uxLen; uxi += 6)
+	{
+		ulValue = prvGet32(&pucData[uxi + 2]);
+		switch (((uint16_t)pucData[uxi] << 8) | pucData[uxi + 1])
+		{
+		case eSetting_InitialWindowSize:
+			if (ulValue > 0x7FFFFFFFu)
+				return prvConnectionError(pxConn, eHttp2Error_FlowControl);
+			// the windows of open streams change by the difference
+			lDelta = (int32_t)ulValue - pxConn->lInitialWindow;
+			for (BaseType_t xi = 0; xi < emberHTTP2_MAX_STREAMS; xi++)
+			{
+				if (pxConn->pxStreams[xi] != NULL)
+					pxConn->pxStreams[xi]->lSendWindow += lDelta;
+			}
+			pxConn->lInitialWindow = (int32_t)ulValue;
+			break;
+		case eSetting_MaxFrameSize:
+			if (ulValue < HTTP2_MAX_FRAME_SZ || ulValue > 0xFFFFFFu)
+				return prvConnectionError(pxConn, eHttp2Error_Protocol);
+			pxConn->ulMaxFrame = ulValue;
+			break;
+		default:
+			// the other settings do not affect a server that does not push,
+			// and that encodes headers without a dynamic table
+			break;
+		}
+	}
+	return 0;
+}
+
+static BaseType_t prvApplyEncodedSettings(
+	Http2Connection_t *pxConn,
+	const char *pcValue,
+	const size_t uxLen)
+{
+	// the value is the payload of a SETTINGS frame, in unpadded base64url; it
+	// is converted to base64 in the block buffer, and decoded into the output
+	// buffer, neither of which are in use yet
+	char *pcBase64 = (char *)pxConn->pucBlock;
+	size_t uxi, uxDecoded = sizeof(pxConn->pucOut);
+	if (uxLen + 3 > sizeof(pxConn->pucBlock))
+		return -pdFREERTOS_ERRNO_EINVAL;
+	for (uxi = 0; uxi < uxLen; uxi++)
+	{
+		pcBase64[uxi] = (pcValue[uxi] == '-') ? '+'
+						: (pcValue[uxi] == '_') ? '/'
+												: pcValue[uxi];
+	}
+	while ((uxi % 4) != 0)
+		pcBase64[uxi++] = '=';
+	if (base64_decode(pxConn->pucOut, &uxDecoded, (const uint8_t *)pcBase64,
+					  uxi) != 0
+		|| (uxDecoded % 6) != 0)
+		return -pdFREERTOS_ERRNO_EINVAL;
+	return prvApplySettings(pxConn, pxConn->pucOut, uxDecoded);
+}
+
+static BaseType_t prvBlockStart(Http2Client_t *pxClient)
+{
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	Http2Stream_t *pxStream = prvStreamFind(pxConn, pxConn->ulStream);
+	if (pxStream == NULL)
+	{
+		// a new stream's identifier must be odd, and larger than any before
+		if ((pxConn->ulStream & 1u) == 0 || pxConn->ulStream <= pxConn->ulLastStream)
+			return prvConnectionError(pxConn, eHttp2Error_Protocol);
+		pxConn->ulLastStream = pxConn->ulStream;
+	}
+	else if (pxStream->xState != eStream_Request)
+	{
+		return prvConnectionError(pxConn, eHttp2Error_Protocol);
+	}
+	pxConn->ulBlockStream = pxConn->ulStream;
+	pxConn->uxBlockLen = 0;
+	pxConn->xBlockEndStream = (pxConn->ucFlags & eHttp2Flag_EndStream) != 0;
+	pxConn->xBlockOverflow = pdFALSE;
+	return 0;
+}
+
+static BaseType_t prvBlockEnd(Http2Client_t *pxClient)
+{
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	const uint32_t ulId = pxConn->ulBlockStream;
+	Http2Stream_t *pxStream = prvStreamFind(pxConn, ulId);
+	BaseType_t xRc;
+	pxConn->ulBlockStream = 0;
+#if (emberHTTP2_HPACK_TABLE_SIZE > 0)
+	// a block that was not kept cannot be decoded, so what it added to the
+	// dynamic table is unknown
+	if (pxConn->xBlockOverflow)
+		vHpackTableClear(&pxConn->xTable);
+#endif
+	if (pxStream != NULL)
+	{
+		// trailers, which are not passed on, but are decoded for the fields
+		// that they add to the dynamic table
+		if (!pxConn->xBlockOverflow && prvSkipBlock(pxConn) < 0)
+			return prvConnectionError(pxConn, eHttp2Error_Compression);
+		if (pxConn->xBlockEndStream)
+			prvRequestEnd(pxStream);
+		return 0;
+	}
+	if (pxConn->xBlockOverflow)
+		return prvSendStatus(pxClient, ulId, "431", !pxConn->xBlockEndStream);
+	pxStream = prvStreamCreate(pxClient, ulId);
+	if (pxStream == NULL)
+	{
+		// a refused stream's block is decoded all the same
+		if (prvSkipBlock(pxConn) < 0)
+			return prvConnectionError(pxConn, eHttp2Error_Compression);
+		return prvSendRstStream(pxClient, ulId, eHttp2Error_RefusedStream);
+	}
+	xRc = prvRequestHeaders(pxConn, pxStream);
+	if (xRc == -pdFREERTOS_ERRNO_EBADE)
+	{
+		// a malformed request
+		prvStreamClose(pxConn, pxStream);
+		return prvSendRstStream(pxClient, ulId, eHttp2Error_Protocol);
+	}
+	if (xRc == -pdFREERTOS_ERRNO_ENOBUFS)
+		return prvStreamRefuse(pxClient, pxStream, "431");
+	if (xRc < 0)
+		return prvConnectionError(pxConn, eHttp2Error_Compression);
+	if (pxConn->xBlockEndStream)
+		prvRequestEnd(pxStream);
+	return 0;
+}
+
+static BaseType_t prvRequestHeaders(Http2Connection_t *pxConn, Http2Stream_t *pxStream)
+{
+	RequestBuilder_t xBuilder = {pxStream, 0, 0, 0, pdFALSE};
+	BaseType_t xRc = 0;
+	// every pass adds the block's indexed fields to the dynamic table, so the
+	// table is restored before each pass after the first
+	prvSaveTable(pxConn);
+	for (xBuilder.xPass = 0; xBuilder.xPass < 3 && xRc >= 0; xBuilder.xPass++)
+	{
+		if (xBuilder.xPass > 0)
+			prvRestoreTable(pxConn);
+		xRc = prvDecodeBlock(pxConn, prvRequestField, &xBuilder);
+		// a request has exactly one method and one path
+		if (xRc >= 0
+			&& ((xBuilder.xPass == 0 && xBuilder.xMethods != 1)
+				|| (xBuilder.xPass == 1 && xBuilder.xPaths != 1)))
+			xRc = -pdFREERTOS_ERRNO_EBADE;
+	}
+	if (xRc < 0)
+	{
+		// a request that is refused, part of the way through its block, must
+		// still add all of the block's fields to the table
+		prvRestoreTable(pxConn);
+		if (prvSkipBlock(pxConn) < 0)
+			return -pdFREERTOS_ERRNO_EINVAL;
+		return xRc;
+	}
+	// the Content-Length header, and the end of the headers, are written once
+	// the whole body has been received
+	if (pxStream->uxLen + uxLengthGap >= sizeof(pxStream->pcBuff))
+		return -pdFREERTOS_ERRNO_ENOBUFS;
+	pxStream->uxHeadLen = pxStream->uxLen;
+	pxStream->uxBodyLen = 0;
+	return 0;
+}
+
+static BaseType_t prvDecodeBlock(
+	Http2Connection_t *pxConn,
+	xHpackField *pxField,
+	void *pvArg)
+{
+#if (emberHTTP2_HPACK_TABLE_SIZE > 0)
+	HpackTable_t *pxTable = &pxConn->xTable;
+#else
+	HpackTable_t *pxTable = NULL;
+#endif
+	return xHpackDecode(pxTable, pxConn->pucBlock, pxConn->uxBlockLen,
+						(char *)pxConn->pucOut, sizeof(pxConn->pucOut),
+						pxField, pvArg);
+}
+
+static BaseType_t prvSkipBlock(Http2Connection_t *pxConn)
+{
+	// decodes a block only for the fields that it adds to the dynamic table; if
+	// a string does not fit in the scratch space, the table is cleared instead,
+	// as what the block added is unknown
+	BaseType_t xRc = prvDecodeBlock(pxConn, prvIgnoreField, NULL);
+	if (xRc != -pdFREERTOS_ERRNO_ENOBUFS)
+		return xRc;
+#if (emberHTTP2_HPACK_TABLE_SIZE > 0)
+	vHpackTableClear(&pxConn->xTable);
+#endif
+	return 0;
+}
+
+static BaseType_t prvIgnoreField(
+	void *pvArg,
+	const char *pcName,
+	size_t uxNameLen,
+	const char *pcValue,
+	size_t uxValueLen)
+{
+	return 0;
+}
+
+static void prvSaveTable(Http2Connection_t *pxConn)
+{
+#if (emberHTTP2_HPACK_TABLE_SIZE > 0)
+	vHpackTableInit(&xSavedTable, pucSavedTable, sizeof(pucSavedTable));
+	vHpackTableCopy(&xSavedTable, &pxConn->xTable);
+#endif
+}
+
+static void prvRestoreTable(Http2Connection_t *pxConn)
+{
+#if (emberHTTP2_HPACK_TABLE_SIZE > 0)
+	vHpackTableCopy(&pxConn->xTable, &xSavedTable);
+#endif
+}
+
+static BaseType_t prvRequestField(
+	void *pvArg,
+	const char *pcName,
+	size_t uxNameLen,
+	const char *pcValue,
+	size_t uxValueLen)
+{
+	RequestBuilder_t *pxBuilder = (RequestBuilder_t *)pvArg;
+	Http2Stream_t *pxStream = pxBuilder->pxStream;
+	BaseType_t xRc;
+	// a field must not end its line of the HTTP/1.1 request early; only a
+	// pseudo-header's name contains a colon, at its start
+	if (uxNameLen == 0)
+		return -pdFREERTOS_ERRNO_EBADE;
+	for (size_t uxi = 0; uxi < uxNameLen; uxi++)
+	{
+		if (pcName[uxi] <= ' ' || (pcName[uxi] == ':' && uxi > 0))
+			return -pdFREERTOS_ERRNO_EBADE;
+	}
+	if (memchr(pcValue, '\r', uxValueLen) != NULL
+		|| memchr(pcValue, '\n', uxValueLen) != NULL
+		|| memchr(pcValue, 0, uxValueLen) != NULL)
+		return -pdFREERTOS_ERRNO_EBADE;
+	switch (pxBuilder->xPass)
+	{
+	case 0:
+		if (uxNameLen == 10 && memcmp(pcName, ":authority", 10) == 0)
+			pxBuilder->xAuthority = pdTRUE;
+		if (uxNameLen != 7 || memcmp(pcName, ":method", 7) != 0)
+			return 0;
+		pxBuilder->xMethods++;
+		xRc = prvRequestAppend(pxStream, pcValue, uxValueLen);
+		if (xRc < 0)
+			return xRc;
+		return prvRequestAppend(pxStream, " ", 1);
+	case 1:
+		if (uxNameLen != 5 || memcmp(pcName, ":path", 5) != 0)
+			return 0;
+		if (uxValueLen == 0 || memchr(pcValue, ' ', uxValueLen) != NULL)
+			return -pdFREERTOS_ERRNO_EBADE;
+		pxBuilder->xPaths++;
+		xRc = prvRequestAppend(pxStream, pcValue, uxValueLen);
+		if (xRc < 0)
+			return xRc;
+		return prvRequestAppend(pxStream, " HTTP/1.1\r\n", 11);
+	default:
+		if (uxNameLen == 10 && memcmp(pcName, ":authority", 10) == 0)
+		{
+			pcName = "Host";
+			uxNameLen = 4;
+		}
+		else if (pcName[0] == ':'
+				 || (uxNameLen == 4 && memcmp(pcName, "host", 4) == 0
+					 && pxBuilder->xAuthority)
+				 || (uxNameLen == 14 && memcmp(pcName, "content-length", 14) == 0))
+		{
+			// the other pseudo-headers, and the headers that are replaced
+			return 0;
+		}
+		xRc = prvRequestAppend(pxStream, pcName, uxNameLen);
+		if (xRc >= 0)
+			xRc = prvRequestAppend(pxStream, ": ", 2);
+		if (xRc >= 0)
+			xRc = prvRequestAppend(pxStream, pcValue, uxValueLen);
+		if (xRc >= 0)
+			xRc = prvRequestAppend(pxStream, "\r\n", 2);
+		return xRc;
+	}
+}
+
+static BaseType_t prvRequestAppend(
+	Http2Stream_t *pxStream,
+	const char *pcData,
+	const size_t uxLen)
+{
+	if (uxLen > sizeof(pxStream->pcBuff) - pxStream->uxLen)
+		return -pdFREERTOS_ERRNO_ENOBUFS;
+	memcpy(&pxStream->pcBuff[pxStream->uxLen], pcData, uxLen);
+	pxStream->uxLen += uxLen;
+	return 0;
+}
+
+static BaseType_t prvRequestBody(
+	Http2Client_t *pxClient,
+	const uint8_t *pucData,
+	const size_t uxLen)
+{
+	Http2Stream_t *pxStream = prvStreamFind(pxClient->pxConn,
+											pxClient->pxConn->ulStream);
+	size_t uxOffset;
+	// the data of a stream that was closed, or refused, is discarded
+	if (pxStream == NULL || pxStream->xState != eStream_Request)
+		return 0;
+	// the whole request must fit in the receive buffer, as for HTTP/1.1
+	uxOffset = pxStream->uxHeadLen + uxLengthGap + pxStream->uxBodyLen;
+	if (uxLen >= sizeof(pxStream->pcBuff) - uxOffset)
+		return prvStreamRefuse(pxClient, pxStream, "413");
+	memcpy(&pxStream->pcBuff[uxOffset], pucData, uxLen);
+	pxStream->uxBodyLen += uxLen;
+	return 0;
+}
+
+static void prvRequestEnd(Http2Stream_t *pxStream)
+{
+	char *pcDst;
+	if (pxStream == NULL || pxStream->xState != eStream_Request)
+		return;
+	// the raw request of an upgraded connection is already complete
+	if (pxStream->uxHeadLen > 0)
+	{
+		pcDst = &pxStream->pcBuff[pxStream->uxHeadLen];
+		if (pxStream->uxBodyLen > 0)
+		{
+			memcpy(pcDst, pcContentLength, sizeof(pcContentLength) - 1);
+			pcDst += sizeof(pcContentLength) - 1;
+			pcDst += uxEmberUtoa(pcDst, pxStream->uxBodyLen);
+			*pcDst++ = '\r';
+			*pcDst++ = '\n';
+		}
+		*pcDst++ = '\r';
+		*pcDst++ = '\n';
+		memmove(pcDst, &pxStream->pcBuff[pxStream->uxHeadLen + uxLengthGap],
+				pxStream->uxBodyLen);
+		pxStream->uxLen = (size_t)(pcDst - pxStream->pcBuff) + pxStream->uxBodyLen;
+	}
+	pxStream->xState = eStream_Ready;
+}
+
+static Http2Stream_t *prvStreamCreate(Http2Client_t *pxClient, const uint32_t ulId)
+{
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	Http2Stream_t *pxStream;
+	HTTPClient_t *pxHttpClient;
+	BaseType_t xi;
+	for (xi = 0; xi < emberHTTP2_MAX_STREAMS; xi++)
+	{
+		if (pxConn->pxStreams[xi] == NULL)
+			break;
+	}
+	if (xi == emberHTTP2_MAX_STREAMS)
+		return NULL;
+	pxStream = (Http2Stream_t *)pvPortMalloc(sizeof(Http2Stream_t));
+	if (pxStream == NULL)
+		return NULL;
+	memset(pxStream, 0, sizeof(Http2Stream_t));
+	// the stream is an HTTP client of the connection's server, whose output is
+	// translated to frames on the connection
+	pxHttpClient = &pxStream->xClient;
+	pxHttpClient->pxParent = pxClient->pxParent;
+	pxHttpClient->xSock = pxClient->xSock;
+	pxHttpClient->ulRemoteAddress = pxClient->ulRemoteAddress;
+	pxHttpClient->xPriority = pxClient->xPriority;
+	pxHttpClient->xWork = HTTPD_WORKER_METHOD;
+	pxHttpClient->xDelete = HTTPD_DELETE_METHOD;
+	pxHttpClient->xOutput = prvStreamOutput;
+	xHttpCreate(pxHttpClient);
+	pxStream->pxConn = pxConn;
+	pxStream->ulId = ulId;
+	pxStream->lSendWindow = pxConn->lInitialWindow;
+	pxStream->xState = eStream_Request;
+	pxConn->pxStreams[xi] = pxStream;
+	return pxStream;
+}
+
+static Http2Stream_t *prvStreamFind(Http2Connection_t *pxConn, const uint32_t ulId)
+{
+	for (BaseType_t xi = 0; xi < emberHTTP2_MAX_STREAMS; xi++)
+	{
+		if (pxConn->pxStreams[xi] != NULL && pxConn->pxStreams[xi]->ulId == ulId)
+			return pxConn->pxStreams[xi];
+	}
+	return NULL;
+}
+
+static void prvStreamClose(Http2Connection_t *pxConn, Http2Stream_t *pxStream)
+{
+	for (BaseType_t xi = 0; xi < emberHTTP2_MAX_STREAMS; xi++)
+	{
+		if (pxConn->pxStreams[xi] == pxStream)
+			pxConn->pxStreams[xi] = NULL;
+	}
+	xHttpDelete(&pxStream->xClient);
+	vEmberDiscardOutput((TCPClient_t *)&pxStream->xClient);
+	vPortFree(pxStream);
+}
+
+static BaseType_t prvStreamRefuse(
+	Http2Client_t *pxClient,
+	Http2Stream_t *pxStream,
+	const char *pcStatus)
+{
+	const uint32_t ulId = pxStream->ulId;
+	const BaseType_t xReset = (pxStream->xState == eStream_Request);
+	prvStreamClose(pxClient->pxConn, pxStream);
+	return prvSendStatus(pxClient, ulId, pcStatus, xReset);
+}
+
+static BaseType_t prvServeStreams(Http2Client_t *pxClient)
+{
+	Http2Connection_t *pxConn = pxClient->pxConn;
+	Http2Stream_t *pxStream;
+	HTTPClient_t *pxHttpClient;
+	BaseType_t xRc, xWantWrite = pdFALSE;
+	for (BaseType_t xi = 0; xi < emberHTTP2_MAX_STREAMS; xi++)
+	{
+		pxStream = pxConn->pxStreams[xi];
+		if (pxStream == NULL || pxStream->xState == eStream_Request)
+			continue;
+		// streams are served while the connection's socket keeps up
+		if (pxClient->pxOutputHead != NULL)
+			break;
+		pxHttpClient = &pxStream->xClient;
+		xRc = 0;
+		if (pxStream->xState == eStream_Ready)
+		{
+			xRc = prvStreamStart(pxStream);
+		}
+		else
+		{
+			if (pxHttpClient->pxOutputHead != NULL)
+				xRc = prvDrainStream(pxStream);
+			if (xRc >= 0 && pxHttpClient->pxOutputHead == NULL
+				&& xHttpResponseInProgress(pxHttpClient))
+				xRc = xHttpWork(pxHttpClient);
+		}
+		if (xRc < 0)
+		{
+			const uint32_t ulId = pxStream->ulId;
+			prvStreamClose(pxConn, pxStream);
+			xRc = prvSendRstStream(pxClient, ulId, eHttp2Error_Internal);
+			if (xRc < 0)
+				return xRc;
+			continue;
+		}
+		// the response is complete once all of it has been sent
+		if (pxHttpClient->pxOutputHead == NULL
+			&& !xHttpResponseInProgress(pxHttpClient))
+		{
+			const uint32_t ulId = pxStream->ulId;
+			const BaseType_t xHeadSent = pxStream->xHeadSent;
+			prvStreamClose(pxConn, pxStream);
+			if (xHeadSent)
+				xRc = prvSendFrame((TCPClient_t *)pxClient, eHttp2_Data,
+								   eHttp2Flag_EndStream, ulId, NULL, 0);
+			else
+				xRc = prvSendRstStream(pxClient, ulId, eHttp2Error_Internal);
+			if (xRc < 0)
+				return xRc;
+			continue;
+		}
+		xWantWrite |= prvStreamWantsWrite(pxStream);
+	}
+	// the connection is served again as soon as its socket may be written to,
+	// if that would let a stream make progress
+	for (BaseType_t xi = 0; xi < emberHTTP2_MAX_STREAMS && !xWantWrite; xi++)
+	{
+		pxStream = pxConn->pxStreams[xi];
+		xWantWrite = (pxStream != NULL && pxStream->xState == eStream_Ready);
+	}
+	if (xWantWrite || pxClient->pxOutputHead != NULL)
+		FreeRTOS_FD_SET(pxClient->xSock, pxClient->pxParent->xSockSet,
+						eSELECT_WRITE);
+	else
+		FreeRTOS_FD_CLR(pxClient->xSock, pxClient->pxParent->xSockSet,
+						eSELECT_WRITE);
+	return 0;
+}
+
+static BaseType_t prvStreamStart(Http2Stream_t *pxStream)
+{
+	HTTPClient_t *pxHttpClient = &pxStream->xClient;
+	// the request is served from the server's receive buffer, as if it had
+	// been received on a socket
+	memcpy(pxHttpClient->pxParent->pcRcvBuff, pxStream->pcBuff, pxStream->uxLen);
+	pxHttpClient->uxPendingRequest = pxStream->uxLen;
+	pxStream->xState = eStream_Response;
+	// the stream's buffer now collects the headers of the response
+	pxStream->xResponse = eResponse_Head;
+	pxStream->uxLen = 0;
+	return xHttpWork(pxHttpClient);
+}
+
+static BaseType_t prvStreamWantsWrite(Http2Stream_t *pxStream)
+{
+	HTTPClient_t *pxHttpClient = &pxStream->xClient;
+	// queued data waits for a window update, if it cannot be sent
+	if (pxHttpClient->pxOutputHead != NULL)
+		return pxStream->lSendWindow > 0 && pxStream->pxConn->lSendWindow > 0;
+	// producers and responses waiting for a cache are polled
+	return pxHttpClient->bits.bFileInProgress
+		   || pxHttpClient->bits.bTemplateInProgress
+		   || pxHttpClient->bits.bRomInProgress;
+}
+
+static BaseType_t prvStreamOutput(void *pxc, const char *pcData, size_t uxLen)
+{
+	Http2Stream_t *pxStream = (Http2Stream_t *)pxc;
+	const size_t uxTotal = uxLen;
+	size_t uxUsed;
+	BaseType_t xRc = 0;
+	while (uxLen > 0 && xRc >= 0)
+	{
+		uxUsed = 1;
+		switch (pxStream->xResponse)
+		{
+		case eResponse_Head:
+			xRc = prvResponseHead(pxStream, pcData, uxLen, &uxUsed);
+			break;
+		case eResponse_Body:
+			uxUsed = uxLen;
+			xRc = prvStreamData(pxStream, pcData, uxLen);
+			break;
+		case eResponse_ChunkData:
+			// chunks are sent as they are, without their framing
+			uxUsed = (uxLen < pxStream->uxChunkLeft) ? uxLen : pxStream->uxChunkLeft;
+			xRc = prvStreamData(pxStream, pcData, uxUsed);
+			pxStream->uxChunkLeft -= uxUsed;
+			if (pxStream->uxChunkLeft == 0)
+				pxStream->xResponse = eResponse_ChunkEnd;
+			break;
+		case eResponse_Done:
+			uxUsed = uxLen;
+			break;
+		default:
+			xRc = prvResponseChunked(pxStream, *pcData);
+			break;
+		}
+		pcData += uxUsed;
+		uxLen -= uxUsed;
+	}
+	if (xRc < 0)
+		return xRc;
+	return (BaseType_t)uxTotal;
+}
+
+static BaseType_t prvResponseHead(
+	Http2Stream_t *pxStream,
+	const char *pcData,
+	const size_t uxLen,
+	size_t *puxUsed)
+{
+	const size_t uxStart = pxStream->uxLen;
+	const char *pcEnd;
+	size_t uxUsed = sizeof(pxStream->pcBuff) - pxStream->uxLen;
+	if (uxUsed > uxLen)
+		uxUsed = uxLen;
+	memcpy(&pxStream->pcBuff[pxStream->uxLen], pcData, uxUsed);
+	pxStream->uxLen += uxUsed;
+	// the end of the headers may span writes
+	pcEnd = prvFindHeadEnd(&pxStream->pcBuff[(uxStart > 3) ? uxStart - 3 : 0],
+						   pxStream->uxLen - ((uxStart > 3) ? uxStart - 3 : 0));
+	if (pcEnd == NULL)
+	{
+		*puxUsed = uxUsed;
+		return (pxStream->uxLen < sizeof(pxStream->pcBuff))
+				   ? 0
+				   : -pdFREERTOS_ERRNO_ENOBUFS;
+	}
+	// the rest of the write is the start of the body
+	pxStream->uxLen = (size_t)(pcEnd - pxStream->pcBuff) + 4;
+	*puxUsed = pxStream->uxLen - uxStart;
+	return prvSendHead(pxStream);
+}
+
+static BaseType_t prvSendHead(Http2Stream_t *pxStream)
+{
+	Http2Connection_t *pxConn = pxStream->pxConn;
+	char *pcLine, *pcEol, *pcColon, *pcValue, *pcEnd;
+	const char *pcValueEnd;
+	size_t uxOut, uxField, uxi;
+	BaseType_t xChunked = pdFALSE, xSkip;
+	pcEnd = &pxStream->pcBuff[pxStream->uxLen - 2];
+	if (pxStream->uxLen < 14 || memcmp(pxStream->pcBuff, "HTTP/1.1 ", 9) != 0)
+		return -pdFREERTOS_ERRNO_EINVAL;
+	uxOut = uxHpackEncode(pxConn->pucOut, sizeof(pxConn->pucOut), ":status", 7,
+						  &pxStream->pcBuff[9], 3);
+	pcLine = memchr(pxStream->pcBuff, '\n', pxStream->uxLen) + 1;
+	while (pcLine < pcEnd)
+	{
+		pcEol = memchr(pcLine, '\r', (size_t)(pcEnd - pcLine) + 1);
+		pcColon = memchr(pcLine, ':', (size_t)(pcEol - pcLine));
+		if (pcColon == NULL)
+		{
+			pcLine = pcEol + 2;
+			continue;
+		}
+		// HTTP/2 field names are lowercase
+		for (char *pc = pcLine; pc < pcColon; pc++)
+		{
+			if (*pc >= 'A' && *pc <= 'Z')
+				*pc += 'a' - 'A';
+		}
+		pcValue = pcColon + 1;
+		while (pcValue < pcEol && (*pcValue == ' ' || *pcValue == '\t'))
+			pcValue++;
+		pcValueEnd = pcEol;
+		while (pcValueEnd > pcValue && (pcValueEnd[-1] == ' ' || pcValueEnd[-1] == '\t'))
+			pcValueEnd--;
+		xSkip = pdFALSE;
+		for (uxi = 0; uxi < sizeof(pcConnectionHeaders) / sizeof(pcConnectionHeaders[0]); uxi++)
+		{
+			if (strlen(pcConnectionHeaders[uxi]) == (size_t)(pcColon - pcLine)
+				&& memcmp(pcConnectionHeaders[uxi], pcLine, (size_t)(pcColon - pcLine)) == 0)
+				xSkip = pdTRUE;
+		}
+		// a chunked body is sent without its framing
+		if (xSkip && (pcColon - pcLine) == 17 && memcmp(pcLine, "transfer-encoding", 17) == 0)
+			xChunked = pdTRUE;
+		if (!xSkip)
+		{
+			uxField = uxHpackEncode(&pxConn->pucOut[uxOut], sizeof(pxConn->pucOut) - uxOut,
+									pcLine, (size_t)(pcColon - pcLine),
+									pcValue, (size_t)(pcValueEnd - pcValue));
+			if (uxField == 0)
+				return -pdFREERTOS_ERRNO_ENOBUFS;
+			uxOut += uxField;
+		}
+		pcLine = pcEol + 2;
+	}
+	pxStream->xHeadSent = pdTRUE;
+	pxStream->xResponse = xChunked ? eResponse_ChunkSize : eResponse_Body;
+	pxStream->uxChunkLeft = 0;
+	return prvSendFrame((TCPClient_t *)pxConn->pxClient, eHttp2_Headers,
+						eHttp2Flag_EndHeaders, pxStream->ulId, pxConn->pucOut, uxOut);
+}
+
+static BaseType_t prvResponseChunked(Http2Stream_t *pxStream, const char cChar)
+{
+	switch (pxStream->xResponse)
+	{
+	case eResponse_ChunkSize:
+		if (cChar == '\n')
+		{
+			pxStream->xResponse = (pxStream->uxChunkLeft > 0)
+									  ? eResponse_ChunkData
+									  : eResponse_Trailer;
+		}
+		else if (pxStream->uxChunkLeft > (SIZE_MAX >> 4))
+		{
+			return -pdFREERTOS_ERRNO_EINVAL;
+		}
+		else if (cChar >= '0' && cChar <= '9')
+		{
+			pxStream->uxChunkLeft = (pxStream->uxChunkLeft << 4) + (size_t)(cChar - '0');
+		}
+		else if ((cChar | 0x20) >= 'a' && (cChar | 0x20) <= 'f')
+		{
+			pxStream->uxChunkLeft = (pxStream->uxChunkLeft << 4)
+									+ (size_t)((cChar | 0x20) - 'a' + 10);
+		}
+		return 0;
+	case eResponse_ChunkEnd:
+		if (cChar == '\n')
+			pxStream->xResponse = eResponse_ChunkSize;
+		return 0;
+	case eResponse_Trailer:
+		// trailer fields are not sent; the body ends with an empty line
+		if (cChar == '\n')
+		{
+			if (pxStream->uxChunkLeft == 0)
+				pxStream->xResponse = eResponse_Done;
+			pxStream->uxChunkLeft = 0;
+		}
+		else if (cChar != '\r')
+		{
+			pxStream->uxChunkLeft++;
+		}
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+static BaseType_t prvStreamData(
+	Http2Stream_t *pxStream,
+	const char *pcData,
+	const size_t uxLen)
+{
+	BaseType_t xRc = 0;
+	// data is sent in order, after any that is queued
+	if (pxStream->xClient.pxOutputHead == NULL)
+	{
+		xRc = prvSendData(pxStream, pcData, uxLen);
+		if (xRc < 0)
+			return xRc;
+	}
+	if ((size_t)xRc < uxLen)
+		return prvQueueData(pxStream, &pcData[xRc], uxLen - (size_t)xRc);
+	return 0;
+}
+
+static BaseType_t prvSendData(
+	Http2Stream_t *pxStream,
+	const char *pcData,
+	const size_t uxLen)
+{
+	Http2Connection_t *pxConn = pxStream->pxConn;
+	TCPClient_t *pxOwner = (TCPClient_t *)pxConn->pxClient;
+	size_t uxBlock, uxSent = 0;
+	BaseType_t xSpace, xRc;
+	while (uxSent < uxLen && pxOwner->pxOutputHead == NULL
+		   && pxConn->lSendWindow > 0 && pxStream->lSendWindow > 0)
+	{
+		// a frame is limited by the flow-control windows, and by what the socket
+		// can take now
+		xSpace = FreeRTOS_tx_space(pxOwner->xSock);
+		if (xSpace <= HTTP2_FRAME_HEADER_SZ)
+			break;
+		uxBlock = uxLen - uxSent;
+		if (uxBlock > (size_t)xSpace - HTTP2_FRAME_HEADER_SZ)
+			uxBlock = (size_t)xSpace - HTTP2_FRAME_HEADER_SZ;
+		if (uxBlock > pxConn->ulMaxFrame)
+			uxBlock = pxConn->ulMaxFrame;
+		if (uxBlock > (size_t)pxConn->lSendWindow)
+			uxBlock = (size_t)pxConn->lSendWindow;
+		if (uxBlock > (size_t)pxStream->lSendWindow)
+			uxBlock = (size_t)pxStream->lSendWindow;
+		xRc = prvSendFrame(pxOwner, eHttp2_Data, 0, pxStream->ulId,
+						   &pcData[uxSent], uxBlock);
+		if (xRc < 0)
+			return xRc;
+		pxConn->lSendWindow -= (int32_t)uxBlock;
+		pxStream->lSendWindow -= (int32_t)uxBlock;
+		uxSent += uxBlock;
+	}
+	return (BaseType_t)uxSent;
+}
+
+static BaseType_t prvQueueData(
+	Http2Stream_t *pxStream,
+	const char *pcData,
+	const size_t uxLen)
+{
+	HTTPClient_t *pxHttpClient = &pxStream->xClient;
+	OutputBlock_t *pxBlock;
+	// as for a client's own socket, httpd waits for queued data to be sent
+	// before it continues a response
+	if ((pxHttpClient->uxOutputQueued + uxLen) > emberOUTPUT_QUEUE_SIZE)
+		return -pdFREERTOS_ERRNO_ENOBUFS;
+	pxBlock = (OutputBlock_t *)pvPortMalloc(sizeof(OutputBlock_t) + uxLen);
+	if (pxBlock == NULL)
+		return -pdFREERTOS_ERRNO_ENOMEM;
+	memcpy(pxBlock->pcData, pcData, uxLen);
+	pxBlock->pxNext = NULL;
+	pxBlock->uxLen = uxLen;
+	pxBlock->uxOffset = 0;
+	if (pxHttpClient->pxOutputTail != NULL)
+		pxHttpClient->pxOutputTail->pxNext = pxBlock;
+	else
+		pxHttpClient->pxOutputHead = pxBlock;
+	pxHttpClient->pxOutputTail = pxBlock;
+	pxHttpClient->uxOutputQueued += uxLen;
+	return 0;
+}
+
+static BaseType_t prvDrainStream(Http2Stream_t *pxStream)
+{
+	HTTPClient_t *pxHttpClient = &pxStream->xClient;
+	OutputBlock_t *pxBlock;
+	BaseType_t xRc;
+	while ((pxBlock = pxHttpClient->pxOutputHead) != NULL)
+	{
+		xRc = prvSendData(pxStream, &pxBlock->pcData[pxBlock->uxOffset],
+						  pxBlock->uxLen - pxBlock->uxOffset);
+		if (xRc < 0)
+			return xRc;
+		pxBlock->uxOffset += (size_t)xRc;
+		pxHttpClient->uxOutputQueued -= (size_t)xRc;
+		if (pxBlock->uxOffset < pxBlock->uxLen)
+			break;
+		pxHttpClient->pxOutputHead = pxBlock->pxNext;
+		if (pxHttpClient->pxOutputHead == NULL)
+			pxHttpClient->pxOutputTail = NULL;
+		vPortFree(pxBlock);
+	}
+	return 0;
+}
+
+static BaseType_t prvSendFrame(
+	TCPClient_t *pxOwner,
+	const uint8_t ucType,
+	const uint8_t ucFlags,
+	const uint32_t ulId,
+	const void *pvPayload,
+	const size_t uxLen)
+{
+	uint8_t pucHead[HTTP2_FRAME_HEADER_SZ];
+	BaseType_t xRc;
+	pucHead[0] = (uint8_t)(uxLen >> 16);
+	pucHead[1] = (uint8_t)(uxLen >> 8);
+	pucHead[2] = (uint8_t)uxLen;
+	pucHead[3] = ucType;
+	pucHead[4] = ucFlags;
+	prvPut32(&pucHead[5], ulId);
+	xRc = xEmberWrite(pxOwner, pucHead, sizeof(pucHead));
+	if (xRc >= 0 && uxLen > 0)
+		xRc = xEmberWrite(pxOwner, pvPayload, uxLen);
+	if (xRc < 0)
+		return xRc;
+	return (BaseType_t)(sizeof(pucHead) + uxLen);
+}
+
+static BaseType_t prvSendSettings(Http2Client_t *pxClient)
+{
+	uint8_t pucSettings[12];
+	// the size of the decoder's dynamic table; without one, the client must not
+	// add fields to it
+	pucSettings[0] = 0;
+	pucSettings[1] = eSetting_HeaderTableSize;
+	prvPut32(&pucSettings[2], emberHTTP2_HPACK_TABLE_SIZE);
+	pucSettings[6] = 0;
+	pucSettings[7] = eSetting_MaxConcurrentStreams;
+	prvPut32(&pucSettings[8], emberHTTP2_MAX_STREAMS);
+	return prvSendFrame((TCPClient_t *)pxClient, eHttp2_Settings, 0, 0,
+						pucSettings, sizeof(pucSettings));
+}
+
+static BaseType_t prvSendRstStream(
+	Http2Client_t *pxClient,
+	const uint32_t ulId,
+	const uint32_t ulError)
+{
+	uint8_t pucError[4];
+	prvPut32(pucError, ulError);
+	return prvSendFrame((TCPClient_t *)pxClient, eHttp2_RstStream, 0, ulId,
+						pucError, sizeof(pucError));
+}
+
+static BaseType_t prvSendWindowUpdate(
+	Http2Client_t *pxClient,
+	const uint32_t ulId,
+	const uint32_t ulIncrement)
+{
+	uint8_t pucIncrement[4];
+	prvPut32(pucIncrement, ulIncrement);
+	return prvSendFrame((TCPClient_t *)pxClient, eHttp2_WindowUpdate, 0, ulId,
+						pucIncrement, sizeof(pucIncrement));
+}
+
+static BaseType_t prvSendStatus(
+	Http2Client_t *pxClient,
+	const uint32_t ulId,
+	const char *pcStatus,
+	const BaseType_t xReset)
+{
+	uint8_t pucBlock[8];
+	size_t uxLen = uxHpackEncode(pucBlock, sizeof(pucBlock), ":status", 7,
+								 pcStatus, 3);
+	BaseType_t xRc = prvSendFrame((TCPClient_t *)pxClient, eHttp2_Headers,
+								  eHttp2Flag_EndHeaders | eHttp2Flag_EndStream,
+								  ulId, pucBlock, uxLen);
+	// the rest of the request is not wanted
+	if (xRc >= 0 && xReset)
+		xRc = prvSendRstStream(pxClient, ulId, eHttp2Error_None);
+	return xRc;
+}
+
+static BaseType_t prvSendGoaway(Http2Client_t *pxClient)
+{
+	uint8_t pucPayload[8];
+	prvPut32(&pucPayload[0], pxClient->pxConn->ulLastStream);
+	prvPut32(&pucPayload[4], (uint32_t)pxClient->pxConn->xError);
+	return prvSendFrame((TCPClient_t *)pxClient, eHttp2_Goaway, 0, 0,
+						pucPayload, sizeof(pucPayload));
+}
+
+static BaseType_t prvFindHeader(
+	const char *pcHead,
+	const char *pcEnd,
+	const char *pcName,
+	const char **ppcValue)
+{
+	const size_t uxNameLen = strlen(pcName);
+	const char *pcLine = memchr(pcHead, '\n', (size_t)(pcEnd - pcHead));
+	const char *pcValue, *pcEol;
+	// each line of the head ends with CRLF, including the last, at `pcEnd`
+	while (pcLine != NULL && pcLine < pcEnd)
+	{
+		pcLine++;
+		pcEol = memchr(pcLine, '\r', (size_t)(pcEnd - pcLine) + 1);
+		if ((size_t)(pcEol - pcLine) > uxNameLen && pcLine[uxNameLen] == ':'
+			&& strncasecmp(pcLine, pcName, uxNameLen) == 0)
+		{
+			pcValue = &pcLine[uxNameLen + 1];
+			while (pcValue < pcEol && (*pcValue == ' ' || *pcValue == '\t'))
+				pcValue++;
+			while (pcEol > pcValue && (pcEol[-1] == ' ' || pcEol[-1] == '\t'))
+				pcEol--;
+			*ppcValue = pcValue;
+			return (BaseType_t)(pcEol - pcValue);
+		}
+		pcLine = memchr(pcLine, '\n', (size_t)(pcEnd - pcLine) + 2);
+	}
+	return -1;
+}
+
+static const char *prvFindHeadEnd(const char *pcData, const size_t uxLen)
+{
+	for (size_t uxi = 0; uxi + 4 <= uxLen; uxi++)
+	{
+		if (pcData[uxi] == '\r' && memcmp(&pcData[uxi], "\r\n\r\n", 4) == 0)
+			return &pcData[uxi];
+	}
+	return NULL;
+}
+
+static void prvPut32(uint8_t *pucDst, const uint32_t ulValue)
+{
+	pucDst[0] = (uint8_t)(ulValue >> 24);
+	pucDst[1] = (uint8_t)(ulValue >> 16);
+	pucDst[2] = (uint8_t)(ulValue >> 8);
+	pucDst[3] = (uint8_t)ulValue;
+}
+
+static uint32_t prvGet32(const uint8_t *pucSrc)
+{
+	return ((uint32_t)pucSrc[0] << 24) | ((uint32_t)pucSrc[1] << 16)
+		   | ((uint32_t)pucSrc[2] << 8) | pucSrc[3];
+}
+
+#endif /* (emberHTTP2_MAX_STREAMS > 0) */
@@ -13,11 +13,18 @@
 #include "inc/httpd.h"
 #include "inc/ember_private.h"
 #include "inc/websocketd.h"
+#include "inc/http2.h"
 
 /*===============================================
  private constants
  ===============================================*/
 
+/* a block that ends on a write boundary may have to be copied to the receive
+ * buffer, where the TCP receive stream wraps */
+#if (emberHTTP_WRITE_SIZE > emberTCP_RCV_BUFFER_SIZE)
+#error "emberHTTP_WRITE_SIZE must not exceed emberTCP_RCV_BUFFER_SIZE"
+#endif
+
 /*===============================================
  private data prototypes
  ===============================================*/
@@ -57,12 +64,49 @@ typedef struct xTYPE_COUPLE TypeCouple_t;
 static BaseType_t prvServiceRequest(HTTPClient_t *pxClient);
 static BaseType_t prvDefaultErrorHandler(void *pxc, eHttpStatus xCode);
 static void prvFindHTTPVerb(HTTPClient_t *pxClient);
-static BaseType_t prvUrlDecode(char *pcUrl);
+static uint32_t prvHashParam(uint32_t ulHash, const char cChar);
+static BaseType_t prvHexNibble(const char cChar);
+static char* prvUrlDecode(
+    char *pcDst,
+    const char **ppcSrc,
+    const char *pcEnd,
+    const char *pcStops,
+    uint32_t *pulHash);
+static void prvIndexParams(
+    HTTPClient_t *pxClient,
+    char *pcData,
+    const char *pcEnd);
 static void prvResolveUrlParts(HTTPClient_t *pxClient);
+static void prvResolveFormBody(HTTPClient_t *pxClient);
+static void prvResolveJsonBody(HTTPClient_t *pxClient);
 static BaseType_t prvFindMatchingHeader(const char *pcFind);
 static BaseType_t prvResolveHeaders(HTTPClient_t *pxClient);
-static BaseType_t prvResolveBody(HTTPClient_t *pxClient);
+static BaseType_t prvResolveBody(HTTPClient_t *pxClient, const char *pcEndOfCmd);
 static BaseType_t prvMatchRoute(HTTPClient_t *pxClient);
+static void prvSelectFilters(HTTPClient_t *pxClient, const UBaseType_t uxMask);
+static BaseType_t prvFilterRequest(HTTPClient_t *pxClient);
+static BaseType_t prvFilterBody(
+    HTTPClient_t *pxClient,
+    const UBaseType_t uxFrom,
+    const uint8_t *pucData,
+    size_t uxLen);
+static void prvFilterComplete(HTTPClient_t *pxClient);
+static BaseType_t prvCallHandler(
+    HTTPClient_t *pxClient,
+    const RouteItem_t *pxRouteItem);
+static BaseType_t prvContinueOffload(HTTPClient_t *pxClient);
+static BaseType_t prvCachedRequest(HTTPClient_t *pxClient);
+static BaseType_t prvContinueCacheWait(HTTPClient_t *pxClient);
+static void prvCacheRelease(HTTPClient_t *pxClient, const BaseType_t xStore);
+static BaseType_t prvQosClaim(HTTPClient_t *pxClient, RouteQos_t *pxQos);
+static void prvQosRelease(HTTPClient_t *pxClient, const BaseType_t xRestore);
+static BaseType_t prvSendServiceUnavailable(HTTPClient_t *pxClient);
+static BaseType_t prvSendTooManyRequests(HTTPClient_t *pxClient);
+static char* prvAppend(
+    char *pcDst,
+    const char *pcEnd,
+    const char *pcSrc,
+    const size_t uxLen);
 static size_t prvConstructHeaders(
     char *pcDst,
     const size_t uxMaxSz,
@@ -70,9 +114,37 @@ static size_t prvConstructHeaders(
     const uint32_t xOpts,
     const char *pcContentType,
     const size_t uxContentLen,
+    const char *pcEncoding,
     const char *pcExtra);
+static const char *prvStartCompression(HTTPClient_t *pxClient,
+    const uint32_t xOpts);
+static BaseType_t prvAcceptsCoding(const char *pcAccept, const char *pcCoding);
+static BaseType_t prvDeflateSink(void *pxc, const uint8_t *pucData, size_t uxLen);
+static BaseType_t prvSendChunk(HTTPClient_t *pxClient, const char *pcContent,
+    const size_t uxLen);
+static BaseType_t prvEncodeBody(HTTPClient_t *pxClient, const char *pcContent,
+    const size_t uxLen);
 static BaseType_t prvSendWebsocketUpgradeHeaders(HTTPClient_t *pxc, char *pcKey);
 static BaseType_t prvContinueSendFile(HTTPClient_t *pxClient);
+static BaseType_t prvContinueOutputFile(HTTPClient_t *pxClient);
+static BaseType_t prvContinueTemplate(HTTPClient_t *pxClient);
+static BaseType_t prvRenderEncoded(HTTPClient_t *pxClient,
+    const size_t uxBudget);
+static BaseType_t prvContinueSendRom(HTTPClient_t *pxClient);
+static BaseType_t prvContinueProducer(HTTPClient_t *pxClient);
+static BaseType_t prvContinueReceiveBody(HTTPClient_t *pxClient);
+static BaseType_t prvReceiveBodyBlock(
+    HTTPClient_t *pxClient,
+    const uint8_t **ppucData,
+    BaseType_t *pxZeroCopy);
+static void prvFailBody(HTTPClient_t *pxClient, const BaseType_t xRc);
+static BaseType_t prvEndBody(HTTPClient_t *pxClient);
+static BaseType_t prvMultipartSink(void *pxc, const uint8_t *pucData, size_t uxLen);
+static BaseType_t prvFileSink(void *pxc, const uint8_t *pucData, size_t uxLen);
+static void prvTempFilename(HTTPClient_t *pxClient, char *pcDst);
+static void prvAbortFile(HTTPClient_t *pxClient);
+static void prvRequestComplete(HTTPClient_t *pxClient, const BaseType_t xRc);
+static void prvRecordRequest(HTTPClient_t *pxClient);
 
 /*===============================================
  private global variables
@@ -103,6 +175,9 @@ static const HTTPRcvdHeaderDescriptor_t pxRcvdHeaderDescs[] = {
     // common headers
     { "Host" },
     { "Connection" },
+    // caching and content negotiation headers
+    { "If-None-Match" },
+    { "Accept-Encoding" },
     // websocket headers
     { "Transfer-Encoding" },
     { "Upgrade" },
@@ -115,9 +190,29 @@ static const size_t uxNumRcvdHeaderDescrs =
 
 static const char *const pcWebsocketUUID =
     "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
-static const char *const pcWebsocketRespHeaders =
+static const char pcWebsocketRespHeaders[] =
     "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Accept: ";
 
+// the complete response to a request that exceeds a rate limit; sent as is, so
+// that refusing a request costs as little as possible
+static const char pcTooManyRequests[] =
+    "HTTP/1.1 429 too many requests\r\nRetry-After: 1\r\nContent-Length: 0\r\n\r\n";
+static const char pcServiceUnavailable[] =
+    "HTTP/1.1 503 service unavailable\r\nRetry-After: 1\r\nContent-Length: 0\r\n\r\n";
+
+// fixed parts of response headers, appended by length rather than formatted
+static const char pcHttpVersion[] = "HTTP/1.1 ";
+static const char pcFixedHeaders[] =
+    "Accept-Encoding: identity\r\nConnection: close\r\n";
+static const char pcContentTypeHeader[] = "Content-Type: ";
+static const char pcContentLengthHeader[] = "Content-Length: ";
+static const char pcChunkedHeader[] = "Transfer-Encoding: chunked\r\n";
+static const char pcGzipEncoding[] =
+    "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n";
+static const char pcDeflateEncoding[] =
+    "Content-Encoding: deflate\r\nVary: Accept-Encoding\r\n";
+static const char pcCrLf[] = "\r\n";
+
 /*===============================================
  external objects
  ===============================================*/
@@ -139,29 +234,137 @@ BaseType_t xHttpCreate(void *pxc) {
 
 BaseType_t xHttpWork(void *pxc) {
 	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	BaseType_t xRc, xFlushRc;
+	if (pxClient->bits.bBodyInProgress) {
+		// the response, once the body is complete, is collected as for a request
+		vEmberCork((TCPClient_t*) pxClient);
+		xRc = prvContinueReceiveBody(pxClient);
+		xFlushRc = xEmberFlush((TCPClient_t*) pxClient);
+		if (xFlushRc < 0)
+		  return xFlushRc;
+		prvRequestComplete(pxClient, xRc);
+		return xRc;
+	}
+	if (pxClient->bits.bCacheWait) {
+		// the shared response, or a refusal, is written as for a request
+		vEmberCork((TCPClient_t*) pxClient);
+		xRc = prvContinueCacheWait(pxClient);
+		xFlushRc = xEmberFlush((TCPClient_t*) pxClient);
+		if (xFlushRc < 0)
+		  return xFlushRc;
+		if (pxClient->xWork == HTTPD_WORKER_METHOD)
+		  prvRequestComplete(pxClient, xRc);
+		return xRc;
+	}
+	if (pxClient->bits.bOffloadWait) {
+		// the response, once a worker has built it, is written as for a request
+		vEmberCork((TCPClient_t*) pxClient);
+		xRc = prvContinueOffload(pxClient);
+		xFlushRc = xEmberFlush((TCPClient_t*) pxClient);
+		if (xFlushRc < 0)
+		  return xFlushRc;
+		prvRequestComplete(pxClient, xRc);
+		return xRc;
+	}
 	if (pxClient->bits.bFileInProgress) {
-		return prvContinueSendFile(pxClient);
+		xRc = prvContinueSendFile(pxClient);
+		prvRequestComplete(pxClient, xRc);
+		return xRc;
 	}
-	else {
-		return prvServiceRequest(pxClient);
+	if (pxClient->bits.bTemplateInProgress) {
+		xRc = prvContinueTemplate(pxClient);
+		prvRequestComplete(pxClient, xRc);
+		return xRc;
 	}
+	if (pxClient->bits.bRomInProgress) {
+		xRc = prvContinueSendRom(pxClient);
+		prvRequestComplete(pxClient, xRc);
+		return xRc;
+	}
+	if (pxClient->bits.bProducerInProgress) {
+		// the producer's writes are collected as for a request
+		vEmberCork((TCPClient_t*) pxClient);
+		xRc = prvContinueProducer(pxClient);
+		xFlushRc = xEmberFlush((TCPClient_t*) pxClient);
+		if (xFlushRc < 0)
+		  return xFlushRc;
+		prvRequestComplete(pxClient, xRc);
+		return xRc;
+	}
+	// collect the headers and (small) content of the response so that they are
+	// transmitted together; note that the client may have been converted to a
+	// websocket client by the time the response is flushed
+	vEmberCork((TCPClient_t*) pxClient);
+	xRc = prvServiceRequest(pxClient);
+	xFlushRc = xEmberFlush((TCPClient_t*) pxClient);
+	if (xFlushRc < 0)
+	  return xFlushRc;
+	// an upgraded client has already recorded its request
+	if (pxClient->xWork == HTTPD_WORKER_METHOD)
+	  prvRequestComplete(pxClient, xRc);
+	return xRc;
+}
+
+BaseType_t xHttpResponseInProgress(void *pxc) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	return (pxClient->bits.bFileInProgress || pxClient->bits.bTemplateInProgress
+	    || pxClient->bits.bRomInProgress || pxClient->bits.bBodyInProgress
+	    || pxClient->bits.bCacheWait || pxClient->bits.bProducerInProgress
+	    || pxClient->bits.bOffloadWait) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xHttpFlush(void *pxc) {
+	size_t uxSpace;
+	BaseType_t xRc;
+	if (pcEmberCorkTail((TCPClient_t*) pxc, &uxSpace) == NULL)
+	  return 0;
+	xRc = xEmberFlush((TCPClient_t*) pxc);
+	if (xRc >= 0)
+	  vEmberCork((TCPClient_t*) pxc);
+	return xRc;
 }
 
 BaseType_t xHttpDelete(void *pxc) {
 	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	// an unfinished body is aborted first, as its consumer may close files
+	if (pxClient->pxMultipart != 0)
+	  vMultipartStop(pxClient->pxMultipart);
+	if (pxClient->bits.bBodyInProgress && pxClient->pxBodySink == prvFileSink)
+	  prvAbortFile(pxClient);
 	if (pxClient->pxFileHandle != 0)
 	  ff_fclose(pxClient->pxFileHandle);
+	if (pxClient->pxReadAhead != 0)
+	  vEmberReadAheadStop(pxClient->pxReadAhead);
+	if (pxClient->pxTemplate != 0)
+	  vTemplateStop(pxClient->pxTemplate);
+	if (pxClient->pxDeflate != 0)
+	  vDeflateStop(pxClient->pxDeflate);
+	if (pxClient->pxOffload != 0)
+	  vHttpOffloadStop(pxClient->pxOffload);
+	if (pxClient->bits.bProducerInProgress) {
+		BaseType_t xDone = pdTRUE;
+		pxClient->pxProducer(pxClient, pxClient->pvProducerArg, 0, &xDone);
+	}
+	// an unfinished response is not cached
+	if (pxClient->pxCacheEntry != 0 && !pxClient->bits.bCacheWait)
+	  prvCacheRelease(pxClient, pdFALSE);
+	if (pxClient->pxQos != 0)
+	  prvQosRelease(pxClient, pdFALSE);
 	return 0;
 }
 
 const HttpStatusDescriptor_t* const pxGetHttpStatusMessage(
     const BaseType_t xStatus) {
-	HttpStatusDescriptor_t *pxStatusDesc =
-	    (HttpStatusDescriptor_t*) &xHttpStatuses[0];
-	while (pxStatusDesc->uxLen != 0) {
-		if (pxStatusDesc->pcStatus == xStatus)
-		  return pxStatusDesc;
-		pxStatusDesc++;
+	// binary search of `xHttpStatuses`, which is in order of status code
+	size_t uxLo = 0, uxHi = xNumHttpStatusDescs - 1, uxMid;
+	while (uxLo < uxHi) {
+		uxMid = (uxLo + uxHi) / 2u;
+		if (xHttpStatuses[uxMid].pcStatus == xStatus)
+		  return &xHttpStatuses[uxMid];
+		if (xHttpStatuses[uxMid].pcStatus < xStatus)
+		  uxLo = uxMid + 1u;
+		else
+		  uxHi = uxMid;
 	}
 	return pxDefaultHttpStatus;
 }
@@ -176,24 +379,20 @@ size_t xPrintRoute(char *pcDst, const char **pcRouteParts, const size_t uxn) {
 	return uxCnt;
 }
 
-size_t xPrintParams(char *pcDst, const char **pcParamParts, const size_t uxn) {
+size_t xPrintParams(
+    char *pcDst,
+    const HttpParam_t *pxParams,
+    const size_t uxNumParams,
+    const size_t uxn) {
 	size_t uxp, uxCnt = 0;
-	char **pcr = (char**) pcParamParts;
-	if (*pcr == HTTPD_ROUTE_TERMINATOR) {
-		*pcDst = 0;
-		return 0;
-	}
-	else {
-		*pcDst = '?';
-		uxCnt = 1;
-	}
-	char pcDelim[2] = { 0, 0 };
-	while (*pcr != HTTPD_ROUTE_TERMINATOR) {
-		uxp = snprintf(&pcDst[uxCnt], uxn - uxCnt, "%s%s", pcDelim, *pcr++);
-		pcDelim[0] = '&';
+	*pcDst = 0;
+	for (size_t uxi = 0; uxi < uxNumParams && uxCnt < uxn; uxi++) {
+		uxp = snprintf(&pcDst[uxCnt], uxn - uxCnt, "%c%s%s%s",
+		    (uxi == 0) ? '?' : '&', pxParams[uxi].pcKey,
+		    (*pxParams[uxi].pcValue) ? "=" : "", pxParams[uxi].pcValue);
 		uxCnt += uxp;
 	}
-	return uxCnt;
+	return (uxCnt < uxn) ? uxCnt : uxn - 1;
 }
 
 const char* pcGetContentsType(const char *pcFileExt) {
@@ -228,124 +427,260 @@ BaseType_t xSendHttpResponseHeaders(
     ) {
 	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
 	char *pcSndBuff = pxClient->pxParent->pcSndBuff;
-	size_t uxHeaderSz = 0;
+	size_t uxHeaderSz = 0, uxSpace;
 	BaseType_t xRc;
+	char *pcDst = pcEmberCorkTail((TCPClient_t*) pxClient, &uxSpace);
+	const char *pcEncoding = prvStartCompression(pxClient, xOpts);
+	pxClient->xRequestStatus = xCode;
+	if (pcDst != NULL) {
+		// construct the headers in place, behind any earlier corked writes
+		uxHeaderSz = prvConstructHeaders(pcDst, uxSpace, xCode, xOpts,
+		    pcContentType, uxLen, pcEncoding, pcExtra);
+		if (uxHeaderSz >= uxSpace && pcDst != pcSndBuff) {
+			// may not have fit: transmit the earlier writes and start again
+			xRc = xEmberFlush((TCPClient_t*) pxClient);
+			if (xRc < 0)
+			  return xRc;
+			vEmberCork((TCPClient_t*) pxClient);
+			pcDst = pcEmberCorkTail((TCPClient_t*) pxClient, &uxSpace);
+			uxHeaderSz = prvConstructHeaders(pcDst, uxSpace, xCode, xOpts,
+			    pcContentType, uxLen, pcEncoding, pcExtra);
+		}
+		vEmberCorkAdvance((TCPClient_t*) pxClient, uxHeaderSz);
+		return (BaseType_t) uxHeaderSz;
+	}
 	uxHeaderSz = prvConstructHeaders(pcSndBuff,
 	    sizeof(pxClient->pxParent->pcSndBuff),
 	    xCode,
 	    xOpts,
-	    pcContentType, uxLen, pcExtra);
-	// send the data
-	xRc = FreeRTOS_send(pxClient->xSock, (const void*) pcSndBuff, uxHeaderSz, 0);
-	if (xRc < 0)
-	  return xRc;
-	// return the number of bytes sent
-	return xRc;
+	    pcContentType, uxLen, pcEncoding, pcExtra);
+	// send (or queue) the data
+	return xEmberWrite((TCPClient_t*) pxClient, pcSndBuff, uxHeaderSz);
 }
 
 BaseType_t xSendHttpResponseContent(void *pxc, char *pcContent, size_t uxLen) {
-	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
-	size_t uxSpace, uxBlock, uxSent = 0;
-	BaseType_t xRc = 0;
-	do {
-		uxSpace = FreeRTOS_tx_space(pxClient->xSock);
-		uxBlock = (uxLen - uxSent) > uxSpace ? uxSpace : uxLen - uxSent;
-		if (uxBlock > 0) {
-			xRc = FreeRTOS_send(pxClient->xSock, &pcContent[uxSent], uxBlock, 0);
-			if (xRc < 0)
-			  break;
-			uxSent += (size_t) xRc;
-		}
-	} while (uxLen < uxSent);
-	if (pxClient->uxBytesLeft == 0u) {
-		/* Writing is ready, no need for further 'eSELECT_WRITE' events. */
-		FreeRTOS_FD_CLR(pxClient->xSock, pxClient->pxParent->xSockSet,
-		    eSELECT_WRITE);
-	}
-	else {
-		/* Wake up the TCP task as soon as this socket may be written to. */
-		FreeRTOS_FD_SET(pxClient->xSock, pxClient->pxParent->xSockSet,
-		    eSELECT_WRITE);
-	}
-	return (BaseType_t) uxSent;
+	// while corked, this only collects the content for transmission later; any
+	// content that the socket cannot accept yet is queued, and transmitted by
+	// EMBER when the socket becomes writable
+	return xEmberWrite((TCPClient_t*) pxc, pcContent, uxLen);
 }
 
 BaseType_t xSendHttpResponseChunk(void *pxc, char *pcContent, size_t uxLen) {
-	char pcChunkMsg[16];
-	size_t uxChunkSz, uxSent;
-	BaseType_t xRc;
-	if (pcContent == 0)
-	  return xSendHttpResponseContent(pxc, "0\r\n\r\n", 5);
-	if (uxLen == 0)
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	if (pcContent != 0 && uxLen == 0)
 	  uxLen = strlen(pcContent);
-	uxChunkSz = snprintf(pcChunkMsg, sizeof(pcChunkMsg), "%x\r\n", uxLen);
-	xRc = xSendHttpResponseContent(pxc, pcChunkMsg, uxChunkSz);
-	if (xRc < 0)
-	  return xRc;
-	uxSent += (size_t) xRc;
-	xRc = xSendHttpResponseContent(pxc, pcContent, uxLen);
-	if (xRc < 0)
-	  return xRc;
-	uxSent += (size_t) xRc;
-	xRc = xSendHttpResponseContent(pxc, "\r\n", 2);
-	if (xRc < 0)
-	  return xRc;
-	uxSent += (size_t) xRc;
-	return (BaseType_t) uxSent;
+	// the body passes through the route's filters, if any, on its way out
+	if (pxClient->xFilterBody)
+	  return prvFilterBody(pxClient, 0, (const uint8_t*) pcContent, uxLen);
+	return prvEncodeBody(pxClient, pcContent, uxLen);
+}
+
+BaseType_t xHttpFilterWrite(void *pxc, const uint8_t *pucData, size_t uxLen) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	// an empty chunk would end the body
+	if (pucData != NULL && uxLen == 0)
+	  return 0;
+	return prvFilterBody(pxClient, pxClient->uxFilterStage + 1, pucData, uxLen);
 }
 
 BaseType_t xSendHttpResponseFile(void *pxc) {
 	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
-	size_t uxSpace, uxCount, uxSent;
+	size_t uxBlock = 0;
+#if (emberFILE_IO_TASK == 0)
+	size_t uxSpace;
+	char *pcDst;
+#endif
 	BaseType_t xRc = 0;
 	if (pxClient->pxFileHandle == NULL)
 	  return 0;
 	pxClient->uxBytesLeft = (size_t) pxClient->pxFileHandle->ulFileSize;
 	pxClient->bits.bFileInProgress = 1;
-	uxSent = 0;
-	do {
-		uxSpace = FreeRTOS_tx_space(pxClient->xSock);
-		uxCount = pxClient->uxBytesLeft < uxSpace ? pxClient->uxBytesLeft : uxSpace;
-		if (uxCount > 0u) {
-			if (uxCount > sizeof(pxClient->pxParent->pcSndBuff))
-			  uxCount = sizeof(pxClient->pxParent->pcSndBuff);
-			ff_fread(pxClient->pxParent->pcSndBuff, 1, uxCount,
-			    pxClient->pxFileHandle);
-			pxClient->uxBytesLeft -= uxCount;
-			xRc = FreeRTOS_send(pxClient->xSock, pxClient->pxParent->pcSndBuff,
-			    uxCount,
-			    0);
-			if (xRc <= 0)
-			break;
-			else // not required; included for clarity
-			uxSent += xRc;
+#if (emberFILE_IO_TASK == 0)
+	// send the start of the file with the corked headers, so that a small file
+	// and its headers are transmitted together; with an I/O task, EMBER never
+	// reads storage itself, so the file is left to the read-ahead
+	pcDst = pcEmberCorkTail((TCPClient_t*) pxClient, &uxSpace);
+	if (pcDst != NULL && pxClient->uxBytesLeft > 0) {
+		// whole sectors, unless the rest of the file fits, so that later reads
+		// stay aligned
+		uxBlock = pxClient->uxBytesLeft;
+		if (uxBlock > uxSpace)
+		  uxBlock = uxSpace & ~((size_t)emberFILE_SECTOR_SIZE - 1u);
+	}
+	if (uxBlock > 0) {
+		if (ff_fread(pcDst, 1, uxBlock, pxClient->pxFileHandle) != uxBlock) {
+			ff_fclose(pxClient->pxFileHandle);
+			pxClient->pxFileHandle = NULL;
+			pxClient->bits.bFileInProgress = 0;
+			return -pdFREERTOS_ERRNO_EIO;
 		}
-	} while (pxClient->uxBytesLeft > 0u && uxSent < emberHTTP_FILE_CHUNK_SIZE);
+		vEmberCorkAdvance((TCPClient_t*) pxClient, uxBlock);
+		pxClient->uxBytesLeft -= uxBlock;
+		xRc = (BaseType_t) uxBlock;
+	}
+#endif
 	if (pxClient->uxBytesLeft == 0u) {
-		/* Writing is ready, no need for further 'eSELECT_WRITE' events. */
-		FreeRTOS_FD_CLR(pxClient->xSock, pxClient->pxParent->xSockSet,
-		    eSELECT_WRITE);
-		// close the file, and clear the local pointer to the file handle
 		ff_fclose(pxClient->pxFileHandle);
 		pxClient->pxFileHandle = NULL;
 		pxClient->bits.bFileInProgress = 0;
-		return uxSent;
+		return xRc;
 	}
-	else if (xRc < 0) { // implied: error trying to write to socket; ditch
-		FreeRTOS_FD_CLR(pxClient->xSock, pxClient->pxParent->xSockSet,
-		    eSELECT_WRITE);
-		// close the file, and clear the local pointer to the file handle
+	// the file transfer uses `pcSndBuff`, so the cork must be emptied first
+	xRc = xHttpFlush(pxClient);
+	if (xRc < 0)
+	  return xRc;
+#if (emberFILE_IO_TASK != 0)
+	// hand the file over to the I/O task, which then owns it, unless the client
+	// has no socket of its own to send it to
+	if (pxClient->xOutput == NULL)
+	  pxClient->pxReadAhead = pxEmberReadAheadStart(pxClient->pxFileHandle,
+	      pxClient->uxBytesLeft);
+	if (pxClient->pxReadAhead != NULL)
+	  pxClient->pxFileHandle = NULL;
+#endif
+	xRc = prvContinueSendFile(pxClient);
+	if (xRc < 0)
+	  return xRc;
+	return xRc + (BaseType_t) uxBlock;
+}
+
+BaseType_t xSendHttpResponseTemplate(
+    void *pxc,
+    TemplateCallback_t pxCallback,
+    void *pvArg) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	if (pxClient->pxFileHandle == NULL)
+	  return 0;
+	pxClient->pxTemplate = pxTemplateStart(pxClient->pxFileHandle, pxCallback,
+	    pvArg);
+	if (pxClient->pxTemplate == NULL) {
 		ff_fclose(pxClient->pxFileHandle);
 		pxClient->pxFileHandle = NULL;
-		pxClient->bits.bFileInProgress = 0;
-		return xRc;
+		return -pdFREERTOS_ERRNO_EINVAL;
 	}
-	else { // implied: xRc == 0, i.e. could not write to socket, but bytes are left to write
-		/* Wake up the TCP task as soon as this socket may be written to. */
-		FreeRTOS_FD_SET(pxClient->xSock, pxClient->pxParent->xSockSet,
-		    eSELECT_WRITE);
-		return uxSent;
+	// the render now owns the file
+	pxClient->pxFileHandle = NULL;
+	pxClient->bits.bTemplateInProgress = 1;
+	// render the start of the template behind the corked headers
+	return prvContinueTemplate(pxClient);
+}
+
+BaseType_t xSendHttpResponseProducer(
+    void *pxc,
+    xResponseProducer *pxProducer,
+    void *pvArg) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	pxClient->pxProducer = pxProducer;
+	pxClient->pvProducerArg = pvArg;
+	pxClient->bits.bProducerInProgress = 1;
+	// produce the start of the response behind the corked headers
+	return prvContinueProducer(pxClient);
+}
+
+BaseType_t xSendHttpResponseRom(void *pxc, const RomfsEntry_t *pxEntry) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	const char *pcHeaders = pxEntry->pcHeaders;
+	size_t uxSpace, uxBlock;
+	char *pcDst, *pcValue;
+	BaseType_t xRc, xLen = 0;
+	// the client's cached copy is current
+	if (xGetHeaderValue(pxc, "If-None-Match", &pcValue) >= 0
+	    && strstr(pcValue, pxEntry->pcETag) != NULL)
+	  return xSendHttpResponseHeaders(pxc, eHTTP_NOT_MODIFIED,
+	      eResponseOption_None, 0, NULL, pxEntry->pcHeaders);
+	pxClient->pucRomData = pxEntry->pucData;
+	pxClient->uxBytesLeft = pxEntry->ulSize;
+	if (pxEntry->pucGzipData != NULL
+	    && xGetHeaderValue(pxc, "Accept-Encoding", &pcValue) >= 0
+	    && strcasestr(pcValue, "gzip") != NULL) {
+		pxClient->pucRomData = pxEntry->pucGzipData;
+		pxClient->uxBytesLeft = pxEntry->ulGzipSize;
+		pcHeaders = pxEntry->pcGzipHeaders;
+	}
+	xRc = xSendHttpResponseHeaders(pxc, eHTTP_REPLY_OK,
+	    eResponseOption_ContentLength, pxClient->uxBytesLeft,
+	    pxEntry->pcContentType, pcHeaders);
+	if (xRc < 0 || pxClient->xHttpVerb == eHTTP_HEAD)
+	  return xRc;
+	xLen += xRc;
+	// send the start of the file with the corked headers, so that a small file
+	// and its headers are transmitted together
+	pcDst = pcEmberCorkTail((TCPClient_t*) pxClient, &uxSpace);
+	if (pcDst != NULL && uxSpace > 0 && pxClient->uxBytesLeft > 0) {
+		uxBlock = (pxClient->uxBytesLeft < uxSpace) ?
+		    pxClient->uxBytesLeft : uxSpace;
+		memcpy(pcDst, pxClient->pucRomData, uxBlock);
+		vEmberCorkAdvance((TCPClient_t*) pxClient, uxBlock);
+		pxClient->pucRomData += uxBlock;
+		pxClient->uxBytesLeft -= uxBlock;
+		xLen += (BaseType_t) uxBlock;
+	}
+	if (pxClient->uxBytesLeft == 0u)
+	  return xLen;
+	// the rest of the file is sent directly, after the headers
+	xRc = xHttpFlush(pxClient);
+	if (xRc < 0)
+	  return xRc;
+	pxClient->bits.bRomInProgress = 1;
+	xRc = prvContinueSendRom(pxClient);
+	if (xRc < 0)
+	  return xRc;
+	return xLen + xRc;
+}
+
+BaseType_t xReceiveHttpBody(void *pxc, xBodySink *pxSink) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	BaseType_t xRc;
+	pxClient->pxBodySink = pxSink;
+	pxClient->xBodyStatus = 0;
+	pxClient->uxBodyRcvd = pxClient->uxBodySz;
+	if (pxClient->uxBodySz > 0) {
+		xRc = pxSink(pxc, (const uint8_t*) pxClient->pcBody, pxClient->uxBodySz);
+		if (xRc < 0)
+		  prvFailBody(pxClient, xRc);
 	}
+	if (pxClient->uxBodyLeft == 0)
+	  return prvEndBody(pxClient);
+	pxClient->bits.bBodyInProgress = 1;
+	return 0;
+}
+
+BaseType_t xReceiveHttpMultipart(
+    void *pxc,
+    MultipartCallback_t pxCallback,
+    void *pvArg) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	char *pcType;
+	if (xGetHeaderValue(pxc, "Content-Type", &pcType) < 0)
+	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_BAD_REQUEST);
+	pxClient->pxMultipart = pxMultipartStart(pcType, pxCallback, pvArg);
+	if (pxClient->pxMultipart == 0)
+	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_BAD_REQUEST);
+	return xReceiveHttpBody(pxc, prvMultipartSink);
+}
+
+BaseType_t xReceiveHttpFile(void *pxc, const char *pcPath) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	char pcTemp[sizeof(pxClient->pcCurrentFilename)];
+	FF_Stat_t xStat;
+	// the temporary filename must fit as well
+	if (strlen(pcPath) >= (sizeof(pxClient->pcCurrentFilename) - 1))
+	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_BAD_REQUEST);
+	if (pcPath != pxClient->pcCurrentFilename)
+	  strcpy((char*) pxClient->pcCurrentFilename, pcPath);
+	prvTempFilename(pxClient, pcTemp);
+	pxClient->bits.bFileCreated = (ff_stat(pcPath, &xStat) != 0);
+	pxClient->pxFileHandle = ff_fopen(pcTemp, "w");
+	if (pxClient->pxFileHandle == 0)
+	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_INTERNAL_SERVER_ERROR);
+	return xReceiveHttpBody(pxc, prvFileSink);
+}
+
+BaseType_t xDeleteHttpFile(void *pxc, const char *pcPath) {
+	if (ff_remove(pcPath) != 0)
+	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_NOT_FOUND);
+	return xSendHttpResponseHeaders(pxc, eHTTP_NO_CONTENT, eResponseOption_None,
+	    0, 0, 0);
 }
 
 BaseType_t xGetHeaderValue(void *pxc, const char *pcText, char **pcValue) {
@@ -367,6 +702,22 @@ BaseType_t xGetHeaderValue(void *pxc, const char *pcText, char **pcValue) {
 	return -1;
 }
 
+BaseType_t xGetQueryParam(void *pxc, const char *pcName, const char **pcValue) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	uint32_t ulHash = 2166136261u;
+	for (const char *pc = pcName; *pc; pc++)
+		ulHash = prvHashParam(ulHash, *pc);
+	for (size_t uxi = 0; uxi < pxClient->uxNumParams; uxi++) {
+		if (pxClient->pxParams[uxi].ulHash == ulHash
+		    && strcmp(pxClient->pxParams[uxi].pcKey, pcName) == 0) {
+			*pcValue = pxClient->pxParams[uxi].pcValue;
+			return (BaseType_t) uxi;
+		}
+	}
+	*pcValue = 0;
+	return -1;
+}
+
 BaseType_t xUpgradeToWebsocket(
     void *pxc,
     const WebsocketMessageHandler_t txtHandler,
@@ -375,7 +726,9 @@ BaseType_t xUpgradeToWebsocket(
 	HTTPClient_t *pxHttpClient = (HTTPClient_t*) pxc;
 	WebsocketClient_t *pxWsClient = (WebsocketClient_t*) pxc;
 	BaseType_t xRc;
-	if (pxHttpClient->xHttpVerb != eHTTP_GET)
+	// a client without a socket of its own, e.g. an HTTP/2 stream, cannot be
+	// converted
+	if (pxHttpClient->xHttpVerb != eHTTP_GET || pxHttpClient->xOutput != NULL)
 	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_BAD_REQUEST);
 	// find the mandatory websocket upgrade headers; if any were not received, throw a BAD_REQUEST
 	char *pcHostname, *pcConnection, *pcUpgrade, *pcWsVersion, *pcWsKey;
@@ -392,6 +745,17 @@ BaseType_t xUpgradeToWebsocket(
 	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_BAD_REQUEST);
 	xRc = prvSendWebsocketUpgradeHeaders(pxHttpClient, pcWsKey);
 	if (xRc > 0) {
+		// the HTTP part of the connection ends here
+		pxHttpClient->xRequestStatus = eHTTP_SWITCHING_PROTOCOLS;
+		prvRecordRequest(pxHttpClient);
+		if (pxHttpClient->pxCacheEntry != 0)
+		  prvCacheRelease(pxHttpClient, pdFALSE);
+		// the connection keeps the route's priority class
+		if (pxHttpClient->pxQos != 0)
+		  prvQosRelease(pxHttpClient, pdFALSE);
+		// the websocket's state overlays the HTTP client's, and starts empty
+		memset(&pxWsClient->xFlags, 0,
+		    sizeof(WebsocketClient_t) - offsetof(WebsocketClient_t, xFlags));
 		pxWsClient->xCreator = WEBSOCKETD_CREATOR_METHOD;
 		pxWsClient->xWork = WEBSOCKETD_WORKER_METHOD;
 		pxWsClient->xDelete = WEBSOCKETD_DELETE_METHOD;
@@ -402,6 +766,40 @@ BaseType_t xUpgradeToWebsocket(
 	return xRc;
 }
 
+BaseType_t xUpgradeToEventStream(void *pxc, const char *pcStream) {
+	HTTPClient_t *pxHttpClient = (HTTPClient_t*) pxc;
+	SseClient_t *pxSseClient = (SseClient_t*) pxc;
+	EventStream_t *pxStream;
+	BaseType_t xRc;
+	if (pxHttpClient->xHttpVerb != eHTTP_GET)
+	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_NOT_ALLOWED);
+	if (pxHttpClient->xOutput != NULL)
+	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_BAD_REQUEST);
+	pxStream = pxEventStreamFind(pcStream);
+	if (pxStream == NULL)
+	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_NOT_FOUND);
+	xRc = xSendHttpResponseHeaders(pxc, eHTTP_REPLY_OK, eResponseOption_None,
+	    0, "text/event-stream", "Cache-Control: no-cache\r\n");
+	if (xRc > 0) {
+		// the HTTP part of the connection ends here
+		pxHttpClient->xRequestStatus = eHTTP_REPLY_OK;
+		prvRecordRequest(pxHttpClient);
+		if (pxHttpClient->pxCacheEntry != 0)
+		  prvCacheRelease(pxHttpClient, pdFALSE);
+		// the connection keeps the route's priority class
+		if (pxHttpClient->pxQos != 0)
+		  prvQosRelease(pxHttpClient, pdFALSE);
+		pxSseClient->xCreator = SSED_CREATOR_METHOD;
+		pxSseClient->xWork = SSED_WORKER_METHOD;
+		pxSseClient->xDelete = SSED_DELETE_METHOD;
+		pxSseClient->pxStream = pxStream;
+		// only records published from now on are transmitted
+		pxSseClient->ulCursor = pxStream->ulHead;
+		pxSseClient->xLastSend = xTaskGetTickCount();
+	}
+	return xRc;
+}
+
 /*===============================================
  private functions
  ===============================================*/
@@ -411,16 +809,51 @@ static BaseType_t prvServiceRequest(HTTPClient_t *pxClient) {
 	size_t uxCmdBuffSz;
 	char *pcCmdBuff, *pcEndOfCmd, *pcEndOfUrl;
 	pcCmdBuff = pxClient->pxParent->pcRcvBuff;
-	uxCmdBuffSz = emberTCP_RCV_BUFFER_SIZE;
-	// (try to) transfer a new request from the TCP receive buffer to the HTTP
-	// server receive buffer
-	xRc = FreeRTOS_recv(pxClient->xSock, (void*) pcCmdBuff, uxCmdBuffSz, 0);
-	if (xRc <= 0) // -ve is an error; 0 is "no data received"; either way, return it
-	  return xRc;
+	// one byte is kept for the terminator, which the request's parameters are
+	// decoded up to
+	uxCmdBuffSz = emberTCP_RCV_BUFFER_SIZE - 1;
+	// a previous response that was still queued when it completed has now been
+	// transmitted, so its request is recorded before the next one is timed
+	prvRecordRequest(pxClient);
+	if (pxClient->uxPendingRequest > 0) {
+		// the request is already in the HTTP server receive buffer
+		xRc = (BaseType_t) pxClient->uxPendingRequest;
+		pxClient->uxPendingRequest = 0;
+	}
+	else {
+		// (try to) transfer a new request from the TCP receive buffer to the
+		// HTTP server receive buffer
+		xRc = FreeRTOS_recv(pxClient->xSock, (void*) pcCmdBuff, uxCmdBuffSz, 0);
+		if (xRc <= 0) // -ve is an error; 0 is "no data received"; either way, return it
+		  return xRc;
+	}
+	// the request is timed from its receipt, if it matches a route with statistics
+	pxClient->pxStats = NULL;
+	pxClient->xCompress = pdFALSE;
+	pxClient->uxFilters = 0;
+	pxClient->xFilterBody = pdFALSE;
+	prvSelectFilters(pxClient, xRouteConfig.uxFilters);
+	pxClient->xFilterComplete = (xRouteConfig.uxNumFilters > 0);
+	pxClient->ulRequestStart = emberSTATS_TIME_US();
+	pxClient->xRequestStatus = 0;
 	// ensure that we know where the request ends
-	if (xRc < uxCmdBuffSz)
+	if (xRc <= uxCmdBuffSz)
 	  pcCmdBuff[xRc] = 0;
 	pcEndOfCmd = &pcCmdBuff[xRc];
+#if (emberHTTP2_MAX_STREAMS > 0)
+	// a connection that starts with the HTTP/2 preface, or that asks to
+	// upgrade, is converted; each of its streams is then an HTTP client
+	if (pxClient->xOutput == NULL) {
+		xRc = xHttp2Upgrade(pxClient, pcCmdBuff, (size_t) xRc);
+		if (xRc != 0)
+		  return xRc;
+		xRc = (BaseType_t) (pcEndOfCmd - pcCmdBuff);
+	}
+#endif
+	// refuse the request without parsing it if the client is over its limit
+	if (xEmberRateLimit(pxClient->pxParent, pxClient->ulRemoteAddress,
+	    xRouteConfig.pxRateLimit) != pdTRUE)
+	  return prvSendTooManyRequests(pxClient);
 	/* Parse the request:
 	 *  - find the verb and URL
 	 *  - resolve the URL parts
@@ -439,10 +872,22 @@ static BaseType_t prvServiceRequest(HTTPClient_t *pxClient) {
 	xRc = prvResolveHeaders(pxClient);
 	if (xRc < 0)
 	  return xRouteConfig.pxErrorHandler(pxClient, eHTTP_BAD_REQUEST);
-	xRc = prvResolveBody(pxClient);
+	xRc = prvResolveBody(pxClient, pcEndOfCmd);
 	if (xRc < 0)
 	  return xRouteConfig.pxErrorHandler(pxClient, eHTTP_BAD_REQUEST);
-	return prvMatchRoute(pxClient);
+	prvResolveFormBody(pxClient);
+	prvResolveJsonBody(pxClient);
+	// a request filter may respond to the request itself
+	xRc = prvFilterRequest(pxClient);
+	if (xRc == 0)
+	  xRc = prvMatchRoute(pxClient);
+	// the rest of a body that the handler did not receive must still be read,
+	// so that it is not mistaken for the next request
+	if (pxClient->uxBodyLeft > 0 && !pxClient->bits.bBodyInProgress) {
+		pxClient->pxBodySink = 0;
+		pxClient->bits.bBodyInProgress = 1;
+	}
+	return xRc;
 }
 
 static BaseType_t prvDefaultErrorHandler(void *pxc, eHttpStatus xCode) {
@@ -469,35 +914,94 @@ static void prvFindHTTPVerb(HTTPClient_t *pxClient) {
 	}
 }
 
-static BaseType_t prvUrlDecode(char *pcUrl) {
-	size_t uxUrlLen = strlen(pcUrl);
-	BaseType_t xn = 0;
-	while (xn < uxUrlLen) {
-		if (pcUrl[xn] == '%') {
-			if ((uxUrlLen - xn) < 3) {
-				// there aren't enough chars to parse; eek!
-				return uxUrlLen;
-			}
-			else {
-				char pcNum[3];
-				pcNum[0] = pcUrl[xn + 1];
-				pcNum[1] = pcUrl[xn + 2];
-				pcNum[2] = 0;
-				pcUrl[xn] = strtol(pcNum, 0, 16);
-				memcpy(&pcUrl[xn + 1], &pcUrl[xn + 3], uxUrlLen - xn - 2);
-				uxUrlLen -= 2;
+static uint32_t prvHashParam(uint32_t ulHash, const char cChar) {
+	// FNV-1a; parameter names are compared by hash before by string
+	return (ulHash ^ (uint8_t) cChar) * 16777619u;
+}
+
+static BaseType_t prvHexNibble(const char cChar) {
+	if (cChar >= '0' && cChar <= '9')
+	  return cChar - '0';
+	if (cChar >= 'a' && cChar <= 'f')
+	  return cChar - 'a' + 10;
+	if (cChar >= 'A' && cChar <= 'F')
+	  return cChar - 'A' + 10;
+	return -1;
+}
+
+static char* prvUrlDecode(
+    char *pcDst,
+    const char **ppcSrc,
+    const char *pcEnd,
+    const char *pcStops,
+    uint32_t *pulHash) {
+	// decodes from *ppcSrc to pcDst (which may be the same location, since the
+	// output is never longer than the input) until the end of the data or one
+	// of pcStops, which is left at *ppcSrc. Returns the end of the output.
+	const char *pcSrc = *ppcSrc;
+	while (pcSrc < pcEnd && *pcSrc && strchr(pcStops, *pcSrc) == 0) {
+		char cChar = *pcSrc++;
+		if (cChar == '+') {
+			cChar = ' ';
+		}
+		else if (cChar == '%' && (pcEnd - pcSrc) >= 2) {
+			BaseType_t xHi = prvHexNibble(pcSrc[0]);
+			BaseType_t xLo = prvHexNibble(pcSrc[1]);
+			// a malformed escape is kept as-is
+			if (xHi >= 0 && xLo >= 0) {
+				cChar = (char) ((xHi << 4) | xLo);
+				pcSrc += 2;
 			}
 		}
-		else if (pcUrl[xn] == '+') {
-			pcUrl[xn] = ' ';
+		if (pulHash)
+		  *pulHash = prvHashParam(*pulHash, cChar);
+		*pcDst++ = cChar;
+	}
+	*ppcSrc = pcSrc;
+	return pcDst;
+}
+
+static void prvIndexParams(
+    HTTPClient_t *pxClient,
+    char *pcData,
+    const char *pcEnd) {
+	// splits the data on '&' and '=', decoding keys and values in place; the
+	// last terminator may be written at pcEnd, so that byte must be writable
+	const char *pcSrc = pcData;
+	char *pcDst = pcData;
+	while (pcSrc < pcEnd && *pcSrc
+	    && pxClient->uxNumParams < (emberHTTP_PARAM_PARTS - 1)) {
+		HttpParam_t *pxParam = &pxClient->pxParams[pxClient->uxNumParams];
+		uint32_t ulHash = 2166136261u;
+		char *pcKey = pcDst;
+		pcDst = prvUrlDecode(pcDst, &pcSrc, pcEnd, "&=", &ulHash);
+		// the delimiter is read before the key is terminated, since the
+		// terminator may overwrite it
+		char cDelim = (pcSrc < pcEnd) ? *pcSrc : 0;
+		*pcDst++ = 0;
+		if (cDelim)
+		  pcSrc++;
+		pxParam->pcValue = "";
+		if (cDelim == '=') {
+			char *pcValue = pcDst;
+			pcDst = prvUrlDecode(pcDst, &pcSrc, pcEnd, "&", 0);
+			cDelim = (pcSrc < pcEnd) ? *pcSrc : 0;
+			*pcDst++ = 0;
+			if (cDelim)
+			  pcSrc++;
+			pxParam->pcValue = pcValue;
 		}
-		xn++;
+		// ignore empty parameters, e.g. "a=1&&b=2"
+		if (*pcKey == 0 && *pxParam->pcValue == 0)
+		  continue;
+		pxParam->ulHash = ulHash;
+		pxParam->pcKey = pcKey;
+		pxClient->uxNumParams++;
 	}
-	return xn;
 }
 
 static void prvResolveUrlParts(HTTPClient_t *pxClient) {
-	BaseType_t xnRoutes = 0, xnParams = 0;
+	BaseType_t xnRoutes = 0;
 	char *pcWkgUrl = strncpy((char*) pxClient->pcWorkingUrl, pxClient->pcUrlData,
 	    sizeof(pxClient->pcWorkingUrl));
 	// discard any leading slashes from the uri
@@ -528,25 +1032,36 @@ static void prvResolveUrlParts(HTTPClient_t *pxClient) {
 //	while (pxClient->routeParts[nRoutes] != HTTPD_ROUTE_TERMINATOR) {
 //		prvUrlDecode((char*)pxClient->routeParts[xnRoutes++]);
 //	}
-	if (pcParams != 0) {
-		pxClient->pcParamParts[0] = pcParams;
-		for (xnParams = 1; xnParams < (emberHTTP_PARAM_PARTS - 1); xnParams++) {
-			char *pcNext = strpbrk(pcParams, xRouteConfig.pcDelims);
-			if (pcNext == 0)
-			break;
-			else {
-				*pcNext = 0;
-				pcParams = ++pcNext;
-				pxClient->pcParamParts[xnParams] = pcParams;
-			}
-		}
-	}
-	pxClient->pcParamParts[xnParams] = (char*) HTTPD_ROUTE_TERMINATOR;
-	/* perform URL decoding on the parameters */
-	xnParams = 0;
-	while (pxClient->pcParamParts[xnParams] != HTTPD_ROUTE_TERMINATOR) {
-		prvUrlDecode((char*) pxClient->pcParamParts[xnParams]);
-	}
+	/* index and URL decode the parameters */
+	pxClient->uxNumParams = 0;
+	if (pcParams != 0)
+	  prvIndexParams(pxClient, pcParams, &pcParams[strlen(pcParams)]);
+}
+
+static void prvResolveFormBody(HTTPClient_t *pxClient) {
+	char *pcType;
+	if (pxClient->uxBodySz <= 0 || pxClient->uxBodyLeft > 0
+	    || xGetHeaderValue(pxClient, "Content-Type", &pcType) < 0
+	    || strncasecmp(pcType, "application/x-www-form-urlencoded", 33) != 0)
+	  return;
+	prvIndexParams(pxClient, pxClient->pcBody,
+	    &pxClient->pcBody[pxClient->uxBodySz]);
+}
+
+static void prvResolveJsonBody(HTTPClient_t *pxClient) {
+	pxClient->pxJson = NULL;
+#if (emberJSON_TOKENS > 0)
+	TCPServer_t *pxServer = pxClient->pxParent;
+	char *pcType;
+	if (pxClient->uxBodySz <= 0 || pxClient->uxBodyLeft > 0
+	    || xGetHeaderValue(pxClient, "Content-Type", &pcType) < 0
+	    || strncasecmp(pcType, "application/json", 16) != 0)
+	  return;
+	if (xJsonParse(&pxServer->xJsonIndex, pxClient->pcBody,
+	    (size_t) pxClient->uxBodySz, pxServer->pxJsonTokens, emberJSON_TOKENS)
+	    > 0)
+	  pxClient->pxJson = &pxServer->xJsonIndex;
+#endif
 }
 
 static BaseType_t prvFindMatchingHeader(const char *pcFind) {
@@ -621,23 +1136,25 @@ static BaseType_t prvResolveHeaders(HTTPClient_t *pxClient) {
 	return xHdrId;
 }
 
-static BaseType_t prvResolveBody(HTTPClient_t *pxClient) {
+static BaseType_t prvResolveBody(HTTPClient_t *pxClient, const char *pcEndOfCmd) {
 	BaseType_t xContentLenId = -1, xChunkedId = -1;
+	const BaseType_t xTransferEncodingDesc = prvFindMatchingHeader("Transfer-Encoding");
+	const BaseType_t xContentLenDesc = prvFindMatchingHeader("Content-Length");
 	pxClient->uxBodySz = -1;
+	pxClient->uxBodyLeft = 0;
 	for (BaseType_t xi = 0; xi < emberHTTP_HEADER_PARTS; xi++) {
 		// A descriptor < 0 indicates no more potential headers
 		if (pxClient->pxHeaders[xi].xDescriptor < 0)
 		break;
-		// Transfer-Encoding is descriptor 4, and has priority over Content-Length if it includes "chunked"
-		else if (pxClient->pxHeaders[xi].xDescriptor == 4) {
+		// Transfer-Encoding has priority over Content-Length if it includes "chunked"
+		else if (pxClient->pxHeaders[xi].xDescriptor == xTransferEncodingDesc) {
 			if (strstr(pxClient->pxHeaders[xi].pcValue, "chunked")) {
 				xChunkedId = xi;
 				xContentLenId = -1;
 				break;
 			}
 		}
-		// Content-Length is descriptor 1
-		else if (pxClient->pxHeaders[xi].xDescriptor == 1)
+		else if (pxClient->pxHeaders[xi].xDescriptor == xContentLenDesc)
 		  xContentLenId = xi;
 	}
 	if (xChunkedId < 0 && xContentLenId < 0) {
@@ -687,13 +1204,15 @@ static BaseType_t prvResolveBody(HTTPClient_t *pxClient) {
 		xContentLen = atoi(pxClient->pxHeaders[xContentLenId].pcValue);
 		if (xContentLen < 0)
 		  return eHTTPBody_Invalid;
-		uxBodyLen = strnlen(
-		    pxClient->pcBody,
-		    emberTCP_RCV_BUFFER_SIZE
-		        - (size_t) (pxClient->pcBody - pxClient->pxParent->pcRcvBuff)
-		        );
-		if (uxBodyLen != xContentLen)
+		// the body may be binary, so its length is that received rather than
+		// that of a string
+		uxBodyLen = (pxClient->pcBody != 0 && pcEndOfCmd > pxClient->pcBody)
+		    ? (size_t) (pcEndOfCmd - pxClient->pcBody) : 0;
+		if (uxBodyLen > xContentLen)
 		  return eHTTPBody_Invalid;
+		// the rest of a longer body can only be received by a route that
+		// streams its body
+		pxClient->uxBodyLeft = xContentLen - uxBodyLen;
 		pxClient->uxBodySz = uxBodyLen;
 		return pxClient->uxBodySz;
 	}
@@ -757,7 +1276,22 @@ static BaseType_t prvMatchRoute(HTTPClient_t *pxClient) {
 			  break;
 		}
 		if (pxHandler != 0) {
-			return pxHandler(pxClient);
+			pxClient->pxStats = pxRouteItem->pxStats;
+			if (xEmberRateLimit(pxClient->pxParent, pxClient->ulRemoteAddress,
+			    pxRouteItem->pxRateLimit) != pdTRUE)
+			  return prvSendTooManyRequests(pxClient);
+			if (pxClient->uxBodyLeft > 0 && !pxRouteItem->uxOptions.stream_body)
+			  return xRouteConfig.pxErrorHandler(pxClient, eHTTP_PAYLOAD_TOO_LARGE);
+			if (pxRouteItem->pxQos != 0
+			    && prvQosClaim(pxClient, pxRouteItem->pxQos) != pdTRUE)
+			  return prvSendServiceUnavailable(pxClient);
+			pxClient->xCompress = pxRouteItem->uxOptions.compress;
+			prvSelectFilters(pxClient, pxRouteItem->uxFilters);
+			if (pxRouteItem->pxCache != 0 && pxClient->xHttpVerb == eHTTP_GET) {
+				pxClient->pxCacheRoute = pxRouteItem;
+				return prvCachedRequest(pxClient);
+			}
+			return prvCallHandler(pxClient, pxRouteItem);
 		}
 	}
 	if (pxHandler == 0)
@@ -765,6 +1299,219 @@ static BaseType_t prvMatchRoute(HTTPClient_t *pxClient) {
 	return -1;
 }
 
+static void prvSelectFilters(HTTPClient_t *pxClient, const UBaseType_t uxMask) {
+	size_t uxi;
+	if (uxMask == 0)
+	  return;
+	pxClient->uxFilters |= uxMask;
+	// a body is only passed through the filters if one of them transforms it
+	pxClient->xFilterBody = pdFALSE;
+	for (uxi = 0; uxi < xRouteConfig.uxNumFilters; uxi++) {
+		if ((pxClient->uxFilters & (1u << uxi))
+		    && xRouteConfig.pxFilters[uxi].pxBody != NULL)
+		  pxClient->xFilterBody = pdTRUE;
+	}
+}
+
+static BaseType_t prvFilterRequest(HTTPClient_t *pxClient) {
+	const HttpFilter_t *pxFilter;
+	BaseType_t xRc;
+	size_t uxi;
+	for (uxi = 0; uxi < xRouteConfig.uxNumFilters; uxi++) {
+		pxFilter = &xRouteConfig.pxFilters[uxi];
+		if (pxFilter->pxRequest == NULL)
+		  continue;
+		xRc = pxFilter->pxRequest(pxClient, pxFilter->pvArg);
+		if (xRc != 0)
+		  return xRc;
+	}
+	return 0;
+}
+
+static BaseType_t prvFilterBody(
+    HTTPClient_t *pxClient,
+    const UBaseType_t uxFrom,
+    const uint8_t *pucData,
+    size_t uxLen) {
+	const HttpFilter_t *pxFilter;
+	UBaseType_t uxi, uxStage;
+	BaseType_t xRc;
+	for (uxi = uxFrom; uxi < xRouteConfig.uxNumFilters; uxi++) {
+		pxFilter = &xRouteConfig.pxFilters[uxi];
+		if (pxFilter->pxBody == NULL || !(pxClient->uxFilters & (1u << uxi)))
+		  continue;
+		// the filter's output is written to the filters after it
+		uxStage = pxClient->uxFilterStage;
+		pxClient->uxFilterStage = uxi;
+		xRc = pxFilter->pxBody(pxClient, pxFilter->pvArg, pucData, uxLen);
+		pxClient->uxFilterStage = uxStage;
+		return xRc;
+	}
+	return prvEncodeBody(pxClient, (const char*) pucData, uxLen);
+}
+
+static void prvFilterComplete(HTTPClient_t *pxClient) {
+	const HttpFilter_t *pxFilter;
+	size_t uxi;
+	pxClient->xFilterComplete = pdFALSE;
+	for (uxi = 0; uxi < xRouteConfig.uxNumFilters; uxi++) {
+		pxFilter = &xRouteConfig.pxFilters[uxi];
+		if (pxFilter->pxComplete != NULL && (pxClient->uxFilters & (1u << uxi)))
+		  pxFilter->pxComplete(pxClient, pxFilter->pvArg);
+	}
+}
+
+static BaseType_t prvCachedRequest(HTTPClient_t *pxClient) {
+	const RouteItem_t *pxRouteItem = pxClient->pxCacheRoute;
+	RouteCacheEntry_t *pxEntry;
+	char pcKey[emberCACHE_KEY_SIZE];
+	size_t uxKeyLen;
+	uxKeyLen = uxRouteCacheKey(pcKey, sizeof(pcKey), pxClient->pcRouteParts,
+	    pxClient->pxParams, pxClient->uxNumParams);
+	if (uxKeyLen == 0)
+	  return prvCallHandler(pxClient, pxRouteItem);
+	switch (xRouteCacheFind(pxRouteItem->pxCache, pcKey, uxKeyLen, &pxEntry)) {
+	case eRouteCache_Hit:
+		pxClient->xRequestStatus = pxEntry->xStatus;
+		return xEmberWrite((TCPClient_t*) pxClient, pxEntry->pucData,
+		    pxEntry->uxLen);
+	case eRouteCache_Pending:
+		// wait for the response being built for another request; the request
+		// will not outlive the receive buffer, so only the fill is remembered
+		pxClient->pxCacheEntry = pxEntry;
+		pxClient->ulCacheFill = pxEntry->ulFill;
+		pxClient->bits.bCacheWait = 1;
+		return 0;
+	default:
+		break;
+	}
+	// copy the response as it is written; if it cannot be copied, it is still
+	// sent, just not cached
+	if (pxEntry != 0
+	    && pxEmberTapStart((TCPClient_t*) pxClient, emberCACHE_MAX_SIZE) != 0) {
+		vRouteCacheClaim(pxEntry, pcKey, uxKeyLen, pxClient);
+		pxClient->pxCacheEntry = pxEntry;
+	}
+	return prvCallHandler(pxClient, pxRouteItem);
+}
+
+static BaseType_t prvCallHandler(
+    HTTPClient_t *pxClient,
+    const RouteItem_t *pxRouteItem) {
+#if (emberHTTP_OFFLOAD_WORKERS > 0)
+	// a slow handler is called by a worker task with a copy of the request,
+	// while the client is parked; a body that is received as it arrives needs
+	// the client, so its handler is called here
+	if (pxRouteItem->uxOptions.offload && pxClient->uxBodyLeft == 0) {
+		pxClient->pxOffload = pxHttpOffloadStart(pxClient, pxRouteItem->pxHandler);
+		if (pxClient->pxOffload == NULL)
+		  return prvSendServiceUnavailable(pxClient);
+		pxClient->bits.bOffloadWait = 1;
+		return 0;
+	}
+#endif
+	return pxRouteItem->pxHandler(pxClient);
+}
+
+static BaseType_t prvContinueOffload(HTTPClient_t *pxClient) {
+	HttpOffload_t *pxOffload = pxClient->pxOffload;
+	BaseType_t xRc, xWriteRc;
+	if (!xHttpOffloadDone(pxOffload))
+	  return 0;
+	pxClient->bits.bOffloadWait = 0;
+	pxClient->pxOffload = NULL;
+	xRc = pxOffload->xRc;
+	pxClient->xRequestStatus = pxOffload->xStatus;
+	// nothing has been sent of a response that did not fit, so it is refused
+	if (xRc == -pdFREERTOS_ERRNO_ENOBUFS) {
+		vHttpOffloadStop(pxOffload);
+		return xRouteConfig.pxErrorHandler(pxClient, eHTTP_INTERNAL_SERVER_ERROR);
+	}
+	// otherwise, as for a handler called here, what it wrote is sent even if it
+	// failed
+	xWriteRc = xEmberWrite((TCPClient_t*) pxClient, pxOffload->pcResponse,
+	    pxOffload->uxLen);
+	vHttpOffloadStop(pxOffload);
+	if (xRc < 0)
+	  return xRc;
+	return xWriteRc;
+}
+
+static BaseType_t prvContinueCacheWait(HTTPClient_t *pxClient) {
+	RouteCacheEntry_t *pxEntry = pxClient->pxCacheEntry;
+	BaseType_t xSameFill = (pxEntry->ulFill == pxClient->ulCacheFill);
+	if (xSameFill && pxEntry->pxFiller != 0)
+	  return 0;
+	pxClient->bits.bCacheWait = 0;
+	pxClient->pxCacheEntry = 0;
+	// any data in the entry was stored after the wait started, so is shared
+	// regardless of its TTL
+	if (xSameFill && pxEntry->pucData != 0) {
+		pxClient->xRequestStatus = pxEntry->xStatus;
+		return xEmberWrite((TCPClient_t*) pxClient, pxEntry->pucData,
+		    pxEntry->uxLen);
+	}
+	// the response was not cached, or its entry has been reused; the request
+	// was not kept, so it cannot be handled now and the client is asked to
+	// retry it
+	return prvSendServiceUnavailable(pxClient);
+}
+
+static void prvCacheRelease(HTTPClient_t *pxClient, const BaseType_t xStore) {
+	OutputTap_t *pxTap = pxClient->pxOutputTap;
+	if (xStore && pxTap != 0 && !pxTap->xOverflow
+	    && pxClient->xRequestStatus == eHTTP_REPLY_OK)
+	  vRouteCacheStore(pxClient->pxCacheEntry, pxTap->pcData, pxTap->uxLen,
+	      pxClient->xRequestStatus);
+	else
+	  vRouteCacheStore(pxClient->pxCacheEntry, 0, 0, 0);
+	vEmberTapStop((TCPClient_t*) pxClient);
+	pxClient->pxCacheEntry = 0;
+}
+
+static BaseType_t prvQosClaim(HTTPClient_t *pxClient, RouteQos_t *pxQos) {
+	if (pxQos->uxMaxActive != 0 && pxQos->uxActive >= pxQos->uxMaxActive)
+	  return pdFALSE;
+	pxQos->uxActive++;
+	pxClient->pxQos = pxQos;
+	pxClient->xBasePriority = pxClient->xPriority;
+	pxClient->xPriority = pxQos->xPriority;
+	return pdTRUE;
+}
+
+static void prvQosRelease(HTTPClient_t *pxClient, const BaseType_t xRestore) {
+	pxClient->pxQos->uxActive--;
+	pxClient->pxQos = 0;
+	if (xRestore)
+	  pxClient->xPriority = pxClient->xBasePriority;
+}
+
+static BaseType_t prvSendServiceUnavailable(HTTPClient_t *pxClient) {
+	pxClient->bits.ulFlags = 0;
+	pxClient->xRequestStatus = eHTTP_SERVICE_UNAVAILABLE;
+	return xEmberWrite((TCPClient_t*) pxClient, pcServiceUnavailable,
+	    sizeof(pcServiceUnavailable) - 1);
+}
+
+static BaseType_t prvSendTooManyRequests(HTTPClient_t *pxClient) {
+	pxClient->bits.ulFlags = 0;
+	pxClient->xRequestStatus = eHTTP_TOO_MANY_REQUESTS;
+	return xEmberWrite((TCPClient_t*) pxClient, pcTooManyRequests,
+	    sizeof(pcTooManyRequests) - 1);
+}
+
+static char* prvAppend(
+    char *pcDst,
+    const char *pcEnd,
+    const char *pcSrc,
+    const size_t uxLen) {
+	size_t uxCopy = (size_t) (pcEnd - pcDst);
+	if (uxLen < uxCopy)
+	  uxCopy = uxLen;
+	memcpy(pcDst, pcSrc, uxCopy);
+	return pcDst + uxCopy;
+}
+
 static size_t prvConstructHeaders(
     char *pcDst,
     const size_t uxMaxSz,
@@ -772,40 +1519,172 @@ static size_t prvConstructHeaders(
     const uint32_t xOpts,
     const char *pcContentType,
     const size_t uxContentLen,
+    const char *pcEncoding,
     const char *pcExtra) {
-	size_t uxp = 0;
-	uxp += snprintf(&pcDst[uxp], uxMaxSz - uxp, "HTTP/1.1 %d %s\r\n", xCode,
-	    pxGetHttpStatusMessage(xCode)->pcText);
-	uxp += snprintf(&pcDst[uxp], uxMaxSz - uxp, "%s",
-	    "Accept-Encoding: identity\r\nConnection: close\r\n");
-	if (pcContentType)
-	  uxp += snprintf(&pcDst[uxp], uxMaxSz - uxp, "Content-Type: %s\r\n",
-	      pcContentType);
-	if (((ResponseOptions_t) xOpts).content_length)
-	uxp += snprintf(&pcDst[uxp], uxMaxSz - uxp, "Content-Length: %u\r\n",
-	    uxContentLen);
+	const HttpStatusDescriptor_t *pxStatus = pxGetHttpStatusMessage(xCode);
+	const char *pcEnd = &pcDst[uxMaxSz];
+	char *pcp = pcDst;
+	char pcNum[emberUTOA_MAX_LEN];
+	if (pxStatus->uxLineLen > 0) {
+		pcp = prvAppend(pcp, pcEnd, pxStatus->pcLine, pxStatus->uxLineLen);
+	}
+	else {
+		// no prebuilt status line for this code
+		pcp = prvAppend(pcp, pcEnd, pcHttpVersion, sizeof(pcHttpVersion) - 1);
+		pcp = prvAppend(pcp, pcEnd, pcNum,
+		    uxEmberUtoa(pcNum, (size_t) xCode));
+		pcp = prvAppend(pcp, pcEnd, " ", 1);
+		pcp = prvAppend(pcp, pcEnd, pcCrLf, sizeof(pcCrLf) - 1);
+	}
+	pcp = prvAppend(pcp, pcEnd, pcFixedHeaders, sizeof(pcFixedHeaders) - 1);
+	if (pcContentType) {
+		pcp = prvAppend(pcp, pcEnd, pcContentTypeHeader,
+		    sizeof(pcContentTypeHeader) - 1);
+		pcp = prvAppend(pcp, pcEnd, pcContentType, strlen(pcContentType));
+		pcp = prvAppend(pcp, pcEnd, pcCrLf, sizeof(pcCrLf) - 1);
+	}
+	if (((ResponseOptions_t) xOpts).content_length) {
+		pcp = prvAppend(pcp, pcEnd, pcContentLengthHeader,
+		    sizeof(pcContentLengthHeader) - 1);
+		pcp = prvAppend(pcp, pcEnd, pcNum, uxEmberUtoa(pcNum, uxContentLen));
+		pcp = prvAppend(pcp, pcEnd, pcCrLf, sizeof(pcCrLf) - 1);
+	}
 	else if (((ResponseOptions_t) xOpts).chunked_body)
-	  uxp += snprintf(&pcDst[uxp], uxMaxSz - uxp, "%s",
-	      "Transfer-Encoding: chunked\r\n");
+	  pcp = prvAppend(pcp, pcEnd, pcChunkedHeader, sizeof(pcChunkedHeader) - 1);
+	if (pcEncoding)
+	  pcp = prvAppend(pcp, pcEnd, pcEncoding, strlen(pcEncoding));
 	if (pcExtra) {
-		uxp += snprintf(&pcDst[uxp], uxMaxSz - uxp, "%s", pcExtra);
+		size_t uxExtraLen = strlen(pcExtra);
+		pcp = prvAppend(pcp, pcEnd, pcExtra, uxExtraLen);
 		// if someone didn't add a trailing \r\n, do so
-		if (pcDst[uxp - 2] != 13 || pcDst[uxp - 1] != 10)
-		  uxp += snprintf(&pcDst[uxp], uxMaxSz - uxp, "%s", "\r\n");
+		if (uxExtraLen < 2 || pcExtra[uxExtraLen - 2] != 13
+		    || pcExtra[uxExtraLen - 1] != 10)
+		  pcp = prvAppend(pcp, pcEnd, pcCrLf, sizeof(pcCrLf) - 1);
 	}
 	// extra CRLF to terminate the header block
-	uxp += snprintf(&pcDst[uxp], uxMaxSz - uxp, "%s", "\r\n");
-	return uxp;
+	pcp = prvAppend(pcp, pcEnd, pcCrLf, sizeof(pcCrLf) - 1);
+	return (size_t) (pcp - pcDst);
+}
+
+static const char *prvStartCompression(HTTPClient_t *pxClient,
+    const uint32_t xOpts) {
+	char *pcAccept;
+	const char *pcEncoding;
+	eDeflateFormat eFormat;
+	// only the chunked bodies of routes that opt in are compressed; a body that
+	// is being cached is not, as it is shared with clients that may not accept
+	// the encoding
+	if (!pxClient->xCompress || !((ResponseOptions_t) xOpts).chunked_body
+	    || pxClient->xHttpVerb == eHTTP_HEAD || pxClient->pxCacheEntry != NULL
+	    || pxClient->pxDeflate != NULL
+	    || xGetHeaderValue(pxClient, "Accept-Encoding", &pcAccept) < 0)
+	  return NULL;
+	if (prvAcceptsCoding(pcAccept, "gzip")) {
+		eFormat = eDeflateFormat_Gzip;
+		pcEncoding = pcGzipEncoding;
+	}
+	else if (prvAcceptsCoding(pcAccept, "deflate")) {
+		eFormat = eDeflateFormat_Zlib;
+		pcEncoding = pcDeflateEncoding;
+	}
+	else
+	  return NULL;
+	// without the memory for a compressor, the body is sent as it is
+	pxClient->pxDeflate = pxDeflateStart(eFormat, prvDeflateSink, pxClient);
+	if (pxClient->pxDeflate == NULL)
+	  return NULL;
+	return pcEncoding;
+}
+
+static BaseType_t prvAcceptsCoding(const char *pcAccept, const char *pcCoding) {
+	const size_t uxLen = strlen(pcCoding);
+	const char *pcp = pcAccept;
+	while (pcp != NULL && *pcp != 0) {
+		while (*pcp == ' ' || *pcp == '\t' || *pcp == ',')
+		  pcp++;
+		if (strncasecmp(pcp, pcCoding, uxLen) == 0
+		    && (pcp[uxLen] == 0 || pcp[uxLen] == ',' || pcp[uxLen] == ';'
+		        || pcp[uxLen] == ' ')) {
+			// a weight of 0 (e.g. "gzip;q=0.0") refuses the coding
+			pcp += uxLen;
+			while (*pcp == ' ' || *pcp == ';')
+			  pcp++;
+			if ((*pcp != 'q' && *pcp != 'Q') || pcp[1] != '=' || pcp[2] != '0')
+			  return pdTRUE;
+			pcp += 3;
+			if (*pcp == '.')
+			  pcp++;
+			while (*pcp == '0')
+			  pcp++;
+			return (*pcp >= '1' && *pcp <= '9') ? pdTRUE : pdFALSE;
+		}
+		pcp = strchr(pcp, ',');
+	}
+	return pdFALSE;
+}
+
+static BaseType_t prvDeflateSink(void *pxc, const uint8_t *pucData, size_t uxLen) {
+	// each block of the compressed stream is a chunk of the body
+	return prvSendChunk((HTTPClient_t*) pxc, (const char*) pucData, uxLen);
+}
+
+static BaseType_t prvSendChunk(HTTPClient_t *pxClient, const char *pcContent,
+    const size_t uxLen) {
+	char pcChunkMsg[emberUTOHEX_MAX_LEN + 2];
+	size_t uxChunkSz, uxSent = 0;
+	BaseType_t xRc;
+	uxChunkSz = uxEmberUtoHex(pcChunkMsg, uxLen);
+	pcChunkMsg[uxChunkSz++] = '\r';
+	pcChunkMsg[uxChunkSz++] = '\n';
+	xRc = xEmberWrite((TCPClient_t*) pxClient, pcChunkMsg, uxChunkSz);
+	if (xRc < 0)
+	  return xRc;
+	uxSent += (size_t) xRc;
+	xRc = xEmberWrite((TCPClient_t*) pxClient, pcContent, uxLen);
+	if (xRc < 0)
+	  return xRc;
+	uxSent += (size_t) xRc;
+	xRc = xEmberWrite((TCPClient_t*) pxClient, "\r\n", 2);
+	if (xRc < 0)
+	  return xRc;
+	uxSent += (size_t) xRc;
+	return (BaseType_t) uxSent;
+}
+
+static BaseType_t prvEncodeBody(HTTPClient_t *pxClient, const char *pcContent,
+    const size_t uxLen) {
+	BaseType_t xRc, xEndRc;
+	if (pxClient->pxDeflate == NULL) {
+		if (pcContent == 0)
+		  return xSendHttpResponseContent(pxClient, "0\r\n\r\n", 5);
+		return prvSendChunk(pxClient, pcContent, uxLen);
+	}
+	// the chunks of a compressed body are written by the compressor's sink; the
+	// text of a template is flushed at the end of each pass rather than with
+	// each block
+	if (pcContent != 0)
+	  return xDeflateWrite(pxClient->pxDeflate, (const uint8_t*) pcContent, uxLen,
+	      !pxClient->bits.bTemplateInProgress);
+	xRc = xDeflateFinish(pxClient->pxDeflate);
+	vDeflateStop(pxClient->pxDeflate);
+	pxClient->pxDeflate = NULL;
+	if (xRc < 0)
+	  return xRc;
+	xEndRc = xSendHttpResponseContent(pxClient, "0\r\n\r\n", 5);
+	if (xEndRc < 0)
+	  return xEndRc;
+	return xRc + xEndRc;
 }
 
 static BaseType_t prvSendWebsocketUpgradeHeaders(
     HTTPClient_t *pxClient,
     char *pcKey) {
-	char *pcSndBuff = pxClient->pxParent->pcSndBuff;
-	size_t uxSndBuffSz = sizeof(pxClient->pxParent->pcSndBuff);
-	size_t uxHeaderSz = 0;
+	char pcResponse[sizeof(pcWebsocketRespHeaders) + 32 + 4];
+	const char *pcEnd = &pcResponse[sizeof(pcResponse)];
+	char *pcp;
 	BaseType_t xRc;
-	uxHeaderSz = snprintf(pcSndBuff, uxSndBuffSz, pcWebsocketRespHeaders);
+	pcp = prvAppend(pcResponse, pcEnd, pcWebsocketRespHeaders,
+	    sizeof(pcWebsocketRespHeaders) - 1);
 	char pcAcceptVal[64] = "";
 	unsigned char pucAcceptHash[20];
 	char pcAcceptEnc[32];
@@ -816,9 +1695,10 @@ static BaseType_t prvSendWebsocketUpgradeHeaders(
 	if (base64_encode(pcAcceptEnc, &uxAcceptLen, pucAcceptHash,
 	    sizeof(pucAcceptHash)) != 0)
 	  return -pdFREERTOS_ERRNO_ENOBUFS;
-	uxHeaderSz += snprintf(&pcSndBuff[uxHeaderSz], uxSndBuffSz, "%s\r\n\r\n",
-	    pcAcceptEnc);
-	xRc = FreeRTOS_send(pxClient->xSock, (const void*) pcSndBuff, uxHeaderSz, 0);
+	pcp = prvAppend(pcp, pcEnd, pcAcceptEnc, uxAcceptLen);
+	pcp = prvAppend(pcp, pcEnd, "\r\n\r\n", 4);
+	xRc = xEmberWrite((TCPClient_t*) pxClient, pcResponse,
+	    (size_t) (pcp - pcResponse));
 	if (xRc < 0)
 	  return xRc;
 	// return the number of bytes sent
@@ -826,54 +1706,450 @@ static BaseType_t prvSendWebsocketUpgradeHeaders(
 }
 
 static BaseType_t prvContinueSendFile(HTTPClient_t *pxClient) {
-	size_t uxSpace, uxCount, uxSent;
-	BaseType_t xRc = 0;
-	if (pxClient->pxFileHandle == NULL)
+	TCPClient_t *pxc = (TCPClient_t*) pxClient;
+	BaseType_t xRc;
+	// a response that is not copied by its output tap cannot be cached
+	if (pxClient->pxOutputTap != NULL)
+	  pxClient->pxOutputTap->xOverflow = pdTRUE;
+	// the file is transmitted directly, so must wait for any queued output
+	if (pxClient->pxOutputHead != NULL)
 	  return 0;
-	uxSent = 0;
-	do {
-		uxSpace = FreeRTOS_tx_space(pxClient->xSock);
-		uxCount = pxClient->uxBytesLeft < uxSpace ? pxClient->uxBytesLeft : uxSpace;
-		if (uxCount > 0u) {
-			if (uxCount > sizeof(pxClient->pxParent->pcSndBuff))
-			  uxCount = sizeof(pxClient->pxParent->pcSndBuff);
-			ff_fread(pxClient->pxParent->pcSndBuff, 1, uxCount,
-			    pxClient->pxFileHandle);
-			pxClient->uxBytesLeft -= uxCount;
-			xRc = FreeRTOS_send(pxClient->xSock, pxClient->pxParent->pcSndBuff,
-			    uxCount,
-			    0);
-			if (xRc <= 0)
-			break;
-			else // not required; included for clarity
-			uxSent += xRc;
+	if (pxClient->xOutput != NULL)
+	  return prvContinueOutputFile(pxClient);
+	if (pxClient->pxReadAhead != NULL) {
+		xRc = xEmberSendReadAhead(pxClient->pxParent, pxClient->xSock,
+		    pxClient->pxReadAhead, &pxClient->uxBytesLeft,
+		    uxEmberTxBudget(pxc, emberHTTP_FILE_CHUNK_SIZE), eFileTx_None);
+		if (xRc < 0 || pxClient->uxBytesLeft == 0u) {
+			vEmberReadAheadStop(pxClient->pxReadAhead);
+			pxClient->pxReadAhead = NULL;
+			pxClient->bits.bFileInProgress = 0;
 		}
-	} while (pxClient->uxBytesLeft > 0u && uxSent < emberHTTP_FILE_CHUNK_SIZE);
-	if (pxClient->uxBytesLeft == 0u) {
-		/* Writing is ready, no need for further 'eSELECT_WRITE' events. */
-		FreeRTOS_FD_CLR(pxClient->xSock, pxClient->pxParent->xSockSet,
-		    eSELECT_WRITE);
-		// close the file, and clear the local pointer to the file handle
+		return xRc;
+	}
+	if (pxClient->pxFileHandle == NULL)
+	  return 0;
+	xRc = xEmberSendFile(pxClient->pxParent, pxClient->xSock,
+	    pxClient->pxFileHandle, &pxClient->uxBytesLeft,
+	    uxEmberTxBudget(pxc, emberHTTP_FILE_CHUNK_SIZE), eFileTx_None);
+	if (xRc < 0 || pxClient->uxBytesLeft == 0u) {
+		// finished or failed: close the file, and clear the local pointer to the
+		// file handle
 		ff_fclose(pxClient->pxFileHandle);
 		pxClient->pxFileHandle = NULL;
 		pxClient->bits.bFileInProgress = 0;
-		return uxSent;
 	}
-	else if (xRc < 0) { // implied: error trying to write to socket; ditch
-		FreeRTOS_FD_CLR(pxClient->xSock, pxClient->pxParent->xSockSet,
-		    eSELECT_WRITE);
-		// close the file, and clear the local pointer to the file handle
+	return xRc;
+}
+
+/* Pass the next block of a file to a client's output, e.g. an HTTP/2 stream,
+ * which queues what it cannot yet send */
+static BaseType_t prvContinueOutputFile(HTTPClient_t *pxClient) {
+	char *pcBuff = pxClient->pxParent->pcSndBuff;
+	size_t uxBlock;
+	BaseType_t xRc;
+	if (pxClient->pxFileHandle == NULL)
+	  return 0;
+	uxBlock = uxEmberTxBudget((TCPClient_t*) pxClient, emberHTTP_FILE_CHUNK_SIZE);
+	if (uxBlock > sizeof(pxClient->pxParent->pcSndBuff))
+	  uxBlock = sizeof(pxClient->pxParent->pcSndBuff);
+	if (uxBlock > pxClient->uxBytesLeft)
+	  uxBlock = pxClient->uxBytesLeft;
+	if (ff_fread(pcBuff, 1, uxBlock, pxClient->pxFileHandle) != uxBlock)
+	  xRc = -pdFREERTOS_ERRNO_EIO;
+	else
+	  xRc = pxClient->xOutput(pxClient, pcBuff, uxBlock);
+	if (xRc >= 0)
+	  pxClient->uxBytesLeft -= uxBlock;
+	if (xRc < 0 || pxClient->uxBytesLeft == 0u) {
 		ff_fclose(pxClient->pxFileHandle);
 		pxClient->pxFileHandle = NULL;
 		pxClient->bits.bFileInProgress = 0;
+	}
+	return xRc;
+}
+
+static BaseType_t prvContinueTemplate(HTTPClient_t *pxClient) {
+	// each chunk is rendered in place, between a fixed-width size line and the
+	// chunk's trailing CRLF
+	static const size_t uxPrefixSz = 6, uxSuffixSz = 2;
+	static const char pcHex[] = "0123456789abcdef";
+	TCPClient_t *pxc = (TCPClient_t*) pxClient;
+	size_t uxSpace, uxSent = 0;
+	const size_t uxBudget = uxEmberTxBudget(pxc, emberHTTP_FILE_CHUNK_SIZE);
+	char *pcDst;
+	BaseType_t xRc, xCorked, xEncoded;
+	// rendered text is transmitted after any queued output
+	if (pxClient->pxOutputHead != NULL)
+	  return 0;
+	// continue any cork started by the handler, or start one
+	xCorked = (pcEmberCorkTail(pxc, &uxSpace) != NULL);
+	if (!xCorked)
+	  vEmberCork(pxc);
+	// a filtered or compressed body is rendered through the filters and the
+	// compressor instead
+	xEncoded = (pxClient->xFilterBody || pxClient->pxDeflate != NULL);
+	if (xEncoded) {
+		xRc = prvRenderEncoded(pxClient, uxBudget);
+		if (xRc < 0)
+		  return xRc;
+		uxSent = (size_t) xRc;
+	}
+	while (!xEncoded && pxClient->bits.bTemplateInProgress && uxSent < uxBudget) {
+		pcDst = pcEmberCorkTail(pxc, &uxSpace);
+		if (uxSpace <= uxPrefixSz + uxSuffixSz + 5) {
+			// transmit the full cork, unless the socket cannot take any more
+			xRc = xEmberFlush(pxc);
+			if (xRc < 0)
+			  return xRc;
+			if (pxClient->pxOutputHead != NULL)
+			  break;
+			vEmberCork(pxc);
+			continue;
+		}
+		uxSpace -= uxPrefixSz + uxSuffixSz;
+		if (uxSpace > 0xFFFFu)
+		  uxSpace = 0xFFFFu;
+		xRc = xTemplateRender(pxClient->pxTemplate, &pcDst[uxPrefixSz], uxSpace);
+		if (xRc < 0)
+		  return xRc;
+		if (xRc == 0) {
+			vTemplateStop(pxClient->pxTemplate);
+			pxClient->pxTemplate = NULL;
+			pxClient->bits.bTemplateInProgress = 0;
+			xRc = xEmberWrite(pxc, "0\r\n\r\n", 5);
+			if (xRc < 0)
+			  return xRc;
+			uxSent += (size_t) xRc;
+			break;
+		}
+		pcDst[0] = pcHex[(xRc >> 12) & 0xF];
+		pcDst[1] = pcHex[(xRc >> 8) & 0xF];
+		pcDst[2] = pcHex[(xRc >> 4) & 0xF];
+		pcDst[3] = pcHex[xRc & 0xF];
+		pcDst[4] = '\r';
+		pcDst[5] = '\n';
+		pcDst[uxPrefixSz + (size_t) xRc] = '\r';
+		pcDst[uxPrefixSz + (size_t) xRc + 1] = '\n';
+		vEmberCorkAdvance(pxc, uxPrefixSz + (size_t) xRc + uxSuffixSz);
+		uxSent += uxPrefixSz + (size_t) xRc + uxSuffixSz;
+	}
+	// a cork started by the handler is flushed when the handler returns
+	if (!xCorked || !pxClient->bits.bTemplateInProgress) {
+		xRc = xEmberFlush(pxc);
+		if (xRc < 0)
+		  return xRc;
+	}
+	// wake for the next chunk as soon as the socket may be written to
+	if (pxClient->pxOutputHead == NULL) {
+		if (pxClient->bits.bTemplateInProgress)
+		  FreeRTOS_FD_SET(pxClient->xSock, pxClient->pxParent->xSockSet,
+		      eSELECT_WRITE);
+		else
+		  FreeRTOS_FD_CLR(pxClient->xSock, pxClient->pxParent->xSockSet,
+		      eSELECT_WRITE);
+	}
+	return (BaseType_t) uxSent;
+}
+
+static BaseType_t prvRenderEncoded(HTTPClient_t *pxClient,
+    const size_t uxBudget) {
+	uint8_t pucText[emberHTTP_FILTER_BLOCK_SIZE];
+	size_t uxSpace, uxRendered = 0;
+	uint8_t *pucDst;
+	BaseType_t xRc;
+	// the text is rendered in blocks for the filters, or else straight into the
+	// compressor's window; the budget applies to the text, before it is encoded
+	while (pxClient->bits.bTemplateInProgress && uxRendered < uxBudget
+	    && pxClient->pxOutputHead == NULL) {
+		if (pxClient->xFilterBody) {
+			pucDst = pucText;
+			uxSpace = sizeof(pucText);
+		}
+		else
+		  pucDst = pucDeflateInput(pxClient->pxDeflate, &uxSpace);
+		xRc = xTemplateRender(pxClient->pxTemplate, (char*) pucDst, uxSpace);
+		if (xRc < 0)
+		  return xRc;
+		if (xRc == 0) {
+			vTemplateStop(pxClient->pxTemplate);
+			pxClient->pxTemplate = NULL;
+			pxClient->bits.bTemplateInProgress = 0;
+			// end the compressed stream, and the body
+			xRc = xSendHttpResponseChunk(pxClient, NULL, 0);
+			return (xRc < 0) ? xRc : (BaseType_t) uxRendered;
+		}
+		uxRendered += (size_t) xRc;
+		if (pxClient->xFilterBody)
+		  xRc = prvFilterBody(pxClient, 0, pucText, (size_t) xRc);
+		else
+		  xRc = xDeflateCommit(pxClient->pxDeflate, (size_t) xRc, pdFALSE);
+		if (xRc < 0)
+		  return xRc;
+	}
+	// the text rendered in this pass is transmitted now, not with the next
+	if (pxClient->pxDeflate != NULL) {
+		xRc = xDeflateCommit(pxClient->pxDeflate, 0, pdTRUE);
+		if (xRc < 0)
+		  return xRc;
+	}
+	return (BaseType_t) uxRendered;
+}
+
+static BaseType_t prvContinueSendRom(HTTPClient_t *pxClient) {
+	TCPClient_t *pxc = (TCPClient_t*) pxClient;
+	size_t uxBlock;
+	BaseType_t xRc;
+	if (pxClient->pxOutputTap != NULL)
+	  pxClient->pxOutputTap->xOverflow = pdTRUE;
+	// the file is transmitted directly, so must wait for any queued output
+	if (pxClient->pxOutputHead != NULL)
+	  return 0;
+	if (pxClient->xOutput != NULL) {
+		// a client without a socket of its own is given a block per pass, as
+		// for a file, so that its output queue is not overrun
+		uxBlock = uxEmberTxBudget(pxc, emberHTTP_FILE_CHUNK_SIZE);
+		if (uxBlock > sizeof(pxClient->pxParent->pcSndBuff))
+		  uxBlock = sizeof(pxClient->pxParent->pcSndBuff);
+		if (uxBlock > pxClient->uxBytesLeft)
+		  uxBlock = pxClient->uxBytesLeft;
+		xRc = pxClient->xOutput(pxClient, (const char*) pxClient->pucRomData,
+		    uxBlock);
+		if (xRc >= 0) {
+			pxClient->pucRomData += uxBlock;
+			pxClient->uxBytesLeft -= uxBlock;
+		}
+		if (xRc < 0 || pxClient->uxBytesLeft == 0u)
+		  pxClient->bits.bRomInProgress = 0;
 		return xRc;
 	}
-	else { // implied: xRc == 0, i.e. could not write to socket, but bytes are left to write
-		/* Wake up the TCP task as soon as this socket may be written to. */
+	xRc = xEmberSendMemory(pxClient->pxParent, pxClient->xSock,
+	    &pxClient->pucRomData, &pxClient->uxBytesLeft,
+	    uxEmberTxBudget(pxc, emberHTTP_FILE_CHUNK_SIZE));
+	if (xRc < 0 || pxClient->uxBytesLeft == 0u)
+	  pxClient->bits.bRomInProgress = 0;
+	return xRc;
+}
+
+/* Call the producer with the space in the socket's transmit stream, and then
+ * wait for the socket to be writable while it makes progress, or poll it while
+ * it has nothing to send */
+static BaseType_t prvContinueProducer(HTTPClient_t *pxClient) {
+	BaseType_t xSpace, xRc, xDone = pdFALSE;
+	// the producer writes behind any queued output
+	if (pxClient->pxOutputHead != NULL)
+	  return 0;
+	xSpace = FreeRTOS_tx_space(pxClient->xSock);
+	if (xSpace <= 0) {
 		FreeRTOS_FD_SET(pxClient->xSock, pxClient->pxParent->xSockSet,
 		    eSELECT_WRITE);
-		return uxSent;
+		return 0;
+	}
+	xRc = pxClient->pxProducer(pxClient, pxClient->pvProducerArg,
+	    (size_t) xSpace, &xDone);
+	// a producer that fails is released when the client is deleted
+	if (xRc < 0)
+	  return xRc;
+	if (xDone)
+	  pxClient->bits.bProducerInProgress = 0;
+	// wake as soon as the socket may be written to while the producer is
+	// making progress; a producer with nothing to send yet is polled
+	if (pxClient->pxOutputHead == NULL) {
+		if (pxClient->bits.bProducerInProgress && xRc > 0)
+		  FreeRTOS_FD_SET(pxClient->xSock, pxClient->pxParent->xSockSet,
+		      eSELECT_WRITE);
+		else
+		  FreeRTOS_FD_CLR(pxClient->xSock, pxClient->pxParent->xSockSet,
+		      eSELECT_WRITE);
+	}
+	return xRc;
+}
+
+static BaseType_t prvContinueReceiveBody(HTTPClient_t *pxClient) {
+	const uint8_t *pucData;
+	size_t uxRcvd = 0;
+	BaseType_t xRc, xSinkRc, xZeroCopy;
+	// receive up to a chunk before cooperatively switching to another client
+	while (uxRcvd < emberHTTP_FILE_CHUNK_SIZE) {
+		xRc = prvReceiveBodyBlock(pxClient, &pucData, &xZeroCopy);
+		if (xRc <= 0)
+		  return xRc;
+		uxRcvd += xRc;
+		pxClient->uxBodyLeft -= xRc;
+		pxClient->uxBodyRcvd += xRc;
+		// once the sink has failed, the rest of the body is discarded
+		if (pxClient->pxBodySink != 0 && pxClient->xBodyStatus == 0) {
+			xSinkRc = pxClient->pxBodySink(pxClient, pucData, xRc);
+			if (xSinkRc < 0)
+			  prvFailBody(pxClient, xSinkRc);
+		}
+		// a block received in place is released once it has been consumed
+		if (xZeroCopy)
+		  FreeRTOS_recv(pxClient->xSock, NULL, xRc, 0);
+		if (pxClient->uxBodyLeft == 0)
+		  return prvEndBody(pxClient);
 	}
+	return 0;
+}
+
+static BaseType_t prvReceiveBodyBlock(
+    HTTPClient_t *pxClient,
+    const uint8_t **ppucData,
+    BaseType_t *pxZeroCopy) {
+	char *pcBuff = pxClient->pxParent->pcRcvBuff;
+	size_t uxWant;
+	BaseType_t xRc;
+	*pxZeroCopy = pdFALSE;
+#if (emberBODY_RX_ZERO_COPY != 0)
+	// take the block in place from the TCP receive stream; except for the last
+	// block of the body, it must end on a write boundary, so that a file is
+	// written in whole, aligned blocks
+	uint8_t *pucStream;
+	size_t uxEnd;
+	const StreamBuffer_t *pxStream;
+	xRc = FreeRTOS_recv(pxClient->xSock, (void*) &pucStream,
+	    pxClient->uxBodyLeft, FREERTOS_ZERO_COPY | FREERTOS_MSG_DONTWAIT);
+	if (xRc <= 0)
+	  return xRc;
+	if ((size_t) xRc < pxClient->uxBodyLeft) {
+		uxEnd = ((pxClient->uxBodyRcvd + xRc) / emberHTTP_WRITE_SIZE)
+		    * emberHTTP_WRITE_SIZE;
+		if (uxEnd > pxClient->uxBodyRcvd) {
+			*ppucData = pucStream;
+			*pxZeroCopy = pdTRUE;
+			return uxEnd - pxClient->uxBodyRcvd;
+		}
+		// there is less than a block in place; wait for more, unless the
+		// stream wraps before the block would end
+		pxStream = FreeRTOS_get_rx_buf(pxClient->xSock);
+		if (pxStream == NULL
+		    || (pxStream->LENGTH - pxStream->uxTail) > (size_t) xRc)
+		  return 0;
+		uxWant = emberHTTP_WRITE_SIZE
+		    - (pxClient->uxBodyRcvd % emberHTTP_WRITE_SIZE);
+		if (uxWant > pxClient->uxBodyLeft)
+		  uxWant = pxClient->uxBodyLeft;
+		if (FreeRTOS_recvcount(pxClient->xSock) < (BaseType_t) uxWant)
+		  return 0;
+	}
+	else {
+		*ppucData = pucStream;
+		*pxZeroCopy = pdTRUE;
+		return xRc;
+	}
+#else
+	uxWant = (pxClient->uxBodyLeft < emberTCP_RCV_BUFFER_SIZE)
+	    ? pxClient->uxBodyLeft : emberTCP_RCV_BUFFER_SIZE;
+#endif
+	xRc = FreeRTOS_recv(pxClient->xSock, (void*) pcBuff, uxWant, 0);
+	*ppucData = (const uint8_t*) pcBuff;
+	return xRc;
+}
 
+static void prvFailBody(HTTPClient_t *pxClient, const BaseType_t xRc) {
+	// sinks fail with a negated HTTP status, or with any other error
+	if (xRc <= -eHTTP_BAD_REQUEST && xRc >= -599)
+	  pxClient->xBodyStatus = -xRc;
+	else if (xRc == -pdFREERTOS_ERRNO_EINVAL)
+	  pxClient->xBodyStatus = eHTTP_BAD_REQUEST;
+	else
+	  pxClient->xBodyStatus = eHTTP_INTERNAL_SERVER_ERROR;
 }
 
+static BaseType_t prvEndBody(HTTPClient_t *pxClient) {
+	BaseType_t xRc = 0;
+	pxClient->bits.bBodyInProgress = 0;
+	if (pxClient->pxBodySink != 0 && pxClient->xBodyStatus == 0) {
+		xRc = pxClient->pxBodySink(pxClient, 0, 0);
+		if (xRc < 0)
+		  prvFailBody(pxClient, xRc);
+	}
+	if (pxClient->pxMultipart != 0) {
+		vMultipartStop(pxClient->pxMultipart);
+		pxClient->pxMultipart = 0;
+	}
+	if (pxClient->pxBodySink != 0 && pxClient->xBodyStatus != 0)
+	  xRc = xRouteConfig.pxErrorHandler(pxClient, pxClient->xBodyStatus);
+	pxClient->pxBodySink = 0;
+	return xRc;
+}
+
+static BaseType_t prvMultipartSink(void *pxc, const uint8_t *pucData, size_t uxLen) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	// the callback responds when the end of the body is fed to the parser
+	BaseType_t xRc = xMultipartFeed(pxClient->pxMultipart, pucData,
+	    (pucData != 0) ? uxLen : 0);
+	return (xRc < 0) ? xRc : 0;
+}
+
+static BaseType_t prvFileSink(void *pxc, const uint8_t *pucData, size_t uxLen) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	char pcTemp[sizeof(pxClient->pcCurrentFilename)];
+	if (pucData != 0) {
+		if (ff_fwrite(pucData, 1, uxLen, pxClient->pxFileHandle) == uxLen)
+		  return 0;
+		// the sink is not called again after it fails
+		prvAbortFile(pxClient);
+		return -eHTTP_INTERNAL_SERVER_ERROR;
+	}
+	// the complete file replaces any existing file
+	ff_fclose(pxClient->pxFileHandle);
+	pxClient->pxFileHandle = 0;
+	prvTempFilename(pxClient, pcTemp);
+	if (ff_rename(pcTemp, pxClient->pcCurrentFilename, pdTRUE) != 0) {
+		ff_remove(pcTemp);
+		return -eHTTP_INTERNAL_SERVER_ERROR;
+	}
+	if (pxClient->bits.bFileCreated)
+	  return xSendHttpResponseHeaders(pxClient, eHTTP_CREATED,
+	      eResponseOption_ContentLength, 0, 0, 0);
+	return xSendHttpResponseHeaders(pxClient, eHTTP_NO_CONTENT,
+	    eResponseOption_None, 0, 0, 0);
+}
+
+static void prvTempFilename(HTTPClient_t *pxClient, char *pcDst) {
+	size_t uxLen = strlen(pxClient->pcCurrentFilename);
+	memcpy(pcDst, pxClient->pcCurrentFilename, uxLen);
+	pcDst[uxLen] = '~';
+	pcDst[uxLen + 1] = 0;
+}
+
+static void prvAbortFile(HTTPClient_t *pxClient) {
+	char pcTemp[sizeof(pxClient->pcCurrentFilename)];
+	if (pxClient->pxFileHandle == 0)
+	  return;
+	ff_fclose(pxClient->pxFileHandle);
+	pxClient->pxFileHandle = 0;
+	prvTempFilename(pxClient, pcTemp);
+	ff_remove(pcTemp);
+}
+
+static void prvRequestComplete(HTTPClient_t *pxClient, const BaseType_t xRc) {
+	if (xHttpResponseInProgress(pxClient))
+	  return;
+	// a compressed body that the handler did not end
+	if (pxClient->pxDeflate != NULL) {
+		vDeflateStop(pxClient->pxDeflate);
+		pxClient->pxDeflate = NULL;
+	}
+	if (pxClient->xFilterComplete)
+	  prvFilterComplete(pxClient);
+	// the whole response has been written, so a response being cached is
+	// complete, unless it failed
+	if (pxClient->pxCacheEntry != NULL)
+	  prvCacheRelease(pxClient, xRc >= 0);
+	if (pxClient->pxQos != NULL)
+	  prvQosRelease(pxClient, pdTRUE);
+	if (pxClient->pxStats == NULL || pxClient->pxOutputHead != NULL)
+	  return;
+	prvRecordRequest(pxClient);
+}
+
+static void prvRecordRequest(HTTPClient_t *pxClient) {
+	if (pxClient->pxStats == NULL)
+	  return;
+	vRouteStatsRecord(pxClient->pxStats,
+	    emberSTATS_TIME_US() - pxClient->ulRequestStart,
+	    pxClient->xRequestStatus);
+	pxClient->pxStats = NULL;
+}
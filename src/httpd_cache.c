@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <string.h>
+#include "inc/httpd.h"
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static BaseType_t prvKeyAppend(
+    char *pcDst,
+    const size_t uxn,
+    size_t *puxLen,
+    const char *pcText,
+    const char cSep);
+static int prvParamCompare(const HttpParam_t *pxA, const HttpParam_t *pxB);
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+size_t uxRouteCacheKey(
+    char *pcDst,
+    const size_t uxn,
+    const char **pcRouteParts,
+    const HttpParam_t *pxParams,
+    const size_t uxNumParams) {
+	const HttpParam_t *pxOrder[emberHTTP_PARAM_PARTS], *pxParam;
+	const char **pcPart;
+	size_t uxi, uxj, uxLen = 0;
+	for (pcPart = pcRouteParts; *pcPart != HTTPD_ROUTE_TERMINATOR; pcPart++) {
+		if (!prvKeyAppend(pcDst, uxn, &uxLen, *pcPart, '/'))
+		  return 0;
+	}
+	if (!prvKeyAppend(pcDst, uxn, &uxLen, "", 0))
+	  return 0;
+	// there are few parameters, so an insertion sort is fastest
+	for (uxi = 0; uxi < uxNumParams && uxi < emberHTTP_PARAM_PARTS; uxi++) {
+		pxParam = &pxParams[uxi];
+		for (uxj = uxi; uxj > 0 && prvParamCompare(pxOrder[uxj - 1], pxParam) > 0;
+		    uxj--)
+		  pxOrder[uxj] = pxOrder[uxj - 1];
+		pxOrder[uxj] = pxParam;
+	}
+	for (uxj = 0; uxj < uxi; uxj++) {
+		if (!prvKeyAppend(pcDst, uxn, &uxLen, pxOrder[uxj]->pcKey, 0)
+		    || !prvKeyAppend(pcDst, uxn, &uxLen, pxOrder[uxj]->pcValue, 0))
+		  return 0;
+	}
+	return uxLen;
+}
+
+eRouteCacheResult xRouteCacheFind(
+    RouteCache_t *pxCache,
+    const char *pcKey,
+    const size_t uxKeyLen,
+    RouteCacheEntry_t **ppxEntry) {
+	RouteCacheEntry_t *pxEntry, *pxVictim = NULL;
+	TickType_t xNow = xTaskGetTickCount(), xAge, xOldest = 0;
+	size_t uxi;
+	for (uxi = 0; uxi < emberCACHE_ENTRIES; uxi++) {
+		pxEntry = &pxCache->pxEntries[uxi];
+		if (pxEntry->uxKeyLen == uxKeyLen
+		    && memcmp(pxEntry->pcKey, pcKey, uxKeyLen) == 0) {
+			*ppxEntry = pxEntry;
+			if (pxEntry->pxFiller != NULL)
+			  return eRouteCache_Pending;
+			if (pxEntry->pucData != NULL
+			    && (xNow - pxEntry->xFilled) < pdMS_TO_TICKS(pxCache->ulTtlMs))
+			  return eRouteCache_Hit;
+			return eRouteCache_Miss;
+		}
+		if (pxEntry->pxFiller != NULL)
+		  continue;
+		// replace an unused entry, or else the least recently filled
+		xAge = (pxEntry->uxKeyLen == 0) ? portMAX_DELAY : xNow - pxEntry->xFilled;
+		if (pxVictim == NULL || xAge > xOldest) {
+			pxVictim = pxEntry;
+			xOldest = xAge;
+		}
+	}
+	*ppxEntry = pxVictim;
+	return eRouteCache_Miss;
+}
+
+void vRouteCacheClaim(
+    RouteCacheEntry_t *pxEntry,
+    const char *pcKey,
+    const size_t uxKeyLen,
+    void *pxFiller) {
+	if (pxEntry->pucData != NULL)
+	  vPortFree(pxEntry->pucData);
+	pxEntry->pucData = NULL;
+	pxEntry->uxLen = 0;
+	memcpy(pxEntry->pcKey, pcKey, uxKeyLen);
+	pxEntry->uxKeyLen = uxKeyLen;
+	pxEntry->pxFiller = pxFiller;
+	pxEntry->xDiscard = pdFALSE;
+	pxEntry->ulFill++;
+}
+
+void vRouteCacheStore(
+    RouteCacheEntry_t *pxEntry,
+    const void *pvData,
+    const size_t uxLen,
+    const BaseType_t xStatus) {
+	pxEntry->pxFiller = NULL;
+	pxEntry->xFilled = xTaskGetTickCount();
+	if (pvData == NULL || uxLen == 0 || pxEntry->xDiscard)
+	  return;
+	// if there is no memory for it, the response is simply not cached
+	pxEntry->pucData = (uint8_t*) pvPortMalloc(uxLen);
+	if (pxEntry->pucData == NULL)
+	  return;
+	memcpy(pxEntry->pucData, pvData, uxLen);
+	pxEntry->uxLen = uxLen;
+	pxEntry->xStatus = xStatus;
+}
+
+void vRouteCacheFlush(RouteCache_t *pxCache) {
+	RouteCacheEntry_t *pxEntry;
+	size_t uxi;
+	for (uxi = 0; uxi < emberCACHE_ENTRIES; uxi++) {
+		pxEntry = &pxCache->pxEntries[uxi];
+		if (pxEntry->pucData != NULL)
+		  vPortFree(pxEntry->pucData);
+		pxEntry->pucData = NULL;
+		pxEntry->uxLen = 0;
+		if (pxEntry->pxFiller != NULL)
+		  pxEntry->xDiscard = pdTRUE;
+		else
+		  pxEntry->uxKeyLen = 0;
+	}
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+static BaseType_t prvKeyAppend(
+    char *pcDst,
+    const size_t uxn,
+    size_t *puxLen,
+    const char *pcText,
+    const char cSep) {
+	size_t uxTextLen = strlen(pcText);
+	if (*puxLen + uxTextLen + 1 > uxn)
+	  return pdFALSE;
+	memcpy(&pcDst[*puxLen], pcText, uxTextLen);
+	*puxLen += uxTextLen;
+	pcDst[(*puxLen)++] = cSep;
+	return pdTRUE;
+}
+
+static int prvParamCompare(const HttpParam_t *pxA, const HttpParam_t *pxB) {
+	int xRc = strcmp(pxA->pcKey, pxB->pcKey);
+	if (xRc == 0)
+	  xRc = strcmp(pxA->pcValue, pxB->pcValue);
+	return xRc;
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <string.h>
+#include "inc/httpd.h"
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static BaseType_t prvOffloadInit(void);
+static void prvOffloadCollect(void);
+static void prvOffloadFree(HttpOffload_t *pxOffload);
+static void prvOffloadCopy(HttpOffload_t *pxOffload, const HTTPClient_t *pxOwner);
+static void* prvRebase(
+    HttpOffload_t *pxOffload,
+    const HTTPClient_t *pxOwner,
+    const void *pvPtr);
+static void prvOffload_Service(void *pvArgs);
+static void prvOffloadRun(HttpOffload_t *pxOffload);
+static BaseType_t prvOffloadOutput(void *pxc, const char *pcData, size_t uxLen);
+
+/*===============================================
+ private global variables
+ ===============================================*/
+
+/* Requests for the worker tasks, and the requests that they have completed */
+static QueueHandle_t xJobQueue = NULL;
+static QueueHandle_t xDoneQueue = NULL;
+/* The number of requests that have been offloaded and not yet freed; as there
+ * are never more than the length of either queue, neither can be full */
+static UBaseType_t uxOutstanding = 0;
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+HttpOffload_t *pxHttpOffloadStart(HTTPClient_t *pxClient,
+    xRouteHandler *pxHandler) {
+	HttpOffload_t *pxOffload;
+	if (prvOffloadInit() != pdTRUE)
+	  return NULL;
+	prvOffloadCollect();
+	if (uxOutstanding >= emberHTTP_OFFLOAD_QUEUE_LENGTH)
+	  return NULL;
+	pxOffload = (HttpOffload_t*) pvPortMalloc(sizeof(HttpOffload_t));
+	if (pxOffload == NULL)
+	  return NULL;
+	memset(pxOffload, 0, sizeof(HttpOffload_t));
+	pxOffload->pxHandler = pxHandler;
+	prvOffloadCopy(pxOffload, pxClient);
+	if (xQueueSendToBack(xJobQueue, &pxOffload, 0) != pdTRUE) {
+		vPortFree(pxOffload);
+		return NULL;
+	}
+	uxOutstanding++;
+	return pxOffload;
+}
+
+BaseType_t xHttpOffloadDone(HttpOffload_t *pxOffload) {
+	prvOffloadCollect();
+	return pxOffload->xDone;
+}
+
+void vHttpOffloadStop(HttpOffload_t *pxOffload) {
+	// the worker may still be using it, so it is freed once it is collected
+	if (!pxOffload->xDone) {
+		pxOffload->xCancelled = pdTRUE;
+		return;
+	}
+	prvOffloadFree(pxOffload);
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+static BaseType_t prvOffloadInit(void) {
+	UBaseType_t uxi;
+	if (xJobQueue != NULL)
+	  return pdTRUE;
+	xJobQueue = xQueueCreate(emberHTTP_OFFLOAD_QUEUE_LENGTH,
+	    sizeof(HttpOffload_t*));
+	xDoneQueue = xQueueCreate(emberHTTP_OFFLOAD_QUEUE_LENGTH,
+	    sizeof(HttpOffload_t*));
+	if (xJobQueue != NULL && xDoneQueue != NULL) {
+		// as many of the workers as there is memory for
+		for (uxi = 0; uxi < emberHTTP_OFFLOAD_WORKERS; uxi++) {
+			if (xTaskCreate(prvOffload_Service, (const char*) "EmberWork",
+			    emberHTTP_OFFLOAD_STACK_SIZE, 0, emberHTTP_OFFLOAD_PRIORITY, NULL)
+			    != pdPASS)
+			  break;
+		}
+		if (uxi > 0)
+		  return pdTRUE;
+	}
+	if (xJobQueue != NULL)
+	  vQueueDelete(xJobQueue);
+	if (xDoneQueue != NULL)
+	  vQueueDelete(xDoneQueue);
+	xJobQueue = NULL;
+	xDoneQueue = NULL;
+	return pdFALSE;
+}
+
+static void prvOffloadCollect(void) {
+	HttpOffload_t *pxOffload;
+	if (xDoneQueue == NULL)
+	  return;
+	// the requests of clients that have gone are freed as they are collected
+	while (xQueueReceive(xDoneQueue, &pxOffload, 0) == pdTRUE) {
+		if (pxOffload->xCancelled)
+		  prvOffloadFree(pxOffload);
+		else
+		  pxOffload->xDone = pdTRUE;
+	}
+}
+
+static void prvOffloadFree(HttpOffload_t *pxOffload) {
+	vPortFree(pxOffload);
+	uxOutstanding--;
+}
+
+static void prvOffloadCopy(HttpOffload_t *pxOffload, const HTTPClient_t *pxOwner) {
+	HTTPClient_t *pxClient = &pxOffload->xClient;
+	TCPServer_t *pxServer = &pxOffload->xServer;
+	size_t uxi;
+	// the request is parsed in place, in the server's receive buffer, which is
+	// reused for the next request; the copy's pointers are moved into the copy
+	memcpy(pxServer->pcRcvBuff, pxOwner->pxParent->pcRcvBuff,
+	    sizeof(pxServer->pcRcvBuff));
+	memcpy(pxClient, pxOwner, sizeof(HTTPClient_t));
+	pxClient->pcUrlData = prvRebase(pxOffload, pxOwner, pxOwner->pcUrlData);
+	for (uxi = 0; uxi < emberHTTP_ROUTE_PARTS; uxi++)
+	  pxClient->pcRouteParts[uxi] = prvRebase(pxOffload, pxOwner,
+	      pxOwner->pcRouteParts[uxi]);
+	for (uxi = 0; uxi < pxOwner->uxNumParams && uxi < emberHTTP_PARAM_PARTS;
+	    uxi++) {
+		pxClient->pxParams[uxi].pcKey = prvRebase(pxOffload, pxOwner,
+		    pxOwner->pxParams[uxi].pcKey);
+		pxClient->pxParams[uxi].pcValue = prvRebase(pxOffload, pxOwner,
+		    pxOwner->pxParams[uxi].pcValue);
+	}
+	for (uxi = 0; uxi < emberHTTP_HEADER_PARTS; uxi++)
+	  pxClient->pxHeaders[uxi].pcValue = prvRebase(pxOffload, pxOwner,
+	      pxOwner->pxHeaders[uxi].pcValue);
+	pxClient->pcBody = prvRebase(pxOffload, pxOwner, pxOwner->pcBody);
+#if (emberJSON_TOKENS > 0)
+	if (pxOwner->pxJson != NULL) {
+		memcpy(pxServer->pxJsonTokens, pxOwner->pxParent->pxJsonTokens,
+		    sizeof(pxServer->pxJsonTokens));
+		pxServer->xJsonIndex = *pxOwner->pxJson;
+		pxServer->xJsonIndex.pcText = prvRebase(pxOffload, pxOwner,
+		    pxOwner->pxJson->pcText);
+		pxServer->xJsonIndex.pxTokens = pxServer->pxJsonTokens;
+		pxClient->pxJson = &pxServer->xJsonIndex;
+	}
+#endif
+	// the copy is the only client of its own server, so its writes are collected
+	// in its own send buffer and then in the response; the route's statistics,
+	// cache, QoS and completion filters remain with the parked client
+	pxClient->pxParent = pxServer;
+	pxClient->pxPrevClient = NULL;
+	pxClient->pxNextClient = NULL;
+	pxClient->pxOutputHead = NULL;
+	pxClient->pxOutputTail = NULL;
+	pxClient->uxOutputQueued = 0;
+	pxClient->pxOutputTap = NULL;
+	pxClient->xOutput = prvOffloadOutput;
+	pxClient->xPriority = ePriority_Normal;
+	pxClient->pxStats = NULL;
+	pxClient->pxCacheRoute = NULL;
+	pxClient->pxCacheEntry = NULL;
+	pxClient->pxQos = NULL;
+	pxClient->xFilterComplete = pdFALSE;
+	pxClient->bits.ulFlags = 0;
+	// a response that is being cached is not compressed
+	if (pxOwner->pxCacheEntry != NULL)
+	  pxClient->xCompress = pdFALSE;
+}
+
+static void* prvRebase(
+    HttpOffload_t *pxOffload,
+    const HTTPClient_t *pxOwner,
+    const void *pvPtr) {
+	const char *pcPtr = (const char*) pvPtr;
+	const char *pcRcvBuff = pxOwner->pxParent->pcRcvBuff;
+	const char *pcOwner = (const char*) pxOwner;
+	if (pcPtr >= pcRcvBuff && pcPtr < &pcRcvBuff[emberTCP_RCV_BUFFER_SIZE])
+	  return &pxOffload->xServer.pcRcvBuff[pcPtr - pcRcvBuff];
+	if (pcPtr >= pcOwner && pcPtr < &pcOwner[sizeof(HTTPClient_t)])
+	  return &((char*) &pxOffload->xClient)[pcPtr - pcOwner];
+	// e.g. NULL, a route terminator or a constant
+	return (void*) pvPtr;
+}
+
+static void prvOffload_Service(void *pvArgs) {
+	HttpOffload_t *pxOffload;
+	while (1) {
+		if (xQueueReceive(xJobQueue, &pxOffload, portMAX_DELAY) != pdTRUE)
+		  continue;
+		// the handler of a request whose client has gone is not called
+		if (!pxOffload->xCancelled)
+		  prvOffloadRun(pxOffload);
+		xQueueSendToBack(xDoneQueue, &pxOffload, portMAX_DELAY);
+	}
+}
+
+static void prvOffloadRun(HttpOffload_t *pxOffload) {
+	HTTPClient_t *pxClient = &pxOffload->xClient;
+	BaseType_t xRc, xFlushRc;
+	// as for a request served by EMBER, the response is collected and written
+	// when the handler returns
+	vEmberCork((TCPClient_t*) pxClient);
+	xRc = pxOffload->pxHandler(pxClient);
+	xFlushRc = xEmberFlush((TCPClient_t*) pxClient);
+	if (xRc >= 0 && xFlushRc < 0)
+	  xRc = xFlushRc;
+	// the rest of a response that continues, e.g. a file or a template, is
+	// written here too; a producer with nothing to write yet is polled each tick
+	while (xRc >= 0 && xHttpResponseInProgress(pxClient)
+	    && !pxClient->bits.bBodyInProgress) {
+		xRc = xHttpWork(pxClient);
+		if (xRc == 0)
+		  vTaskDelay(1);
+	}
+	// a response that did not fit, or a body that was to be received as it
+	// arrives, fails the request without any of the response being sent
+	if (xRc == -pdFREERTOS_ERRNO_ENOBUFS || (xRc >= 0
+	    && xHttpResponseInProgress(pxClient))) {
+		xRc = -pdFREERTOS_ERRNO_ENOBUFS;
+		pxOffload->uxLen = 0;
+	}
+	xHttpDelete(pxClient);
+	pxOffload->xRc = xRc;
+	pxOffload->xStatus = pxClient->xRequestStatus;
+}
+
+static BaseType_t prvOffloadOutput(void *pxc, const char *pcData, size_t uxLen) {
+	// the copy of the client is at the top of its request
+	HttpOffload_t *pxOffload = (HttpOffload_t*) pxc;
+	if (uxLen > sizeof(pxOffload->pcResponse) - pxOffload->uxLen)
+	  return -pdFREERTOS_ERRNO_ENOBUFS;
+	memcpy(&pxOffload->pcResponse[pxOffload->uxLen], pcData, uxLen);
+	pxOffload->uxLen += uxLen;
+	return (BaseType_t) uxLen;
+}
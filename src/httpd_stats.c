@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <stdio.h>
+#include <string.h>
+#include "inc/httpd.h"
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+#define STATS_SUB_COUNT            (1u << emberSTATS_SUB_BITS)
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static size_t prvBucketIndex(const uint32_t ulValue);
+static uint32_t prvBucketUpperBound(const size_t uxIndex);
+
+/*===============================================
+ external objects
+ ===============================================*/
+
+extern const RouteConfig_t xRouteConfig;
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+void vRouteStatsRecord(
+    RouteStats_t *pxStats,
+    const uint32_t ulLatencyUs,
+    const BaseType_t xStatus) {
+	pxStats->ulCount++;
+	pxStats->ullTotalUs += ulLatencyUs;
+	if (ulLatencyUs > pxStats->ulMaxUs)
+	  pxStats->ulMaxUs = ulLatencyUs;
+	if (xStatus >= 100 && xStatus < 600)
+	  pxStats->pulStatus[(xStatus / 100) - 1]++;
+	pxStats->pulBuckets[prvBucketIndex(ulLatencyUs)]++;
+}
+
+uint32_t ulRouteStatsPercentile(
+    const RouteStats_t *pxStats,
+    const uint32_t ulPerMille) {
+	uint64_t ullRank, ullSeen = 0;
+	size_t uxi;
+	if (pxStats->ulCount == 0)
+	  return 0;
+	// the rank of the percentile, rounded up, and at least the first response
+	ullRank = ((uint64_t) pxStats->ulCount * ulPerMille + 999) / 1000;
+	if (ullRank == 0)
+	  ullRank = 1;
+	for (uxi = 0; uxi < emberSTATS_BUCKETS; uxi++) {
+		ullSeen += pxStats->pulBuckets[uxi];
+		if (ullSeen >= ullRank)
+		  break;
+	}
+	// no response was slower than the maximum, whatever its bucket's bound
+	if (uxi >= emberSTATS_BUCKETS - 1
+	    || prvBucketUpperBound(uxi) > pxStats->ulMaxUs)
+	  return pxStats->ulMaxUs;
+	return prvBucketUpperBound(uxi);
+}
+
+void vRouteStatsReset(RouteStats_t *pxStats) {
+	memset(pxStats, 0, sizeof(RouteStats_t));
+}
+
+BaseType_t xRouteStatsHandler(void *pxc) {
+	HTTPClient_t *pxClient = (HTTPClient_t*) pxc;
+	const RouteItem_t *pxItem;
+	const RouteStats_t *pxStats;
+	char pcLine[256];
+	size_t uxi, uxLen;
+	BaseType_t xRc, xLen = 0, xFirst = pdTRUE;
+	if (pxClient->xHttpVerb != eHTTP_GET)
+	  return xRouteConfig.pxErrorHandler(pxc, eHTTP_NOT_ALLOWED);
+	xRc = xSendHttpResponseHeaders(pxc, eHTTP_REPLY_OK,
+	    eResponseOption_ChunkedBody, 0, "application/json", 0);
+	if (xRc < 0)
+	  return xRc;
+	xLen += xRc;
+	for (uxi = 0; uxi < xRouteConfig.uxNumRoutes; uxi++) {
+		pxItem = &xRouteConfig.pxItems[uxi];
+		pxStats = pxItem->pxStats;
+		if (pxStats == NULL)
+		  continue;
+		uxLen = snprintf(pcLine, sizeof(pcLine), "%s{\"route\":\"",
+		    xFirst ? "[" : ",");
+		xFirst = pdFALSE;
+		uxLen += xPrintRoute(&pcLine[uxLen], (const char**) pxItem->pcPath,
+		    sizeof(pcLine) - uxLen);
+		uxLen += snprintf(&pcLine[uxLen], sizeof(pcLine) - uxLen,
+		    "\",\"count\":%lu,\"mean\":%lu,\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,"
+		        "\"max\":%lu,\"status\":[%lu,%lu,%lu,%lu,%lu]}",
+		    (unsigned long) pxStats->ulCount,
+		    (unsigned long) (pxStats->ulCount ?
+		        pxStats->ullTotalUs / pxStats->ulCount : 0),
+		    (unsigned long) ulRouteStatsPercentile(pxStats, 500),
+		    (unsigned long) ulRouteStatsPercentile(pxStats, 900),
+		    (unsigned long) ulRouteStatsPercentile(pxStats, 990),
+		    (unsigned long) pxStats->ulMaxUs,
+		    (unsigned long) pxStats->pulStatus[0],
+		    (unsigned long) pxStats->pulStatus[1],
+		    (unsigned long) pxStats->pulStatus[2],
+		    (unsigned long) pxStats->pulStatus[3],
+		    (unsigned long) pxStats->pulStatus[4]);
+		if (uxLen >= sizeof(pcLine))
+		  uxLen = sizeof(pcLine) - 1;
+		xRc = xSendHttpResponseChunk(pxc, pcLine, uxLen);
+		if (xRc < 0)
+		  return xRc;
+		xLen += xRc;
+	}
+	xRc = xSendHttpResponseChunk(pxc, xFirst ? "[]" : "]", 0);
+	if (xRc < 0)
+	  return xRc;
+	xLen += xRc;
+	xRc = xSendHttpResponseChunk(pxc, 0, 0);
+	if (xRc < 0)
+	  return xRc;
+	return xLen + xRc;
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+/* Log-linear bucket index: values below STATS_SUB_COUNT have a bucket each;
+ * above that, each power of two is split into STATS_SUB_COUNT buckets */
+static size_t prvBucketIndex(const uint32_t ulValue) {
+	uint32_t ulMsb;
+	if (ulValue < STATS_SUB_COUNT)
+	  return (size_t) ulValue;
+	ulMsb = 31 - (uint32_t) __builtin_clz(ulValue);
+	if (ulMsb >= emberSTATS_RANGE_BITS)
+	  return emberSTATS_BUCKETS - 1;
+	return (size_t) (((ulMsb - emberSTATS_SUB_BITS + 1) << emberSTATS_SUB_BITS)
+	    + ((ulValue >> (ulMsb - emberSTATS_SUB_BITS)) & (STATS_SUB_COUNT - 1)));
+}
+
+static uint32_t prvBucketUpperBound(const size_t uxIndex) {
+	uint32_t ulGroup = (uint32_t) (uxIndex >> emberSTATS_SUB_BITS);
+	uint32_t ulSub = (uint32_t) (uxIndex & (STATS_SUB_COUNT - 1));
+	if (ulGroup == 0)
+	  return ulSub;
+	return ((STATS_SUB_COUNT + ulSub + 1) << (ulGroup - 1)) - 1;
+}
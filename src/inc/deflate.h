@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef EMBER_V0_0_INC_DEFLATE_H_
+#define EMBER_V0_0_INC_DEFLATE_H_
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include "./ember_private.h"
+
+/*===============================================
+ public constants
+ ===============================================*/
+
+/* The size of the compressor's window, i.e. the furthest back that a match
+ * may refer */
+#define DEFLATE_WINDOW_SZ          (1u << emberDEFLATE_WINDOW_BITS)
+/* The number of compressed bytes collected before they are passed on */
+#define DEFLATE_OUT_SZ             (512)
+
+/*===============================================
+ public data prototypes
+ ===============================================*/
+
+/**
+ * @enum eDeflateFormat
+ * @brief The container of a compressed stream.
+ */
+typedef enum
+{
+	eDeflateFormat_Gzip = 0, /**< eDeflateFormat_Gzip: RFC 1952, "gzip" */
+	eDeflateFormat_Zlib,	 /**< eDeflateFormat_Zlib: RFC 1950, "deflate" */
+} eDeflateFormat;
+
+/**
+ * @fn BaseType_t (xDeflateSink)(void*, const uint8_t*, size_t)
+ * @brief Signature for functions that consume a compressed stream, a block at
+ *   a time. A negative return stops compression, and is returned to the caller
+ *   of the compressor.
+ */
+typedef BaseType_t (xDeflateSink)(void *pvArg, const uint8_t *pucData, size_t uxLen);
+
+/**
+ * @struct xDEFLATE_STREAM
+ * @brief The state of a streaming compressor. Data is compressed as it is
+ *   written, with fixed Huffman codes and matches found through hash chains
+ *   in a window of the most recent `DEFLATE_WINDOW_SZ` bytes.
+ */
+struct xDEFLATE_STREAM
+{
+	xDeflateSink *pxSink;
+	void *pvArg;
+	BaseType_t xFormat;
+	/* The CRC-32 or Adler-32 of the uncompressed data, and its length */
+	uint32_t ulCheck;
+	uint32_t ulTotal;
+	/* The sink's error, after which nothing more is passed to it */
+	BaseType_t xError;
+	/* The number of compressed bytes passed to the sink by the current call */
+	size_t uxSent;
+	/* Bits that do not yet make a whole byte of output */
+	uint32_t ulBits;
+	UBaseType_t uxBitCount;
+	BaseType_t xBlockOpen;
+	/* The end of the data in `pucWindow` */
+	size_t uxPos;
+	size_t uxOutLen;
+	uint16_t pusHead[1u << emberDEFLATE_HASH_BITS];
+	uint16_t pusPrev[DEFLATE_WINDOW_SZ];
+	uint8_t pucWindow[2 * DEFLATE_WINDOW_SZ];
+	uint8_t pucOut[DEFLATE_OUT_SZ];
+};
+typedef struct xDEFLATE_STREAM DeflateStream_t;
+
+/*===============================================
+ public function prototypes
+ ===============================================*/
+
+/**
+ * @fn DeflateStream_t* pxDeflateStart(const eDeflateFormat, xDeflateSink*, void*)
+ * @brief Start a compressed stream. The container's header is passed to the
+ *   sink with the first compressed data.
+ *
+ * @param eFormat The container of the stream.
+ * @param pxSink The consumer of the compressed stream.
+ * @param pvArg An argument passed to every call of `pxSink`.
+ * @return The compressor state, or NULL if no memory was available.
+ */
+DeflateStream_t *pxDeflateStart(
+	const eDeflateFormat eFormat,
+	xDeflateSink *pxSink,
+	void *pvArg);
+
+/**
+ * @fn uint8_t* pucDeflateInput(DeflateStream_t*, size_t*)
+ * @brief Find where the next data to be compressed may be written, e.g. by a
+ *   template render, so that it need not be copied. The data is compressed by
+ *   `xDeflateCommit`.
+ *
+ * @param pxStream The compressor state.
+ * @param puxSpace Receives the number of bytes that may be written, which is
+ *   at least a quarter of `DEFLATE_WINDOW_SZ`.
+ * @return The destination of the data.
+ */
+uint8_t *pucDeflateInput(DeflateStream_t *pxStream, size_t *puxSpace);
+
+/**
+ * @fn BaseType_t xDeflateCommit(DeflateStream_t*, const size_t, const BaseType_t)
+ * @brief Compress data written to the destination found by `pucDeflateInput`.
+ *
+ * @param pxStream The compressor state.
+ * @param uxLen The number of bytes written.
+ * @param xFlush If pdTRUE, all of the data compressed so far is passed to the
+ *   sink, ending on a byte boundary (a "sync flush"), so that the client can
+ *   decompress it without waiting for more.
+ * @return
+ *   < 0 the sink's error
+ *   >= 0 the number of compressed bytes passed to the sink
+ */
+BaseType_t xDeflateCommit(
+	DeflateStream_t *pxStream,
+	const size_t uxLen,
+	const BaseType_t xFlush);
+
+/**
+ * @fn BaseType_t xDeflateWrite(DeflateStream_t*, const uint8_t*, size_t, const BaseType_t)
+ * @brief Compress data.
+ *
+ * @param pxStream The compressor state.
+ * @param pucData The data.
+ * @param uxLen The length of the data.
+ * @param xFlush If pdTRUE, sync flush the stream after the data (see
+ *   `xDeflateCommit`).
+ * @return
+ *   < 0 the sink's error
+ *   >= 0 the number of compressed bytes passed to the sink
+ */
+BaseType_t xDeflateWrite(
+	DeflateStream_t *pxStream,
+	const uint8_t *pucData,
+	size_t uxLen,
+	const BaseType_t xFlush);
+
+/**
+ * @fn BaseType_t xDeflateFinish(DeflateStream_t*)
+ * @brief End a compressed stream, and pass the rest of it, with the
+ *   container's trailer, to the sink. The state must then be freed by
+ *   `vDeflateStop`.
+ *
+ * @param pxStream The compressor state.
+ * @return
+ *   < 0 the sink's error
+ *   >= 0 the number of compressed bytes passed to the sink
+ */
+BaseType_t xDeflateFinish(DeflateStream_t *pxStream);
+
+/**
+ * @fn void vDeflateStop(DeflateStream_t*)
+ * @brief Free a compressor's state, whether or not its stream was finished.
+ *
+ * @param pxStream The compressor state.
+ */
+void vDeflateStop(DeflateStream_t *pxStream);
+
+#endif /* EMBER_V0_0_INC_DEFLATE_H_ */
@@ -85,5 +85,465 @@
 #define emberHTTP_FILE_CHUNK_SIZE  (20*1024)
 #endif
 
+/**
+ * @def emberFTP_FILE_CHUNK_SIZE
+ * @brief The approximate number of bytes that will be uploaded for an FTP
+ * RETR before cooperatively switching to another client.
+ */
+#ifndef emberFTP_FILE_CHUNK_SIZE
+#define emberFTP_FILE_CHUNK_SIZE   (emberHTTP_FILE_CHUNK_SIZE)
+#endif
+
+/**
+ * @def emberFILE_TX_ZERO_COPY
+ * @brief If non-zero, files are read directly into the TCP transmit stream
+ * rather than via the shared `pcSndBuff`.
+ */
+#ifndef emberFILE_TX_ZERO_COPY
+#define emberFILE_TX_ZERO_COPY     (1)
+#endif
+
+/**
+ * @def emberFILE_SECTOR_SIZE
+ * @brief The filesystem sector size (in bytes). File reads are rounded down to
+ * a multiple of this size, except for the final read of a file. Must be a power
+ * of 2.
+ */
+#ifndef emberFILE_SECTOR_SIZE
+#define emberFILE_SECTOR_SIZE      (512)
+#endif
+
+/**
+ * @def emberFILE_IO_TASK
+ * @brief If non-zero, file reads for transmission are issued to a dedicated
+ * I/O task and double-buffered, so that the EMBER task never blocks on storage.
+ */
+#ifndef emberFILE_IO_TASK
+#define emberFILE_IO_TASK          (0)
+#endif
+
+/**
+ * @def emberFILE_IO_STACK_SIZE
+ * @brief The size (in bytes) of the file I/O task's stack
+ */
+#ifndef emberFILE_IO_STACK_SIZE
+#define emberFILE_IO_STACK_SIZE    (1024)
+#endif
+
+/**
+ * @def emberFILE_IO_PRIORITY
+ * @brief The priority of the file I/O task. Should be at least the priority of
+ * the EMBER task.
+ */
+#ifndef emberFILE_IO_PRIORITY
+#define emberFILE_IO_PRIORITY      (tskIDLE_PRIORITY + 1)
+#endif
+
+/**
+ * @def emberFILE_IO_QUEUE_LENGTH
+ * @brief The maximum number of outstanding read requests to the file I/O task
+ */
+#ifndef emberFILE_IO_QUEUE_LENGTH
+#define emberFILE_IO_QUEUE_LENGTH  (8)
+#endif
+
+/**
+ * @def emberFILE_READAHEAD_SIZE
+ * @brief The size (in bytes) of each of the two read-ahead buffers allocated
+ * per file transfer when `emberFILE_IO_TASK` is enabled. Should be a multiple
+ * of `emberFILE_SECTOR_SIZE`.
+ */
+#ifndef emberFILE_READAHEAD_SIZE
+#define emberFILE_READAHEAD_SIZE   (2048)
+#endif
+
+/**
+ * @def emberOUTPUT_QUEUE_SIZE
+ * @brief The maximum number of bytes that may be queued for transmission to a
+ * single client while its socket's transmit stream is full. Writes that would
+ * exceed this fail with -pdFREERTOS_ERRNO_ENOBUFS.
+ */
+#ifndef emberOUTPUT_QUEUE_SIZE
+#define emberOUTPUT_QUEUE_SIZE     (8*1024)
+#endif
+
+/**
+ * @def emberWEBSOCKET_CORK_SIZE
+ * @brief The maximum payload size (in bytes) of a websocket message that is
+ * sent in a single call together with its header. The message is assembled on
+ * the stack of the sending task, so this also determines the stack space used.
+ */
+#ifndef emberWEBSOCKET_CORK_SIZE
+#define emberWEBSOCKET_CORK_SIZE   (128)
+#endif
+
+/**
+ * @def emberWEBSOCKET_MESSAGE_BUFFERS
+ * @brief The number of buffers, shared by all websocket clients, in which
+ * fragmented messages are reassembled. A client holds one while it receives a
+ * fragmented message; if none is free, the connection is closed with 1013.
+ */
+#ifndef emberWEBSOCKET_MESSAGE_BUFFERS
+#define emberWEBSOCKET_MESSAGE_BUFFERS (2)
+#endif
+
+/**
+ * @def emberWEBSOCKET_MESSAGE_SIZE
+ * @brief The maximum size (in bytes) of a reassembled websocket message, and
+ * so of each of the `emberWEBSOCKET_MESSAGE_BUFFERS` buffers. A larger message
+ * closes the connection with 1009.
+ */
+#ifndef emberWEBSOCKET_MESSAGE_SIZE
+#define emberWEBSOCKET_MESSAGE_SIZE (emberTCP_RCV_BUFFER_SIZE)
+#endif
+
+/**
+ * @def emberSSE_KEEPALIVE_MS
+ * @brief The period (in ms) after which an idle server-sent events connection
+ * is sent a comment line, to prevent intermediaries from closing it.
+ */
+#ifndef emberSSE_KEEPALIVE_MS
+#define emberSSE_KEEPALIVE_MS      (15000)
+#endif
+
+/**
+ * @def emberTEMPLATE_MAX_DEPTH
+ * @brief The maximum nesting depth of loop sections in a template
+ */
+#ifndef emberTEMPLATE_MAX_DEPTH
+#define emberTEMPLATE_MAX_DEPTH    (4)
+#endif
+
+/**
+ * @def emberTEMPLATE_NAME_SIZE
+ * @brief The maximum length (in bytes, including the terminating NUL) of a
+ * template value or loop name
+ */
+#ifndef emberTEMPLATE_NAME_SIZE
+#define emberTEMPLATE_NAME_SIZE    (32)
+#endif
+
+/**
+ * @def emberTEMPLATE_VALUE_SIZE
+ * @brief The maximum length (in bytes) of a value supplied by a template
+ * callback. Longer values are truncated.
+ */
+#ifndef emberTEMPLATE_VALUE_SIZE
+#define emberTEMPLATE_VALUE_SIZE   (64)
+#endif
+
+/**
+ * @def emberTEMPLATE_READ_SIZE
+ * @brief The size (in bytes) of the window through which a compiled template
+ * is read from its file
+ */
+#ifndef emberTEMPLATE_READ_SIZE
+#define emberTEMPLATE_READ_SIZE    (512)
+#endif
+
+/**
+ * @def emberRATE_LIMIT_BUCKETS
+ * @brief The number of per-address token buckets kept for rate limiting. If 0,
+ * rate limits are not enforced.
+ */
+#ifndef emberRATE_LIMIT_BUCKETS
+#define emberRATE_LIMIT_BUCKETS    (16)
+#endif
+
+/**
+ * @def emberRATE_LIMIT_PROBES
+ * @brief The number of buckets searched for a remote address before the least
+ * recently used of them is reused
+ */
+#ifndef emberRATE_LIMIT_PROBES
+#define emberRATE_LIMIT_PROBES     (4)
+#endif
+
+/**
+ * @def emberSTATS_SUB_BITS
+ * @brief The log2 of the number of route latency histogram buckets per power
+ * of two. Each bucket spans at most 1/(2^emberSTATS_SUB_BITS) of its value.
+ */
+#ifndef emberSTATS_SUB_BITS
+#define emberSTATS_SUB_BITS        (2)
+#endif
+
+/**
+ * @def emberSTATS_RANGE_BITS
+ * @brief The log2 of the largest latency (in microseconds) distinguished by a
+ * route latency histogram; larger latencies are counted in the last bucket.
+ */
+#ifndef emberSTATS_RANGE_BITS
+#define emberSTATS_RANGE_BITS      (24)
+#endif
+
+/**
+ * @def emberSTATS_BUCKETS
+ * @brief The number of buckets in a route latency histogram
+ */
+#define emberSTATS_BUCKETS \
+	((emberSTATS_RANGE_BITS - emberSTATS_SUB_BITS + 1) << emberSTATS_SUB_BITS)
+
+/**
+ * @def emberSTATS_TIME_US
+ * @brief A free-running 32-bit microsecond timestamp, used to time HTTP
+ * requests. The default has the resolution of the RTOS tick; define it as e.g.
+ * a hardware timer or cycle counter for finer measurements.
+ */
+#ifndef emberSTATS_TIME_US
+#define emberSTATS_TIME_US() \
+	((uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS * 1000u))
+#endif
+
+/**
+ * @def emberMULTIPART_BOUNDARY_SIZE
+ * @brief The maximum length (in bytes) of the boundary of a
+ * `multipart/form-data` body. RFC 2046 limits boundaries to 70 characters.
+ */
+#ifndef emberMULTIPART_BOUNDARY_SIZE
+#define emberMULTIPART_BOUNDARY_SIZE (70)
+#endif
+
+/**
+ * @def emberMULTIPART_HEADER_SIZE
+ * @brief The maximum length (in bytes) of a part header line in a
+ * `multipart/form-data` body. Longer lines are truncated.
+ */
+#ifndef emberMULTIPART_HEADER_SIZE
+#define emberMULTIPART_HEADER_SIZE (256)
+#endif
+
+/**
+ * @def emberMULTIPART_NAME_SIZE
+ * @brief The maximum length (in bytes, including the terminating NUL) of the
+ * name, filename and content type of a part of a `multipart/form-data` body
+ */
+#ifndef emberMULTIPART_NAME_SIZE
+#define emberMULTIPART_NAME_SIZE   (64)
+#endif
+
+/**
+ * @def emberMULTIPART_WRITE_SIZE
+ * @brief The size (in bytes) of the blocks in which the content of a part of a
+ * `multipart/form-data` body is delivered, e.g. to be written to a file. Should
+ * be a multiple of `emberFILE_SECTOR_SIZE`, ideally the flash erase-block size.
+ */
+#ifndef emberMULTIPART_WRITE_SIZE
+#define emberMULTIPART_WRITE_SIZE  (4*emberFILE_SECTOR_SIZE)
+#endif
+
+/**
+ * @def emberBODY_RX_ZERO_COPY
+ * @brief If non-zero, streamed HTTP request bodies are passed to their
+ * consumer directly from the TCP receive stream rather than via the shared
+ * `pcRcvBuff`.
+ */
+#ifndef emberBODY_RX_ZERO_COPY
+#define emberBODY_RX_ZERO_COPY     (1)
+#endif
+
+/**
+ * @def emberHTTP_WRITE_SIZE
+ * @brief The size (in bytes) of the blocks on whose boundaries streamed HTTP
+ * request bodies (e.g. files stored with `xReceiveHttpFile`) are received.
+ * Defaults to the FTP server's preferred write size, if that is configured;
+ * ideally the flash erase-block size. Must not exceed
+ * `emberTCP_RCV_BUFFER_SIZE`.
+ */
+#ifndef emberHTTP_WRITE_SIZE
+#ifdef ipconfigFTP_PREFERRED_WRITE_SIZE
+#define emberHTTP_WRITE_SIZE       (ipconfigFTP_PREFERRED_WRITE_SIZE)
+#else
+#define emberHTTP_WRITE_SIZE       (emberFILE_SECTOR_SIZE)
+#endif
+#endif
+
+/**
+ * @def emberCACHE_ENTRIES
+ * @brief The number of responses (for different queries) kept by each HTTP
+ *   route cache
+ */
+#ifndef emberCACHE_ENTRIES
+#define emberCACHE_ENTRIES         (4)
+#endif
+
+/**
+ * @def emberCACHE_KEY_SIZE
+ * @brief The maximum length (in bytes) of the key of a cached HTTP response,
+ *   i.e. its route and normalised query. Requests with longer keys are not
+ *   cached.
+ */
+#ifndef emberCACHE_KEY_SIZE
+#define emberCACHE_KEY_SIZE        (96)
+#endif
+
+/**
+ * @def emberCACHE_MAX_SIZE
+ * @brief The maximum size (in bytes, including headers) of a cached HTTP
+ *   response. Larger responses are not cached.
+ */
+#ifndef emberCACHE_MAX_SIZE
+#define emberCACHE_MAX_SIZE        (emberTCP_SND_BUFFER_SIZE)
+#endif
+
+/**
+ * @def emberJSON_TOKENS
+ * @brief The number of tokens (values and keys) in the JSON index built for
+ *   each websocket text message and `application/json` HTTP request body. If
+ *   0, no index is built.
+ */
+#ifndef emberJSON_TOKENS
+#define emberJSON_TOKENS           (32)
+#endif
+
+/**
+ * @def emberJSON_KEYS
+ * @brief The number of top-level keys of a JSON text that are found without a
+ *   search. Must be a power of 2.
+ */
+#ifndef emberJSON_KEYS
+#define emberJSON_KEYS             (8)
+#endif
+
+/**
+ * @def emberJSON_MAX_DEPTH
+ * @brief The maximum nesting depth of objects and arrays in a JSON text
+ */
+#ifndef emberJSON_MAX_DEPTH
+#define emberJSON_MAX_DEPTH        (8)
+#endif
+
+/**
+ * @def emberBULK_PASS_BUDGET
+ * @brief The approximate number of bytes that all of the bulk priority clients
+ * together will transfer in each pass of the EMBER task, after the interactive
+ * and normal priority clients have been served.
+ */
+#ifndef emberBULK_PASS_BUDGET
+#define emberBULK_PASS_BUDGET      (8*1024)
+#endif
+
+/**
+ * @def emberHTTP2_MAX_STREAMS
+ * @brief The maximum number of concurrent streams of each HTTP/2 (cleartext)
+ *   connection. Each open stream is allocated on demand. If 0, HTTP/2 is not
+ *   supported, and requests to upgrade to it are served as HTTP/1.1.
+ */
+#ifndef emberHTTP2_MAX_STREAMS
+#define emberHTTP2_MAX_STREAMS     (0)
+#endif
+
+/**
+ * @def emberHTTP2_HEADER_SIZE
+ * @brief The maximum size (in bytes) of the HPACK-encoded header block of an
+ *   HTTP/2 request, and of the encoded headers of each response on a stream.
+ *   Requests with larger header blocks are refused with a 431 response.
+ */
+#ifndef emberHTTP2_HEADER_SIZE
+#define emberHTTP2_HEADER_SIZE     (1024)
+#endif
+
+/**
+ * @def emberHTTP2_HPACK_TABLE_SIZE
+ * @brief The size (in bytes) of the HPACK dynamic table of each HTTP/2
+ *   connection, in which the fields that a client indexes are kept. It must be
+ *   at least 4096, the size that a client may use before it has received the
+ *   server's settings. If 0, no table is kept, and a client that refers to the
+ *   table before it has received the server's setting of 0 is disconnected.
+ */
+#ifndef emberHTTP2_HPACK_TABLE_SIZE
+#define emberHTTP2_HPACK_TABLE_SIZE (4096)
+#endif
+
+/**
+ * @def emberDEFLATE_WINDOW_BITS
+ * @brief The log2 of the window of the streaming compressor used for
+ *   compressed responses, from 8 to 14. Each compressed response allocates
+ *   about 3 times the window, plus the hash table and output buffer, while it
+ *   is sent.
+ */
+#ifndef emberDEFLATE_WINDOW_BITS
+#define emberDEFLATE_WINDOW_BITS   (10)
+#endif
+
+/**
+ * @def emberDEFLATE_HASH_BITS
+ * @brief The log2 of the number of hash chains searched by the streaming
+ *   compressor for matches.
+ */
+#ifndef emberDEFLATE_HASH_BITS
+#define emberDEFLATE_HASH_BITS     (9)
+#endif
+
+/**
+ * @def emberDEFLATE_CHAIN_LENGTH
+ * @brief The maximum number of earlier positions compared by the streaming
+ *   compressor when looking for a match; more is slower, but may compress
+ *   better.
+ */
+#ifndef emberDEFLATE_CHAIN_LENGTH
+#define emberDEFLATE_CHAIN_LENGTH  (8)
+#endif
+
+
+/**
+ * @def emberHTTP_OFFLOAD_WORKERS
+ * @brief The number of worker tasks that call the handlers of routes with the
+ *   `eRouteOption_Offload` option, so that slow handlers do not block the EMBER
+ *   task. If 0, no workers are started and those handlers are called by the
+ *   EMBER task.
+ */
+#ifndef emberHTTP_OFFLOAD_WORKERS
+#define emberHTTP_OFFLOAD_WORKERS  (0)
+#endif
+
+/**
+ * @def emberHTTP_OFFLOAD_STACK_SIZE
+ * @brief The size (in bytes) of each worker task's stack
+ */
+#ifndef emberHTTP_OFFLOAD_STACK_SIZE
+#define emberHTTP_OFFLOAD_STACK_SIZE (2048)
+#endif
+
+/**
+ * @def emberHTTP_OFFLOAD_PRIORITY
+ * @brief The priority of the worker tasks. Should not be above the priority
+ *   of the EMBER task, so that a busy handler does not delay the network.
+ */
+#ifndef emberHTTP_OFFLOAD_PRIORITY
+#define emberHTTP_OFFLOAD_PRIORITY (tskIDLE_PRIORITY)
+#endif
+
+/**
+ * @def emberHTTP_OFFLOAD_QUEUE_LENGTH
+ * @brief The maximum number of offloaded requests that are queued for, or
+ *   being handled by, the worker tasks. Further requests are refused with a 503
+ *   response. Each allocates a copy of the client and of the server's buffers,
+ *   and `emberHTTP_OFFLOAD_RESPONSE_SIZE` bytes, until its response is written.
+ */
+#ifndef emberHTTP_OFFLOAD_QUEUE_LENGTH
+#define emberHTTP_OFFLOAD_QUEUE_LENGTH (4)
+#endif
+
+/**
+ * @def emberHTTP_OFFLOAD_RESPONSE_SIZE
+ * @brief The maximum size (in bytes) of the complete response, headers
+ *   included, of an offloaded handler. A larger response fails with a 500
+ *   response.
+ */
+#ifndef emberHTTP_OFFLOAD_RESPONSE_SIZE
+#define emberHTTP_OFFLOAD_RESPONSE_SIZE (emberTCP_SND_BUFFER_SIZE)
+#endif
+
+
+/**
+ * @def emberHTTP_FILTER_BLOCK_SIZE
+ * @brief The size (in bytes) of the block, on the EMBER task's stack, in which
+ *   a template is rendered for the body filters of its route.
+ */
+#ifndef emberHTTP_FILTER_BLOCK_SIZE
+#define emberHTTP_FILTER_BLOCK_SIZE (256)
+#endif
+
 
 #endif /* _EMBER_CONFIG_DEFAULTS_H_ */
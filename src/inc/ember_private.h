@@ -53,6 +53,7 @@
 #include <FreeRTOS_IP.h>
 #include <ff_stdio.h>
 #include "./ember.h"
+#include "./json.h"
 
 /*===============================================
  public constants
@@ -60,6 +61,11 @@
 
 #define	FREERTOS_NO_SOCKET					(0)
 
+/* The maximum number of characters written by `uxEmberUtoa` */
+#define emberUTOA_MAX_LEN           (sizeof(size_t) * 3)
+/* The maximum number of characters written by `uxEmberUtoHex` */
+#define emberUTOHEX_MAX_LEN         (sizeof(size_t) * 2)
+
 #define TCP_CLIENT_PROPERTIES        \
 	struct xTCP_SERVER *pxParent;      \
 	Socket_t xSock;                   \
@@ -67,7 +73,14 @@
 	xTCPClientWorker xWork;            \
 	xTCPClientDelete xDelete;          \
 	struct xTCP_CLIENT *pxPrevClient;  \
-	struct xTCP_CLIENT *pxNextClient
+	struct xTCP_CLIENT *pxNextClient;  \
+	struct xOUTPUT_BLOCK *pxOutputHead; \
+	struct xOUTPUT_BLOCK *pxOutputTail; \
+	size_t uxOutputQueued;             \
+	struct xOUTPUT_TAP *pxOutputTap;   \
+	xTCPClientOutput xOutput;          \
+	BaseType_t xPriority;              \
+	uint32_t ulRemoteAddress
 
 /*===============================================
  public data prototypes
@@ -77,9 +90,39 @@
  * GENERIC TCP CLIENT DEFINITIONS
  * -----------------------------------------**/
 
+/**
+ * @struct xOUTPUT_BLOCK
+ * @brief A block of data written to a client that could not yet be sent,
+ *   queued until the socket becomes writable.
+ */
+struct xOUTPUT_BLOCK {
+	struct xOUTPUT_BLOCK *pxNext;
+	size_t uxLen;
+	size_t uxOffset;
+	char pcData[];
+};
+typedef struct xOUTPUT_BLOCK OutputBlock_t;
+
+/**
+ * @struct xOUTPUT_TAP
+ * @brief A copy of the data written to a client since `pxEmberTapStart`, e.g.
+ *   to be cached. `xOverflow` is set if the data did not fit in `pcData`, or if
+ *   any of it was sent without passing through `xEmberWrite`.
+ */
+struct xOUTPUT_TAP {
+	size_t uxLen;
+	size_t uxMax;
+	BaseType_t xOverflow;
+	char pcData[];
+};
+typedef struct xOUTPUT_TAP OutputTap_t;
+
 typedef BaseType_t (*xTCPClientCreate)(void*);
 typedef BaseType_t (*xTCPClientWorker)(void*);
 typedef BaseType_t (*xTCPClientDelete)(void*);
+/* If set, data written to a client is passed to its `xOutput` instead of its
+ * socket, e.g. for a stream that is multiplexed onto another connection */
+typedef BaseType_t (*xTCPClientOutput)(void*, const char*, size_t);
 
 struct xTCP_CLIENT {
 	TCP_CLIENT_PROPERTIES
@@ -91,6 +134,45 @@ typedef struct xTCP_CLIENT TCPClient_t;
  * GENERIC TCP SERVER DEFINITIONS
  * -----------------------------------------**/
 
+/**
+ * @struct xRATE_LIMIT
+ * @brief A token bucket rate limit, applied separately to each remote IP
+ *   address. Each connection or request consumes a token; tokens are restored
+ *   at `usPerSecond`, up to a maximum of `usBurst`.
+ */
+struct xRATE_LIMIT {
+	uint16_t usPerSecond;
+	uint16_t usBurst;
+};
+typedef struct xRATE_LIMIT RateLimit_t;
+
+/**
+ * @struct xRATE_BUCKET
+ * @brief The token bucket of one remote IP address for one `RateLimit_t`.
+ *   Tokens are held as credit in ticks, so that refilling a bucket is a
+ *   subtraction of tick counts.
+ */
+struct xRATE_BUCKET {
+	const RateLimit_t *pxLimit;
+	uint32_t ulAddress;
+	TickType_t xLastTick;
+	TickType_t xCredit;
+};
+typedef struct xRATE_BUCKET RateBucket_t;
+
+/**
+ * @enum eEmberPriority
+ * @brief Enumeration of the priority classes of client connections. In each
+ *   pass of the EMBER task, interactive clients are served first, then normal
+ *   clients, then bulk clients, whose file transfers share a budget of
+ *   `emberBULK_PASS_BUDGET` bytes per pass.
+ */
+typedef enum {
+	ePriority_Normal = 0,   /**< ePriority_Normal */
+	ePriority_Interactive,  /**< ePriority_Interactive */
+	ePriority_Bulk,         /**< ePriority_Bulk */
+} eEmberPriority;
+
 struct xWEBPROTO_SERVER {
 	struct xTCP_SERVER *pxParent;
 	const char *pcRootDir;
@@ -99,6 +181,8 @@ struct xWEBPROTO_SERVER {
 	xTCPClientWorker xWorker;
 	xTCPClientDelete xDelete;
 	Socket_t xSock;
+	const RateLimit_t *pxRateLimit;
+	BaseType_t xPriority;
 };
 typedef struct xWEBPROTO_SERVER WebProtoServer_t;
 
@@ -110,6 +194,22 @@ struct xTCP_SERVER {
 	char pcContentsType[40];
 	SemaphoreHandle_t xClientMutex;
 	TCPClient_t *pxClients;
+	/* The client (if any) whose writes are being collected in `pcSndBuff` */
+	TCPClient_t *pxCorkClient;
+	size_t uxCorkLen;
+	/* The transfer budget of each bulk client in the current pass */
+	size_t uxBulkShare;
+#if (emberJSON_TOKENS > 0)
+	/* The index of a JSON payload in `pcRcvBuff`, built before its handler is
+	 * called */
+	JsonIndex_t xJsonIndex;
+	JsonToken_t pxJsonTokens[emberJSON_TOKENS];
+#endif
+#if (emberRATE_LIMIT_BUCKETS > 0)
+	/* Token buckets of recently seen remote addresses, hashed by address and
+	 * limit */
+	RateBucket_t pxBuckets[emberRATE_LIMIT_BUCKETS];
+#endif
 	size_t uxNumProtocols;
 	/* The `protocols` field _must_ be the last field for this struct, as the array
 	 * may be increased in size.*/
@@ -125,6 +225,9 @@ struct xWEBPROTO_CONFIG {
 	xTCPClientCreate xCreator;
 	xTCPClientWorker xWorker;
 	xTCPClientDelete xDelete;
+	const RateLimit_t *pxRateLimit;
+	/* The priority class of the protocol's clients, per `eEmberPriority` */
+	BaseType_t xPriority;
 };
 typedef struct xWEBPROTO_CONFIG WebProtoConfig_t;
 
@@ -134,8 +237,350 @@ struct xTCP_SERVER_CONFIG {
 };
 typedef struct xTCP_SERVER_CONFIG TCPServerConfig_t;
 
+/**
+ * @enum eFileTxOptions
+ * @brief Enumeration of bit flag options for `xEmberSendFile`.
+ */
+typedef enum {
+	eFileTx_None = 0,            /**< eFileTx_None */
+	eFileTx_CloseAfterSend = 1,  /**< eFileTx_CloseAfterSend */
+} eFileTxOptions;
+
+/**
+ * @enum eReadAheadState
+ * @brief Enumeration of the states of a read-ahead buffer.
+ */
+typedef enum {
+	eReadAhead_Empty = 0,  /**< eReadAhead_Empty */
+	eReadAhead_Pending,    /**< eReadAhead_Pending */
+	eReadAhead_Ready,      /**< eReadAhead_Ready */
+	eReadAhead_Error,      /**< eReadAhead_Error */
+} eReadAheadState;
+
+/**
+ * @struct xREADAHEAD_BUFFER
+ * @brief One of the two buffers of a `FileReadAhead_t`. `xState` is written by
+ *   the EMBER task when a read is requested, and by the I/O task when the read
+ *   completes.
+ */
+struct xREADAHEAD_BUFFER {
+	volatile BaseType_t xState;
+	size_t uxLen;
+	size_t uxOffset;
+	char pcData[emberFILE_READAHEAD_SIZE];
+};
+
+/**
+ * @struct xFILE_READAHEAD
+ * @brief Double-buffered read-ahead state for a single file transfer. Owns the
+ *   file, which is closed when the last reference is released.
+ */
+struct xFILE_READAHEAD {
+	FF_FILE *pxFile;
+	size_t uxUnrequested;
+	UBaseType_t uxRefs;
+	volatile BaseType_t xCancelled;
+	BaseType_t xCurrent;
+	BaseType_t xNextRequest;
+	struct xREADAHEAD_BUFFER pxBuffers[2];
+};
+typedef struct xFILE_READAHEAD FileReadAhead_t;
+
 /*===============================================
  public function prototypes
  ===============================================*/
 
+/**
+ * @fn BaseType_t xEmberSendFile(TCPServer_t*, Socket_t, FF_FILE*, size_t*,
+ *   const size_t, const UBaseType_t)
+ * @brief Transmit the next part of an open file. Data is read from the
+ *   filesystem, in sector-aligned blocks, directly into the socket's transmit
+ *   stream. The server's `pcSndBuff` is used only when the free space at the
+ *   head of the transmit stream is smaller than a sector.
+ *
+ * @post `eSELECT_WRITE` is set on the socket if bytes remain to be sent and
+ *   the socket did not fail, and cleared otherwise. The file is not closed.
+ * @param pxServer The server that owns the socket.
+ * @param xSock The socket to transmit on.
+ * @param pxFile The (open) file to transmit.
+ * @param puxBytesLeft The number of bytes left to transmit. Decremented by the
+ *   number of bytes read from the file.
+ * @param uxBudget The approximate number of bytes to transmit before returning,
+ *   allowing other clients to be serviced.
+ * @param uxOpts Options, per `eFileTxOptions`.
+ * @return
+ *   < 0 if an error occurred (-pdFREERTOS_ERRNO_EIO for a short file read)
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xEmberSendFile(
+	TCPServer_t *pxServer,
+	Socket_t xSock,
+	FF_FILE *pxFile,
+	size_t *puxBytesLeft,
+	const size_t uxBudget,
+	const UBaseType_t uxOpts);
+
+/**
+ * @fn BaseType_t xEmberSendMemory(TCPServer_t*, Socket_t, const uint8_t**,
+ *   size_t*, const size_t)
+ * @brief Transmit the next part of a block of memory, e.g. a file in a ROM
+ *   filesystem image. Data is copied from its location, e.g. memory-mapped
+ *   flash, directly into the socket's transmit stream, without any
+ *   intermediate buffer.
+ *
+ * @post `eSELECT_WRITE` is set on the socket if bytes remain to be sent and
+ *   the socket did not fail, and cleared otherwise.
+ * @param pxServer The server that owns the socket.
+ * @param xSock The socket to transmit on.
+ * @param ppucData The data left to transmit. Advanced by the number of bytes
+ *   transmitted.
+ * @param puxBytesLeft The number of bytes left to transmit. Decremented by the
+ *   number of bytes transmitted.
+ * @param uxBudget The approximate number of bytes to transmit before returning,
+ *   allowing other clients to be serviced.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xEmberSendMemory(
+	TCPServer_t *pxServer,
+	Socket_t xSock,
+	const uint8_t **ppucData,
+	size_t *puxBytesLeft,
+	const size_t uxBudget);
+
+/**
+ * @fn size_t uxEmberTxBudget(const TCPClient_t*, const size_t)
+ * @brief Limit the number of bytes that a client may transfer before
+ *   switching to another client. Bulk clients share `emberBULK_PASS_BUDGET`
+ *   bytes per pass of the EMBER task; other clients are not limited.
+ *
+ * @param pxClient The client.
+ * @param uxBudget The number of bytes the client would transfer, e.g.
+ *   `emberHTTP_FILE_CHUNK_SIZE`.
+ * @return The number of bytes the client may transfer in this pass.
+ */
+size_t uxEmberTxBudget(const TCPClient_t *pxClient, const size_t uxBudget);
+
+/**
+ * @fn BaseType_t xEmberIOInit(void)
+ * @brief Start the file I/O task if it is not running. Called by the EMBER
+ *   task when `emberFILE_IO_TASK` is enabled.
+ *
+ * @return pdTRUE if the I/O task is running, pdFALSE otherwise.
+ */
+BaseType_t xEmberIOInit(void);
+
+/**
+ * @fn FileReadAhead_t* pxEmberReadAheadStart(FF_FILE*, const size_t)
+ * @brief Start reading an open file ahead of transmission, via the file I/O
+ *   task.
+ *
+ * @post If successful, the read-ahead owns `pxFile`, which must not be read or
+ *   closed by the caller.
+ * @param pxFile The (open) file to read, positioned at the first byte to read.
+ * @param uxBytes The number of bytes to read.
+ * @return The read-ahead state, or NULL if the I/O task is not running or no
+ *   memory was available, in which case the caller still owns `pxFile`.
+ */
+FileReadAhead_t *pxEmberReadAheadStart(FF_FILE *pxFile, const size_t uxBytes);
+
+/**
+ * @fn void vEmberReadAheadStop(FileReadAhead_t*)
+ * @brief Stop a read-ahead. The read-ahead, and its file, are freed as soon as
+ *   the I/O task has finished with them.
+ *
+ * @param pxReadAhead The read-ahead to stop.
+ */
+void vEmberReadAheadStop(FileReadAhead_t *pxReadAhead);
+
+/**
+ * @fn BaseType_t xEmberSendReadAhead(TCPServer_t*, Socket_t, FileReadAhead_t*,
+ *   size_t*, const size_t, const UBaseType_t)
+ * @brief As `xEmberSendFile`, but transmits only data that the file I/O task
+ *   has already read. Never blocks on storage.
+ *
+ * @param pxServer The server that owns the socket.
+ * @param xSock The socket to transmit on.
+ * @param pxReadAhead The read-ahead to transmit from.
+ * @param puxBytesLeft The number of bytes left to transmit. Decremented by the
+ *   number of bytes transmitted.
+ * @param uxBudget The approximate number of bytes to transmit before returning.
+ * @param uxOpts Options, per `eFileTxOptions`.
+ * @return
+ *   < 0 if an error occurred (-pdFREERTOS_ERRNO_EIO for a failed file read)
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xEmberSendReadAhead(
+	TCPServer_t *pxServer,
+	Socket_t xSock,
+	FileReadAhead_t *pxReadAhead,
+	size_t *puxBytesLeft,
+	const size_t uxBudget,
+	const UBaseType_t uxOpts);
+
+/**
+ * @fn void vEmberCork(TCPClient_t*)
+ * @brief Start collecting writes made by a client with `xEmberWrite` in the
+ *   server's `pcSndBuff`, so that they can be transmitted together by
+ *   `xEmberFlush`. Only one client can be corked at a time, and only from the
+ *   EMBER task. Any previously corked client is flushed first.
+ *
+ * @note While a client is corked, `pcSndBuff` must not be used for any other
+ *   purpose without first calling `xEmberFlush`.
+ * @param pxClient The client to cork.
+ */
+void vEmberCork(TCPClient_t *pxClient);
+
+/**
+ * @fn BaseType_t xEmberWrite(TCPClient_t*, const void*, const size_t)
+ * @brief Write data to a client. If the client is corked, the data is
+ *   collected in `pcSndBuff`, which is flushed whenever it fills. Otherwise,
+ *   the data is sent immediately. Never blocks: any data that does not fit in
+ *   the socket's transmit stream is added to the client's output queue, which
+ *   is drained by the EMBER task when the socket becomes writable.
+ *
+ * @param pxClient The client to write to.
+ * @param pvData The data to write.
+ * @param uxLen The number of bytes to write.
+ * @return
+ *   < 0 if an error occurred (-pdFREERTOS_ERRNO_ENOBUFS if the output queue
+ *       is full)
+ *   = 0 if no error occurred and no data was written
+ *   > 0 the number of bytes written
+ */
+BaseType_t xEmberWrite(
+	TCPClient_t *pxClient,
+	const void *pvData,
+	const size_t uxLen);
+
+/**
+ * @fn BaseType_t xEmberFlush(TCPClient_t*)
+ * @brief Transmit any writes collected for a corked client, and uncork it.
+ *   Does nothing if the client is not corked.
+ *
+ * @param pxClient The client to flush.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xEmberFlush(TCPClient_t *pxClient);
+
+/**
+ * @fn BaseType_t xEmberDrain(TCPClient_t*)
+ * @brief Transmit as much of a client's output queue as the socket will
+ *   accept. Called by the EMBER task before a client's worker; the worker is
+ *   not called until the queue is empty.
+ *
+ * @post `eSELECT_WRITE` is set on the socket if the queue is not empty, and
+ *   cleared otherwise.
+ * @param pxClient The client.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xEmberDrain(TCPClient_t *pxClient);
+
+/**
+ * @fn void vEmberDiscardOutput(TCPClient_t*)
+ * @brief Free a client's output queue without transmitting it, and any
+ *   output tap.
+ *
+ * @param pxClient The client.
+ */
+void vEmberDiscardOutput(TCPClient_t *pxClient);
+
+/**
+ * @fn char* pcEmberCorkTail(TCPClient_t*, size_t*)
+ * @brief Get the position in `pcSndBuff` at which the next corked write for a
+ *   client would be placed, so that data can be constructed in place. The data
+ *   is committed with `vEmberCorkAdvance`.
+ *
+ * @param pxClient The client.
+ * @param puxSpace Set to the number of bytes available at the returned
+ *   position.
+ * @return The write position, or NULL if the client is not corked.
+ */
+char* pcEmberCorkTail(TCPClient_t *pxClient, size_t *puxSpace);
+
+/**
+ * @fn void vEmberCorkAdvance(TCPClient_t*, const size_t)
+ * @brief Commit data constructed in place at `pcEmberCorkTail`.
+ *
+ * @param pxClient The client, which must be corked.
+ * @param uxLen The number of bytes constructed. Must not exceed the space
+ *   reported by `pcEmberCorkTail`.
+ */
+void vEmberCorkAdvance(TCPClient_t *pxClient, const size_t uxLen);
+
+/**
+ * @fn OutputTap_t* pxEmberTapStart(TCPClient_t*, const size_t)
+ * @brief Start copying the data written to a client, as it is handed to the
+ *   TCP stack or queued, into a new `OutputTap_t`. Data still corked is copied
+ *   when it is flushed.
+ *
+ * @param pxClient The client.
+ * @param uxMax The maximum number of bytes to copy.
+ * @return The tap, or NULL if it could not be allocated.
+ */
+OutputTap_t* pxEmberTapStart(TCPClient_t *pxClient, const size_t uxMax);
+
+/**
+ * @fn void vEmberTapStop(TCPClient_t*)
+ * @brief Stop copying the data written to a client, and free its tap. Does
+ *   nothing if the client has no tap.
+ *
+ * @param pxClient The client.
+ */
+void vEmberTapStop(TCPClient_t *pxClient);
+
+/**
+ * @fn size_t uxEmberUtoa(char*, size_t)
+ * @brief Format an unsigned integer as decimal digits. A faster alternative to
+ *   `snprintf("%u")` for lengths and counts.
+ *
+ * @param pcDst The destination, with space for at least `emberUTOA_MAX_LEN`
+ *   characters. No terminating NUL is written.
+ * @param uxValue The value to format.
+ * @return The number of characters written.
+ */
+size_t uxEmberUtoa(char *pcDst, size_t uxValue);
+
+/**
+ * @fn size_t uxEmberUtoHex(char*, size_t)
+ * @brief Format an unsigned integer as lowercase hexadecimal digits, without
+ *   leading zeros, e.g. for HTTP chunk sizes.
+ *
+ * @param pcDst The destination, with space for at least `emberUTOHEX_MAX_LEN`
+ *   characters. No terminating NUL is written.
+ * @param uxValue The value to format.
+ * @return The number of characters written.
+ */
+size_t uxEmberUtoHex(char *pcDst, size_t uxValue);
+
+/**
+ * @fn BaseType_t xEmberRateLimit(TCPServer_t*, const uint32_t,
+ *   const RateLimit_t*)
+ * @brief Take a token from the bucket of a remote address for a rate limit.
+ *   Buckets are held in a small fixed-size hash table; when it is full, the
+ *   least recently used bucket in the probe sequence is reused, so a large
+ *   number of distinct addresses weakens, but does not disable, the limit.
+ *
+ * @note Must only be called from the EMBER task.
+ * @param pxServer The server.
+ * @param ulAddress The remote IPv4 address.
+ * @param pxLimit The rate limit, or NULL for no limit.
+ * @return pdTRUE if a token was taken (or there is no limit), pdFALSE if the
+ *   address has exceeded the limit.
+ */
+BaseType_t xEmberRateLimit(
+	TCPServer_t *pxServer,
+	const uint32_t ulAddress,
+	const RateLimit_t *pxLimit);
+
 #endif /* EMBER_V0_0_INC_EMBER_PRIVATE_H_ */
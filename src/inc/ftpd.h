@@ -87,6 +87,7 @@ struct xFTP_CLIENT
 	FF_FindData_t xFindData;
 	FF_FILE *pxReadHandle;
 	FF_FILE *pxWriteHandle;
+	FileReadAhead_t *pxReadAhead; /* Set instead of pxReadHandle when the file I/O task reads the file */
 	char pcCurrentDir[ffconfigMAX_FILENAME];
 	char pcFileName[ffconfigMAX_FILENAME];
 	char pcConnectionAck[ffconfigMAX_FILENAME];
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef EMBER_V0_0_INC_HPACK_H_
+#define EMBER_V0_0_INC_HPACK_H_
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*===============================================
+ public constants
+ ===============================================*/
+
+/* The number of entries in the HPACK static table */
+#define HPACK_STATIC_ENTRIES      (61)
+/* The length of the longest code of the HPACK Huffman code */
+#define HPACK_HUFFMAN_MAX_BITS    (30)
+/* The size of the dynamic table that an encoder may use until the decoder's
+ * SETTINGS_HEADER_TABLE_SIZE has reached it (RFC 7540, section 6.5.2) */
+#define HPACK_DEFAULT_TABLE_SIZE  (4096)
+/* The overhead of each dynamic table entry, added to the lengths of its name
+ * and value to give its size (RFC 7541, section 4.1) */
+#define HPACK_ENTRY_OVERHEAD      (32)
+
+/*===============================================
+ public data prototypes
+ ===============================================*/
+
+/**
+ * @fn BaseType_t (xHpackField)(void*, const char*, size_t, const char*, size_t)
+ * @brief Signature for functions that receive the fields of a decoded HPACK
+ *   header block, in order. The name and value are not NUL-terminated, and are
+ *   only valid until the function returns. A negative return stops decoding.
+ */
+typedef BaseType_t (xHpackField)(
+	void *pvArg,
+	const char *pcName,
+	size_t uxNameLen,
+	const char *pcValue,
+	size_t uxValueLen);
+
+/**
+ * @struct xHPACK_TABLE
+ * @brief The dynamic table of an HPACK decoder. The entries are kept in
+ *   `pucData`, oldest first, each as the lengths of its name and value
+ *   followed by the name and the value. That is less than the overhead that
+ *   RFC 7541 counts for an entry, so `pucData` need only be as large as the
+ *   largest table size that the encoder may set.
+ */
+struct xHPACK_TABLE
+{
+	uint8_t *pucData;
+	/* The size of `pucData`, which is the largest table size allowed */
+	size_t uxCapacity;
+	/* The table size last set by the encoder */
+	size_t uxMaxSize;
+	/* The size of the entries, as RFC 7541 counts it */
+	size_t uxSize;
+	/* The number of entries, and the bytes of `pucData` that they occupy */
+	size_t uxEntries;
+	size_t uxUsed;
+};
+typedef struct xHPACK_TABLE HpackTable_t;
+
+/*===============================================
+ public function prototypes
+ ===============================================*/
+
+/**
+ * @fn void vHpackTableInit(HpackTable_t*, uint8_t*, size_t)
+ * @brief Start an empty dynamic table, of the default size, or of `uxCapacity`
+ *   if that is smaller.
+ *
+ * @param pxTable The table.
+ * @param pucData The space for the table's entries.
+ * @param uxCapacity The size of `pucData`, and so the largest size to which
+ *   the encoder may set the table.
+ */
+void vHpackTableInit(HpackTable_t *pxTable, uint8_t *pucData, size_t uxCapacity);
+
+/**
+ * @fn void vHpackTableCopy(HpackTable_t*, const HpackTable_t*)
+ * @brief Copy the entries and size of a dynamic table to another, which keeps
+ *   its own space for them and must be at least as large.
+ *
+ * @param pxDst The table copied to.
+ * @param pxSrc The table copied.
+ */
+void vHpackTableCopy(HpackTable_t *pxDst, const HpackTable_t *pxSrc);
+
+/**
+ * @fn void vHpackTableClear(HpackTable_t*)
+ * @brief Remove every entry of a dynamic table, e.g. when a header block
+ *   could not be decoded, so that its entries are unknown. The entries that
+ *   the encoder adds later are still found at the indices that it uses, since
+ *   these count from the newest entry; a field that refers to one of the
+ *   entries that were removed cannot be decoded.
+ *
+ * @param pxTable The table.
+ */
+void vHpackTableClear(HpackTable_t *pxTable);
+
+/**
+ * @fn BaseType_t xHpackDecode(HpackTable_t*, const uint8_t*, size_t, char*,
+ *   size_t, xHpackField*, void*)
+ * @brief Decode an HPACK (RFC 7541) header block, adding the fields that the
+ *   encoder indexes to the dynamic table `pxTable`. Without a table, a field
+ *   that refers to the dynamic table cannot be decoded. Huffman-coded strings
+ *   are decoded into `pcScratch`.
+ *
+ * @param pxTable The dynamic table, or NULL.
+ * @param pucBlock The header block.
+ * @param uxLen The length of the header block.
+ * @param pcScratch Space for one decoded name and value.
+ * @param uxScratchSz The size of `pcScratch`.
+ * @param pxField The function that receives each field.
+ * @param pvArg The first argument of `pxField`.
+ * @return
+ *   < 0 if the block is malformed or refers to an entry that is not in the
+ *     dynamic table (-pdFREERTOS_ERRNO_EINVAL), a string, or a name from the
+ *     dynamic table that is indexed again, does not fit in `pcScratch`
+ *     (-pdFREERTOS_ERRNO_ENOBUFS), or `pxField` failed (its return value)
+ *   >= 0 the number of fields decoded
+ */
+BaseType_t xHpackDecode(
+	HpackTable_t *pxTable,
+	const uint8_t *pucBlock,
+	size_t uxLen,
+	char *pcScratch,
+	size_t uxScratchSz,
+	xHpackField *pxField,
+	void *pvArg);
+
+/**
+ * @fn size_t uxHpackEncode(uint8_t*, size_t, const char*, size_t,
+ *   const char*, size_t)
+ * @brief Encode a header field, without Huffman coding and without adding it
+ *   to the decoder's dynamic table. A field that is in the static table is
+ *   encoded as its index, and a name that is in the static table as its index
+ *   and a literal value.
+ *
+ * @param pucDst The destination.
+ * @param uxSpace The space at `pucDst`.
+ * @param pcName The name, which must be lowercase.
+ * @param uxNameLen The length of the name.
+ * @param pcValue The value.
+ * @param uxValueLen The length of the value.
+ * @return The number of bytes written, or 0 if the field did not fit.
+ */
+size_t uxHpackEncode(
+	uint8_t *pucDst,
+	size_t uxSpace,
+	const char *pcName,
+	size_t uxNameLen,
+	const char *pcValue,
+	size_t uxValueLen);
+
+#endif /* EMBER_V0_0_INC_HPACK_H_ */
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef EMBER_V0_0_INC_HTTP2_H_
+#define EMBER_V0_0_INC_HTTP2_H_
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include "./ember_private.h"
+#include "./httpd.h"
+#include "./hpack.h"
+
+/*===============================================
+ public constants
+ ===============================================*/
+
+#define HTTP2_CREATOR_METHOD (NULL)
+#define HTTP2_WORKER_METHOD (xHttp2Work)
+#define HTTP2_DELETE_METHOD (xHttp2Delete)
+
+/* The size of the header of every HTTP/2 frame */
+#define HTTP2_FRAME_HEADER_SZ     (9)
+/* The size of the connection preface sent by HTTP/2 clients */
+#define HTTP2_PREFACE_SZ          (24)
+/* The default, and smallest, maximum frame payload size */
+#define HTTP2_MAX_FRAME_SZ        (16384)
+/* The initial flow-control window of connections and streams */
+#define HTTP2_DEFAULT_WINDOW      (65535)
+
+/*===============================================
+ public data prototypes
+ ===============================================*/
+
+/**
+ * @enum eHttp2FrameType
+ * @brief Enumeration of HTTP/2 frame types (RFC 7540, section 6).
+ */
+typedef enum
+{
+	eHttp2_Data = 0,           /**< eHttp2_Data */
+	eHttp2_Headers = 1,        /**< eHttp2_Headers */
+	eHttp2_Priority = 2,       /**< eHttp2_Priority */
+	eHttp2_RstStream = 3,      /**< eHttp2_RstStream */
+	eHttp2_Settings = 4,       /**< eHttp2_Settings */
+	eHttp2_PushPromise = 5,    /**< eHttp2_PushPromise */
+	eHttp2_Ping = 6,           /**< eHttp2_Ping */
+	eHttp2_Goaway = 7,         /**< eHttp2_Goaway */
+	eHttp2_WindowUpdate = 8,   /**< eHttp2_WindowUpdate */
+	eHttp2_Continuation = 9,   /**< eHttp2_Continuation */
+} eHttp2FrameType;
+
+/**
+ * @enum eHttp2FrameFlags
+ * @brief Enumeration of the HTTP/2 frame flags used by EMBER.
+ */
+typedef enum
+{
+	eHttp2Flag_EndStream = 0x1,    /**< eHttp2Flag_EndStream, also ACK */
+	eHttp2Flag_EndHeaders = 0x4,   /**< eHttp2Flag_EndHeaders */
+	eHttp2Flag_Padded = 0x8,       /**< eHttp2Flag_Padded */
+	eHttp2Flag_Priority = 0x20,    /**< eHttp2Flag_Priority */
+} eHttp2FrameFlags;
+
+/**
+ * @enum eHttp2Error
+ * @brief Enumeration of the HTTP/2 error codes used by EMBER.
+ */
+typedef enum
+{
+	eHttp2Error_None = 0,            /**< eHttp2Error_None */
+	eHttp2Error_Protocol = 1,        /**< eHttp2Error_Protocol */
+	eHttp2Error_Internal = 2,        /**< eHttp2Error_Internal */
+	eHttp2Error_FlowControl = 3,     /**< eHttp2Error_FlowControl */
+	eHttp2Error_FrameSize = 6,       /**< eHttp2Error_FrameSize */
+	eHttp2Error_RefusedStream = 7,   /**< eHttp2Error_RefusedStream */
+	eHttp2Error_Compression = 9,     /**< eHttp2Error_Compression */
+} eHttp2Error;
+
+/**
+ * @enum eHttp2StreamState
+ * @brief Enumeration of the states of an HTTP/2 stream.
+ */
+typedef enum
+{
+	eStream_Request = 0,   /**< eStream_Request: receiving the request */
+	eStream_Ready,         /**< eStream_Ready: waiting to be served */
+	eStream_Response,      /**< eStream_Response: being served by httpd */
+} eHttp2StreamState;
+
+/**
+ * @enum eHttp2ResponseState
+ * @brief Enumeration of the states of the translation of an HTTP/1.1 response
+ *   into HTTP/2 frames.
+ */
+typedef enum
+{
+	eResponse_Head = 0,    /**< eResponse_Head: collecting the headers */
+	eResponse_Body,        /**< eResponse_Body: the body, as is */
+	eResponse_ChunkSize,   /**< eResponse_ChunkSize: a chunk's size line */
+	eResponse_ChunkData,   /**< eResponse_ChunkData: a chunk's data */
+	eResponse_ChunkEnd,    /**< eResponse_ChunkEnd: the CRLF after a chunk */
+	eResponse_Trailer,     /**< eResponse_Trailer: the chunked trailer */
+	eResponse_Done,        /**< eResponse_Done: the whole body was seen */
+} eHttp2ResponseState;
+
+/**
+ * @struct xHTTP2_STREAM
+ * @brief An HTTP/2 stream. Each stream is served by httpd as an HTTP client of
+ *   its own: its request is translated to HTTP/1.1 in `pcBuff`, and the
+ *   HTTP/1.1 response that httpd writes to it is passed to its `xOutput`,
+ *   which translates it to HEADERS and DATA frames on the connection. Response
+ *   data that flow control does not yet allow to be sent is queued on the
+ *   stream, so that httpd waits for it as it would for a full socket.
+ */
+struct xHTTP2_STREAM
+{
+	HTTPClient_t xClient;
+	/* --- Keep at the top  --- */
+	struct xHTTP2_CONNECTION *pxConn;
+	uint32_t ulId;
+	int32_t lSendWindow;
+	BaseType_t xState;
+	BaseType_t xResponse;
+	BaseType_t xHeadSent;
+	size_t uxChunkLeft;
+	/* The end of the request headers, and the start of the request body, in
+	 * `pcBuff`; a gap is left between them for a Content-Length header */
+	size_t uxHeadLen;
+	size_t uxBodyLen;
+	/* The length of the request, or of the response headers, in `pcBuff` */
+	size_t uxLen;
+	char pcBuff[emberTCP_RCV_BUFFER_SIZE];
+};
+typedef struct xHTTP2_STREAM Http2Stream_t;
+
+/**
+ * @struct xHTTP2_CONNECTION
+ * @brief The state of an HTTP/2 connection, allocated when the connection is
+ *   converted from HTTP/1.1.
+ */
+struct xHTTP2_CONNECTION
+{
+	/* The connection's client, to which the frames of every stream are written */
+	struct xHTTP2_CLIENT *pxClient;
+	Http2Stream_t *pxStreams[emberHTTP2_MAX_STREAMS];
+	uint32_t ulLastStream;
+	int32_t lSendWindow;
+	int32_t lInitialWindow;
+	uint32_t ulMaxFrame;
+	/* The number of bytes of the client preface still to be received */
+	size_t uxPrefaceLeft;
+	/* The connection error that is reported by GOAWAY, if any */
+	BaseType_t xError;
+	/* The frame being received */
+	BaseType_t xInFrame;
+	uint8_t ucType;
+	uint8_t ucFlags;
+	uint32_t ulStream;
+	size_t uxFrameLen;
+	size_t uxLeft;
+	size_t uxSkip;
+	size_t uxPad;
+	BaseType_t xPadPending;
+	/* The header block being received, if any */
+	uint32_t ulBlockStream;
+	size_t uxBlockLen;
+	BaseType_t xBlockEndStream;
+	BaseType_t xBlockOverflow;
+	size_t uxInLen;
+	size_t uxInPos;
+	uint8_t pucIn[emberTCP_RCV_BUFFER_SIZE];
+	uint8_t pucBlock[emberHTTP2_HEADER_SIZE];
+#if (emberHTTP2_HPACK_TABLE_SIZE > 0)
+	/* The HPACK dynamic table of the client's header blocks */
+	HpackTable_t xTable;
+	uint8_t pucTable[emberHTTP2_HPACK_TABLE_SIZE];
+#endif
+	/* An encoded header block, or the scratch space of the HPACK decoder */
+	uint8_t pucOut[emberHTTP2_HEADER_SIZE];
+};
+typedef struct xHTTP2_CONNECTION Http2Connection_t;
+
+/**
+ * @struct xHTTP2_CLIENT
+ * @brief HTTP/2 connection record. Inherits from `TCPClient_t` via the
+ *   `TCP_CLIENT_PROPERTIES` macro. Like a websocket client, it overwrites what
+ *   was originally an HTTP client struct.
+ */
+struct xHTTP2_CLIENT
+{
+	TCP_CLIENT_PROPERTIES;
+	/* --- Keep at the top  --- */
+	Http2Connection_t *pxConn;
+};
+typedef struct xHTTP2_CLIENT Http2Client_t;
+
+/*===============================================
+ public function prototypes
+ ===============================================*/
+
+/**
+ * @fn BaseType_t xHttp2Upgrade(void*, const char*, size_t)
+ * @brief Convert an HTTP client to an HTTP/2 connection if `pcData`, the data
+ *   that it has received, is the HTTP/2 client preface ("prior knowledge"), or
+ *   a complete request without a body that asks to upgrade to "h2c". Called
+ *   by httpd before a request is parsed.
+ *
+ * @param pxc The HTTP client.
+ * @param pcData The data received.
+ * @param uxLen The length of the data.
+ * @return
+ *   0 if the data is not for HTTP/2, and is to be served as HTTP/1.1
+ *   > 0 the client was converted, and this many bytes were sent to it
+ *   < 0 an error occurred
+ */
+BaseType_t xHttp2Upgrade(void *pxc, const char *pcData, size_t uxLen);
+
+/**
+ * @fn BaseType_t xHttp2Work(void*)
+ * @brief HTTP/2 connection worker method. Receives frames, and serves the
+ *   requests of the connection's streams through httpd.
+ *
+ * @param pxc The HTTP/2 client.
+ * @return < 0 if the connection is to be closed, otherwise >= 0
+ */
+BaseType_t xHttp2Work(void *pxc);
+
+/**
+ * @fn BaseType_t xHttp2Delete(void*)
+ * @brief HTTP/2 connection delete method. Releases the connection's streams.
+ *
+ * @param pxc The HTTP/2 client.
+ * @return 0
+ */
+BaseType_t xHttp2Delete(void *pxc);
+
+#endif /* EMBER_V0_0_INC_HTTP2_H_ */
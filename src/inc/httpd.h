@@ -51,6 +51,11 @@
 
 #include "./ember_private.h"
 #include "./websocketd.h"
+#include "./ssed.h"
+#include "./template.h"
+#include "./romfs.h"
+#include "./multipart.h"
+#include "./deflate.h"
 
 /*===============================================
  public constants
@@ -92,6 +97,41 @@ struct xHTTP_HEADER_DESC {
 	char *pcValue;
 };
 
+/**
+ * @struct xHTTP_PARAM
+ * @brief A URL-decoded parameter from the request's query string, or from an
+ *   `application/x-www-form-urlencoded` body. A parameter without a `=` has an
+ *   empty value.
+ */
+struct xHTTP_PARAM {
+	uint32_t ulHash;
+	const char *pcKey;
+	const char *pcValue;
+};
+typedef struct xHTTP_PARAM HttpParam_t;
+
+/**
+ * @fn BaseType_t (*xBodySink)(void*, const uint8_t*, size_t)
+ * @brief Signature for functions that consume a request body as it is
+ *   received. Called with each received part of the body, and then with a NULL
+ *   `pucData` once the body is complete, when the sink must send the response.
+ *   A negative return (e.g. `-eHTTP_PAYLOAD_TOO_LARGE`) fails the request.
+ */
+typedef BaseType_t (xBodySink)(void*, const uint8_t*, size_t);
+
+/**
+ * @fn BaseType_t (*xResponseProducer)(void*, void*, size_t, BaseType_t*)
+ * @brief Signature for functions that produce the rest of a response, a part
+ *   at a time (see `xSendHttpResponseProducer`). Called with the client, the
+ *   producer's argument and the space in the socket's transmit stream, which
+ *   the producer should not exceed. The producer writes with e.g.
+ *   `xSendHttpResponseChunk`, and sets `*pxDone` once the response is complete.
+ *   It may return without writing anything if it has nothing to send yet. If
+ *   the producer fails, or the connection closes first, it is called once more
+ *   with a zero space and must release its argument without writing.
+ */
+typedef BaseType_t (xResponseProducer)(void*, void*, size_t, BaseType_t*);
+
 /**
  * @struct xHTTP_CLIENT
  * @brief HTTP client data record. Inherits from `TCPClient_t` via the
@@ -104,9 +144,49 @@ struct xHTTP_CLIENT {
 	char *pcUrlData;
 	size_t uxBytesLeft;
 	FF_FILE *pxFileHandle;
+	FileReadAhead_t *pxReadAhead;
+	TemplateRender_t *pxTemplate;
+	const uint8_t *pucRomData;
+	MultipartParser_t *pxMultipart;
+	xBodySink *pxBodySink;
+	size_t uxBodyLeft;
+	size_t uxBodyRcvd;
+	BaseType_t xBodyStatus;
+	xResponseProducer *pxProducer;
+	void *pvProducerArg;
+	struct xROUTE_STATS *pxStats;
+	const struct xROUTE_ITEM *pxCacheRoute;
+	struct xROUTE_CACHE_ENTRY *pxCacheEntry;
+	uint32_t ulCacheFill;
+	struct xROUTE_QOS *pxQos;
+	/* The request's route allows a chunked response to be compressed, and the
+	 * compressor of the response, if it is */
+	BaseType_t xCompress;
+	DeflateStream_t *pxDeflate;
+	struct xHTTP_OFFLOAD *pxOffload;
+	/* The filters that apply to the request, the one that is writing, whether
+	 * any of them transform the body, and whether they are yet to be told
+	 * that the response is complete */
+	UBaseType_t uxFilters;
+	UBaseType_t uxFilterStage;
+	BaseType_t xFilterBody;
+	BaseType_t xFilterComplete;
+	BaseType_t xBasePriority;
+	uint32_t ulRequestStart;
+	BaseType_t xRequestStatus;
+	/* The length of a request that was placed in the server's receive buffer
+	 * on the client's behalf, e.g. by an HTTP/2 stream, rather than received */
+	size_t uxPendingRequest;
 	union {
 		struct {
 			unsigned bFileInProgress :1;
+			unsigned bTemplateInProgress :1;
+			unsigned bRomInProgress :1;
+			unsigned bBodyInProgress :1;
+			unsigned bFileCreated :1;
+			unsigned bCacheWait :1;
+			unsigned bProducerInProgress :1;
+			unsigned bOffloadWait :1;
 		};
 		uint32_t ulFlags;
 	} bits;
@@ -114,10 +194,14 @@ struct xHTTP_CLIENT {
 	const char pcCurrentFilename[ffconfigMAX_FILENAME];
 	const char pcWorkingUrl[ffconfigMAX_FILENAME];
 	const char *pcRouteParts[emberHTTP_ROUTE_PARTS];
-	const char *pcParamParts[emberHTTP_PARAM_PARTS];
+	HttpParam_t pxParams[emberHTTP_PARAM_PARTS];
+	size_t uxNumParams;
 	struct xHTTP_HEADER_DESC pxHeaders[emberHTTP_HEADER_PARTS];
 	char *pcBody;
 	BaseType_t uxBodySz;
+	/* The index of an `application/json` body, or NULL if there is none or
+	 * it is not valid JSON */
+	const JsonIndex_t *pxJson;
 };
 typedef struct xHTTP_CLIENT HTTPClient_t;
 
@@ -128,7 +212,9 @@ typedef struct xHTTP_CLIENT HTTPClient_t;
 typedef enum {
 	eHTTP_SWITCHING_PROTOCOLS = 101,  /**< eHTTP_SWITCHING_PROTOCOLS */
 	eHTTP_REPLY_OK = 200,             /**< eHTTP_REPLY_OK */
+	eHTTP_CREATED = 201,              /**< eHTTP_CREATED */
 	eHTTP_NO_CONTENT = 204,           /**< eHTTP_NO_CONTENT */
+	eHTTP_NOT_MODIFIED = 304,         /**< eHTTP_NOT_MODIFIED */
 	eHTTP_BAD_REQUEST = 400,          /**< eHTTP_BAD_REQUEST */
 	eHTTP_UNAUTHORIZED = 401,         /**< eHTTP_UNAUTHORIZED */
 	eHTTP_NOT_FOUND = 404,            /**< eHTTP_NOT_FOUND */
@@ -136,35 +222,51 @@ typedef enum {
 	eHTTP_GONE = 410,                 /**< eHTTP_GONE */
 	eHTTP_PRECONDITION_FAILED = 412,  /**< eHTTP_PRECONDITION_FAILED */
 	eHTTP_PAYLOAD_TOO_LARGE = 413,    /**< eHTTP_PAYLOAD_TOO_LARGE */
+	eHTTP_TOO_MANY_REQUESTS = 429,    /**< eHTTP_TOO_MANY_REQUESTS */
 	eHTTP_HEADER_TOO_LARGE = 431,     /**< eHTTP_HEADER_TOO_LARGE */
 	eHTTP_INTERNAL_SERVER_ERROR = 500,/**< eHTTP_INTERNAL_SERVER_ERROR */
+	eHTTP_SERVICE_UNAVAILABLE = 503,  /**< eHTTP_SERVICE_UNAVAILABLE */
 } eHttpStatus;
 
 /**
  * @struct xHTTP_STATUS_DESC
  * @brief Mapping of HTTP status code enumerated at `eHttpStatus` to
- *   corresponding text description.
+ *   corresponding text description, and to the complete response status line.
  */
 struct xHTTP_STATUS_DESC {
 	BaseType_t uxLen;
 	const char *const pcText;
 	BaseType_t pcStatus;
+	BaseType_t uxLineLen;
+	const char *const pcLine;
 };
 typedef struct xHTTP_STATUS_DESC HttpStatusDescriptor_t;
+/* Builds a descriptor, including its "HTTP/1.1 <code> <text>\r\n" status line,
+ * at compile time. `code` must be a numeric literal. */
+#define HTTP_STATUS_DESC(code, text) \
+	{ sizeof(text) - 1, text, code, \
+	  sizeof("HTTP/1.1 " #code " " text "\r\n") - 1, \
+	  "HTTP/1.1 " #code " " text "\r\n" }
+/* In order of status code, which `pxGetHttpStatusMessage` relies on, and
+ * ending with the default descriptor. */
 static const HttpStatusDescriptor_t xHttpStatuses[] = {
-    { 19, "switching protocols", eHTTP_SWITCHING_PROTOCOLS },
-    { 2, "OK", eHTTP_REPLY_OK },
-    { 10, "no content", eHTTP_NO_CONTENT },
-    { 11, "bad request", eHTTP_BAD_REQUEST },
-    { 14, "not authorized", eHTTP_UNAUTHORIZED },
-    { 9, "not found", eHTTP_NOT_FOUND },
-    { 11, "not allowed", eHTTP_NOT_ALLOWED },
-    { 5, "gone!", eHTTP_GONE },
-    { 19, "precondition failed", eHTTP_PRECONDITION_FAILED },
-    { 17, "payload too large", eHTTP_PAYLOAD_TOO_LARGE },
-    { 17, "headers too large", eHTTP_HEADER_TOO_LARGE },
-    { 21, "internal server error", eHTTP_INTERNAL_SERVER_ERROR },
-    { 0, "", -1 },
+    HTTP_STATUS_DESC(101, "switching protocols"),
+    HTTP_STATUS_DESC(200, "OK"),
+    HTTP_STATUS_DESC(201, "created"),
+    HTTP_STATUS_DESC(204, "no content"),
+    HTTP_STATUS_DESC(304, "not modified"),
+    HTTP_STATUS_DESC(400, "bad request"),
+    HTTP_STATUS_DESC(401, "not authorized"),
+    HTTP_STATUS_DESC(404, "not found"),
+    HTTP_STATUS_DESC(405, "not allowed"),
+    HTTP_STATUS_DESC(410, "gone!"),
+    HTTP_STATUS_DESC(412, "precondition failed"),
+    HTTP_STATUS_DESC(413, "payload too large"),
+    HTTP_STATUS_DESC(429, "too many requests"),
+    HTTP_STATUS_DESC(431, "headers too large"),
+    HTTP_STATUS_DESC(500, "internal server error"),
+    HTTP_STATUS_DESC(503, "service unavailable"),
+    { 0, "", -1, 0, "" },
 };
 static const size_t xNumHttpStatusDescs = sizeof(xHttpStatuses)
     / sizeof(HttpStatusDescriptor_t);
@@ -223,6 +325,9 @@ typedef enum {
 	eRouteOption_None = 0,                 /**< eRouteOption_None */
 	eRouteOption_IgnoreTrailingSlash = 0x1,/**< eRouteOption_IgnoreTrailingSlash */
 	eRouteOption_AllowWildcards = 0x2,     /**< eRouteOption_AllowWildcards */
+	eRouteOption_StreamBody = 0x4,         /**< eRouteOption_StreamBody */
+	eRouteOption_Compress = 0x8,           /**< eRouteOption_Compress */
+	eRouteOption_Offload = 0x10,           /**< eRouteOption_Offload */
 } eRouteOptions;
 
 /**
@@ -260,6 +365,143 @@ typedef BaseType_t (xRouteHandler)(void*);
  */
 typedef BaseType_t (xErrorHandler)(void*, eHttpStatus);
 
+/**
+ * @fn BaseType_t (*xRequestFilter)(void*, void*)
+ * @brief Signature for functions that filter each request before it is
+ *   matched to a route, called with the client and the filter's argument.
+ *   Returns 0 to pass the request on, or else responds to the request itself
+ *   and returns as a handler would.
+ */
+typedef BaseType_t (xRequestFilter)(void*, void*);
+/**
+ * @fn BaseType_t (*xBodyFilter)(void*, void*, const uint8_t*, size_t)
+ * @brief Signature for functions that transform the body of a "chunked"
+ *   response as it is written, called with the client, the filter's argument
+ *   and each part of the body. The filter writes its output, if any, with
+ *   `xHttpFilterWrite`. At the end of the body it is called with a NULL part,
+ *   when it must write anything that it holds and then pass the NULL on.
+ */
+typedef BaseType_t (xBodyFilter)(void*, void*, const uint8_t*, size_t);
+/**
+ * @fn void (*xCompleteFilter)(void*, void*)
+ * @brief Signature for functions that are called once the response to a
+ *   request is complete, e.g. to log it, with the client and the filter's
+ *   argument. The request's status is in `xRequestStatus`.
+ */
+typedef void (xCompleteFilter)(void*, void*);
+
+/**
+ * @struct xHTTP_FILTER
+ * @brief A filter in the pipeline of `xRouteConfig`, with any of its three
+ *   functions, and its argument. Request filters are applied to every request;
+ *   body and completion filters are applied to the requests to routes that
+ *   select them, and to every request if `xRouteConfig` selects them.
+ */
+struct xHTTP_FILTER {
+	xRequestFilter *pxRequest;
+	xBodyFilter *pxBody;
+	xCompleteFilter *pxComplete;
+	void *pvArg;
+};
+typedef struct xHTTP_FILTER HttpFilter_t;
+
+/**
+ * @struct xROUTE_STATS
+ * @brief Latency and response statistics of an HTTP route. Latencies (in
+ *   microseconds, from the receipt of a request until the last byte of its
+ *   response has been written) are counted in a log-linear histogram, with
+ *   2^`emberSTATS_SUB_BITS` buckets per power of two, so memory is fixed and
+ *   the relative precision is the same at all latencies.
+ */
+struct xROUTE_STATS {
+	uint32_t ulCount;
+	uint32_t ulMaxUs;
+	uint64_t ullTotalUs;
+	/* responses by status class, 1xx to 5xx */
+	uint32_t pulStatus[5];
+	uint32_t pulBuckets[emberSTATS_BUCKETS];
+};
+typedef struct xROUTE_STATS RouteStats_t;
+
+/**
+ * @struct xROUTE_CACHE_ENTRY
+ * @brief A cached response, or a response being built by `pxFiller`. The key
+ *   is the request's route and normalised query, as built by
+ *   `uxRouteCacheKey`.
+ */
+struct xROUTE_CACHE_ENTRY {
+	char pcKey[emberCACHE_KEY_SIZE];
+	size_t uxKeyLen;
+	uint8_t *pucData;
+	size_t uxLen;
+	BaseType_t xStatus;
+	TickType_t xFilled;
+	void *pxFiller;
+	BaseType_t xDiscard;
+	/* Counts the responses that have been built for the entry, so that a
+	 * request waiting for one can tell if the entry has since been reused */
+	uint32_t ulFill;
+};
+typedef struct xROUTE_CACHE_ENTRY RouteCacheEntry_t;
+
+/**
+ * @struct xROUTE_CACHE
+ * @brief The cached responses of an HTTP route, each kept for `ulTtlMs`.
+ */
+struct xROUTE_CACHE {
+	uint32_t ulTtlMs;
+	RouteCacheEntry_t pxEntries[emberCACHE_ENTRIES];
+};
+typedef struct xROUTE_CACHE RouteCache_t;
+
+/**
+ * @enum eRouteCacheResult
+ * @brief The result of looking up a request in a route cache.
+ */
+typedef enum {
+	eRouteCache_Miss = 0,  /**< not cached; build the response */
+	eRouteCache_Hit,       /**< cached; send the entry's data */
+	eRouteCache_Pending,   /**< being built for another request; wait */
+} eRouteCacheResult;
+
+/**
+ * @struct xROUTE_QOS
+ * @brief The priority class of an HTTP route, per `eEmberPriority`, and the
+ *   number of its requests that may be served at once. While a request to the
+ *   route is served, its client has the route's class; a request that would
+ *   exceed `uxMaxActive` is refused with 503. If `uxMaxActive` is 0, the number
+ *   is not limited.
+ */
+struct xROUTE_QOS {
+	BaseType_t xPriority;
+	UBaseType_t uxMaxActive;
+	UBaseType_t uxActive;
+};
+typedef struct xROUTE_QOS RouteQos_t;
+
+/**
+ * @struct xHTTP_OFFLOAD
+ * @brief A request whose handler is called by a worker task (see
+ *   `eRouteOption_Offload`). The worker calls the handler with `xClient`, a
+ *   copy of the parked client whose request is copied to `xServer`, and
+ *   collects the response in `pcResponse`; EMBER then writes the response to
+ *   the client. `xCancelled` and `xDone` are only written by EMBER.
+ */
+struct xHTTP_OFFLOAD {
+	/* --- Keep at the top: the copy's output finds its request by address --- */
+	HTTPClient_t xClient;
+	xRouteHandler *pxHandler;
+	volatile BaseType_t xCancelled;
+	BaseType_t xDone;
+	/* The result of the handler, and the status of its response */
+	BaseType_t xRc;
+	BaseType_t xStatus;
+	size_t uxLen;
+	char pcResponse[emberHTTP_OFFLOAD_RESPONSE_SIZE];
+	TCPServer_t xServer;
+};
+typedef struct xHTTP_OFFLOAD HttpOffload_t;
+
 /**
  * @struct xROUTE_ITEM
  * @brief Description of an individual HTTP route.
@@ -270,11 +512,21 @@ struct xROUTE_ITEM {
 		struct {
 			unsigned ignore_trailing_slash :1;
 			unsigned allow_wildcards :1;
-			unsigned :30;
+			unsigned stream_body :1;
+			unsigned compress :1;
+			unsigned offload :1;
+			unsigned :27;
 		};
 	} uxOptions;
 	xRouteHandler *pxHandler;
 	const char const *const*pcPath;
+	const RateLimit_t *pxRateLimit;
+	RouteStats_t *pxStats;
+	RouteCache_t *pxCache;
+	RouteQos_t *pxQos;
+	/* The filters of `xRouteConfig` that apply to the route, as a mask with bit
+	 * n for `pxFilters[n]` */
+	UBaseType_t uxFilters;
 };
 typedef struct xROUTE_ITEM RouteItem_t;
 
@@ -287,6 +539,12 @@ struct xROUTE_CONFIG {
 	const size_t uxNumRoutes;
 	const RouteItem_t const *pxItems;
 	xErrorHandler *pxErrorHandler;
+	const RateLimit_t *pxRateLimit;
+	/* The filters, applied in order (at most 32), and the mask of those that
+	 * apply to every request */
+	const HttpFilter_t *pxFilters;
+	size_t uxNumFilters;
+	UBaseType_t uxFilters;
 };
 typedef struct xROUTE_CONFIG RouteConfig_t;
 
@@ -328,9 +586,36 @@ BaseType_t xHttpWork(void *pxc);
  */
 BaseType_t xHttpDelete(void *pxc);
 
+/**
+ * @fn BaseType_t xHttpResponseInProgress(void*)
+ * @brief Determine whether the response to a client's current request is
+ *   still being produced, e.g. a file is being transmitted or the request body
+ *   is being received, so that `xHttpWork` must be called again.
+ *
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @return pdTRUE if the response is in progress, otherwise pdFALSE
+ */
+BaseType_t xHttpResponseInProgress(void *pxc);
+
+/**
+ * @fn BaseType_t xHttpFlush(void*)
+ * @brief Transmit the parts of a response that have been written so far.
+ *   While a request is being handled, response headers and content are
+ *   collected and transmitted together when the handler returns; handlers only
+ *   need to call this function to transmit part of a response early.
+ *
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xHttpFlush(void *pxc);
+
 /**
  * @fn const HttpStatusDescriptor_t* const pxGetHttpStatusMessage (const BaseType_t)
  * @brief Find a status descriptor (text) corresponding to an HTTP status code.
+ *   Constant-time, i.e. does not search `xHttpStatuses`.
  *
  * @param xStatus The status code to search for
  * @return A pointer to an `HttpStatusDescriptor_t` that includes the status text.
@@ -351,16 +636,22 @@ const HttpStatusDescriptor_t* const pxGetHttpStatusMessage(
 size_t xPrintRoute(char *pcDest, const char **pxRouteParts, const size_t uxn);
 
 /**
- * @fn size_t xPrintParams(char*, const char**, const size_t)
- * @brief Print formatted HTTP route parameters.
+ * @fn size_t xPrintParams(char*, const HttpParam_t*, const size_t, const size_t)
+ * @brief Print formatted HTTP route parameters, as `?key=value&key=value`. The
+ *   parameters are printed as decoded, i.e. they are not re-encoded.
  *
  * @param pcDest The location to print the parameters.
- * @param pxParamParts An array of strings making up the parameters, terminated
- *   by a `HTTPD_ROUTE_TERMINATOR`. The terminator is not printed.
+ * @param pxParams An array of parameters, e.g. the `pxParams` of an
+ *   `HTTPClient_t` instance.
+ * @param uxNumParams The number of parameters in `pxParams`.
  * @param uxn The maximum number of characters to print.
  * @return The actual number of characters printed.
  */
-size_t xPrintParams(char *pcDest, const char **pxParamParts, const size_t uxn);
+size_t xPrintParams(
+    char *pcDest,
+    const HttpParam_t *pxParams,
+    const size_t uxNumParams,
+    const size_t uxn);
 
 /**
  * @fn const char* pcGetContentsType(const char*)
@@ -375,7 +666,9 @@ const char* pcGetContentsType(const char *pcFileExt);
 /**
  * @fn BaseType_t xSendHttpResponseHeaders(void*, const BaseType_t,
  *   const UBaseType_t, const size_t, const char*, const char*)
- * @brief Construct and transmit HTTP headers.
+ * @brief Construct and transmit HTTP headers. If the request's route has the
+ *   `eRouteOption_Compress` option, a "chunked" body is compressed as it is
+ *   transmitted, with gzip (or deflate) if the client accepts it.
  *
  * @post The `HTTPClient_t` instance is ready to transmit an HTTP body.
  * @param pxc An anonymized `HTTPClient_t` instance.
@@ -420,6 +713,8 @@ BaseType_t xSendHttpResponseContent(void *pxc, char *pcContent, size_t uxLen);
 /**
  * @fn BaseType_t xSendHttpResponseChunk(void*, char*, size_t)
  * @brief Transmit a chunk of the HTTP body, in "chunked" transmission mode.
+ *   A compressed body is flushed after each chunk, so that the client does not
+ *   wait for more, so it compresses better in fewer, larger chunks.
  *
  * @pre `xSendHttpResponseHeaders` should have been called immediately prior with
  *   `uxOpts.chunked_body`=`1`.
@@ -433,6 +728,22 @@ BaseType_t xSendHttpResponseContent(void *pxc, char *pcContent, size_t uxLen);
  */
 BaseType_t xSendHttpResponseChunk(void *pxc, char *pcContent, size_t uxLen);
 
+/**
+ * @fn BaseType_t xHttpFilterWrite(void*, const uint8_t*, size_t)
+ * @brief Write the output of a body filter, which is passed to the next body
+ *   filter that applies to the request, and then compressed (if it is) and
+ *   transmitted as chunks. Must only be called by a body filter.
+ *
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @param pucData The output, or NULL to end the body.
+ * @param uxLen The number of bytes of output.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xHttpFilterWrite(void *pxc, const uint8_t *pucData, size_t uxLen);
+
 /**
  * @fn BaseType_t xSendHttpResponseFile(void*)
  * @brief Transmit a file from the filesystem. Note that the file reference is
@@ -451,6 +762,152 @@ BaseType_t xSendHttpResponseChunk(void *pxc, char *pcContent, size_t uxLen);
  */
 BaseType_t xSendHttpResponseFile(void *pxc);
 
+/**
+ * @fn BaseType_t xSendHttpResponseTemplate(void*, TemplateCallback_t, void*)
+ * @brief Render a compiled template (see `tools/ember_tplc.py`) from the
+ *   filesystem as the body of a chunked response. The template is rendered
+ *   incrementally, one transmit buffer at a time, with values supplied by
+ *   `pxCallback`. Note that the file reference is set separately, in the
+ *   `HTTPClient_t` instance.
+ *
+ * @pre
+ *   * The `HTTPClient_t` field `pxFileHandle` should have been set (and the
+ *     compiled template file opened).
+ *   * `xSendHttpResponseHeaders` should have been sent immediately prior with
+ *   `uxOpts.chunked_body`=`1`.
+ * @post The file is owned by the render, and is closed when it completes.
+ *   `pvArg` must remain valid until then.
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @param pxCallback The callback that supplies the template's values.
+ * @param pvArg An argument passed to every call of `pxCallback`.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xSendHttpResponseTemplate(
+    void *pxc,
+    TemplateCallback_t pxCallback,
+    void *pvArg);
+
+/**
+ * @fn BaseType_t xSendHttpResponseProducer(void*, xResponseProducer*, void*)
+ * @brief Produce the rest of a response with a producer, which is called now
+ *   and then, once the handler has returned, whenever the socket can accept
+ *   more data, until it reports that the response is complete. Long responses
+ *   (e.g. a log dump) are so transmitted without holding up other clients.
+ *
+ * @pre `xSendHttpResponseHeaders` should have been sent immediately prior,
+ *   typically with `uxOpts.chunked_body`=`1`.
+ * @post `pvArg` must remain valid until the producer reports that the
+ *   response is complete, or is called with a zero space.
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @param pxProducer The producer.
+ * @param pvArg An argument passed to every call of `pxProducer`.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xSendHttpResponseProducer(
+    void *pxc,
+    xResponseProducer *pxProducer,
+    void *pvArg);
+
+/**
+ * @fn BaseType_t xSendHttpResponseRom(void*, const RomfsEntry_t*)
+ * @brief Respond with a file from the ROM filesystem image, including the
+ *   headers. The file is transmitted directly from the image into the TCP
+ *   stream. If the request's `If-None-Match` header matches the file's entity
+ *   tag, `304 Not Modified` is sent instead; if the file has a gzip variant and
+ *   the request's `Accept-Encoding` header allows it, the variant is sent. For
+ *   a HEAD request, only the headers are sent.
+ *
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @param pxEntry The file, e.g. as found by `pxRomfsFind`.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xSendHttpResponseRom(void *pxc, const RomfsEntry_t *pxEntry);
+
+/**
+ * @fn BaseType_t xReceiveHttpBody(void*, xBodySink*)
+ * @brief Receive the request's body through a sink, which is called with each
+ *   part of the body as it arrives and then responds once the body is
+ *   complete. The part of the body that arrived with the request is passed to
+ *   the sink immediately. If the sink fails, the rest of the body is discarded
+ *   and the route configuration's error handler responds.
+ *
+ * @pre The request was matched to a route with the `eRouteOption_StreamBody`
+ *   option, which allows its body to be larger than the receive buffer. The
+ *   body must have a `Content-Length`.
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @param pxSink The sink.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xReceiveHttpBody(void *pxc, xBodySink *pxSink);
+
+/**
+ * @fn BaseType_t xReceiveHttpMultipart(void*, MultipartCallback_t, void*)
+ * @brief Receive the request's `multipart/form-data` body, e.g. a file upload
+ *   from an HTML form, through a multipart callback. The callback must respond
+ *   on `eMultipartEvent_End`; if the body is invalid, the route configuration's
+ *   error handler responds with `400 Bad Request`.
+ *
+ * @pre As for `xReceiveHttpBody`.
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @param pxCallback The callback that consumes the parts of the body.
+ * @param pvArg An argument passed to every call of `pxCallback`.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xReceiveHttpMultipart(
+    void *pxc,
+    MultipartCallback_t pxCallback,
+    void *pvArg);
+
+/**
+ * @fn BaseType_t xReceiveHttpFile(void*, const char*)
+ * @brief Store the request's body as a file, e.g. for a PUT request. The body
+ *   is written to a temporary file (the path with `~` appended) as it is
+ *   received, in blocks that end on multiples of `emberHTTP_WRITE_SIZE` bytes
+ *   of the file, and the temporary file replaces `pcPath` once the body is
+ *   complete; so an interrupted upload never leaves a partial file at
+ *   `pcPath`. Responds with `201 Created` if the file did not exist, otherwise
+ *   `204 No Content`.
+ *
+ * @pre As for `xReceiveHttpBody`.
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @param pcPath The path of the file to store.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xReceiveHttpFile(void *pxc, const char *pcPath);
+
+/**
+ * @fn BaseType_t xDeleteHttpFile(void*, const char*)
+ * @brief Delete a file, e.g. for a DELETE request, and respond with
+ *   `204 No Content`, or with the route configuration's error handler if the
+ *   file does not exist.
+ *
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @param pcPath The path of the file to delete.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xDeleteHttpFile(void *pxc, const char *pcPath);
+
 /**
  * @fn BaseType_t xGetHeaderValue(void*, const char*, char**)
  * @brief Given a header name, return its value if it exists.
@@ -464,6 +921,22 @@ BaseType_t xSendHttpResponseFile(void *pxc);
  */
 BaseType_t xGetHeaderValue(void *pxc, const char *pcText, char **pcValue);
 
+/**
+ * @fn BaseType_t xGetQueryParam(void*, const char*, const char**)
+ * @brief Given a parameter name, return its URL-decoded value if it exists.
+ *   Parameters are indexed from the request's query string and, if the request
+ *   has an `application/x-www-form-urlencoded` body, from the body (which is
+ *   decoded in place). If a name occurs more than once, the first is returned.
+ *
+ * @pre An HTTP request has been received by the `HTTPClient_t` instance.
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @param pcName The parameter name to be searched/checked (case-sensitive).
+ * @param pcValue The location to store a pointer to the parameter value.
+ * @return The index of the corresponding parameter in the `HTTPClient_t`
+ *   instance, or -1 if it was not found.
+ */
+BaseType_t xGetQueryParam(void *pxc, const char *pcName, const char **pcValue);
+
 /**
  * @fn BaseType_t xUpgradeToWebsocket(void*, const WebsocketMessageHandler_t,
  *   const WebsocketMessageHandler_t, const char*)
@@ -496,4 +969,193 @@ BaseType_t xUpgradeToWebsocket(
     const WebsocketMessageHandler_t binHandler,
     const char *pcRoute);
 
+/**
+ * @fn BaseType_t xUpgradeToEventStream(void*, const char*)
+ * @brief Respond to an HTTP request with a `text/event-stream` response, and
+ *   attach the connection to a named event stream. Records subsequently
+ *   published to the stream with `xEventStreamPublish` are transmitted to the
+ *   connection by EMBER.
+ *
+ * @post
+ *   * The de-anonymized `pxc` argument will be changed from a `HTTPClient_t`
+ *     to a `SseClient_t`.
+ *   * The `xCreator`, `xWork` and `xDelete` properties of the new object will
+ *     be set to the corresponding ssed functions.
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @param pcStream The name of a stream created by `pxEventStreamCreate`.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xUpgradeToEventStream(void *pxc, const char *pcStream);
+
+/**
+ * @fn void vRouteStatsRecord(RouteStats_t*, const uint32_t, const BaseType_t)
+ * @brief Record a response in the statistics of a route. Called by httpd when
+ *   the response to a request for a route with statistics is complete.
+ *
+ * @param pxStats The route's statistics.
+ * @param ulLatencyUs The latency of the response, in microseconds.
+ * @param xStatus The HTTP status of the response.
+ */
+void vRouteStatsRecord(
+    RouteStats_t *pxStats,
+    const uint32_t ulLatencyUs,
+    const BaseType_t xStatus);
+
+/**
+ * @fn uint32_t ulRouteStatsPercentile(const RouteStats_t*, const uint32_t)
+ * @brief Estimate a latency percentile of a route.
+ *
+ * @note Statistics are updated by the EMBER task without locking; values read
+ *   by other tasks may be slightly inconsistent.
+ * @param pxStats The route's statistics.
+ * @param ulPerMille The percentile, in tenths of a percent, e.g. 990 for the
+ *   99th percentile.
+ * @return The upper bound (in microseconds) of the histogram bucket containing
+ *   the percentile, or 0 if no responses have been recorded.
+ */
+uint32_t ulRouteStatsPercentile(
+    const RouteStats_t *pxStats,
+    const uint32_t ulPerMille);
+
+/**
+ * @fn void vRouteStatsReset(RouteStats_t*)
+ * @brief Clear the statistics of a route, e.g. after a firmware update.
+ *
+ * @param pxStats The route's statistics.
+ */
+void vRouteStatsReset(RouteStats_t *pxStats);
+
+/**
+ * @fn BaseType_t xRouteStatsHandler(void*)
+ * @brief A route handler that responds with the statistics of every route that
+ *   has them, as a JSON array. Add it to `xRouteConfig` to expose the
+ *   statistics, e.g. at `/stats`.
+ *
+ * @param pxc An anonymized `HTTPClient_t` instance.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xRouteStatsHandler(void *pxc);
+
+/**
+ * @fn size_t uxRouteCacheKey(char*, const size_t, const char**, const HttpParam_t*, const size_t)
+ * @brief Build the route cache key of a request: its route, followed by its
+ *   parameters sorted by name and value, each NUL-separated, so that requests
+ *   that differ only in the order of their parameters share a key.
+ *
+ * @param pcDst The destination.
+ * @param uxn The size of the destination.
+ * @param pcRouteParts The request's route parts.
+ * @param pxParams The request's parameters.
+ * @param uxNumParams The number of parameters.
+ * @return The length of the key, or 0 if it does not fit.
+ */
+size_t uxRouteCacheKey(
+    char *pcDst,
+    const size_t uxn,
+    const char **pcRouteParts,
+    const HttpParam_t *pxParams,
+    const size_t uxNumParams);
+
+/**
+ * @fn eRouteCacheResult xRouteCacheFind(RouteCache_t*, const char*, const size_t, RouteCacheEntry_t**)
+ * @brief Look up a key in a route cache.
+ *
+ * @param pxCache The route's cache.
+ * @param pcKey The key, from `uxRouteCacheKey`.
+ * @param uxKeyLen The length of the key.
+ * @param ppxEntry Set to the matching entry or, on a miss, to the entry in
+ *   which the response should be built (NULL if every entry is being built).
+ * @return `eRouteCache_Hit`, `eRouteCache_Pending` or `eRouteCache_Miss`.
+ */
+eRouteCacheResult xRouteCacheFind(
+    RouteCache_t *pxCache,
+    const char *pcKey,
+    const size_t uxKeyLen,
+    RouteCacheEntry_t **ppxEntry);
+
+/**
+ * @fn void vRouteCacheClaim(RouteCacheEntry_t*, const char*, const size_t, void*)
+ * @brief Claim a cache entry in which to build a response; until it is stored,
+ *   requests for the same key are `eRouteCache_Pending`.
+ *
+ * @param pxEntry The entry, from `xRouteCacheFind`.
+ * @param pcKey The key.
+ * @param uxKeyLen The length of the key.
+ * @param pxFiller The client building the response.
+ */
+void vRouteCacheClaim(
+    RouteCacheEntry_t *pxEntry,
+    const char *pcKey,
+    const size_t uxKeyLen,
+    void *pxFiller);
+
+/**
+ * @fn void vRouteCacheStore(RouteCacheEntry_t*, const void*, const size_t, const BaseType_t)
+ * @brief Store a response in a claimed cache entry, and release the entry.
+ *
+ * @param pxEntry The entry.
+ * @param pvData The complete response, or NULL to release the entry without
+ *   caching anything.
+ * @param uxLen The length of the response.
+ * @param xStatus The HTTP status of the response.
+ */
+void vRouteCacheStore(
+    RouteCacheEntry_t *pxEntry,
+    const void *pvData,
+    const size_t uxLen,
+    const BaseType_t xStatus);
+
+/**
+ * @fn void vRouteCacheFlush(RouteCache_t*)
+ * @brief Discard the responses cached for a route, e.g. when the state that
+ *   they report has changed. A response being built when the cache is flushed
+ *   is not cached. Must be called from the EMBER task, e.g. by a handler.
+ *
+ * @param pxCache The route's cache.
+ */
+void vRouteCacheFlush(RouteCache_t *pxCache);
+
+/**
+ * @fn HttpOffload_t* pxHttpOffloadStart(HTTPClient_t*, xRouteHandler*)
+ * @brief Copy a parsed request, and queue it for a worker task to call its
+ *   handler. The worker tasks are started when the first request is offloaded.
+ *
+ * @note Must only be called from the EMBER task.
+ * @param pxClient The client, whose request has been parsed.
+ * @param pxHandler The handler to call.
+ * @return The offloaded request, or NULL if the workers are busy with
+ *   `emberHTTP_OFFLOAD_QUEUE_LENGTH` requests, or could not be started, or no
+ *   memory was available.
+ */
+HttpOffload_t *pxHttpOffloadStart(HTTPClient_t *pxClient,
+    xRouteHandler *pxHandler);
+
+/**
+ * @fn BaseType_t xHttpOffloadDone(HttpOffload_t*)
+ * @brief Collect the completions posted by the worker tasks, and determine
+ *   whether an offloaded request is one of them.
+ *
+ * @note Must only be called from the EMBER task.
+ * @param pxOffload The offloaded request.
+ * @return pdTRUE if the handler has returned and its response is complete,
+ *   otherwise pdFALSE
+ */
+BaseType_t xHttpOffloadDone(HttpOffload_t *pxOffload);
+
+/**
+ * @fn void vHttpOffloadStop(HttpOffload_t*)
+ * @brief Release an offloaded request. If its handler has not yet returned,
+ *   the request is freed when the worker's completion is collected.
+ *
+ * @note Must only be called from the EMBER task.
+ * @param pxOffload The offloaded request.
+ */
+void vHttpOffloadStop(HttpOffload_t *pxOffload);
+
 #endif /* EMBER_V0_0_INC_HTTPD_H_ */
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef EMBER_V0_0_INC_JSON_H_
+#define EMBER_V0_0_INC_JSON_H_
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <stdint.h>
+#include "./ember.h"
+
+/*===============================================
+ public constants
+ ===============================================*/
+
+/* The number of slots in the top-level key table of a JSON index; a power of
+ * 2, and greater than the number of keys that are looked up in O(1) */
+#define JSON_KEY_SLOTS             (2u * emberJSON_KEYS)
+
+/*===============================================
+ public data prototypes
+ ===============================================*/
+
+/**
+ * @enum eJsonType
+ * @brief Enumeration of the types of JSON token.
+ */
+typedef enum
+{
+	eJsonType_Object = 0, /**< eJsonType_Object */
+	eJsonType_Array,      /**< eJsonType_Array */
+	eJsonType_String,     /**< eJsonType_String; also object keys */
+	eJsonType_Number,     /**< eJsonType_Number */
+	eJsonType_True,       /**< eJsonType_True */
+	eJsonType_False,      /**< eJsonType_False */
+	eJsonType_Null,       /**< eJsonType_Null */
+} eJsonType;
+
+/**
+ * @struct xJSON_TOKEN
+ * @brief A value (or object key) in a JSON text. Tokens are stored in document
+ *   order, with the key of each object member immediately followed by its
+ *   value, so that the contents of an object or array follow it and end at
+ *   `usNext`.
+ */
+struct xJSON_TOKEN
+{
+	/* The offset in the text of the value; for a string, of the character
+	 * after the opening quote */
+	uint32_t ulOffset;
+	/* The length of the value; for a string, excluding the quotes (and with
+	 * any escape sequences not decoded) */
+	uint32_t ulLen;
+	/* The index of the token after this value and its contents */
+	uint16_t usNext;
+	/* The number of members of an object, or elements of an array */
+	uint16_t usSize;
+	uint8_t ucType;
+};
+typedef struct xJSON_TOKEN JsonToken_t;
+
+/**
+ * @struct xJSON_INDEX
+ * @brief The tokens of a JSON text, built by `xJsonParse` in a single pass.
+ *   If the text is an object, its keys are also hashed into `pusKeys`, so that
+ *   they are found by `pxJsonGet` without a search.
+ */
+struct xJSON_INDEX
+{
+	const char *pcText;
+	JsonToken_t *pxTokens;
+	size_t uxNumTokens;
+	/* Indices (+1) of the top-level keys, by hash; 0 is an empty slot */
+	uint16_t pusKeys[JSON_KEY_SLOTS];
+	/* Set if a key did not fit in `pusKeys`, so must be searched for */
+	BaseType_t xKeysOverflow;
+};
+typedef struct xJSON_INDEX JsonIndex_t;
+
+/*===============================================
+ public function prototypes
+ ===============================================*/
+
+/**
+ * @fn BaseType_t xJsonParse(JsonIndex_t*, const char*, const size_t, JsonToken_t*, const size_t)
+ * @brief Validate a JSON text (RFC 8259) and index its values, in a single
+ *   pass and without allocating memory. The text is not modified, and must
+ *   remain valid while the index is used.
+ *
+ * @param pxIndex The index to build.
+ * @param pcText The text. Need not be NUL-terminated.
+ * @param uxLen The length of the text.
+ * @param pxTokens The array in which to store the tokens.
+ * @param uxMaxTokens The number of tokens in the array; at most 65535.
+ * @return
+ *   < 0 if the text is not valid JSON (-pdFREERTOS_ERRNO_EINVAL), or has more
+ *       values than there are tokens (-pdFREERTOS_ERRNO_ENOBUFS)
+ *   > 0 the number of tokens
+ */
+BaseType_t xJsonParse(
+	JsonIndex_t *pxIndex,
+	const char *pcText,
+	const size_t uxLen,
+	JsonToken_t *pxTokens,
+	const size_t uxMaxTokens);
+
+/**
+ * @fn const JsonToken_t* pxJsonGet(const JsonIndex_t*, const char*)
+ * @brief Find the value of a member of the top-level object of a JSON text.
+ *   Keys are compared as written, i.e. escape sequences are not decoded. If a
+ *   key appears more than once, the first is found.
+ *
+ * @param pxIndex The index.
+ * @param pcKey The key.
+ * @return The value, or NULL if the text is not an object or has no such key.
+ */
+const JsonToken_t* pxJsonGet(const JsonIndex_t *pxIndex, const char *pcKey);
+
+/**
+ * @fn const JsonToken_t* pxJsonMember(const JsonIndex_t*, const JsonToken_t*, const char*)
+ * @brief Find the value of a member of any object, by searching its keys.
+ *
+ * @param pxIndex The index.
+ * @param pxObject The object.
+ * @param pcKey The key.
+ * @return The value, or NULL if `pxObject` is not an object or has no such key.
+ */
+const JsonToken_t* pxJsonMember(
+	const JsonIndex_t *pxIndex,
+	const JsonToken_t *pxObject,
+	const char *pcKey);
+
+/**
+ * @fn const JsonToken_t* pxJsonElement(const JsonIndex_t*, const JsonToken_t*, const size_t)
+ * @brief Find an element of an array.
+ *
+ * @param pxIndex The index.
+ * @param pxArray The array.
+ * @param uxElement The (zero-based) position of the element.
+ * @return The element, or NULL if `pxArray` is not an array or is too short.
+ */
+const JsonToken_t* pxJsonElement(
+	const JsonIndex_t *pxIndex,
+	const JsonToken_t *pxArray,
+	const size_t uxElement);
+
+/**
+ * @fn BaseType_t xJsonString(const JsonIndex_t*, const JsonToken_t*, char*, const size_t)
+ * @brief Copy a string value, decoding its escape sequences (`\uXXXX` to
+ *   UTF-8). The copy is NUL-terminated, and truncated if need be.
+ *
+ * @param pxIndex The index.
+ * @param pxToken The string.
+ * @param pcDst The destination.
+ * @param uxn The size of the destination.
+ * @return
+ *   < 0 if the token is not a string (-pdFREERTOS_ERRNO_EINVAL)
+ *   >= 0 the length of the copy
+ */
+BaseType_t xJsonString(
+	const JsonIndex_t *pxIndex,
+	const JsonToken_t *pxToken,
+	char *pcDst,
+	const size_t uxn);
+
+/**
+ * @fn BaseType_t xJsonInteger(const JsonIndex_t*, const JsonToken_t*, int32_t*)
+ * @brief Get the value of an integral number.
+ *
+ * @param pxIndex The index.
+ * @param pxToken The number.
+ * @param plValue Set to the value, saturated to the range of `int32_t`.
+ * @return pdTRUE if the token is a number without a fraction or exponent, and
+ *   pdFALSE otherwise.
+ */
+BaseType_t xJsonInteger(
+	const JsonIndex_t *pxIndex,
+	const JsonToken_t *pxToken,
+	int32_t *plValue);
+
+#endif /* EMBER_V0_0_INC_JSON_H_ */
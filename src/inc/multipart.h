@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef EMBER_V0_0_INC_MULTIPART_H_
+#define EMBER_V0_0_INC_MULTIPART_H_
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include "./ember_private.h"
+
+/*===============================================
+ public constants
+ ===============================================*/
+
+/* The delimiter that precedes each boundary is "\r\n--" */
+#define MULTIPART_DELIM_PREFIX_SZ  (4)
+
+/*===============================================
+ public data prototypes
+ ===============================================*/
+
+/**
+ * @enum eMultipartEvent
+ * @brief The kinds of event reported to a `MultipartCallback_t`.
+ */
+typedef enum
+{
+	eMultipartEvent_PartStart = 0, /**< eMultipartEvent_PartStart */
+	eMultipartEvent_PartData,	   /**< eMultipartEvent_PartData */
+	eMultipartEvent_PartEnd,	   /**< eMultipartEvent_PartEnd */
+	eMultipartEvent_End,		   /**< eMultipartEvent_End */
+	eMultipartEvent_Abort,		   /**< eMultipartEvent_Abort */
+} eMultipartEvent;
+
+/**
+ * @struct xMULTIPART_PART
+ * @brief The headers of a part of a `multipart/form-data` body. Values that
+ *   are absent are empty strings; values that are too long are truncated.
+ *   `pcFilename` is reduced to its last path component, after `/` or `\`, as
+ *   some browsers send the full path of the uploaded file; a `\` in it is
+ *   therefore not taken as an escape.
+ */
+struct xMULTIPART_PART
+{
+	char pcName[emberMULTIPART_NAME_SIZE];
+	char pcFilename[emberMULTIPART_NAME_SIZE];
+	char pcContentType[emberMULTIPART_NAME_SIZE];
+};
+typedef struct xMULTIPART_PART MultipartPart_t;
+
+/**
+ * @fn BaseType_t (*MultipartCallback_t)(void*, const eMultipartEvent,
+ *   const MultipartPart_t*, const uint8_t*, const size_t)
+ * @brief Signature for multipart callback functions, which consume the parts
+ *   of a `multipart/form-data` body as it is parsed.
+ *
+ * For each part, the callback is called with `eMultipartEvent_PartStart` once
+ * its headers have been parsed, with `eMultipartEvent_PartData` for each block
+ * of its content, and with `eMultipartEvent_PartEnd`. Content is delivered in
+ * blocks of exactly `emberMULTIPART_WRITE_SIZE` bytes from a word-aligned
+ * buffer, except for the last block of a part, so that it may be passed
+ * straight to `ff_fwrite`. `eMultipartEvent_End` is reported when the end of
+ * the body is fed to the parser, if the body was complete; otherwise, or if
+ * the callback failed, `eMultipartEvent_Abort` is reported, so that the
+ * callback can release any resources. `pucData`
+ * is NULL for all but `eMultipartEvent_PartData`. A negative return aborts
+ * parsing.
+ */
+typedef BaseType_t (*MultipartCallback_t)(
+	void *pvArg,
+	const eMultipartEvent eEvent,
+	const MultipartPart_t *pxPart,
+	const uint8_t *pucData,
+	const size_t uxLen);
+
+/**
+ * @enum eMultipartState
+ * @brief The states of a `MultipartParser_t`.
+ */
+typedef enum
+{
+	eMultipartState_Preamble = 0, /**< eMultipartState_Preamble */
+	eMultipartState_Boundary,	  /**< eMultipartState_Boundary */
+	eMultipartState_Headers,	  /**< eMultipartState_Headers */
+	eMultipartState_Content,	  /**< eMultipartState_Content */
+	eMultipartState_Epilogue,	  /**< eMultipartState_Epilogue */
+	eMultipartState_Failed,		  /**< eMultipartState_Failed */
+} eMultipartState;
+
+/**
+ * @struct xMULTIPART_PARSER
+ * @brief The state of a `multipart/form-data` body being parsed. The body is
+ *   fed to the parser in segments of any size; the delimiter is searched for
+ *   with a precomputed skip table, and up to one delimiter's length of each
+ *   segment is held back in case the delimiter continues in the next segment.
+ */
+struct xMULTIPART_PARSER
+{
+	MultipartCallback_t pxCallback;
+	void *pvArg;
+	eMultipartState eState;
+	BaseType_t xError;
+	size_t uxDelimLen;
+	size_t uxHeld;
+	size_t uxLineLen;
+	size_t uxStaged;
+	MultipartPart_t xPart;
+	uint8_t pucSkip[256];
+	uint8_t pucDelim[MULTIPART_DELIM_PREFIX_SZ + emberMULTIPART_BOUNDARY_SIZE];
+	uint8_t pucHeld[MULTIPART_DELIM_PREFIX_SZ + emberMULTIPART_BOUNDARY_SIZE];
+	char pcLine[emberMULTIPART_HEADER_SIZE];
+	uint32_t pulStage[emberMULTIPART_WRITE_SIZE / sizeof(uint32_t)];
+};
+typedef struct xMULTIPART_PARSER MultipartParser_t;
+
+/*===============================================
+ public function prototypes
+ ===============================================*/
+
+/**
+ * @fn MultipartParser_t* pxMultipartStart(const char*, MultipartCallback_t,
+ *   void*)
+ * @brief Start parsing a `multipart/form-data` body.
+ *
+ * @param pcContentType The value of the request's `Content-Type` header, from
+ *   which the boundary is taken.
+ * @param pxCallback The callback that consumes the parts of the body.
+ * @param pvArg An argument passed to every call of `pxCallback`.
+ * @return The parser state, or NULL if the content type is not
+ *   `multipart/form-data` with a valid boundary or no memory was available.
+ */
+MultipartParser_t *pxMultipartStart(
+	const char *pcContentType,
+	MultipartCallback_t pxCallback,
+	void *pvArg);
+
+/**
+ * @fn BaseType_t xMultipartFeed(MultipartParser_t*, const uint8_t*,
+ *   const size_t)
+ * @brief Parse the next segment of a body. A segment of length 0 marks the end
+ *   of the body.
+ *
+ * @param pxParser The parser state.
+ * @param pucData The segment.
+ * @param uxLen The length (in bytes) of the segment.
+ * @return
+ *   < 0 if an error occurred (-pdFREERTOS_ERRNO_EINVAL for an invalid body, or
+ *       the callback's error); the error is returned for every later segment
+ *   = 0 if no error occurred and the final boundary has not yet been found
+ *   > 0 if the final boundary has been found (for the end of the body, if
+ *       the body was complete)
+ */
+BaseType_t xMultipartFeed(
+	MultipartParser_t *pxParser,
+	const uint8_t *pucData,
+	const size_t uxLen);
+
+/**
+ * @fn void vMultipartStop(MultipartParser_t*)
+ * @brief Stop parsing a body and free its state. If the body is not complete,
+ *   the callback is first called with `eMultipartEvent_Abort`.
+ *
+ * @param pxParser The parser state.
+ */
+void vMultipartStop(MultipartParser_t *pxParser);
+
+#endif /* EMBER_V0_0_INC_MULTIPART_H_ */
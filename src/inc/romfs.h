@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef EMBER_V0_0_INC_ROMFS_H_
+#define EMBER_V0_0_INC_ROMFS_H_
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <stdint.h>
+
+/*===============================================
+ public data prototypes
+ ===============================================*/
+
+/**
+ * @struct xROMFS_ENTRY
+ * @brief A file in a ROM filesystem image, as generated by
+ *   `tools/ember_romfs.py`. Everything needed to respond with the file is
+ *   precomputed, including the extra response headers.
+ */
+struct xROMFS_ENTRY {
+	/* The path of the file, relative to the packed directory, e.g.
+	 * "/static/index.htm" */
+	const char *pcPath;
+	const char *pcContentType;
+	/* The quoted entity tag of the file */
+	const char *pcETag;
+	/* The extra headers sent with the file, and with its gzip variant */
+	const char *pcHeaders;
+	const char *pcGzipHeaders;
+	const uint8_t *pucData;
+	uint32_t ulSize;
+	/* The gzip variant of the file, or NULL if there is none */
+	const uint8_t *pucGzipData;
+	uint32_t ulGzipSize;
+};
+typedef struct xROMFS_ENTRY RomfsEntry_t;
+
+/**
+ * @struct xROMFS_IMAGE
+ * @brief A ROM filesystem image. Entries are sorted by path (by byte value),
+ *   so that they can be found by binary search.
+ */
+struct xROMFS_IMAGE {
+	const size_t uxNumEntries;
+	const RomfsEntry_t *const pxEntries;
+};
+typedef struct xROMFS_IMAGE RomfsImage_t;
+
+/*===============================================
+ public function prototypes
+ ===============================================*/
+
+/**
+ * @fn const RomfsEntry_t* pxRomfsFind(const char*)
+ * @brief Find a file in the ROM filesystem image `xRomfsImage`. If no image is
+ *   linked into the application, no files are found.
+ *
+ * @param pcPath The path of the file, e.g. "/static/index.htm". The match is
+ *   case-sensitive.
+ * @return The file, or NULL if it is not in the image.
+ */
+const RomfsEntry_t* pxRomfsFind(const char *pcPath);
+
+#endif /* EMBER_V0_0_INC_ROMFS_H_ */
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef EMBER_V0_0_INC_SSED_H_
+#define EMBER_V0_0_INC_SSED_H_
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <semphr.h>
+#include "./ember_private.h"
+
+/*===============================================
+ public constants
+ ===============================================*/
+
+#define SSED_CREATOR_METHOD (NULL)
+#define SSED_WORKER_METHOD (xSsedWork)
+#define SSED_DELETE_METHOD (NULL)
+
+/*===============================================
+ public data prototypes
+ ===============================================*/
+
+/**
+ * @struct xEVENT_STREAM
+ * @brief A named stream of server-sent events. Published records are formatted
+ *   once into a ring buffer, from which they are transmitted to every attached
+ *   connection.
+ *
+ * `ulHead` counts every byte ever published to the stream, and each connection
+ * keeps its own count of the bytes it has transmitted, so the ring buffer is
+ * shared by all connections without per-connection copies.
+ */
+struct xEVENT_STREAM
+{
+	struct xEVENT_STREAM *pxNext;
+	const char *pcName;
+	SemaphoreHandle_t xMutex;
+	size_t uxSize;
+	volatile uint32_t ulHead;
+	char pcBuffer[];
+};
+typedef struct xEVENT_STREAM EventStream_t;
+
+/**
+ * @struct xSSE_CLIENT
+ * @brief Server-sent events client record. Inherits from `TCPClient_t` via the
+ *   `TCP_CLIENT_PROPERTIES` macro.
+ *
+ * As for `WebsocketClient_t`, the SSE client struct overwrites what was
+ * originally an HTTP client struct, and is much smaller.
+ */
+struct xSSE_CLIENT
+{
+	TCP_CLIENT_PROPERTIES;
+	/* --- Keep at the top  --- */
+	EventStream_t *pxStream;
+	uint32_t ulCursor;
+	TickType_t xLastSend;
+};
+typedef struct xSSE_CLIENT SseClient_t;
+
+/*===============================================
+ public function prototypes
+ ===============================================*/
+
+/**
+ * @fn BaseType_t xSsedWork(void*)
+ * @brief SSE client work function. Called periodically by EMBER for each
+ *   `SseClient_t` instance in its list of current `TCPClient_t` instances.
+ *   Transmits any records published to the client's stream since the last call.
+ *
+ * @param pxc An anonymized `SseClient_t` instance.
+ * @return
+ *   < 0 if an error occurred, or if the client fell so far behind the stream
+ *       that unsent records were overwritten
+ *   = 0 if no error occurred and no data was transmitted
+ *   > 0 the number of bytes transmitted
+ */
+BaseType_t xSsedWork(void *pxc);
+
+/**
+ * @fn EventStream_t* pxEventStreamCreate(const char*, const size_t)
+ * @brief Create a named event stream, to which HTTP connections may be
+ *   attached with `xUpgradeToEventStream`.
+ *
+ * @param pcName The name of the stream. Not copied, so must remain valid.
+ * @param uxSize The size (in bytes) of the stream's ring buffer. Must be a power
+ *   of 2, and larger than any single record.
+ * @return The new stream, or NULL if `uxSize` is invalid or no memory was
+ *   available.
+ */
+EventStream_t *pxEventStreamCreate(const char *pcName, const size_t uxSize);
+
+/**
+ * @fn EventStream_t* pxEventStreamFind(const char*)
+ * @brief Find an event stream by name.
+ *
+ * @param pcName The name of the stream.
+ * @return The stream, or NULL if no stream of that name has been created.
+ */
+EventStream_t *pxEventStreamFind(const char *pcName);
+
+/**
+ * @fn BaseType_t xEventStreamPublish(EventStream_t*, const char*, const char*,
+ *   const size_t)
+ * @brief Publish a record to an event stream. The record is formatted once, as
+ *   an optional `event:` line followed by one `data:` line per line of
+ *   `pcData`, and then transmitted by EMBER to each attached connection. May be
+ *   called from any task.
+ *
+ * @param pxStream The stream.
+ * @param pcEvent The event type, or NULL for the default ("message") type.
+ * @param pcData The event data.
+ * @param uxLen The length of `pcData`, or 0 if it is NUL-terminated.
+ * @return
+ *   < 0 if an error occurred (-pdFREERTOS_ERRNO_ENOBUFS if the record is larger
+ *       than the stream's ring buffer)
+ *   > 0 the size of the formatted record
+ */
+BaseType_t xEventStreamPublish(
+	EventStream_t *pxStream,
+	const char *pcEvent,
+	const char *pcData,
+	size_t uxLen);
+
+#endif /* EMBER_V0_0_INC_SSED_H_ */
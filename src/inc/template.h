@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef EMBER_V0_0_INC_TEMPLATE_H_
+#define EMBER_V0_0_INC_TEMPLATE_H_
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include "./ember_private.h"
+
+/*===============================================
+ public constants
+ ===============================================*/
+
+/* The first four bytes of every compiled template */
+#define TEMPLATE_MAGIC             "ETP\x01"
+#define TEMPLATE_MAGIC_SZ          (4)
+
+/*===============================================
+ public data prototypes
+ ===============================================*/
+
+/**
+ * @enum eTemplateOpcode
+ * @brief Opcodes of a compiled template, as generated by
+ *   `tools/ember_tplc.py`. Each opcode is a single byte; multi-byte operands
+ *   are little-endian, and offsets are from the start of the file.
+ *
+ *   * End: no operands.
+ *   * Text: u16 length, then that many bytes of text.
+ *   * Value: u8 name length, then the name.
+ *   * Loop: u8 name length, the name, then u32 offset of the opcode following
+ *     the matching EndLoop.
+ *   * EndLoop: u32 offset of the matching Loop.
+ */
+typedef enum
+{
+	eTemplateOp_End = 0, /**< eTemplateOp_End */
+	eTemplateOp_Text,	 /**< eTemplateOp_Text */
+	eTemplateOp_Value,	 /**< eTemplateOp_Value */
+	eTemplateOp_Loop,	 /**< eTemplateOp_Loop */
+	eTemplateOp_EndLoop, /**< eTemplateOp_EndLoop */
+} eTemplateOpcode;
+
+/**
+ * @enum eTemplateQuery
+ * @brief The kinds of query made to a `TemplateCallback_t`.
+ */
+typedef enum
+{
+	eTemplateQuery_Value = 0, /**< eTemplateQuery_Value */
+	eTemplateQuery_Loop,	  /**< eTemplateQuery_Loop */
+} eTemplateQuery;
+
+/**
+ * @fn BaseType_t (*TemplateCallback_t)(void*, const eTemplateQuery,
+ *   const char*, const UBaseType_t, char*, const size_t)
+ * @brief Signature for template callback functions, which supply the values
+ *   rendered into a template.
+ *
+ * For `eTemplateQuery_Value`, the callback writes the value of `pcName` to
+ * `pcValue` (which is not NUL-terminated) and returns its length; as for
+ * `snprintf`, a length of `uxMaxLen` or more renders the first `uxMaxLen - 1`
+ * bytes. For
+ * `eTemplateQuery_Loop`, `pcValue` is NULL and the callback returns > 0 if the
+ * loop `pcName` has an iteration `uxIteration`, or 0 if the loop is finished.
+ * `uxIteration` is the iteration of the innermost loop (0 outside any loop).
+ * A negative return aborts rendering.
+ */
+typedef BaseType_t (*TemplateCallback_t)(
+	void *pvArg,
+	const eTemplateQuery eQuery,
+	const char *pcName,
+	const UBaseType_t uxIteration,
+	char *pcValue,
+	const size_t uxMaxLen);
+
+/**
+ * @struct xTEMPLATE_LOOP
+ * @brief The state of an active loop section.
+ */
+struct xTEMPLATE_LOOP
+{
+	uint32_t ulBegin;
+	UBaseType_t uxIteration;
+};
+
+/**
+ * @struct xTEMPLATE_RENDER
+ * @brief The state of a template being rendered. The compiled template is read
+ *   from its file through a small window, so its size is not limited by RAM.
+ */
+struct xTEMPLATE_RENDER
+{
+	FF_FILE *pxFile;
+	TemplateCallback_t pxCallback;
+	void *pvArg;
+	uint32_t ulPos;
+	uint32_t ulWinPos;
+	size_t uxWinLen;
+	size_t uxTextLeft;
+	size_t uxValueLen;
+	size_t uxValueOff;
+	BaseType_t xDepth;
+	BaseType_t xDone;
+	struct xTEMPLATE_LOOP pxLoops[emberTEMPLATE_MAX_DEPTH];
+	char pcName[emberTEMPLATE_NAME_SIZE];
+	char pcValue[emberTEMPLATE_VALUE_SIZE];
+	uint8_t pucWindow[emberTEMPLATE_READ_SIZE];
+};
+typedef struct xTEMPLATE_RENDER TemplateRender_t;
+
+/*===============================================
+ public function prototypes
+ ===============================================*/
+
+/**
+ * @fn TemplateRender_t* pxTemplateStart(FF_FILE*, TemplateCallback_t, void*)
+ * @brief Start rendering a compiled template.
+ *
+ * @post If successful, the render owns `pxFile`, which is closed by
+ *   `vTemplateStop`.
+ * @param pxFile The (open) compiled template file.
+ * @param pxCallback The callback that supplies values and loop iterations.
+ * @param pvArg An argument passed to every call of `pxCallback`.
+ * @return The render state, or NULL if the file is not a compiled template or
+ *   no memory was available, in which case the caller still owns `pxFile`.
+ */
+TemplateRender_t *pxTemplateStart(
+	FF_FILE *pxFile,
+	TemplateCallback_t pxCallback,
+	void *pvArg);
+
+/**
+ * @fn BaseType_t xTemplateRender(TemplateRender_t*, char*, const size_t)
+ * @brief Render the next part of a template.
+ *
+ * @param pxRender The render state.
+ * @param pcDst The destination of the rendered text.
+ * @param uxMax The maximum number of bytes to render.
+ * @return
+ *   < 0 if an error occurred (-pdFREERTOS_ERRNO_EIO for a read error,
+ *       -pdFREERTOS_ERRNO_EINVAL for an invalid template, or the callback's
+ *       error)
+ *   = 0 if the template has been completely rendered
+ *   > 0 the number of bytes rendered
+ */
+BaseType_t xTemplateRender(
+	TemplateRender_t *pxRender,
+	char *pcDst,
+	const size_t uxMax);
+
+/**
+ * @fn void vTemplateStop(TemplateRender_t*)
+ * @brief Stop rendering a template; close its file and free its state.
+ *
+ * @param pxRender The render state.
+ */
+void vTemplateStop(TemplateRender_t *pxRender);
+
+#endif /* EMBER_V0_0_INC_TEMPLATE_H_ */
@@ -57,7 +57,7 @@
 
 #define WEBSOCKETD_CREATOR_METHOD (NULL)
 #define WEBSOCKETD_WORKER_METHOD (xWebsocketWork)
-#define WEBSOCKETD_DELETE_METHOD (NULL)
+#define WEBSOCKETD_DELETE_METHOD (xWebsocketDelete)
 
 /*===============================================
  public data prototypes
@@ -69,6 +69,19 @@
  */
 typedef BaseType_t (*WebsocketMessageHandler_t)(void *);
 
+/**
+ * @fn BaseType_t (*WebsocketSink_t)(void*, void*, const uint8_t*, size_t)
+ * @brief Signature for functions that consume a large message as it is
+ *   received (see `xReceiveWebsocketMessage`). Called with the client, the
+ *   argument given to `xReceiveWebsocketMessage`, and each unmasked part of
+ *   the message, and then once with a NULL `pucData`. The `uxLen` of that last
+ *   call is 0 if the whole message was received, or otherwise the close status
+ *   (e.g. `eWS_ABNORMAL_CLOSURE`) for which the rest will not arrive. A
+ *   negative return (e.g. `-eWS_POLICY_VIOLATION`) closes the connection, with
+ *   that status if it is one, and the sink is not called again.
+ */
+typedef BaseType_t (*WebsocketSink_t)(void *, void *, const uint8_t *, size_t);
+
 /**
  * @struct xWEBSOCKET_FLAGS
  * @brief The first two bytes of all websocket messages. Common to all types of
@@ -104,10 +117,28 @@ struct xWEBSOCKET_CLIENT
 	TCP_CLIENT_PROPERTIES;
 	/* --- Keep at the top  --- */
 	struct xWEBSOCKET_FLAGS xFlags;
-	uint16_t usMaskKeyL;
-	uint16_t usMaskKeyU;
+	uint8_t pucMaskKey[4];
 	int64_t xPayloadSz;
 	char *pcPayload;
+	/* The number of bytes that must be waiting in the socket before the frame
+	 * at its head can be parsed further, or 0 */
+	size_t uxRxWant;
+	/* The buffer in which a fragmented message is being reassembled, or NULL */
+	uint8_t *pucMessage;
+	size_t uxMessageSz;
+	/* The opcode of the first frame of the fragmented message */
+	uint8_t ucMessageOp;
+	/* Called, if it is set, when a binary message that is too large for the
+	 * receive buffer begins, so that it can take the message with
+	 * `xReceiveWebsocketMessage`; otherwise the message is refused with 1009 */
+	WebsocketMessageHandler_t pxLargeHandler;
+	/* The sink of the message being streamed, or NULL */
+	WebsocketSink_t pxSink;
+	void *pvSinkArg;
+	/* The number of bytes of the streamed frame's payload still to arrive */
+	uint64_t ullFrameLeft;
+	/* The index of a text message's payload, or NULL if it is not valid JSON */
+	const JsonIndex_t *pxJson;
 	char pcRoute[ffconfigMAX_FILENAME];
 	WebsocketMessageHandler_t pxTxtHandler;
 	WebsocketMessageHandler_t pxBinHandler;
@@ -276,6 +307,11 @@ static const WebsocketStatusDescriptor_t *defaultWebsocketStatus =
  * @brief Websocket client work function. Called periodically by EMBER for each
  *   `WebsocketClient_t` instance in its list of current `TCPClient_t` instances.
  *
+ * Every complete frame that is waiting in the socket is handled, in order. A
+ * frame that has only partly arrived is left in the socket until it is
+ * complete. The frames of a fragmented message are reassembled in a buffer
+ * from a shared pool, and its handler is called when the last has arrived.
+ *
  * @param pxc An anonymized `WebsocketClient_t` instance.
  * @return
  *   < 0 if an error occurred
@@ -284,6 +320,39 @@ static const WebsocketStatusDescriptor_t *defaultWebsocketStatus =
  */
 BaseType_t xWebsocketWork(void *pxc);
 
+/**
+ * @fn BaseType_t xWebsocketDelete(void*)
+ * @brief Websocket client deletion function. Called by EMBER to release the
+ *   message buffer held by a `WebsocketClient_t` instance, if any.
+ *
+ * @param pxc An anonymized `WebsocketClient_t` instance.
+ * @return 0
+ */
+BaseType_t xWebsocketDelete(void *pxc);
+
+/**
+ * @fn BaseType_t xReceiveWebsocketMessage(void*, WebsocketSink_t, void*)
+ * @brief Take a binary message that is too large for the receive buffer, e.g.
+ *   a firmware image, through a sink, which is called with each part of the
+ *   message as it arrives, unmasked, and then once at its end. The message is
+ *   not buffered, so its size is limited only by the sink. Control messages
+ *   that arrive between its fragments are handled as usual.
+ *
+ * @pre Called from the client's `pxLargeHandler`, which is called with the
+ *   frame's header in `xFlags` and `xPayloadSz` (the size of the first frame,
+ *   and of the whole message if `xFlags.fin` is set) and a NULL `pcPayload`.
+ * @param pxc An anonymized `WebsocketClient_t` instance.
+ * @param pxSink The sink.
+ * @param pvArg An argument passed to every call of `pxSink`.
+ * @return
+ *   < 0 if an error occurred
+ *   = 0 if the message will be passed to the sink
+ */
+BaseType_t xReceiveWebsocketMessage(
+	void *pxc,
+	WebsocketSink_t pxSink,
+	void *pvArg);
+
 /**
  * @fn const WebsocketStatusDescriptor_t* const
  *   pxPrintWebsocketStatusMessage(const BaseType_t)
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef EMBER_V0_0_INC_WSMASK_H_
+#define EMBER_V0_0_INC_WSMASK_H_
+
+/*===============================================
+ includes
+ ===============================================*/
+
+// the kernel depends only on the C library, so that it can also be built and
+// measured on a host, by tools/ember_wsmask_bench.py
+#include <stddef.h>
+#include <stdint.h>
+
+/*===============================================
+ public function prototypes
+ ===============================================*/
+
+/**
+ * @fn void vWebsocketUnmask(uint8_t*, const uint8_t*, size_t, const uint8_t*, size_t)
+ * @brief XOR a block of a websocket payload with its masking key, either in
+ *   place or while copying it.
+ *
+ * The bytes before the first word boundary of the destination are unmasked
+ * one at a time, the bulk a word (or, where SSE2 or NEON is available, 16
+ * bytes) at a time, and the tail one at a time. Neither buffer need be
+ * aligned, and no byte outside either is read or written.
+ *
+ * @param pucDst The destination, which may be the same as `pucSrc`, but must
+ *   not otherwise overlap it.
+ * @param pucSrc The masked bytes.
+ * @param uxLen The number of bytes.
+ * @param pucKey The 4-byte masking key, in the order that it was received.
+ * @param uxPhase The offset of the block from the start of the payload, of
+ *   which only the lower 2 bits are used, so that a payload may be unmasked in
+ *   several blocks.
+ */
+void vWebsocketUnmask(
+	uint8_t *pucDst,
+	const uint8_t *pucSrc,
+	size_t uxLen,
+	const uint8_t *pucKey,
+	size_t uxPhase);
+
+#endif /* EMBER_V0_0_INC_WSMASK_H_ */
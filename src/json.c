@@ -0,0 +1,589 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <FreeRTOS.h>
+#include <FreeRTOS_IP.h>
+#include <string.h>
+#include "inc/json.h"
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static size_t prvSkipSpace(const char *pcText, size_t uxPos, const size_t uxLen);
+static size_t prvScanString(const char *pcText, size_t uxPos, const size_t uxLen);
+static size_t prvScanNumber(const char *pcText, size_t uxPos, const size_t uxLen);
+static size_t prvScanLiteral(
+	const char *pcText,
+	const size_t uxPos,
+	const size_t uxLen,
+	const char *pcLiteral);
+static BaseType_t prvHexValue(const char *pcHex, uint32_t *pulValue);
+static uint32_t prvHashKey(const char *pcKey, const size_t uxLen);
+static BaseType_t prvKeyEquals(
+	const JsonIndex_t *pxIndex,
+	const JsonToken_t *pxKey,
+	const char *pcKey,
+	const size_t uxLen);
+static void prvAddKey(JsonIndex_t *pxIndex, const size_t uxToken);
+static size_t prvPutUtf8(char *pcDst, const uint32_t ulCode);
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+BaseType_t xJsonParse(
+	JsonIndex_t *pxIndex,
+	const char *pcText,
+	const size_t uxLen,
+	JsonToken_t *pxTokens,
+	const size_t uxMaxTokens)
+{
+	uint16_t pusStack[emberJSON_MAX_DEPTH];
+	size_t uxDepth = 0, uxPos = 0, uxNum = 0, uxEnd;
+	size_t uxMax = (uxMaxTokens < 0xffffu) ? uxMaxTokens : 0xffffu;
+	JsonToken_t *pxToken, *pxParent;
+	BaseType_t xExpectKey = pdFALSE;
+	char cChar, cClose;
+	memset(pxIndex->pusKeys, 0, sizeof(pxIndex->pusKeys));
+	pxIndex->xKeysOverflow = pdFALSE;
+	pxIndex->pcText = pcText;
+	pxIndex->pxTokens = pxTokens;
+	pxIndex->uxNumTokens = 0;
+	for (;;)
+	{
+		// a value is expected, or a key if in an object
+		uxPos = prvSkipSpace(pcText, uxPos, uxLen);
+		if (uxPos >= uxLen)
+			return -pdFREERTOS_ERRNO_EINVAL;
+		if (uxNum >= uxMax)
+			return -pdFREERTOS_ERRNO_ENOBUFS;
+		pxParent = (uxDepth > 0) ? &pxTokens[pusStack[uxDepth - 1]] : NULL;
+		pxToken = &pxTokens[uxNum];
+		pxToken->ulOffset = (uint32_t)uxPos;
+		pxToken->usSize = 0;
+		cChar = pcText[uxPos];
+		if (xExpectKey)
+		{
+			if (cChar != '"')
+				return -pdFREERTOS_ERRNO_EINVAL;
+			uxEnd = prvScanString(pcText, uxPos, uxLen);
+			if (uxEnd == 0)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			pxToken->ulOffset = (uint32_t)(uxPos + 1);
+			pxToken->ulLen = (uint32_t)(uxEnd - uxPos - 2);
+			pxToken->ucType = eJsonType_String;
+			pxToken->usNext = (uint16_t)(uxNum + 1);
+			pxParent->usSize++;
+			if (uxDepth == 1)
+				prvAddKey(pxIndex, uxNum);
+			uxNum++;
+			uxPos = prvSkipSpace(pcText, uxEnd, uxLen);
+			if (uxPos >= uxLen || pcText[uxPos] != ':')
+				return -pdFREERTOS_ERRNO_EINVAL;
+			uxPos++;
+			xExpectKey = pdFALSE;
+			continue;
+		}
+		if (pxParent != NULL && pxParent->ucType == eJsonType_Array)
+			pxParent->usSize++;
+		if (cChar == '{' || cChar == '[')
+		{
+			if (uxDepth >= emberJSON_MAX_DEPTH)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			pxToken->ucType = (cChar == '{') ? eJsonType_Object : eJsonType_Array;
+			pusStack[uxDepth++] = (uint16_t)uxNum++;
+			uxPos = prvSkipSpace(pcText, uxPos + 1, uxLen);
+			// an empty object or array is closed below
+			if (uxPos >= uxLen || pcText[uxPos] != ((cChar == '{') ? '}' : ']'))
+			{
+				xExpectKey = (cChar == '{');
+				continue;
+			}
+		}
+		else
+		{
+			if (cChar == '"')
+			{
+				uxEnd = prvScanString(pcText, uxPos, uxLen);
+				pxToken->ucType = eJsonType_String;
+			}
+			else if (cChar == '-' || (cChar >= '0' && cChar <= '9'))
+			{
+				uxEnd = prvScanNumber(pcText, uxPos, uxLen);
+				pxToken->ucType = eJsonType_Number;
+			}
+			else if (cChar == 't')
+			{
+				uxEnd = prvScanLiteral(pcText, uxPos, uxLen, "true");
+				pxToken->ucType = eJsonType_True;
+			}
+			else if (cChar == 'f')
+			{
+				uxEnd = prvScanLiteral(pcText, uxPos, uxLen, "false");
+				pxToken->ucType = eJsonType_False;
+			}
+			else if (cChar == 'n')
+			{
+				uxEnd = prvScanLiteral(pcText, uxPos, uxLen, "null");
+				pxToken->ucType = eJsonType_Null;
+			}
+			else
+			{
+				uxEnd = 0;
+			}
+			if (uxEnd == 0)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			if (pxToken->ucType == eJsonType_String)
+			{
+				pxToken->ulOffset = (uint32_t)(uxPos + 1);
+				pxToken->ulLen = (uint32_t)(uxEnd - uxPos - 2);
+			}
+			else
+			{
+				pxToken->ulLen = (uint32_t)(uxEnd - uxPos);
+			}
+			pxToken->usNext = (uint16_t)(uxNum + 1);
+			uxNum++;
+			uxPos = uxEnd;
+		}
+		// after a value: close any objects and arrays that end here, then expect
+		// the next value
+		for (;;)
+		{
+			uxPos = prvSkipSpace(pcText, uxPos, uxLen);
+			if (uxDepth == 0)
+			{
+				if (uxPos != uxLen)
+					return -pdFREERTOS_ERRNO_EINVAL;
+				pxIndex->uxNumTokens = uxNum;
+				return (BaseType_t)uxNum;
+			}
+			if (uxPos >= uxLen)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			pxParent = &pxTokens[pusStack[uxDepth - 1]];
+			cClose = (pxParent->ucType == eJsonType_Object) ? '}' : ']';
+			if (pcText[uxPos] == ',')
+			{
+				uxPos++;
+				xExpectKey = (pxParent->ucType == eJsonType_Object);
+				break;
+			}
+			if (pcText[uxPos] != cClose)
+				return -pdFREERTOS_ERRNO_EINVAL;
+			uxPos++;
+			pxParent->ulLen = (uint32_t)(uxPos - pxParent->ulOffset);
+			pxParent->usNext = (uint16_t)uxNum;
+			uxDepth--;
+		}
+	}
+}
+
+const JsonToken_t *pxJsonGet(const JsonIndex_t *pxIndex, const char *pcKey)
+{
+	size_t uxLen = strlen(pcKey), uxi;
+	uint32_t ulSlot;
+	uint16_t usKey;
+	if (pxIndex->uxNumTokens == 0 || pxIndex->pxTokens[0].ucType != eJsonType_Object)
+		return NULL;
+	ulSlot = prvHashKey(pcKey, uxLen);
+	for (uxi = 0; uxi < JSON_KEY_SLOTS; uxi++)
+	{
+		usKey = pxIndex->pusKeys[(ulSlot + uxi) & (JSON_KEY_SLOTS - 1)];
+		if (usKey == 0)
+			break;
+		if (prvKeyEquals(pxIndex, &pxIndex->pxTokens[usKey - 1], pcKey, uxLen))
+			return &pxIndex->pxTokens[usKey];
+	}
+	// keys that did not fit in the table must be searched for
+	if (pxIndex->xKeysOverflow)
+		return pxJsonMember(pxIndex, &pxIndex->pxTokens[0], pcKey);
+	return NULL;
+}
+
+const JsonToken_t *pxJsonMember(
+	const JsonIndex_t *pxIndex,
+	const JsonToken_t *pxObject,
+	const char *pcKey)
+{
+	size_t uxLen = strlen(pcKey), uxKey, uxi;
+	if (pxObject->ucType != eJsonType_Object)
+		return NULL;
+	uxKey = (size_t)(pxObject - pxIndex->pxTokens) + 1;
+	for (uxi = 0; uxi < pxObject->usSize; uxi++)
+	{
+		if (prvKeyEquals(pxIndex, &pxIndex->pxTokens[uxKey], pcKey, uxLen))
+			return &pxIndex->pxTokens[uxKey + 1];
+		// the next key follows the value
+		uxKey = pxIndex->pxTokens[uxKey + 1].usNext;
+	}
+	return NULL;
+}
+
+const JsonToken_t *pxJsonElement(
+	const JsonIndex_t *pxIndex,
+	const JsonToken_t *pxArray,
+	const size_t uxElement)
+{
+	size_t uxToken, uxi;
+	if (pxArray->ucType != eJsonType_Array || uxElement >= pxArray->usSize)
+		return NULL;
+	uxToken = (size_t)(pxArray - pxIndex->pxTokens) + 1;
+	for (uxi = 0; uxi < uxElement; uxi++)
+		uxToken = pxIndex->pxTokens[uxToken].usNext;
+	return &pxIndex->pxTokens[uxToken];
+}
+
+BaseType_t xJsonString(
+	const JsonIndex_t *pxIndex,
+	const JsonToken_t *pxToken,
+	char *pcDst,
+	const size_t uxn)
+{
+	const char *pcSrc = &pxIndex->pcText[pxToken->ulOffset];
+	const char *pcEnd = &pcSrc[pxToken->ulLen];
+	char pcUtf8[4];
+	size_t uxLen = 0, uxCode;
+	uint32_t ulCode, ulLow;
+	if (pxToken->ucType != eJsonType_String)
+		return -pdFREERTOS_ERRNO_EINVAL;
+	if (uxn == 0)
+		return 0;
+	while (pcSrc < pcEnd)
+	{
+		if (*pcSrc != '\\')
+		{
+			if (uxLen + 1 >= uxn)
+				break;
+			pcDst[uxLen++] = *pcSrc++;
+			continue;
+		}
+		// escape sequences were validated by the parser
+		pcSrc++;
+		switch (*pcSrc++)
+		{
+		case 'b':
+			ulCode = '\b';
+			break;
+		case 'f':
+			ulCode = '\f';
+			break;
+		case 'n':
+			ulCode = '\n';
+			break;
+		case 'r':
+			ulCode = '\r';
+			break;
+		case 't':
+			ulCode = '\t';
+			break;
+		case 'u':
+			prvHexValue(pcSrc, &ulCode);
+			pcSrc += 4;
+			// a surrogate pair encodes a code point beyond the BMP
+			if (ulCode >= 0xd800u && ulCode < 0xdc00u && (pcEnd - pcSrc) >= 6
+				&& pcSrc[0] == '\\' && pcSrc[1] == 'u'
+				&& prvHexValue(&pcSrc[2], &ulLow) && ulLow >= 0xdc00u
+				&& ulLow < 0xe000u)
+			{
+				ulCode = 0x10000u + ((ulCode - 0xd800u) << 10) + (ulLow - 0xdc00u);
+				pcSrc += 6;
+			}
+			break;
+		default:
+			ulCode = (uint8_t)pcSrc[-1];
+			break;
+		}
+		uxCode = prvPutUtf8(pcUtf8, ulCode);
+		// a character that does not fit is not split
+		if (uxLen + uxCode >= uxn)
+			break;
+		memcpy(&pcDst[uxLen], pcUtf8, uxCode);
+		uxLen += uxCode;
+	}
+	pcDst[uxLen] = 0;
+	return (BaseType_t)uxLen;
+}
+
+BaseType_t xJsonInteger(
+	const JsonIndex_t *pxIndex,
+	const JsonToken_t *pxToken,
+	int32_t *plValue)
+{
+	const char *pcSrc = &pxIndex->pcText[pxToken->ulOffset];
+	const char *pcEnd = &pcSrc[pxToken->ulLen];
+	BaseType_t xNegative = pdFALSE;
+	int64_t llValue = 0;
+	if (pxToken->ucType != eJsonType_Number)
+		return pdFALSE;
+	if (*pcSrc == '-')
+	{
+		xNegative = pdTRUE;
+		pcSrc++;
+	}
+	for (; pcSrc < pcEnd; pcSrc++)
+	{
+		if (*pcSrc < '0' || *pcSrc > '9')
+			return pdFALSE;
+		if (llValue <= INT32_MAX)
+			llValue = llValue * 10 + (*pcSrc - '0');
+	}
+	if (xNegative)
+		llValue = -llValue;
+	if (llValue > INT32_MAX)
+		llValue = INT32_MAX;
+	else if (llValue < INT32_MIN)
+		llValue = INT32_MIN;
+	*plValue = (int32_t)llValue;
+	return pdTRUE;
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+static size_t prvSkipSpace(const char *pcText, size_t uxPos, const size_t uxLen)
+{
+	while (uxPos < uxLen && (pcText[uxPos] == ' ' || pcText[uxPos] == '\t'
+							 || pcText[uxPos] == '\n' || pcText[uxPos] == '\r'))
+		uxPos++;
+	return uxPos;
+}
+
+/* Returns the position after the closing quote, or 0 if the string is
+ * invalid */
+static size_t prvScanString(const char *pcText, size_t uxPos, const size_t uxLen)
+{
+	uint32_t ulCode;
+	char cChar;
+	for (uxPos++; uxPos < uxLen; uxPos++)
+	{
+		cChar = pcText[uxPos];
+		if (cChar == '"')
+			return uxPos + 1;
+		if ((uint8_t)cChar < 0x20u)
+			return 0;
+		if (cChar != '\\')
+			continue;
+		if (++uxPos >= uxLen)
+			return 0;
+		switch (pcText[uxPos])
+		{
+		case '"':
+		case '\\':
+		case '/':
+		case 'b':
+		case 'f':
+		case 'n':
+		case 'r':
+		case 't':
+			break;
+		case 'u':
+			if (uxLen - uxPos <= 4 || !prvHexValue(&pcText[uxPos + 1], &ulCode))
+				return 0;
+			uxPos += 4;
+			break;
+		default:
+			return 0;
+		}
+	}
+	return 0;
+}
+
+/* Returns the position after the number, or 0 if the number is invalid */
+static size_t prvScanNumber(const char *pcText, size_t uxPos, const size_t uxLen)
+{
+	size_t uxDigits;
+	if (pcText[uxPos] == '-')
+		uxPos++;
+	// no leading zeros
+	if (uxPos < uxLen && pcText[uxPos] == '0')
+	{
+		uxPos++;
+	}
+	else
+	{
+		for (uxDigits = 0; uxPos < uxLen && pcText[uxPos] >= '0' && pcText[uxPos] <= '9';
+			 uxDigits++)
+			uxPos++;
+		if (uxDigits == 0)
+			return 0;
+	}
+	if (uxPos < uxLen && pcText[uxPos] == '.')
+	{
+		uxPos++;
+		for (uxDigits = 0; uxPos < uxLen && pcText[uxPos] >= '0' && pcText[uxPos] <= '9';
+			 uxDigits++)
+			uxPos++;
+		if (uxDigits == 0)
+			return 0;
+	}
+	if (uxPos < uxLen && (pcText[uxPos] == 'e' || pcText[uxPos] == 'E'))
+	{
+		uxPos++;
+		if (uxPos < uxLen && (pcText[uxPos] == '+' || pcText[uxPos] == '-'))
+			uxPos++;
+		for (uxDigits = 0; uxPos < uxLen && pcText[uxPos] >= '0' && pcText[uxPos] <= '9';
+			 uxDigits++)
+			uxPos++;
+		if (uxDigits == 0)
+			return 0;
+	}
+	return uxPos;
+}
+
+static size_t prvScanLiteral(
+	const char *pcText,
+	const size_t uxPos,
+	const size_t uxLen,
+	const char *pcLiteral)
+{
+	size_t uxLiteralLen = strlen(pcLiteral);
+	if (uxLen - uxPos < uxLiteralLen
+		|| memcmp(&pcText[uxPos], pcLiteral, uxLiteralLen) != 0)
+		return 0;
+	return uxPos + uxLiteralLen;
+}
+
+static BaseType_t prvHexValue(const char *pcHex, uint32_t *pulValue)
+{
+	BaseType_t xi;
+	char cChar;
+	*pulValue = 0;
+	for (xi = 0; xi < 4; xi++)
+	{
+		cChar = pcHex[xi];
+		*pulValue <<= 4;
+		if (cChar >= '0' && cChar <= '9')
+			*pulValue |= (uint32_t)(cChar - '0');
+		else if (cChar >= 'a' && cChar <= 'f')
+			*pulValue |= (uint32_t)(cChar - 'a' + 10);
+		else if (cChar >= 'A' && cChar <= 'F')
+			*pulValue |= (uint32_t)(cChar - 'A' + 10);
+		else
+			return pdFALSE;
+	}
+	return pdTRUE;
+}
+
+static uint32_t prvHashKey(const char *pcKey, const size_t uxLen)
+{
+	uint32_t ulHash = 2166136261u;
+	size_t uxi;
+	for (uxi = 0; uxi < uxLen; uxi++)
+		ulHash = (ulHash ^ (uint8_t)pcKey[uxi]) * 16777619u;
+	return ulHash;
+}
+
+static BaseType_t prvKeyEquals(
+	const JsonIndex_t *pxIndex,
+	const JsonToken_t *pxKey,
+	const char *pcKey,
+	const size_t uxLen)
+{
+	return pxKey->ulLen == uxLen
+		   && memcmp(&pxIndex->pcText[pxKey->ulOffset], pcKey, uxLen) == 0;
+}
+
+static void prvAddKey(JsonIndex_t *pxIndex, const size_t uxToken)
+{
+	const JsonToken_t *pxKey = &pxIndex->pxTokens[uxToken];
+	const char *pcKey = &pxIndex->pcText[pxKey->ulOffset];
+	uint32_t ulSlot = prvHashKey(pcKey, pxKey->ulLen);
+	uint16_t *pusSlot;
+	size_t uxi;
+	for (uxi = 0; uxi < JSON_KEY_SLOTS; uxi++)
+	{
+		pusSlot = &pxIndex->pusKeys[(ulSlot + uxi) & (JSON_KEY_SLOTS - 1)];
+		if (*pusSlot == 0)
+		{
+			*pusSlot = (uint16_t)(uxToken + 1);
+			return;
+		}
+		// the first of duplicate keys is kept
+		if (prvKeyEquals(pxIndex, &pxIndex->pxTokens[*pusSlot - 1], pcKey,
+						 pxKey->ulLen))
+			return;
+	}
+	pxIndex->xKeysOverflow = pdTRUE;
+}
+
+static size_t prvPutUtf8(char *pcDst, const uint32_t ulCode)
+{
+	if (ulCode < 0x80u)
+	{
+		pcDst[0] = (char)ulCode;
+		return 1;
+	}
+	if (ulCode < 0x800u)
+	{
+		pcDst[0] = (char)(0xc0u | (ulCode >> 6));
+		pcDst[1] = (char)(0x80u | (ulCode & 0x3fu));
+		return 2;
+	}
+	if (ulCode < 0x10000u)
+	{
+		pcDst[0] = (char)(0xe0u | (ulCode >> 12));
+		pcDst[1] = (char)(0x80u | ((ulCode >> 6) & 0x3fu));
+		pcDst[2] = (char)(0x80u | (ulCode & 0x3fu));
+		return 3;
+	}
+	pcDst[0] = (char)(0xf0u | (ulCode >> 18));
+	pcDst[1] = (char)(0x80u | ((ulCode >> 12) & 0x3fu));
+	pcDst[2] = (char)(0x80u | ((ulCode >> 6) & 0x3fu));
+	pcDst[3] = (char)(0x80u | (ulCode & 0x3fu));
+	return 4;
+}
@@ -0,0 +1,467 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include "inc/multipart.h"
+#include <string.h>
+#include <strcasestr.h>
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+/* the skip table holds distances of up to the delimiter's length */
+#if ((MULTIPART_DELIM_PREFIX_SZ + emberMULTIPART_BOUNDARY_SIZE) > 255)
+#error "emberMULTIPART_BOUNDARY_SIZE is too large"
+#endif
+
+#if ((emberMULTIPART_WRITE_SIZE % 4) != 0)
+#error "emberMULTIPART_WRITE_SIZE must be a multiple of 4"
+#endif
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static BaseType_t prvFail(MultipartParser_t *pxParser, const BaseType_t xError);
+static BaseType_t prvSearch(
+	MultipartParser_t *pxParser,
+	const uint8_t *pucData,
+	const size_t uxLen,
+	size_t *puxSafe);
+static BaseType_t prvEmit(
+	MultipartParser_t *pxParser,
+	const uint8_t *pucData,
+	size_t uxLen);
+static BaseType_t prvEndPart(MultipartParser_t *pxParser);
+static BaseType_t prvLine(MultipartParser_t *pxParser, const char cChar);
+static void prvParseHeader(MultipartParser_t *pxParser);
+static void prvHeaderParam(
+	const char *pcParams,
+	const char *pcKey,
+	char *pcDst,
+	const size_t uxMax,
+	const BaseType_t xEscapes);
+
+/*===============================================
+ private global variables
+ ===============================================*/
+
+/*===============================================
+ public objects
+ ===============================================*/
+
+/*===============================================
+ external objects
+ ===============================================*/
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+MultipartParser_t *pxMultipartStart(
+	const char *pcContentType,
+	MultipartCallback_t pxCallback,
+	void *pvArg)
+{
+	MultipartParser_t *pxParser;
+	const char *pcBoundary;
+	size_t uxLen, uxi;
+	if (strncasecmp(pcContentType, "multipart/form-data", 19) != 0)
+		return NULL;
+	pcBoundary = strcasestr(pcContentType, "boundary=");
+	if (!pcBoundary)
+		return NULL;
+	pcBoundary += 9;
+	if (*pcBoundary == '"')
+	{
+		pcBoundary++;
+		uxLen = strcspn(pcBoundary, "\"");
+	}
+	else
+		uxLen = strcspn(pcBoundary, "; \t");
+	if (uxLen == 0 || uxLen > emberMULTIPART_BOUNDARY_SIZE)
+		return NULL;
+	pxParser = (MultipartParser_t *)pvPortMalloc(sizeof(MultipartParser_t));
+	if (!pxParser)
+		return NULL;
+	memset(pxParser, 0, sizeof(MultipartParser_t) - sizeof(pxParser->pulStage));
+	pxParser->pxCallback = pxCallback;
+	pxParser->pvArg = pvArg;
+	memcpy(pxParser->pucDelim, "\r\n--", MULTIPART_DELIM_PREFIX_SZ);
+	memcpy(&pxParser->pucDelim[MULTIPART_DELIM_PREFIX_SZ], pcBoundary, uxLen);
+	pxParser->uxDelimLen = MULTIPART_DELIM_PREFIX_SZ + uxLen;
+	// the distance that the search can skip, given the byte that is aligned
+	// with the end of the delimiter
+	memset(pxParser->pucSkip, pxParser->uxDelimLen, sizeof(pxParser->pucSkip));
+	for (uxi = 0; uxi < (pxParser->uxDelimLen - 1); uxi++)
+		pxParser->pucSkip[pxParser->pucDelim[uxi]] = pxParser->uxDelimLen - 1 - uxi;
+	// the first boundary may not be preceded by a line break, so pretend that
+	// one has been received
+	memcpy(pxParser->pucHeld, "\r\n", 2);
+	pxParser->uxHeld = 2;
+	pxParser->eState = eMultipartState_Preamble;
+	return pxParser;
+}
+
+BaseType_t xMultipartFeed(
+	MultipartParser_t *pxParser,
+	const uint8_t *pucData,
+	const size_t uxLen)
+{
+	size_t uxPos = 0, uxSafe, uxLeft, uxKeep, uxi;
+	BaseType_t xMatch, xRc;
+	if (pxParser->eState == eMultipartState_Failed)
+		return pxParser->xError;
+	if (uxLen == 0)
+	{
+		// the body must not end before its final boundary
+		if (pxParser->eState != eMultipartState_Epilogue)
+			return prvFail(pxParser, -pdFREERTOS_ERRNO_EINVAL);
+		xRc = pxParser->pxCallback(pxParser->pvArg, eMultipartEvent_End,
+			&pxParser->xPart, NULL, 0);
+		return (xRc < 0) ? xRc : pdTRUE;
+	}
+	while (uxPos < uxLen)
+	{
+		switch (pxParser->eState)
+		{
+		case eMultipartState_Preamble:
+		case eMultipartState_Content:
+			uxLeft = uxLen - uxPos;
+			xMatch = prvSearch(pxParser, &pucData[uxPos], uxLeft, &uxSafe);
+			if (pxParser->eState == eMultipartState_Content)
+			{
+				// everything before the delimiter (or before the bytes that
+				// might be the start of one) is content
+				xRc = prvEmit(pxParser, &pucData[uxPos],
+					(xMatch >= 0) ? (size_t)xMatch : uxSafe);
+				if (xRc < 0)
+					return prvFail(pxParser, xRc);
+			}
+			if (xMatch < 0)
+			{
+				// hold back the bytes that might be the start of a delimiter;
+				// they are never behind the position that they are moved to
+				uxKeep = pxParser->uxHeld + uxLeft - uxSafe;
+				for (uxi = 0; uxi < uxKeep; uxi++)
+					pxParser->pucHeld[uxi] = ((uxSafe + uxi) < pxParser->uxHeld)
+						? pxParser->pucHeld[uxSafe + uxi]
+						: pucData[uxPos + uxSafe + uxi - pxParser->uxHeld];
+				pxParser->uxHeld = uxKeep;
+				uxPos = uxLen;
+				break;
+			}
+			// the delimiter is longer than any held bytes, so it ends in this
+			// segment
+			uxPos += xMatch + pxParser->uxDelimLen - pxParser->uxHeld;
+			pxParser->uxHeld = 0;
+			if (pxParser->eState == eMultipartState_Content)
+			{
+				xRc = prvEndPart(pxParser);
+				if (xRc < 0)
+					return prvFail(pxParser, xRc);
+			}
+			pxParser->uxLineLen = 0;
+			pxParser->eState = eMultipartState_Boundary;
+			break;
+		case eMultipartState_Boundary:
+		case eMultipartState_Headers:
+			xRc = prvLine(pxParser, (char)pucData[uxPos++]);
+			if (xRc < 0)
+				return prvFail(pxParser, xRc);
+			break;
+		default:
+			// anything after the final boundary is ignored
+			uxPos = uxLen;
+			break;
+		}
+	}
+	return (pxParser->eState == eMultipartState_Epilogue) ? pdTRUE : 0;
+}
+
+void vMultipartStop(MultipartParser_t *pxParser)
+{
+	if (pxParser->eState != eMultipartState_Epilogue
+		&& pxParser->eState != eMultipartState_Failed)
+		pxParser->pxCallback(pxParser->pvArg, eMultipartEvent_Abort,
+			&pxParser->xPart, NULL, 0);
+	vPortFree(pxParser);
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+static BaseType_t prvFail(MultipartParser_t *pxParser, const BaseType_t xError)
+{
+	pxParser->eState = eMultipartState_Failed;
+	pxParser->xError = xError;
+	pxParser->pxCallback(pxParser->pvArg, eMultipartEvent_Abort,
+		&pxParser->xPart, NULL, 0);
+	return xError;
+}
+
+static BaseType_t prvSearch(
+	MultipartParser_t *pxParser,
+	const uint8_t *pucData,
+	const size_t uxLen,
+	size_t *puxSafe)
+{
+	// Horspool search of the held bytes followed by the segment, without
+	// joining them. Returns the offset of the delimiter from the start of the
+	// held bytes, or -1; in the latter case, *puxSafe is the number of bytes
+	// (again from the start of the held bytes) that cannot be part of one.
+	const size_t uxHeld = pxParser->uxHeld;
+	const size_t uxTotal = uxHeld + uxLen;
+	const size_t uxDelimLen = pxParser->uxDelimLen;
+	const uint8_t *pucDelim = pxParser->pucDelim;
+	size_t uxPos = 0, uxi;
+	uint8_t ucChar;
+	while ((uxPos + uxDelimLen) <= uxTotal)
+	{
+		uxi = uxDelimLen;
+		do
+		{
+			uxi--;
+			ucChar = ((uxPos + uxi) < uxHeld)
+				? pxParser->pucHeld[uxPos + uxi]
+				: pucData[uxPos + uxi - uxHeld];
+			if (ucChar != pucDelim[uxi])
+				break;
+		} while (uxi > 0);
+		if (uxi == 0 && ucChar == pucDelim[0])
+			return (BaseType_t)uxPos;
+		ucChar = ((uxPos + uxDelimLen - 1) < uxHeld)
+			? pxParser->pucHeld[uxPos + uxDelimLen - 1]
+			: pucData[uxPos + uxDelimLen - 1 - uxHeld];
+		uxPos += pxParser->pucSkip[ucChar];
+	}
+	*puxSafe = uxPos;
+	return -1;
+}
+
+static BaseType_t prvEmit(
+	MultipartParser_t *pxParser,
+	const uint8_t *pucData,
+	size_t uxLen)
+{
+	// emits the first uxLen bytes of the held bytes followed by the segment,
+	// staging them so that they are delivered in whole blocks
+	uint8_t *pucStage = (uint8_t *)pxParser->pulStage;
+	size_t uxHeldOut = 0, uxBlock;
+	BaseType_t xRc;
+	const uint8_t *pucSrc;
+	while (uxLen > 0)
+	{
+		if (uxHeldOut < pxParser->uxHeld)
+		{
+			pucSrc = &pxParser->pucHeld[uxHeldOut];
+			uxBlock = pxParser->uxHeld - uxHeldOut;
+		}
+		else
+		{
+			pucSrc = pucData;
+			uxBlock = uxLen;
+		}
+		if (uxBlock > uxLen)
+			uxBlock = uxLen;
+		if (uxBlock > (emberMULTIPART_WRITE_SIZE - pxParser->uxStaged))
+			uxBlock = emberMULTIPART_WRITE_SIZE - pxParser->uxStaged;
+		memcpy(&pucStage[pxParser->uxStaged], pucSrc, uxBlock);
+		pxParser->uxStaged += uxBlock;
+		uxLen -= uxBlock;
+		if (uxHeldOut < pxParser->uxHeld)
+			uxHeldOut += uxBlock;
+		else
+			pucData += uxBlock;
+		if (pxParser->uxStaged == emberMULTIPART_WRITE_SIZE)
+		{
+			pxParser->uxStaged = 0;
+			xRc = pxParser->pxCallback(pxParser->pvArg, eMultipartEvent_PartData,
+				&pxParser->xPart, pucStage, emberMULTIPART_WRITE_SIZE);
+			if (xRc < 0)
+				return xRc;
+		}
+	}
+	return 0;
+}
+
+static BaseType_t prvEndPart(MultipartParser_t *pxParser)
+{
+	BaseType_t xRc;
+	if (pxParser->uxStaged > 0)
+	{
+		xRc = pxParser->pxCallback(pxParser->pvArg, eMultipartEvent_PartData,
+			&pxParser->xPart, (uint8_t *)pxParser->pulStage, pxParser->uxStaged);
+		pxParser->uxStaged = 0;
+		if (xRc < 0)
+			return xRc;
+	}
+	return pxParser->pxCallback(pxParser->pvArg, eMultipartEvent_PartEnd,
+		&pxParser->xPart, NULL, 0);
+}
+
+static BaseType_t prvLine(MultipartParser_t *pxParser, const char cChar)
+{
+	// collects the rest of a boundary line, or a part header line; characters
+	// beyond the size of the line buffer are dropped
+	BaseType_t xRc;
+	if (cChar != '\n')
+	{
+		if (pxParser->uxLineLen < (sizeof(pxParser->pcLine) - 1))
+			pxParser->pcLine[pxParser->uxLineLen++] = cChar;
+		// "--" straight after a boundary marks the end of the body
+		if (pxParser->eState == eMultipartState_Boundary
+			&& pxParser->uxLineLen == 2
+			&& memcmp(pxParser->pcLine, "--", 2) == 0)
+		{
+			pxParser->eState = eMultipartState_Epilogue;
+		}
+		return 0;
+	}
+	if (pxParser->uxLineLen > 0 && pxParser->pcLine[pxParser->uxLineLen - 1] == '\r')
+		pxParser->uxLineLen--;
+	pxParser->pcLine[pxParser->uxLineLen] = 0;
+	if (pxParser->eState == eMultipartState_Boundary)
+	{
+		// only (transport) padding may follow a boundary
+		if (pxParser->pcLine[strspn(pxParser->pcLine, " \t")] != 0)
+			return -pdFREERTOS_ERRNO_EINVAL;
+		memset(&pxParser->xPart, 0, sizeof(pxParser->xPart));
+		pxParser->eState = eMultipartState_Headers;
+	}
+	else if (pxParser->uxLineLen == 0)
+	{
+		// an empty line ends the part's headers
+		pxParser->uxStaged = 0;
+		pxParser->eState = eMultipartState_Content;
+		xRc = pxParser->pxCallback(pxParser->pvArg, eMultipartEvent_PartStart,
+			&pxParser->xPart, NULL, 0);
+		if (xRc < 0)
+			return xRc;
+	}
+	else
+		prvParseHeader(pxParser);
+	pxParser->uxLineLen = 0;
+	return 0;
+}
+
+static void prvParseHeader(MultipartParser_t *pxParser)
+{
+	char *pcValue = strchr(pxParser->pcLine, ':');
+	char *pcBase, *pcBackslash;
+	if (!pcValue)
+		return;
+	*pcValue++ = 0;
+	pcValue += strspn(pcValue, " \t");
+	if (strcasecmp(pxParser->pcLine, "Content-Disposition") == 0)
+	{
+		prvHeaderParam(pcValue, "name", pxParser->xPart.pcName,
+			sizeof(pxParser->xPart.pcName), pdTRUE);
+		// a full path sent by a Windows browser, e.g. "C:\dir\x.bin", has
+		// backslashes that are not escapes, so they are kept for the basename
+		prvHeaderParam(pcValue, "filename", pxParser->xPart.pcFilename,
+			sizeof(pxParser->xPart.pcFilename), pdFALSE);
+		pcBase = strrchr(pxParser->xPart.pcFilename, '/');
+		pcBackslash = strrchr(pxParser->xPart.pcFilename, '\\');
+		if (!pcBase || (pcBackslash && pcBackslash > pcBase))
+			pcBase = pcBackslash;
+		if (pcBase)
+			memmove(pxParser->xPart.pcFilename, &pcBase[1], strlen(pcBase));
+	}
+	else if (strcasecmp(pxParser->pcLine, "Content-Type") == 0)
+	{
+		strncpy(pxParser->xPart.pcContentType, pcValue,
+			sizeof(pxParser->xPart.pcContentType) - 1);
+	}
+}
+
+static void prvHeaderParam(
+	const char *pcParams,
+	const char *pcKey,
+	char *pcDst,
+	const size_t uxMax,
+	const BaseType_t xEscapes)
+{
+	// finds `key=value` or `key="value"` among the `;`-separated parameters
+	const size_t uxKeyLen = strlen(pcKey);
+	size_t uxLen = 0;
+	const char *pcNext = strchr(pcParams, ';');
+	while (pcNext)
+	{
+		pcNext++;
+		pcNext += strspn(pcNext, " \t");
+		if (strncasecmp(pcNext, pcKey, uxKeyLen) == 0 && pcNext[uxKeyLen] == '=')
+		{
+			pcNext += uxKeyLen + 1;
+			if (*pcNext == '"')
+			{
+				pcNext++;
+				while (*pcNext && *pcNext != '"' && uxLen < (uxMax - 1))
+				{
+					if (xEscapes && *pcNext == '\\' && pcNext[1])
+						pcNext++;
+					pcDst[uxLen++] = *pcNext++;
+				}
+			}
+			else
+			{
+				while (*pcNext && *pcNext != ';' && *pcNext != ' '
+					&& uxLen < (uxMax - 1))
+					pcDst[uxLen++] = *pcNext++;
+			}
+			break;
+		}
+		pcNext = strchr(pcNext, ';');
+	}
+	pcDst[uxLen] = 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include "inc/ssed.h"
+#include <string.h>
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+static const char pcEventField[] = "event: ";
+static const char pcDataField[] = "data: ";
+static const char pcKeepAlive[] = ":\n\n";
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static size_t prvRecordSize(
+	const char *pcEvent,
+	const char *pcData,
+	const size_t uxLen);
+static uint32_t prvRingPut(
+	EventStream_t *pxStream,
+	uint32_t ulPos,
+	const char *pcSrc,
+	const size_t uxLen);
+
+/*===============================================
+ private global variables
+ ===============================================*/
+
+static EventStream_t *pxEventStreams = NULL;
+
+/*===============================================
+ public objects
+ ===============================================*/
+
+/*===============================================
+ external objects
+ ===============================================*/
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+BaseType_t xSsedWork(void *pxc)
+{
+	SseClient_t *pxClient = (SseClient_t *)pxc;
+	EventStream_t *pxStream = pxClient->pxStream;
+	uint32_t ulAvail;
+	size_t uxOffset, uxBlock, uxSent = 0;
+	BaseType_t xRc;
+	// an event stream is one-way; anything received from the client is discarded
+	xRc = FreeRTOS_recv(pxClient->xSock, (void *)pxClient->pxParent->pcRcvBuff,
+						sizeof(pxClient->pxParent->pcRcvBuff), 0);
+	if (xRc < 0)
+		return xRc;
+	xRc = 0;
+	// never wait for a publishing task; try again on the next pass instead
+	if ((pxClient->ulCursor != pxStream->ulHead) && (xSemaphoreTake(pxStream->xMutex, 0) == pdTRUE))
+	{
+		ulAvail = pxStream->ulHead - pxClient->ulCursor;
+		if (ulAvail > pxStream->uxSize)
+		{
+			// unsent records have been overwritten; the browser will reconnect
+			xSemaphoreGive(pxStream->xMutex);
+			return -pdFREERTOS_ERRNO_ENOBUFS;
+		}
+		while (ulAvail > 0)
+		{
+			uxOffset = pxClient->ulCursor & (pxStream->uxSize - 1);
+			uxBlock = pxStream->uxSize - uxOffset;
+			if (uxBlock > ulAvail)
+				uxBlock = ulAvail;
+			xRc = FreeRTOS_send(pxClient->xSock, &pxStream->pcBuffer[uxOffset],
+								uxBlock, 0);
+			if (xRc <= 0)
+				break;
+			pxClient->ulCursor += (uint32_t)xRc;
+			ulAvail -= (uint32_t)xRc;
+			uxSent += (size_t)xRc;
+			if ((size_t)xRc < uxBlock)
+				break;
+		}
+		xSemaphoreGive(pxStream->xMutex);
+		if (xRc < 0)
+			return xRc;
+	}
+	if (uxSent > 0)
+	{
+		pxClient->xLastSend = xTaskGetTickCount();
+	}
+	else if ((pxClient->ulCursor == pxStream->ulHead)
+			 && ((xTaskGetTickCount() - pxClient->xLastSend) >= pdMS_TO_TICKS(emberSSE_KEEPALIVE_MS))
+			 && (FreeRTOS_tx_space(pxClient->xSock) >= (BaseType_t)(sizeof(pcKeepAlive) - 1)))
+	{
+		// a comment line keeps intermediaries from timing out an idle stream
+		xRc = FreeRTOS_send(pxClient->xSock, pcKeepAlive, sizeof(pcKeepAlive) - 1, 0);
+		if (xRc < 0)
+			return xRc;
+		pxClient->xLastSend = xTaskGetTickCount();
+		uxSent = (size_t)xRc;
+	}
+	// wake up the EMBER task as soon as the rest of the stream may be written
+	if (pxClient->ulCursor != pxStream->ulHead)
+		FreeRTOS_FD_SET(pxClient->xSock, pxClient->pxParent->xSockSet, eSELECT_WRITE);
+	else
+		FreeRTOS_FD_CLR(pxClient->xSock, pxClient->pxParent->xSockSet, eSELECT_WRITE);
+	return (BaseType_t)uxSent;
+}
+
+EventStream_t *pxEventStreamCreate(const char *pcName, const size_t uxSize)
+{
+	EventStream_t *pxStream;
+	if ((uxSize == 0) || ((uxSize & (uxSize - 1)) != 0))
+		return NULL;
+	pxStream = (EventStream_t *)pvPortMalloc(sizeof(EventStream_t) + uxSize);
+	if (!pxStream)
+		return NULL;
+	pxStream->xMutex = xSemaphoreCreateMutex();
+	if (!pxStream->xMutex)
+	{
+		vPortFree(pxStream);
+		return NULL;
+	}
+	pxStream->pcName = pcName;
+	pxStream->uxSize = uxSize;
+	pxStream->ulHead = 0;
+	taskENTER_CRITICAL();
+	pxStream->pxNext = pxEventStreams;
+	pxEventStreams = pxStream;
+	taskEXIT_CRITICAL();
+	return pxStream;
+}
+
+EventStream_t *pxEventStreamFind(const char *pcName)
+{
+	EventStream_t *pxStream = pxEventStreams;
+	while (pxStream)
+	{
+		if (strcmp(pxStream->pcName, pcName) == 0)
+			return pxStream;
+		pxStream = pxStream->pxNext;
+	}
+	return NULL;
+}
+
+BaseType_t xEventStreamPublish(
+	EventStream_t *pxStream,
+	const char *pcEvent,
+	const char *pcData,
+	size_t uxLen)
+{
+	const char *pcLine, *pcEnd, *pcEol;
+	size_t uxRecordSz;
+	uint32_t ulPos;
+	if (uxLen == 0)
+		uxLen = strlen(pcData);
+	// a trailing newline would otherwise produce an empty `data:` line
+	if ((uxLen > 0) && (pcData[uxLen - 1] == '\n'))
+		uxLen--;
+	uxRecordSz = prvRecordSize(pcEvent, pcData, uxLen);
+	if (uxRecordSz > pxStream->uxSize)
+		return -pdFREERTOS_ERRNO_ENOBUFS;
+	xSemaphoreTake(pxStream->xMutex, portMAX_DELAY);
+	ulPos = pxStream->ulHead;
+	if (pcEvent)
+	{
+		ulPos = prvRingPut(pxStream, ulPos, pcEventField, sizeof(pcEventField) - 1);
+		ulPos = prvRingPut(pxStream, ulPos, pcEvent, strlen(pcEvent));
+		ulPos = prvRingPut(pxStream, ulPos, "\n", 1);
+	}
+	pcLine = pcData;
+	pcEnd = &pcData[uxLen];
+	do
+	{
+		pcEol = memchr(pcLine, '\n', (size_t)(pcEnd - pcLine));
+		if (!pcEol)
+			pcEol = pcEnd;
+		ulPos = prvRingPut(pxStream, ulPos, pcDataField, sizeof(pcDataField) - 1);
+		ulPos = prvRingPut(pxStream, ulPos, pcLine, (size_t)(pcEol - pcLine));
+		ulPos = prvRingPut(pxStream, ulPos, "\n", 1);
+		pcLine = pcEol + 1;
+	} while (pcEol < pcEnd);
+	ulPos = prvRingPut(pxStream, ulPos, "\n", 1);
+	// the record only becomes visible to connections once it is complete
+	pxStream->ulHead = ulPos;
+	xSemaphoreGive(pxStream->xMutex);
+	return (BaseType_t)uxRecordSz;
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+static size_t prvRecordSize(
+	const char *pcEvent,
+	const char *pcData,
+	const size_t uxLen)
+{
+	size_t uxSz = sizeof(pcDataField) - 1 + 1 + uxLen + 1;
+	const char *pcp = pcData, *pcEnd = &pcData[uxLen];
+	if (pcEvent)
+		uxSz += sizeof(pcEventField) - 1 + strlen(pcEvent) + 1;
+	// each embedded newline starts another `data:` line
+	while ((pcp = memchr(pcp, '\n', (size_t)(pcEnd - pcp))) != NULL)
+	{
+		uxSz += sizeof(pcDataField) - 1;
+		pcp++;
+	}
+	return uxSz;
+}
+
+static uint32_t prvRingPut(
+	EventStream_t *pxStream,
+	uint32_t ulPos,
+	const char *pcSrc,
+	const size_t uxLen)
+{
+	size_t uxOffset = ulPos & (pxStream->uxSize - 1);
+	size_t uxBlock = pxStream->uxSize - uxOffset;
+	if (uxBlock > uxLen)
+		uxBlock = uxLen;
+	memcpy(&pxStream->pcBuffer[uxOffset], pcSrc, uxBlock);
+	memcpy(pxStream->pcBuffer, &pcSrc[uxBlock], uxLen - uxBlock);
+	return ulPos + (uint32_t)uxLen;
+}
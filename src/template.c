@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include "inc/template.h"
+#include <string.h>
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+/* the window must hold the largest opcode: a loop with the longest name */
+#if (emberTEMPLATE_READ_SIZE < (emberTEMPLATE_NAME_SIZE + 6))
+#error "emberTEMPLATE_READ_SIZE is too small for emberTEMPLATE_NAME_SIZE"
+#endif
+
+/*===============================================
+ private data prototypes
+ ===============================================*/
+
+/*===============================================
+ private function prototypes
+ ===============================================*/
+
+static BaseType_t prvFetch(TemplateRender_t *pxRender, const size_t uxLen);
+static BaseType_t prvFetchName(TemplateRender_t *pxRender, const size_t uxExtra);
+static uint32_t prvGetU32(const uint8_t *pucSrc);
+
+/*===============================================
+ private global variables
+ ===============================================*/
+
+/*===============================================
+ public objects
+ ===============================================*/
+
+/*===============================================
+ external objects
+ ===============================================*/
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+TemplateRender_t *pxTemplateStart(
+	FF_FILE *pxFile,
+	TemplateCallback_t pxCallback,
+	void *pvArg)
+{
+	TemplateRender_t *pxRender;
+	pxRender = (TemplateRender_t *)pvPortMalloc(sizeof(TemplateRender_t));
+	if (!pxRender)
+		return NULL;
+	memset(pxRender, 0, sizeof(TemplateRender_t));
+	pxRender->pxFile = pxFile;
+	pxRender->pxCallback = pxCallback;
+	pxRender->pvArg = pvArg;
+	if ((prvFetch(pxRender, TEMPLATE_MAGIC_SZ) != pdTRUE)
+		|| (memcmp(pxRender->pucWindow, TEMPLATE_MAGIC, TEMPLATE_MAGIC_SZ) != 0))
+	{
+		vPortFree(pxRender);
+		return NULL;
+	}
+	pxRender->ulPos = TEMPLATE_MAGIC_SZ;
+	return pxRender;
+}
+
+BaseType_t xTemplateRender(
+	TemplateRender_t *pxRender,
+	char *pcDst,
+	const size_t uxMax)
+{
+	size_t uxOut = 0, uxBlock, uxNameLen;
+	struct xTEMPLATE_LOOP *pxLoop;
+	UBaseType_t uxIteration;
+	const uint8_t *pucOp;
+	BaseType_t xRc;
+	while ((uxOut < uxMax) && !pxRender->xDone)
+	{
+		// finish any value or text that did not fit in the previous output
+		if (pxRender->uxValueOff < pxRender->uxValueLen)
+		{
+			uxBlock = pxRender->uxValueLen - pxRender->uxValueOff;
+			if (uxBlock > (uxMax - uxOut))
+				uxBlock = uxMax - uxOut;
+			memcpy(&pcDst[uxOut], &pxRender->pcValue[pxRender->uxValueOff], uxBlock);
+			pxRender->uxValueOff += uxBlock;
+			uxOut += uxBlock;
+			continue;
+		}
+		if (pxRender->uxTextLeft > 0)
+		{
+			if (prvFetch(pxRender, 1) != pdTRUE)
+				return -pdFREERTOS_ERRNO_EIO;
+			uxBlock = pxRender->uxWinLen - (pxRender->ulPos - pxRender->ulWinPos);
+			if (uxBlock > pxRender->uxTextLeft)
+				uxBlock = pxRender->uxTextLeft;
+			if (uxBlock > (uxMax - uxOut))
+				uxBlock = uxMax - uxOut;
+			memcpy(&pcDst[uxOut], &pxRender->pucWindow[pxRender->ulPos - pxRender->ulWinPos], uxBlock);
+			pxRender->ulPos += uxBlock;
+			pxRender->uxTextLeft -= uxBlock;
+			uxOut += uxBlock;
+			continue;
+		}
+		if (prvFetch(pxRender, 1) != pdTRUE)
+			return -pdFREERTOS_ERRNO_EIO;
+		pucOp = &pxRender->pucWindow[pxRender->ulPos - pxRender->ulWinPos];
+		uxIteration = (pxRender->xDepth > 0) ? pxRender->pxLoops[pxRender->xDepth - 1].uxIteration : 0;
+		switch (pucOp[0])
+		{
+		case eTemplateOp_End:
+			pxRender->xDone = pdTRUE;
+			break;
+		case eTemplateOp_Text:
+			if (prvFetch(pxRender, 3) != pdTRUE)
+				return -pdFREERTOS_ERRNO_EIO;
+			pucOp = &pxRender->pucWindow[pxRender->ulPos - pxRender->ulWinPos];
+			pxRender->uxTextLeft = (size_t)pucOp[1] | ((size_t)pucOp[2] << 8);
+			pxRender->ulPos += 3;
+			break;
+		case eTemplateOp_Value:
+			xRc = prvFetchName(pxRender, 0);
+			if (xRc < 0)
+				return xRc;
+			pxRender->ulPos += 2 + (uint32_t)xRc;
+			xRc = pxRender->pxCallback(pxRender->pvArg, eTemplateQuery_Value,
+									   pxRender->pcName, uxIteration,
+									   pxRender->pcValue, sizeof(pxRender->pcValue));
+			if (xRc < 0)
+				return xRc;
+			// a value that `snprintf` truncated ends with a NUL, which is not rendered
+			pxRender->uxValueLen = ((size_t)xRc < sizeof(pxRender->pcValue)) ? (size_t)xRc : sizeof(pxRender->pcValue) - 1;
+			pxRender->uxValueOff = 0;
+			break;
+		case eTemplateOp_Loop:
+			xRc = prvFetchName(pxRender, 4);
+			if (xRc < 0)
+				return xRc;
+			uxNameLen = (size_t)xRc;
+			pxLoop = (pxRender->xDepth > 0) ? &pxRender->pxLoops[pxRender->xDepth - 1] : NULL;
+			// arriving from the loop's EndLoop starts its next iteration
+			if (pxLoop && (pxLoop->ulBegin == pxRender->ulPos))
+			{
+				pxLoop->uxIteration++;
+			}
+			else
+			{
+				if (pxRender->xDepth >= emberTEMPLATE_MAX_DEPTH)
+					return -pdFREERTOS_ERRNO_EINVAL;
+				pxLoop = &pxRender->pxLoops[pxRender->xDepth++];
+				pxLoop->ulBegin = pxRender->ulPos;
+				pxLoop->uxIteration = 0;
+			}
+			xRc = pxRender->pxCallback(pxRender->pvArg, eTemplateQuery_Loop,
+									   pxRender->pcName, pxLoop->uxIteration,
+									   NULL, 0);
+			if (xRc < 0)
+				return xRc;
+			if (xRc > 0)
+			{
+				pxRender->ulPos += 2 + (uint32_t)uxNameLen + 4;
+			}
+			else
+			{
+				pucOp = &pxRender->pucWindow[pxRender->ulPos - pxRender->ulWinPos];
+				pxRender->ulPos = prvGetU32(&pucOp[2 + uxNameLen]);
+				pxRender->xDepth--;
+			}
+			break;
+		case eTemplateOp_EndLoop:
+			if (prvFetch(pxRender, 5) != pdTRUE)
+				return -pdFREERTOS_ERRNO_EIO;
+			pucOp = &pxRender->pucWindow[pxRender->ulPos - pxRender->ulWinPos];
+			pxRender->ulPos = prvGetU32(&pucOp[1]);
+			break;
+		default:
+			return -pdFREERTOS_ERRNO_EINVAL;
+		}
+	}
+	return (BaseType_t)uxOut;
+}
+
+void vTemplateStop(TemplateRender_t *pxRender)
+{
+	ff_fclose(pxRender->pxFile);
+	vPortFree(pxRender);
+}
+
+/*===============================================
+ private functions
+ ===============================================*/
+
+/* Ensure that `uxLen` bytes from the current position are in the window */
+static BaseType_t prvFetch(TemplateRender_t *pxRender, const size_t uxLen)
+{
+	if ((pxRender->ulPos >= pxRender->ulWinPos)
+		&& ((pxRender->ulPos + uxLen) <= (pxRender->ulWinPos + pxRender->uxWinLen)))
+		return pdTRUE;
+	if (ff_fseek(pxRender->pxFile, (long)pxRender->ulPos, FF_SEEK_SET) != 0)
+		return pdFALSE;
+	pxRender->ulWinPos = pxRender->ulPos;
+	pxRender->uxWinLen = ff_fread(pxRender->pucWindow, 1, sizeof(pxRender->pucWindow),
+								  pxRender->pxFile);
+	return (pxRender->uxWinLen >= uxLen) ? pdTRUE : pdFALSE;
+}
+
+/* Copy the name operand of the current opcode, followed by `uxExtra` bytes of
+ * further operands, into the window; return the length of the name */
+static BaseType_t prvFetchName(TemplateRender_t *pxRender, const size_t uxExtra)
+{
+	const uint8_t *pucOp;
+	size_t uxNameLen;
+	if (prvFetch(pxRender, 2) != pdTRUE)
+		return -pdFREERTOS_ERRNO_EIO;
+	uxNameLen = pxRender->pucWindow[pxRender->ulPos - pxRender->ulWinPos + 1];
+	if (uxNameLen >= sizeof(pxRender->pcName))
+		return -pdFREERTOS_ERRNO_EINVAL;
+	if (prvFetch(pxRender, 2 + uxNameLen + uxExtra) != pdTRUE)
+		return -pdFREERTOS_ERRNO_EIO;
+	pucOp = &pxRender->pucWindow[pxRender->ulPos - pxRender->ulWinPos];
+	memcpy(pxRender->pcName, &pucOp[2], uxNameLen);
+	pxRender->pcName[uxNameLen] = '\0';
+	return (BaseType_t)uxNameLen;
+}
+
+static uint32_t prvGetU32(const uint8_t *pucSrc)
+{
+	return (uint32_t)pucSrc[0] | ((uint32_t)pucSrc[1] << 8)
+		| ((uint32_t)pucSrc[2] << 16) | ((uint32_t)pucSrc[3] << 24);
+}
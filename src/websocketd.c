@@ -47,6 +47,7 @@
  ===============================================*/
 
 #include "inc/websocketd.h"
+#include "inc/wsmask.h"
 #include <string.h>
 
 /*===============================================
@@ -61,10 +62,27 @@
  private function prototypes
  ===============================================*/
 
-static BaseType_t prvParseFrame(WebsocketClient_t *pxClient);
-static BaseType_t prvParseFrameX16(WebsocketClient_t *pxClient);
-static BaseType_t prvParseFrameX64(WebsocketClient_t *pxClient);
+static BaseType_t prvParseHeader(
+	WebsocketClient_t *pxClient,
+	const uint8_t *pucData,
+	const size_t uxLen);
+static BaseType_t prvCheckSequence(WebsocketClient_t *pxClient);
+static BaseType_t prvHandleFrame(WebsocketClient_t *pxClient);
+static BaseType_t prvHandleMessage(WebsocketClient_t *pxClient);
+static BaseType_t prvStartMessage(WebsocketClient_t *pxClient);
+static BaseType_t prvContinueMessage(WebsocketClient_t *pxClient);
+static BaseType_t prvAppendMessage(WebsocketClient_t *pxClient);
+static uint8_t *prvMessageTake(WebsocketClient_t *pxClient);
+static void prvMessageRelease(WebsocketClient_t *pxClient);
+static BaseType_t prvStartStream(WebsocketClient_t *pxClient);
+static BaseType_t prvStreamPayload(
+	WebsocketClient_t *pxClient,
+	uint8_t *pucData,
+	const size_t uxLen);
+static BaseType_t prvFailStream(WebsocketClient_t *pxClient, const BaseType_t xRc);
+static void prvAbortStream(WebsocketClient_t *pxClient, const BaseType_t xStatus);
 static void prvMaskPayload(WebsocketClient_t *pxClient);
+static void prvIndexPayload(WebsocketClient_t *pxClient);
 static BaseType_t prvSendClose(
 	WebsocketClient_t *pxClient,
 	const BaseType_t xCode);
@@ -76,11 +94,27 @@ static BaseType_t prvSendMessageHeader(
 	WebsocketClient_t *pxClient,
 	const eWebsocketOpcode eCode,
 	const size_t uxPayloadSz);
+static BaseType_t prvBuildMessageHeader(
+	char *pcDst,
+	const eWebsocketOpcode eCode,
+	const size_t uxPayloadSz);
+static BaseType_t prvSendMessage(
+	WebsocketClient_t *pxClient,
+	const eWebsocketOpcode eCode,
+	const void *pvPayload,
+	const size_t uxLen);
 
 /*===============================================
  private global variables
  ===============================================*/
 
+#if (emberWEBSOCKET_MESSAGE_BUFFERS > 0)
+// buffers for the reassembly of fragmented messages, and the clients that
+// hold them; they are only used by the EMBER task
+static uint8_t pucMessagePool[emberWEBSOCKET_MESSAGE_BUFFERS][emberWEBSOCKET_MESSAGE_SIZE];
+static WebsocketClient_t *pxMessageOwners[emberWEBSOCKET_MESSAGE_BUFFERS];
+#endif
+
 /*===============================================
  public objects
  ===============================================*/
@@ -95,53 +129,95 @@ static BaseType_t prvSendMessageHeader(
 
 BaseType_t xWebsocketWork(void *pxc)
 {
-	BaseType_t xRc;
+	BaseType_t xRc, xLen, xHeaderSz, xSent = 0;
 	WebsocketClient_t *pxClient = (WebsocketClient_t *)pxc;
-	char *rcvBuff = pxClient->pxParent->pcRcvBuff;
-	size_t rcvBuffSz = emberTCP_RCV_BUFFER_SIZE;
-	xRc = FreeRTOS_recv(pxClient->xSock, (void *)rcvBuff, rcvBuffSz, 0);
-	if (xRc <= 0) // -ve is an error; 0 is "no data received"; either way, return it
-		return xRc;
-	if (((WebsocketHeader_t *)rcvBuff)->xFlags.payLen < 126)
-		xRc = prvParseFrame(pxClient);
-	else if (((WebsocketHeader_t *)rcvBuff)->xFlags.payLen == 126)
-		xRc = prvParseFrameX16(pxClient);
-	else
-		xRc = prvParseFrameX64(pxClient);
-	if (xRc < 0)
-		return -pdFREERTOS_ERRNO_EBADE;
-	switch (pxClient->xFlags.opcode)
+	uint8_t *pucRcvBuff = (uint8_t *)pxClient->pxParent->pcRcvBuff;
+	size_t uxOffset = 0, uxFrameSz;
+	// nothing is copied until the bytes that the frame at the head of the
+	// stream is waiting for have arrived
+	xRc = FreeRTOS_recvcount(pxClient->xSock);
+	if (xRc <= 0 || (size_t)xRc < pxClient->uxRxWant)
+		return (xRc < 0) ? xRc : 0;
+	// the frames are left in the stream until they have been handled, so that
+	// a frame that has only partly arrived is parsed again, whole, later
+	xLen = FreeRTOS_recv(pxClient->xSock, (void *)pucRcvBuff,
+						 emberTCP_RCV_BUFFER_SIZE, FREERTOS_MSG_PEEK);
+	if (xLen <= 0) // -ve is an error; 0 is "no data received"; either way, return it
+		return xLen;
+	pxClient->uxRxWant = 0;
+	while (uxOffset < (size_t)xLen)
 	{
-	case eWSOp_Continue:
-		return 0;
-	case eWSOp_Text:
-		if (pxClient->pxTxtHandler)
-			return pxClient->pxTxtHandler(pxc);
-		else
-			prvSendClose(pxClient, eWS_UNSUPPORTED_DATA);
-		return -1;
-	case eWSOp_Binary:
-		if (pxClient->pxBinHandler)
-			return pxClient->pxBinHandler(pxc);
-		else
-			prvSendClose(pxClient, eWS_UNSUPPORTED_DATA);
-		return -1;
-	case eWSOp_Close:
-		((WebsocketHeader_t *)rcvBuff)->xFlags.fin = 1;
-		FreeRTOS_send(pxClient->xSock, (const void *)rcvBuff,
-					  pxClient->xPayloadSz + sizeof(WebsocketHeader_t), 0);
-		return -1;
-	case eWSOp_Ping:
-		((WebsocketHeader_t *)rcvBuff)->xFlags.opcode = eWSOp_Pong;
-		((WebsocketHeader_t *)rcvBuff)->xFlags.fin = 1;
-		return FreeRTOS_send(pxClient->xSock, (const void *)rcvBuff,
-							 pxClient->xPayloadSz + sizeof(WebsocketHeader_t), 0);
-	case eWSOp_Pong:
-		return 0;
-	default:
-		prvSendClose(pxClient, eWS_PROTOCOL_ERROR);
-		return -1;
+		// the payload of a streamed frame is passed to the sink as it arrives
+		if (pxClient->ullFrameLeft > 0)
+		{
+			uxFrameSz = xLen - uxOffset;
+			if (pxClient->ullFrameLeft < uxFrameSz)
+				uxFrameSz = (size_t)pxClient->ullFrameLeft;
+			xRc = prvStreamPayload(pxClient, &pucRcvBuff[uxOffset], uxFrameSz);
+			if (xRc < 0)
+				return xRc;
+			uxOffset += uxFrameSz;
+			xSent += xRc;
+			continue;
+		}
+		xHeaderSz = prvParseHeader(pxClient, &pucRcvBuff[uxOffset], xLen - uxOffset);
+		if (xHeaderSz < 0 || (xHeaderSz > 0 && prvCheckSequence(pxClient) < 0))
+			return -pdFREERTOS_ERRNO_EBADE;
+		if (xHeaderSz == 0)
+			break;
+		// a frame that continues a streamed message, or that is too large for
+		// the receive buffer, is streamed
+		if ((pxClient->pxSink != NULL && pxClient->xFlags.opcode == eWSOp_Continue)
+			|| (uint64_t)pxClient->xPayloadSz > (size_t)(emberTCP_RCV_BUFFER_SIZE - xHeaderSz))
+		{
+			xRc = prvStartStream(pxClient);
+			if (xRc < 0)
+				return xRc;
+			uxOffset += xHeaderSz;
+			xSent += xRc;
+			continue;
+		}
+		uxFrameSz = xHeaderSz + (size_t)pxClient->xPayloadSz;
+		if (uxFrameSz > xLen - uxOffset)
+		{
+			pxClient->uxRxWant = uxFrameSz;
+			break;
+		}
+		pxClient->pcPayload = (char *)&pucRcvBuff[uxOffset + xHeaderSz];
+		uxOffset += uxFrameSz;
+		xRc = prvHandleFrame(pxClient);
+		if (xRc < 0)
+			return xRc;
+		xSent += xRc;
 	}
+	// discard the frames that were handled from the stream
+	if (uxOffset > 0)
+		FreeRTOS_recv(pxClient->xSock, NULL, uxOffset, 0);
+	return xSent;
+}
+
+BaseType_t xWebsocketDelete(void *pxc)
+{
+	WebsocketClient_t *pxClient = (WebsocketClient_t *)pxc;
+	if (pxClient->pucMessage != NULL)
+		prvMessageRelease(pxClient);
+	prvAbortStream(pxClient, eWS_ABNORMAL_CLOSURE);
+	return 0;
+}
+
+BaseType_t xReceiveWebsocketMessage(
+	void *pxc,
+	WebsocketSink_t pxSink,
+	void *pvArg)
+{
+	WebsocketClient_t *pxClient = (WebsocketClient_t *)pxc;
+	// a message can only be taken while it is offered to the large message
+	// handler, before any of its payload has been received
+	if (pxSink == NULL || pxClient->pcPayload != NULL)
+		return -pdFREERTOS_ERRNO_EINVAL;
+	pxClient->pxSink = pxSink;
+	pxClient->pvSinkArg = pvArg;
+	return 0;
 }
 
 const WebsocketStatusDescriptor_t *const pxGetWebsocketStatusMessage(
@@ -179,12 +255,7 @@ BaseType_t xSendWebsocketTextMessage(
 	const char *msg,
 	const size_t len)
 {
-	WebsocketClient_t *pxClient = (WebsocketClient_t *)pxc;
-	BaseType_t xRc;
-	xRc = prvSendMessageHeader(pxClient, eWSOp_Text, len);
-	if (xRc < 0)
-		return xRc;
-	return prvSendMessagePayload(pxClient, msg, len);
+	return prvSendMessage((WebsocketClient_t *)pxc, eWSOp_Text, msg, len);
 }
 
 BaseType_t xSendWebsocketBinaryMessage(
@@ -192,76 +263,329 @@ BaseType_t xSendWebsocketBinaryMessage(
 	const char *msg,
 	const size_t len)
 {
-	WebsocketClient_t *pxClient = (WebsocketClient_t *)pxc;
-	BaseType_t xRc;
-	xRc = prvSendMessageHeader(pxClient, eWSOp_Binary, len);
-	if (xRc < 0)
-		return xRc;
-	return prvSendMessagePayload(pxClient, msg, len);
+	return prvSendMessage((WebsocketClient_t *)pxc, eWSOp_Binary, msg, len);
 }
 
 /*===============================================
  private functions
  ===============================================*/
 
-static BaseType_t prvParseFrame(WebsocketClient_t *pxClient)
+static BaseType_t prvParseHeader(
+	WebsocketClient_t *pxClient,
+	const uint8_t *pucData,
+	const size_t uxLen)
+{
+	size_t uxHeaderSz = sizeof(WebsocketFlags_t) + sizeof(pxClient->pucMaskKey);
+	uint64_t ullPayloadSz;
+	size_t i;
+	if (uxLen < sizeof(WebsocketFlags_t))
+	{
+		pxClient->uxRxWant = sizeof(WebsocketFlags_t);
+		return 0;
+	}
+	memcpy(&pxClient->xFlags, pucData, sizeof(WebsocketFlags_t));
+	// every frame from a client must be masked, and no extensions are
+	// negotiated; a control frame must not be fragmented, or longer than 125
+	if (!pxClient->xFlags.mask || pxClient->xFlags.rsv != 0
+		|| ((pxClient->xFlags.opcode & 0x8)
+			&& (!pxClient->xFlags.fin || pxClient->xFlags.payLen > 125)))
+	{
+		prvSendClose(pxClient, eWS_PROTOCOL_ERROR);
+		return -1;
+	}
+	if (pxClient->xFlags.payLen == 126)
+		uxHeaderSz += sizeof(uint16_t);
+	else if (pxClient->xFlags.payLen == 127)
+		uxHeaderSz += sizeof(uint64_t);
+	if (uxLen < uxHeaderSz)
+	{
+		pxClient->uxRxWant = uxHeaderSz;
+		return 0;
+	}
+	// the extended payload length is in network byte order
+	ullPayloadSz = pxClient->xFlags.payLen;
+	if (ullPayloadSz >= 126)
+	{
+		ullPayloadSz = 0;
+		for (i = sizeof(WebsocketFlags_t); i < uxHeaderSz - sizeof(pxClient->pucMaskKey); i++)
+			ullPayloadSz = (ullPayloadSz << 8) | pucData[i];
+		if (ullPayloadSz > INT64_MAX)
+		{
+			prvSendClose(pxClient, eWS_PROTOCOL_ERROR);
+			return -1;
+		}
+	}
+	pxClient->xPayloadSz = (int64_t)ullPayloadSz;
+	memcpy(pxClient->pucMaskKey, &pucData[uxHeaderSz - sizeof(pxClient->pucMaskKey)],
+		   sizeof(pxClient->pucMaskKey));
+	return uxHeaderSz;
+}
+
+static BaseType_t prvCheckSequence(WebsocketClient_t *pxClient)
 {
-	char *pcRcvBuff = pxClient->pxParent->pcRcvBuff;
-	WebsocketHeader_t *pxHeader = ((WebsocketHeader_t *)pcRcvBuff);
-	pxClient->pcPayload = &pcRcvBuff[sizeof(WebsocketHeader_t)];
-	pxClient->xPayloadSz = pxHeader->xFlags.payLen;
-	pxClient->xFlags = pxHeader->xFlags;
-	pxClient->usMaskKeyL = pxHeader->usMaskKeyL;
-	pxClient->usMaskKeyU = pxHeader->usMaskKeyU;
-	prvMaskPayload(pxClient);
+	BaseType_t xInMessage = (pxClient->pucMessage != NULL || pxClient->pxSink != NULL);
+	// a continuation needs a message to continue, and a message must not begin
+	// inside another; control frames may come between the fragments
+	if ((pxClient->xFlags.opcode == eWSOp_Continue && !xInMessage)
+		|| ((pxClient->xFlags.opcode == eWSOp_Text
+			 || pxClient->xFlags.opcode == eWSOp_Binary)
+			&& xInMessage))
+	{
+		prvSendClose(pxClient, eWS_PROTOCOL_ERROR);
+		return -1;
+	}
 	return 0;
 }
 
-static BaseType_t prvParseFrameX16(WebsocketClient_t *pxClient)
+static BaseType_t prvHandleFrame(WebsocketClient_t *pxClient)
+{
+	// the fragments of a message are unmasked as they are copied to its
+	// buffer; every other frame is unmasked in place
+	if (pxClient->xFlags.fin && pxClient->xFlags.opcode != eWSOp_Continue)
+		prvMaskPayload(pxClient);
+	switch (pxClient->xFlags.opcode)
+	{
+	case eWSOp_Continue:
+		return prvContinueMessage(pxClient);
+	case eWSOp_Text:
+	case eWSOp_Binary:
+		if (!pxClient->xFlags.fin)
+			return prvStartMessage(pxClient);
+		return prvHandleMessage(pxClient);
+	case eWSOp_Close:
+		// echo the status code, if there is one, and close the connection
+		prvAbortStream(pxClient, (pxClient->xPayloadSz >= 2)
+									 ? (((uint8_t)pxClient->pcPayload[0] << 8)
+										| (uint8_t)pxClient->pcPayload[1])
+									 : eWS_NO_STATUS_RCDV);
+		prvSendMessage(pxClient, eWSOp_Close, pxClient->pcPayload,
+					   (pxClient->xPayloadSz >= 2) ? 2 : 0);
+		return -1;
+	case eWSOp_Ping:
+		// the reply is unmasked, with the ping's application data
+		return prvSendMessage(pxClient, eWSOp_Pong, pxClient->pcPayload,
+							  (size_t)pxClient->xPayloadSz);
+	case eWSOp_Pong:
+		return 0;
+	default:
+		prvSendClose(pxClient, eWS_PROTOCOL_ERROR);
+		return -1;
+	}
+}
+
+static BaseType_t prvHandleMessage(WebsocketClient_t *pxClient)
+{
+	if (pxClient->xFlags.opcode == eWSOp_Text)
+	{
+		if (pxClient->pxTxtHandler)
+		{
+			prvIndexPayload(pxClient);
+			return pxClient->pxTxtHandler(pxClient);
+		}
+	}
+	else if (pxClient->pxBinHandler)
+		return pxClient->pxBinHandler(pxClient);
+	prvSendClose(pxClient, eWS_UNSUPPORTED_DATA);
+	return -1;
+}
+
+static BaseType_t prvStartMessage(WebsocketClient_t *pxClient)
 {
-	char *pcRcvBuff = pxClient->pxParent->pcRcvBuff;
-	WebsocketHeaderX16_t *pxHeader = ((WebsocketHeaderX16_t *)pcRcvBuff);
-	// if we know that the frame doesn't fit in the receive buffer, start the connection close process
-	if (pxHeader->xFlags.payLen > (sizeof(pxClient->pxParent->pcRcvBuff) - sizeof(WebsocketHeaderX16_t)))
+	// a message that could not be handled is refused before it is collected
+	if ((pxClient->xFlags.opcode == eWSOp_Text) ? !pxClient->pxTxtHandler
+												: !pxClient->pxBinHandler)
+	{
+		prvSendClose(pxClient, eWS_UNSUPPORTED_DATA);
+		return -1;
+	}
+	pxClient->pucMessage = prvMessageTake(pxClient);
+	if (pxClient->pucMessage == NULL)
+	{
+		// without any buffers, no fragmented message can ever be received
+		prvSendClose(pxClient, (emberWEBSOCKET_MESSAGE_BUFFERS > 0)
+								   ? eWS_TRY_AGAIN_LATER
+								   : eWS_MESSAGE_TOO_BIG);
+		return -1;
+	}
+	pxClient->ucMessageOp = pxClient->xFlags.opcode;
+	pxClient->uxMessageSz = 0;
+	return prvAppendMessage(pxClient);
+}
+
+static BaseType_t prvContinueMessage(WebsocketClient_t *pxClient)
+{
+	BaseType_t xRc = prvAppendMessage(pxClient);
+	if (xRc < 0 || !pxClient->xFlags.fin)
+		return xRc;
+	// the handler sees the whole message, as if it had arrived in one frame
+	pxClient->xFlags.opcode = pxClient->ucMessageOp;
+	pxClient->pcPayload = (char *)pxClient->pucMessage;
+	pxClient->xPayloadSz = pxClient->uxMessageSz;
+	xRc = prvHandleMessage(pxClient);
+	prvMessageRelease(pxClient);
+	return xRc;
+}
+
+static BaseType_t prvAppendMessage(WebsocketClient_t *pxClient)
+{
+	if ((uint64_t)pxClient->xPayloadSz > emberWEBSOCKET_MESSAGE_SIZE - pxClient->uxMessageSz)
 	{
 		prvSendClose(pxClient, eWS_MESSAGE_TOO_BIG);
 		return -1;
 	}
-	pxClient->pcPayload = &pcRcvBuff[sizeof(WebsocketHeaderX16_t)];
-	pxClient->xPayloadSz = pxHeader->usPayLenX16;
-	pxClient->xFlags = pxHeader->xFlags;
-	pxClient->usMaskKeyL = pxHeader->usMaskKeyL;
-	pxClient->usMaskKeyU = pxHeader->usMaskKeyU;
-	prvMaskPayload(pxClient);
+	vWebsocketUnmask(&pxClient->pucMessage[pxClient->uxMessageSz],
+					 (const uint8_t *)pxClient->pcPayload,
+					 (size_t)pxClient->xPayloadSz, pxClient->pucMaskKey, 0);
+	pxClient->uxMessageSz += (size_t)pxClient->xPayloadSz;
 	return 0;
 }
 
-static BaseType_t prvParseFrameX64(WebsocketClient_t *pxClient)
+static uint8_t *prvMessageTake(WebsocketClient_t *pxClient)
 {
-	// never accept large frames: respond with a "1009 message too big" closing frame
-	prvSendClose(pxClient, eWS_MESSAGE_TOO_BIG);
-	return -1;
+#if (emberWEBSOCKET_MESSAGE_BUFFERS > 0)
+	size_t i;
+	for (i = 0; i < emberWEBSOCKET_MESSAGE_BUFFERS; i++)
+	{
+		if (pxMessageOwners[i] == NULL)
+		{
+			pxMessageOwners[i] = pxClient;
+			return pucMessagePool[i];
+		}
+	}
+#endif
+	return NULL;
 }
 
-static void prvMaskPayload(WebsocketClient_t *pxClient)
+static void prvMessageRelease(WebsocketClient_t *pxClient)
+{
+#if (emberWEBSOCKET_MESSAGE_BUFFERS > 0)
+	size_t i;
+	for (i = 0; i < emberWEBSOCKET_MESSAGE_BUFFERS; i++)
+	{
+		if (pxMessageOwners[i] == pxClient)
+			pxMessageOwners[i] = NULL;
+	}
+#endif
+	pxClient->pucMessage = NULL;
+	pxClient->uxMessageSz = 0;
+}
+
+static BaseType_t prvStartStream(WebsocketClient_t *pxClient)
+{
+	BaseType_t xRc = 0;
+	if (pxClient->pxSink == NULL)
+	{
+		// only a binary message, offered to the large message handler before
+		// any of it is received, can be taken by a sink
+		if (pxClient->xFlags.opcode != eWSOp_Binary || pxClient->pxLargeHandler == NULL)
+		{
+			prvSendClose(pxClient, eWS_MESSAGE_TOO_BIG);
+			return -1;
+		}
+		pxClient->pcPayload = NULL;
+		xRc = pxClient->pxLargeHandler(pxClient);
+		if (xRc < 0)
+			return xRc;
+		if (pxClient->pxSink == NULL)
+		{
+			prvSendClose(pxClient, eWS_MESSAGE_TOO_BIG);
+			return -1;
+		}
+	}
+	pxClient->ullFrameLeft = (uint64_t)pxClient->xPayloadSz;
+	// an empty last fragment ends the message at once
+	if (pxClient->ullFrameLeft == 0 && pxClient->xFlags.fin)
+		return prvStreamPayload(pxClient, NULL, 0);
+	return xRc;
+}
+
+static BaseType_t prvStreamPayload(
+	WebsocketClient_t *pxClient,
+	uint8_t *pucData,
+	const size_t uxLen)
 {
-	uint16_t *pusMaskptr = (uint16_t *)pxClient->pcPayload;
-	while (pusMaskptr < (uint16_t *)(&pxClient->pcPayload[pxClient->xPayloadSz]))
+	WebsocketSink_t pxSink = pxClient->pxSink;
+	BaseType_t xRc = 0, xEnd;
+	if (uxLen > 0)
 	{
-		*pusMaskptr++ ^= pxClient->usMaskKeyL;
-		*pusMaskptr++ ^= pxClient->usMaskKeyU;
+		vWebsocketUnmask(pucData, pucData, uxLen, pxClient->pucMaskKey,
+						 (size_t)((uint64_t)pxClient->xPayloadSz - pxClient->ullFrameLeft));
+		pxClient->ullFrameLeft -= uxLen;
+		xRc = pxSink(pxClient, pxClient->pvSinkArg, pucData, uxLen);
+		if (xRc < 0)
+			return prvFailStream(pxClient, xRc);
 	}
+	if (pxClient->ullFrameLeft > 0 || !pxClient->xFlags.fin)
+		return xRc;
+	// the end of the last frame is the end of the message
+	pxClient->pxSink = NULL;
+	xEnd = pxSink(pxClient, pxClient->pvSinkArg, NULL, 0);
+	if (xEnd < 0)
+		return prvFailStream(pxClient, xEnd);
+	return xRc + xEnd;
+}
+
+static BaseType_t prvFailStream(WebsocketClient_t *pxClient, const BaseType_t xRc)
+{
+	// sinks fail with a negated close status, or with any other error; a sink
+	// that has failed is not called again
+	pxClient->pxSink = NULL;
+	pxClient->ullFrameLeft = 0;
+	if (xRc <= -eWS_NORMAL_CLOSURE && xRc >= -4999)
+		prvSendClose(pxClient, -xRc);
+	else
+		prvSendClose(pxClient, eWS_INTERNAL_ERROR);
+	return -1;
+}
+
+static void prvAbortStream(WebsocketClient_t *pxClient, const BaseType_t xStatus)
+{
+	WebsocketSink_t pxSink = pxClient->pxSink;
+	if (pxSink == NULL)
+		return;
+	// the sink is told why the rest of the message will not arrive
+	pxClient->pxSink = NULL;
+	pxClient->ullFrameLeft = 0;
+	pxSink(pxClient, pxClient->pvSinkArg, NULL, (size_t)xStatus);
+}
+
+static void prvMaskPayload(WebsocketClient_t *pxClient)
+{
+	uint8_t *pucData = (uint8_t *)pxClient->pcPayload;
+	vWebsocketUnmask(pucData, pucData, (size_t)pxClient->xPayloadSz,
+					 pxClient->pucMaskKey, 0);
+}
+
+static void prvIndexPayload(WebsocketClient_t *pxClient)
+{
+	pxClient->pxJson = NULL;
+#if (emberJSON_TOKENS > 0)
+	TCPServer_t *pxServer = pxClient->pxParent;
+	if (xJsonParse(&pxServer->xJsonIndex, pxClient->pcPayload,
+				   (size_t)pxClient->xPayloadSz, pxServer->pxJsonTokens,
+				   emberJSON_TOKENS) > 0)
+		pxClient->pxJson = &pxServer->xJsonIndex;
+#endif
 }
 
 static BaseType_t prvSendClose(
 	WebsocketClient_t *pxClient,
 	const BaseType_t xCode)
 {
-	char *pcSndBuff = pxClient->pxParent->pcSndBuff;
-	size_t uxSndBuffSz = sizeof(pxClient->pxParent->pcSndBuff);
-	size_t uxMsglen = snprintf(pcSndBuff, uxSndBuffSz, "%d %s", xCode,
-							   pxGetWebsocketStatusMessage(xCode)->pcText);
-	return FreeRTOS_send(pxClient->xSock, (const void *)pcSndBuff, uxMsglen, 0);
+	// a close frame's payload is the status code, in network byte order,
+	// followed by its description
+	char pcPayload[2 + 24];
+	const WebsocketStatusDescriptor_t *pxStatus = pxGetWebsocketStatusMessage(xCode);
+	size_t uxLen = 2;
+	prvAbortStream(pxClient, xCode);
+	pcPayload[0] = (char)(xCode >> 8);
+	pcPayload[1] = (char)xCode;
+	if (pxStatus->xLen > 0 && (size_t)pxStatus->xLen <= sizeof(pcPayload) - uxLen)
+	{
+		memcpy(&pcPayload[uxLen], pxStatus->pcText, pxStatus->xLen);
+		uxLen += pxStatus->xLen;
+	}
+	return prvSendMessage(pxClient, eWSOp_Close, pcPayload, uxLen);
 }
 
 static BaseType_t prvSendMessageHeader(
@@ -269,34 +593,69 @@ static BaseType_t prvSendMessageHeader(
 	const eWebsocketOpcode eCode,
 	const size_t uxPayloadSz)
 {
-	BaseType_t xRc;
 	char buff[sizeof(WebsocketSendHeaderX16_t)];
+	BaseType_t xHeaderSz = prvBuildMessageHeader(buff, eCode, uxPayloadSz);
+	if (xHeaderSz < 0)
+	{
+		prvSendClose(pxClient, eWS_INTERNAL_ERROR);
+		return -1;
+	}
+	return FreeRTOS_send(pxClient->xSock, (const void *)buff, xHeaderSz, 0);
+}
+
+static BaseType_t prvBuildMessageHeader(
+	char *pcDst,
+	const eWebsocketOpcode eCode,
+	const size_t uxPayloadSz)
+{
 	if (uxPayloadSz < 126)
 	{
-		WebsocketSendHeader_t *pxHeader = (WebsocketSendHeader_t *)buff;
+		WebsocketSendHeader_t *pxHeader = (WebsocketSendHeader_t *)pcDst;
 		memset(pxHeader, 0, sizeof(WebsocketSendHeader_t));
 		pxHeader->xFlags.fin = 1;
 		pxHeader->xFlags.opcode = eCode;
 		pxHeader->xFlags.payLen = uxPayloadSz;
-		return FreeRTOS_send(pxClient->xSock, (const void *)buff,
-							 sizeof(WebsocketSendHeader_t), 0);
+		return sizeof(WebsocketSendHeader_t);
 	}
 	else if (uxPayloadSz < 65536)
 	{
-		WebsocketSendHeaderX16_t *pxHeader = (WebsocketSendHeaderX16_t *)buff;
+		WebsocketSendHeaderX16_t *pxHeader = (WebsocketSendHeaderX16_t *)pcDst;
 		memset(pxHeader, 0, sizeof(WebsocketSendHeaderX16_t));
 		pxHeader->xFlags.fin = 1;
 		pxHeader->xFlags.opcode = eCode;
 		pxHeader->xFlags.payLen = 126;
 		pxHeader->usPayLenX16 = FreeRTOS_htons(uxPayloadSz);
-		return FreeRTOS_send(pxClient->xSock, (const void *)buff,
-							 sizeof(WebsocketSendHeaderX16_t), 0);
+		return sizeof(WebsocketSendHeaderX16_t);
 	}
-	else
+	return -1;
+}
+
+static BaseType_t prvSendMessage(
+	WebsocketClient_t *pxClient,
+	const eWebsocketOpcode eCode,
+	const void *pvPayload,
+	const size_t uxLen)
+{
+	// messages may be sent from tasks other than the EMBER task, so a small
+	// message is assembled on the stack rather than in the server's send
+	// buffer, and then sent with its header in a single call
+	char pcMsg[sizeof(WebsocketSendHeaderX16_t) + emberWEBSOCKET_CORK_SIZE];
+	BaseType_t xRc, xHeaderSz;
+	if (uxLen <= emberWEBSOCKET_CORK_SIZE)
 	{
-		prvSendClose(pxClient, eWS_INTERNAL_ERROR);
-		return -1;
+		xHeaderSz = prvBuildMessageHeader(pcMsg, eCode, uxLen);
+		memcpy(&pcMsg[xHeaderSz], pvPayload, uxLen);
+		xRc = FreeRTOS_send(pxClient->xSock, (const void *)pcMsg,
+							xHeaderSz + uxLen, 0);
+		if (xRc < 0)
+			return xRc;
+		// as for a separate header and payload, report only the payload
+		return (xRc > xHeaderSz) ? xRc - xHeaderSz : 0;
 	}
+	xRc = prvSendMessageHeader(pxClient, eCode, uxLen);
+	if (xRc < 0)
+		return xRc;
+	return prvSendMessagePayload(pxClient, pvPayload, uxLen);
 }
 
 static BaseType_t prvSendMessagePayload(
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2024 Mark R. Turner.  All Rights Reserved.
+ *
+ * The Ember ("EMBedded c webservER") server code is based on the FreeRTOS Labs
+ * TCP protocols example at
+ * https://github.com/FreeRTOS/FreeRTOS/blob/main/FreeRTOS-Plus/Demo/Common/Demo_IP_Protocols/Common/FreeRTOS_TCP_server.c
+ * (and associated directories).
+ *
+ * For that reason, the FreeRTOS licence is reproduced below.  However, the
+ * reader should be aware that the author has undertaken considerable additional
+ * work to extend both the core TCP server and the protocol implementations.
+ *
+ * In any case, the additional work is released under the same MIT licence as the
+ * FreeRTOS Labs demonstration code.
+ *
+ * ===============================================================================
+ * FreeRTOS V202212.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ * ===============================================================================
+ *
+ * MIT Licence
+ * ============
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*===============================================
+ includes
+ ===============================================*/
+
+#include <string.h>
+#include "inc/wsmask.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/*===============================================
+ private constants
+ ===============================================*/
+
+/* The width of the words of the bulk loop, i.e. of the target's registers */
+#define WSMASK_WORD_SZ             (sizeof(size_t))
+/* The shortest block whose destination is aligned before the bulk loop */
+#define WSMASK_ALIGN_MIN           (64)
+
+/*===============================================
+ public functions
+ ===============================================*/
+
+void vWebsocketUnmask(
+	uint8_t *pucDst,
+	const uint8_t *pucSrc,
+	size_t uxLen,
+	const uint8_t *pucKey,
+	size_t uxPhase)
+{
+	uint8_t pucKeys[8];
+	uint32_t ulKey;
+	size_t uxWord, uxKey, i;
+	uxPhase &= 3;
+	// the head, up to the destination's first word boundary; a short payload
+	// is not worth aligning
+	while (uxLen >= WSMASK_ALIGN_MIN && ((uintptr_t)pucDst & (WSMASK_WORD_SZ - 1)) != 0)
+	{
+		*pucDst++ = *pucSrc++ ^ pucKey[uxPhase];
+		uxPhase = (uxPhase + 1) & 3;
+		uxLen--;
+	}
+	// the key, rotated to the phase of the bulk and repeated to the width of
+	// each loop; as each width is a multiple of 4, the phase is the same at
+	// the start of the tail
+	memcpy(pucKeys, pucKey, 4);
+	memcpy(&pucKeys[4], pucKey, 4);
+	memcpy(&ulKey, &pucKeys[uxPhase], sizeof(ulKey));
+#if defined(__SSE2__)
+	const __m128i xKey = _mm_set1_epi32((int)ulKey);
+	for (; uxLen >= 32; uxLen -= 32, pucSrc += 32, pucDst += 32)
+	{
+		__m128i xLo = _mm_loadu_si128((const __m128i *)pucSrc);
+		__m128i xHi = _mm_loadu_si128((const __m128i *)&pucSrc[16]);
+		_mm_storeu_si128((__m128i *)pucDst, _mm_xor_si128(xLo, xKey));
+		_mm_storeu_si128((__m128i *)&pucDst[16], _mm_xor_si128(xHi, xKey));
+	}
+#elif defined(__ARM_NEON)
+	const uint8x16_t xKey = vreinterpretq_u8_u32(vdupq_n_u32(ulKey));
+	for (; uxLen >= 32; uxLen -= 32, pucSrc += 32, pucDst += 32)
+	{
+		vst1q_u8(pucDst, veorq_u8(vld1q_u8(pucSrc), xKey));
+		vst1q_u8(&pucDst[16], veorq_u8(vld1q_u8(&pucSrc[16]), xKey));
+	}
+#endif
+	uxKey = ulKey;
+	if (WSMASK_WORD_SZ > sizeof(ulKey))
+		uxKey |= (uxKey << 16) << 16;
+	// the source need not be aligned with the destination, so the words are
+	// copied, which compiles to single (unaligned) loads and stores
+	for (; uxLen >= WSMASK_WORD_SZ; uxLen -= WSMASK_WORD_SZ)
+	{
+		memcpy(&uxWord, pucSrc, sizeof(uxWord));
+		uxWord ^= uxKey;
+		memcpy(pucDst, &uxWord, sizeof(uxWord));
+		pucSrc += WSMASK_WORD_SZ;
+		pucDst += WSMASK_WORD_SZ;
+	}
+	// the tail
+	for (i = 0; i < uxLen; i++)
+		pucDst[i] = pucSrc[i] ^ pucKeys[uxPhase + (i & 3)];
+}
@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+Pack a directory of web assets into a ROM filesystem image for EMBER.
+
+The image is a C source file that defines `xRomfsImage` (see src/inc/romfs.h):
+a table of the files, sorted by path, with their sizes, content types, entity
+tags and (optionally) gzip-compressed variants, followed by the file data as
+const arrays.  Linked into the application, the files are served by httpd
+straight from flash with `xSendHttpResponseRom`.
+
+Usage:
+  ember_romfs.py <directory> -o <output.c> [--gzip] [--exclude <pattern>]...
+
+Paths in the image are relative to <directory>, with a leading '/', e.g.
+`example/web/static/index.htm` is `/static/index.htm`.
+"""
+
+import argparse
+import fnmatch
+import gzip
+import hashlib
+import os
+import sys
+
+# a superset of `pxTypeCouples` in src/httpd.c
+CONTENT_TYPES = {
+    "htm": "text/html",
+    "html": "text/html",
+    "css": "text/css",
+    "js": "text/javascript",
+    "png": "image/png",
+    "jpg": "image/jpeg",
+    "gif": "image/gif",
+    "ico": "image/x-icon",
+    "svg": "image/svg+xml",
+    "json": "application/json",
+    "txt": "text/plain",
+    "mp3": "audio/mpeg3",
+    "wav": "audio/wav",
+    "flac": "audio/ogg",
+    "pdf": "application/pdf",
+    "ttf": "application/x-font-ttf",
+    "ttc": "application/x-font-ttf",
+}
+DEFAULT_TYPE = "application/octet-stream"
+
+# a gzip variant is only kept if it saves at least this fraction of the file
+GZIP_MIN_SAVING = 0.1
+
+HEADER = """/*
+ * ROM filesystem image generated by tools/ember_romfs.py from "{source}".
+ * Do not edit.
+ */
+
+#include <romfs.h>
+"""
+
+
+def c_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"') \
+        .replace("\r", "\\r").replace("\n", "\\n") + '"'
+
+
+def c_array(name, data):
+    lines = ["static const uint8_t %s[%d] __attribute__((aligned(4))) = {" % (name, max(len(data), 1))]
+    for i in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    if not data:
+        lines.append("    0")
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def collect(source, excludes):
+    files = []
+    for root, dirs, names in os.walk(source):
+        dirs.sort()
+        for name in names:
+            full = os.path.join(root, name)
+            path = "/" + os.path.relpath(full, source).replace(os.sep, "/")
+            if any(fnmatch.fnmatch(path, pattern) for pattern in excludes):
+                continue
+            files.append((path, full))
+    # sorted by the byte values of the UTF-8 path, to match strcmp()
+    files.sort(key=lambda f: f[0].encode("utf-8"))
+    return files
+
+
+def pack(source, use_gzip, excludes):
+    out = [HEADER.format(source=source.replace(os.sep, "/"))]
+    entries = []
+    for index, (path, full) in enumerate(collect(source, excludes)):
+        with open(full, "rb") as f:
+            data = f.read()
+        ext = path.rsplit(".", 1)[-1].lower() if "." in os.path.basename(path) else ""
+        ctype = CONTENT_TYPES.get(ext, DEFAULT_TYPE)
+        etag = '"%s"' % hashlib.sha1(data).hexdigest()[:16]
+        gz = None
+        if use_gzip and data:
+            # mtime=0 keeps the image reproducible
+            candidate = gzip.compress(data, compresslevel=9, mtime=0)
+            if len(candidate) <= len(data) * (1 - GZIP_MIN_SAVING):
+                gz = candidate
+        headers = "ETag: %s\r\n" % etag
+        if gz is not None:
+            headers += "Vary: Accept-Encoding\r\n"
+        out.append("/* %s */" % path)
+        out.append(c_array("pucFile%d" % index, data))
+        if gz is not None:
+            out.append(c_array("pucFile%dGzip" % index, gz))
+        out.append("")
+        entries.append((path, ctype, etag, headers, gz, index, len(data)))
+
+    out.append("static const RomfsEntry_t pxRomfsEntries[] = {")
+    for path, ctype, etag, headers, gz, index, size in entries:
+        out.append("    {")
+        out.append("        %s," % c_string(path))
+        out.append("        %s," % c_string(ctype))
+        out.append("        %s," % c_string(etag))
+        out.append("        %s," % c_string(headers))
+        out.append("        %s," % (c_string(headers + "Content-Encoding: gzip\r\n") if gz is not None else "NULL"))
+        out.append("        pucFile%d, %d," % (index, size))
+        if gz is not None:
+            out.append("        pucFile%dGzip, %d," % (index, len(gz)))
+        else:
+            out.append("        NULL, 0,")
+        out.append("    },")
+    if not entries:
+        out.append("    { 0 },")
+    out.append("};")
+    out.append("")
+    out.append("const RomfsImage_t xRomfsImage = {")
+    out.append("    %d," % len(entries))
+    out.append("    pxRomfsEntries,")
+    out.append("};")
+    out.append("")
+    return "\n".join(out), entries
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("source", help="the directory of web assets")
+    parser.add_argument("-o", "--output", required=True, help="the C source file to generate")
+    parser.add_argument("--gzip", action="store_true",
+                        help="include gzip variants of files that compress well")
+    parser.add_argument("--exclude", action="append", default=[], metavar="PATTERN",
+                        help="omit files whose image path matches PATTERN, e.g. '*.tpl'")
+    args = parser.parse_args(argv)
+    if not os.path.isdir(args.source):
+        print("ember_romfs: %s is not a directory" % args.source, file=sys.stderr)
+        return 1
+    text, entries = pack(args.source, args.gzip, args.exclude)
+    with open(args.output, "w", encoding="utf-8", newline="\n") as f:
+        f.write(text)
+    total = sum(e[6] for e in entries)
+    gzipped = sum(len(e[4]) for e in entries if e[4] is not None)
+    print("%s: %d files, %d bytes (%d bytes of gzip variants)"
+          % (args.output, len(entries), total, gzipped))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""
+Compile EMBER page templates into the opcode stream rendered by httpd.
+
+Template syntax:
+  {{name}}              a value, supplied by the page's template callback
+  {{#name}} ... {{/name}}  a loop section, repeated for as long as the callback
+                        reports another iteration
+  {{!comment}}          a comment, which is removed
+
+A loop or comment tag that is alone on its line is removed with its line.
+
+Usage:
+  ember_tplc.py <template> [-o <output>]   compile a single template
+  ember_tplc.py <directory>                compile every *.tpl file beneath a
+                                           directory, alongside the source
+
+The output of `page.htm.tpl` is `page.htm.tplc`.  The format is described in
+src/inc/template.h and must be kept in step with it.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+MAGIC = b"ETP\x01"
+OP_END, OP_TEXT, OP_VALUE, OP_LOOP, OP_ENDLOOP = range(5)
+
+# must match the emberTEMPLATE_* defaults in src/inc/ember_config_defaults.h
+MAX_NAME_LEN = 31
+MAX_DEPTH = 4
+MAX_TEXT_OP = 0xFFFF
+
+TAG = re.compile(r"\{\{([#/!]?)\s*([^}]*?)\s*\}\}")
+STANDALONE = re.compile(r"^[ \t]*(\{\{[#/!][^}]*\}\})[ \t]*\r?\n", re.MULTILINE)
+NAME = re.compile(r"^[A-Za-z_][A-Za-z0-9_.-]*$")
+
+
+class TemplateError(Exception):
+    pass
+
+
+def _line_of(src, pos):
+    return src.count("\n", 0, pos) + 1
+
+
+def compile_template(src, max_depth=MAX_DEPTH):
+    """Return the compiled opcode stream for the template text `src`."""
+    src = STANDALONE.sub(r"\1", src)
+    out = bytearray(MAGIC)
+    stack = []  # (name, offset of LOOP op, offset of its end operand)
+
+    def emit_text(text):
+        data = text.encode("utf-8")
+        for i in range(0, len(data), MAX_TEXT_OP):
+            block = data[i:i + MAX_TEXT_OP]
+            out.extend(struct.pack("<BH", OP_TEXT, len(block)))
+            out.extend(block)
+
+    def check_name(name, pos):
+        if not NAME.match(name):
+            raise TemplateError("line %d: invalid name '%s'" % (_line_of(src, pos), name))
+        if len(name) > MAX_NAME_LEN:
+            raise TemplateError("line %d: name '%s' longer than %d characters"
+                                % (_line_of(src, pos), name, MAX_NAME_LEN))
+        return name.encode("ascii")
+
+    pos = 0
+    for m in TAG.finditer(src):
+        if m.start() > pos:
+            emit_text(src[pos:m.start()])
+        pos = m.end()
+        kind, name = m.group(1), m.group(2)
+        if kind == "!":
+            continue
+        bname = check_name(name, m.start())
+        if kind == "":
+            out.extend(struct.pack("<BB", OP_VALUE, len(bname)))
+            out.extend(bname)
+        elif kind == "#":
+            if len(stack) >= max_depth:
+                raise TemplateError("line %d: loops nested more than %d deep"
+                                    % (_line_of(src, m.start()), max_depth))
+            loop_at = len(out)
+            out.extend(struct.pack("<BB", OP_LOOP, len(bname)))
+            out.extend(bname)
+            stack.append((name, loop_at, len(out)))
+            out.extend(b"\0\0\0\0")  # patched at the end of the loop
+        else:
+            if not stack or stack[-1][0] != name:
+                raise TemplateError("line %d: unexpected end of loop '%s'"
+                                    % (_line_of(src, m.start()), name))
+            _, loop_at, patch_at = stack.pop()
+            out.extend(struct.pack("<BI", OP_ENDLOOP, loop_at))
+            struct.pack_into("<I", out, patch_at, len(out))
+    if stack:
+        raise TemplateError("loop '%s' is not closed" % stack[-1][0])
+    if pos < len(src):
+        emit_text(src[pos:])
+    out.append(OP_END)
+    return bytes(out)
+
+
+def compile_file(path, output=None):
+    with open(path, "r", encoding="utf-8") as f:
+        src = f.read()
+    try:
+        data = compile_template(src)
+    except TemplateError as e:
+        raise TemplateError("%s: %s" % (path, e))
+    output = output or path + "c"
+    with open(output, "wb") as f:
+        f.write(data)
+    return output
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("source", help="a template file, or a directory of *.tpl files")
+    parser.add_argument("-o", "--output", help="the output file (single template only)")
+    args = parser.parse_args(argv)
+    try:
+        if os.path.isdir(args.source):
+            if args.output:
+                parser.error("--output cannot be used with a directory")
+            for root, _, files in os.walk(args.source):
+                for name in sorted(files):
+                    if name.endswith(".tpl"):
+                        print(compile_file(os.path.join(root, name)))
+        else:
+            print(compile_file(args.source, args.output))
+    except (TemplateError, OSError) as e:
+        print("ember_tplc: %s" % e, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""
+Measure the websocket unmasking kernel on the host.
+
+Builds a small C harness with the host's C compiler, linked with
+src/wsmask.c, and times `vWebsocketUnmask` against the routine that it
+replaced (16-bit steps with two key halves), for a range of payload sizes
+and buffer offsets.  For each size, the kernel is first checked against a
+byte-at-a-time reference at every phase of the mask, and at every source
+and destination offset within 16 bytes, both in place and while copying.
+
+Usage:
+  ember_wsmask_bench.py [--cc <compiler>] [--cflags <flags>] [--bytes <n>]
+
+The kernel uses SSE2 or NEON when the compiler targets them, and otherwise
+the width of `size_t`; e.g. `--cflags "-O2 -mno-sse2"` measures the word
+loop alone, as it runs on a target without SIMD.
+"""
+
+import argparse
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+SIZES = (16, 125, 1024, 16384, 65536)
+OFFSETS = (0, 1, 3)
+
+HARNESS = r"""
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wsmask.h"
+
+/* the routine replaced by vWebsocketUnmask, as it was in src/websocketd.c;
+ * it may write up to 3 bytes past the payload, so the buffer has room.  It is
+ * not inlined, so that both routines are measured as calls */
+__attribute__((noinline)) static void prvOldMask(char *pcPayload, size_t uxLen, uint16_t usKeyL, uint16_t usKeyU)
+{
+    uint16_t *pusMaskptr = (uint16_t *)pcPayload;
+    while (pusMaskptr < (uint16_t *)(&pcPayload[uxLen]))
+    {
+        *pusMaskptr++ ^= usKeyL;
+        *pusMaskptr++ ^= usKeyU;
+    }
+}
+
+/* unmask at every phase of the mask and every offset of the source and the
+ * destination within 16 bytes, both in place and while copying, and compare
+ * with a byte-at-a-time reference; the bytes either side of the destination
+ * must be left alone */
+static int prvCheck(size_t uxSize, const uint8_t *pucKey)
+{
+    uint8_t *pucSrc = malloc(uxSize + 16);
+    uint8_t *pucDst = malloc(uxSize + 48);
+    uint8_t *pucRef = malloc(uxSize);
+    uint8_t *pucOut;
+    size_t uxPhase, uxSrcOff, uxDstOff, i;
+    for (uxPhase = 0; uxPhase < 4; uxPhase++)
+    {
+        for (uxSrcOff = 0; uxSrcOff < 16; uxSrcOff++)
+        {
+            for (i = 0; i < uxSize; i++)
+            {
+                pucSrc[uxSrcOff + i] = (uint8_t)(i * 131 + uxSrcOff + 7);
+                pucRef[i] = pucSrc[uxSrcOff + i] ^ pucKey[(uxPhase + i) & 3];
+            }
+            /* a destination offset of 16 stands for unmasking in place */
+            for (uxDstOff = 0; uxDstOff <= 16; uxDstOff++)
+            {
+                memset(pucDst, 0xa5, uxSize + 48);
+                pucOut = &pucDst[16 + (uxDstOff & 15)];
+                if (uxDstOff == 16)
+                {
+                    pucOut = &pucDst[16 + uxSrcOff];
+                    memcpy(pucOut, &pucSrc[uxSrcOff], uxSize);
+                    vWebsocketUnmask(pucOut, pucOut, uxSize, pucKey, uxPhase);
+                }
+                else
+                    vWebsocketUnmask(pucOut, &pucSrc[uxSrcOff], uxSize, pucKey, uxPhase);
+                if (memcmp(pucOut, pucRef, uxSize) != 0)
+                {
+                    fprintf(stderr, "mismatch at size %zu, phase %zu, source offset %zu, %s\n",
+                            uxSize, uxPhase, uxSrcOff, (uxDstOff == 16) ? "in place" : "copied");
+                    return 1;
+                }
+                for (i = 0; i < uxSize + 48; i++)
+                {
+                    if ((&pucDst[i] < pucOut || &pucDst[i] >= &pucOut[uxSize]) && pucDst[i] != 0xa5)
+                    {
+                        fprintf(stderr, "write outside the destination at size %zu, phase %zu, source offset %zu\n",
+                                uxSize, uxPhase, uxSrcOff);
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    free(pucSrc);
+    free(pucDst);
+    free(pucRef);
+    return 0;
+}
+
+static double prvNow(void)
+{
+    struct timespec xTs;
+    clock_gettime(CLOCK_MONOTONIC, &xTs);
+    return xTs.tv_sec + xTs.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint8_t pucKey[4] = {0x37, 0xfa, 0x21, 0x3d};
+    uint16_t usKeyL, usKeyU;
+    size_t uxSize, uxOffset, uxBytes, uxRounds, i;
+    uint8_t *pucBuff;
+    volatile uint8_t ucSink;
+    double xStart, xOld, xNew;
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <size> <offset> <bytes>\n", argv[0]);
+        return 2;
+    }
+    uxSize = strtoul(argv[1], NULL, 0);
+    uxOffset = strtoul(argv[2], NULL, 0);
+    uxBytes = strtoul(argv[3], NULL, 0);
+    uxRounds = uxBytes / uxSize + 1;
+    pucBuff = malloc(uxSize + uxOffset + 16);
+    memcpy(&usKeyL, &pucKey[0], 2);
+    memcpy(&usKeyU, &pucKey[2], 2);
+    if (uxOffset == 0 && prvCheck(uxSize, pucKey) != 0)
+        return 1;
+    for (i = 0; i < uxSize; i++)
+        pucBuff[uxOffset + i] = (uint8_t)(i * 131 + 7);
+    xStart = prvNow();
+    for (i = 0; i < uxRounds; i++)
+        prvOldMask((char *)&pucBuff[uxOffset], uxSize, usKeyL, usKeyU);
+    xOld = prvNow() - xStart;
+    ucSink = pucBuff[uxOffset];
+    xStart = prvNow();
+    for (i = 0; i < uxRounds; i++)
+        vWebsocketUnmask(&pucBuff[uxOffset], &pucBuff[uxOffset], uxSize, pucKey, i);
+    xNew = prvNow() - xStart;
+    ucSink = pucBuff[uxOffset];
+    (void)ucSink;
+    free(pucBuff);
+    printf("%.1f %.1f\n", uxRounds * uxSize / xOld / 1e6, uxRounds * uxSize / xNew / 1e6);
+    return 0;
+}
+"""
+
+
+def build(cc, cflags, workdir):
+    source = os.path.join(workdir, "bench.c")
+    binary = os.path.join(workdir, "bench")
+    with open(source, "w", encoding="utf-8") as f:
+        f.write(HARNESS)
+    cmd = [cc] + shlex.split(cflags) + [
+        "-I", os.path.join(ROOT, "src", "inc"),
+        source, os.path.join(ROOT, "src", "wsmask.c"),
+        "-o", binary,
+    ]
+    subprocess.run(cmd, check=True)
+    return binary
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--cc", default=os.environ.get("CC", "cc"),
+                        help="the host C compiler (default: $CC or cc)")
+    parser.add_argument("--cflags", default="-O2",
+                        help="flags for the compiler (default: -O2)")
+    parser.add_argument("--bytes", type=int, default=256 * 1024 * 1024,
+                        help="the number of bytes unmasked by each routine per measurement")
+    args = parser.parse_args(argv)
+    with tempfile.TemporaryDirectory() as workdir:
+        try:
+            binary = build(args.cc, args.cflags, workdir)
+        except (OSError, subprocess.CalledProcessError) as e:
+            print("ember_wsmask_bench: build failed: %s" % e, file=sys.stderr)
+            return 1
+        print("%8s %6s %12s %12s %8s" % ("size", "offset", "old MB/s", "new MB/s", "speedup"))
+        for size in SIZES:
+            for offset in OFFSETS:
+                result = subprocess.run([binary, str(size), str(offset), str(args.bytes)],
+                                        capture_output=True, text=True)
+                if result.returncode != 0:
+                    print("ember_wsmask_bench: %s" % result.stderr.strip(), file=sys.stderr)
+                    return 1
+                old, new = (float(v) for v in result.stdout.split())
+                print("%8d %6d %12.1f %12.1f %7.1fx" % (size, offset, old, new, new / old))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())